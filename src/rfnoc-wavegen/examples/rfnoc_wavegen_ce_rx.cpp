@@ -29,23 +29,304 @@
 #include <boost/program_options.hpp>
 #include <boost/format.hpp>
 #include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/atomic.hpp>
 #include <iostream>
-#include <fstream>
 #include <csignal>
+#include <algorithm>
+#include <cstring>
 #include <complex>
+#include <cmath>
+#include <fstream>
 
 #include <uhd/rfnoc/wavegen_block_ctrl.hpp>
+#include <wavegen/sample_recorder.h>
+#include <wavegen/pulse_framer.h>
+#include <wavegen/pulse_file_writer.h>
+#include <wavegen/pulse_ring_writer.h>
+#include <wavegen/buffer_pool.h>
+#include <wavegen/thread_profile.h>
+#include <wavegen/sample_converter.h>
+#include <wavegen/pulse_integrator.h>
+#include <wavegen/matched_filter.h>
+#include <wavegen/range_doppler.h>
+#include <wavegen/cfar_detector.h>
+#include <wavegen/waveform_synth.h>
 
 namespace po = boost::program_options;
 
 static bool stop_signal_called = false;
 void sig_int_handler(int){stop_signal_called = true;}
 
+// Hands a pulse to the pulse file and the shared memory ring, either
+// of which may be absent
+void deliver(
+    gr::wavegen::pulse_file_writer::sptr writer,
+    gr::wavegen::pulse_ring_writer::sptr ring,
+    const gr::wavegen::pulse_framer::pulse_t &pulse
+) {
+    if (writer) {
+        writer->write(pulse);
+    }
+    if (ring) {
+        ring->publish(pulse);
+    }
+}
+
+// Pulse consumer: moves each pulse record out of the framer's ring
+// into the pulse file, which indexes it by number and time, and the
+// shared memory ring. With an integrator they get its records instead.
+void record_pulses(
+    gr::wavegen::pulse_framer::sptr framer,
+    gr::wavegen::pulse_integrator::sptr integrator,
+    gr::wavegen::pulse_file_writer::sptr writer,
+    gr::wavegen::pulse_ring_writer::sptr ring,
+    const boost::atomic<bool> *done
+) {
+    gr::wavegen::pulse_framer::pulse_t pulse, record;
+    for (;;) {
+        if (not framer->front(pulse)) {
+            // The receive loop publishes its last pulse before setting done
+            if (done->load() and not framer->front(pulse)) {
+                break;
+            }
+            if (not framer->front(pulse)) {
+                boost::this_thread::sleep(boost::posix_time::microseconds(100));
+                continue;
+            }
+        }
+        if (not integrator) {
+            deliver(writer, ring, pulse);
+        } else if (integrator->add(pulse, record)) {
+            deliver(writer, ring, record);
+        }
+        framer->pop();
+    }
+    if (integrator and integrator->flush(record)) {
+        deliver(writer, ring, record);
+    }
+}
+
+// Compression feeder: hands each framed pulse (or integrated record)
+// to the matched filter, which copies it, and frees the framer slot.
+// Sets done when the last pulse has been submitted.
+void compress_pulses(
+    gr::wavegen::pulse_framer::sptr framer,
+    gr::wavegen::pulse_integrator::sptr integrator,
+    gr::wavegen::matched_filter::sptr mf,
+    const boost::atomic<bool> *framer_done,
+    boost::atomic<bool> *done
+) {
+    gr::wavegen::pulse_framer::pulse_t pulse, record;
+    for (;;) {
+        if (not framer->front(pulse)) {
+            if (framer_done->load() and not framer->front(pulse)) {
+                break;
+            }
+            if (not framer->front(pulse)) {
+                boost::this_thread::sleep(boost::posix_time::microseconds(100));
+                continue;
+            }
+        }
+        if (not integrator) {
+            mf->submit(pulse);
+        } else if (integrator->add(pulse, record)) {
+            mf->submit(record);
+        }
+        framer->pop();
+    }
+    if (integrator and integrator->flush(record)) {
+        mf->submit(record);
+    }
+    done->store(true);
+}
+
+// Detections go out as one CSV line each
+void write_detections(
+    std::ostream *out,
+    const std::vector<gr::wavegen::cfar_detector::detection_t> &detections
+) {
+    if (not out) {
+        return;
+    }
+    for (size_t i = 0; i < detections.size(); i++) {
+        const gr::wavegen::cfar_detector::detection_t &d = detections[i];
+        *out << boost::format("%d,%.9f,%d,%d,%g,%g\n")
+            % d.index % (d.has_time ? d.time.get_real_secs() : 0.0)
+            % d.range_bin % d.doppler_bin % d.power % d.noise;
+    }
+}
+
+// Compression consumer: records and publishes the compressed pulses
+// in order and adds them to the range-Doppler CPIs, or without CPIs
+// runs the detector on each pulse. Without any of these they are just
+// released.
+void record_compressed(
+    gr::wavegen::matched_filter::sptr mf,
+    gr::wavegen::pulse_file_writer::sptr writer,
+    gr::wavegen::pulse_ring_writer::sptr ring,
+    gr::wavegen::range_doppler::sptr rd,
+    gr::wavegen::cfar_detector::sptr cfar,
+    std::ostream *det_out,
+    const boost::atomic<bool> *done
+) {
+    std::vector<gr::wavegen::cfar_detector::detection_t> detections;
+    gr::wavegen::pulse_framer::pulse_t pulse;
+    for (;;) {
+        if (not mf->front(pulse)) {
+            // done is set after the last submit(), so an empty filter
+            // means every pulse has been through here
+            if (done->load() and mf->size() == 0) {
+                break;
+            }
+            boost::this_thread::sleep(boost::posix_time::microseconds(100));
+            continue;
+        }
+        deliver(writer, ring, pulse);
+        if (rd) {
+            rd->add(pulse);
+        } else if (cfar) {
+            detections.clear();
+            cfar->detect(pulse, detections);
+            write_detections(det_out, detections);
+        }
+        mf->pop();
+    }
+    if (rd) {
+        rd->flush();
+    }
+}
+
+// Range-Doppler consumer: runs the detector on every map and reports
+// the strongest cell of a CPI about once a second, so targets show up
+// while streaming.
+void report_maps(
+    gr::wavegen::range_doppler::sptr rd,
+    gr::wavegen::cfar_detector::sptr cfar,
+    std::ostream *det_out,
+    const boost::atomic<bool> *done
+) {
+    std::vector<gr::wavegen::cfar_detector::detection_t> detections;
+    boost::system_time last_report;
+    gr::wavegen::range_doppler::map_t map;
+    for (;;) {
+        if (not rd->front(map)) {
+            if (done->load() and rd->size() == 0) {
+                break;
+            }
+            boost::this_thread::sleep(boost::posix_time::microseconds(100));
+            continue;
+        }
+        detections.clear();
+        if (cfar) {
+            cfar->detect(map, detections);
+            write_detections(det_out, detections);
+        }
+        const boost::system_time now = boost::get_system_time();
+        if (last_report.is_not_a_date_time() or now - last_report > boost::posix_time::seconds(1)) {
+            const size_t ncells = map.num_bins * map.doppler_size;
+            const size_t cell = std::max_element(map.data, map.data + ncells) - map.data;
+            const double scale = (map.output == gr::wavegen::range_doppler::OUTPUT_POWER) ? 10.0 : 20.0;
+            std::cout << boost::format("CPI %d (%d pulses): peak %.1f dB at range bin %d, %.1f Hz, %d detections")
+                % map.index % map.pulses % (scale * std::log10(std::max(map.data[cell], 1e-20f)))
+                % (cell / map.doppler_size) % rd->doppler_frequency(cell % map.doppler_size)
+                % detections.size() << std::endl;
+            last_report = now;
+        }
+        rd->pop();
+    }
+}
+
+// Conversion consumer: takes the converted blocks in order and copies
+// them into recorder buffers, back to back. Without a recorder the
+// blocks are just released.
+void record_converted(
+    gr::wavegen::sample_converter::sptr converter,
+    gr::wavegen::sample_recorder::sptr recorder,
+    const boost::atomic<bool> *done
+) {
+    const size_t item_size = converter->output_item_size();
+    gr::wavegen::sample_recorder::buffer_t rec_buff;
+    bool have_rec_buff = false;
+    size_t rec_fill = 0;
+    gr::wavegen::sample_converter::block_t block;
+
+    for (;;) {
+        if (not converter->front(block)) {
+            // done is set after the last submit(), so an empty converter
+            // then means everything has been recorded
+            if (done->load() and converter->size() == 0) {
+                break;
+            }
+            boost::this_thread::sleep(boost::posix_time::microseconds(100));
+            continue;
+        }
+        const char *src = static_cast<const char *>(block.samples);
+        size_t left = recorder ? block.nsamps * item_size : 0;
+        while (left > 0) {
+            if (not have_rec_buff) {
+                have_rec_buff = recorder->acquire(rec_buff);
+                rec_fill = 0;
+                if (not have_rec_buff) {
+                    recorder->drop(left);
+                    break;
+                }
+            }
+            const size_t n = std::min(left, rec_buff.size - rec_fill);
+            std::memcpy(rec_buff.data + rec_fill, src, n);
+            rec_fill += n;
+            src += n;
+            left -= n;
+            if (rec_fill == rec_buff.size) {
+                recorder->commit(rec_buff, rec_fill);
+                have_rec_buff = false;
+            }
+        }
+        converter->pop();
+    }
+    if (have_rec_buff) {
+        recorder->commit(rec_buff, rec_fill);
+    }
+}
+
+// Runs fn in a role of the thread profile, if there is one
+void run_as(
+    gr::wavegen::thread_profile::sptr threads,
+    gr::wavegen::thread_profile::role_t role,
+    const std::string &name,
+    boost::function<void()> fn
+) {
+    gr::wavegen::thread_profile::scoped_role scope(threads, role, name);
+    fn();
+}
+
+void print_recorder_stats(const gr::wavegen::sample_recorder::stats_t &rec_stats)
+{
+    std::cout << boost::format(
+        "Recorder: %d bytes in %d buffers, %d writes (%s), slowest write %d us\n"
+        "          %d backpressure waits, most buffers queued %d, %d buffers (%d bytes) dropped")
+        % rec_stats.bytes_written % rec_stats.buffers_written % rec_stats.writes
+        % (rec_stats.direct_io ? "direct" : "buffered") % rec_stats.max_write_us
+        % rec_stats.backpressure_waits % rec_stats.max_queued
+        % rec_stats.buffers_dropped % rec_stats.bytes_dropped << std::endl;
+}
+
 
 template<typename samp_type> void recv_to_file(
     uhd::rx_streamer::sptr rx_stream,
     const std::string &file,
+    const gr::wavegen::sample_recorder::config_t &rec_config,
     size_t samps_per_buff,
+    const gr::wavegen::pulse_file::info_t &pulse_info,
+    gr::wavegen::sample_converter::sptr converter,
+    gr::wavegen::pulse_integrator::sptr integrator,
+    gr::wavegen::matched_filter::sptr mf,
+    gr::wavegen::range_doppler::sptr rd,
+    gr::wavegen::cfar_detector::sptr cfar,
+    const std::string &det_file,
+    const std::string &ring_name,
+    const gr::wavegen::pulse_ring_writer::config_t &ring_config,
     unsigned long long num_requested_samples,
     double time_requested = 0.0,
     bool bw_summary = false,
@@ -53,15 +334,97 @@ template<typename samp_type> void recv_to_file(
     bool continue_on_bad_packet = false
 ) {
     unsigned long long num_total_samps = 0;
+    // The caller has entered the receive role; consumer threads take
+    // theirs from the same profile
+    const gr::wavegen::thread_profile::sptr threads = rec_config.threads;
 
     uhd::rx_metadata_t md;
+    // Disk writes happen on the recorder's threads. We receive straight
+    // into its buffers and only use buff when there is no file or the
+    // recorder had no buffer to give.
     std::vector<samp_type> buff(samps_per_buff);
-    std::ofstream outfile;
-    if (not file.empty()) {
-        outfile.open(file.c_str(), std::ofstream::binary);
+    gr::wavegen::sample_recorder::sptr recorder;
+    if (not file.empty() and pulse_info.rx_len == 0) {
+        recorder = gr::wavegen::sample_recorder::make(file, rec_config);
     }
+    gr::wavegen::sample_recorder::buffer_t rec_buff;
+    bool have_rec_buff = false;
+    size_t rec_fill = 0;
     bool overflow_message = true;
 
+    // With pulse framing we receive into the framer's ring instead, and
+    // a consumer thread moves whole pulses on to an indexed pulse file.
+    // With an integrator the pulses are summed into records first, and
+    // with a matched filter the records go through it and the file
+    // holds range bins. Whatever goes into the file is also published
+    // to the shared memory ring, if there is one, for other processes.
+    gr::wavegen::pulse_framer::sptr framer;
+    gr::wavegen::pulse_file_writer::sptr writer;
+    gr::wavegen::pulse_ring_writer::sptr ring;
+    boost::atomic<bool> framer_done(false);
+    boost::atomic<bool> compress_done(false);
+    boost::atomic<bool> maps_done(false);
+    boost::thread pulse_consumer;
+    boost::thread compress_consumer;
+    boost::thread map_consumer;
+    std::ofstream det_stream;
+    if (cfar and not det_file.empty()) {
+        det_stream.open(det_file.c_str());
+        if (not det_stream) {
+            throw std::runtime_error("Cannot open detection file " + det_file);
+        }
+        det_stream << "index,time,range_bin,doppler_bin,power,noise\n";
+    }
+    std::ostream *det_out = det_stream.is_open() ? &det_stream : NULL;
+    if (pulse_info.rx_len > 0) {
+        gr::wavegen::pulse_framer::config_t framer_config;
+        framer_config.rx_len = pulse_info.rx_len;
+        framer_config.item_size = sizeof(samp_type);
+        framer_config.rate = pulse_info.rate;
+        framer = gr::wavegen::pulse_framer::make(framer_config);
+        gr::wavegen::pulse_file::info_t record_info = pulse_info;
+        if (integrator) {
+            const gr::wavegen::pulse_integrator::config_t integ_config = integrator->get_config();
+            record_info.rx_len = integrator->get_output_len();
+            record_info.format = (integ_config.output == gr::wavegen::pulse_integrator::OUTPUT_SC16) ?
+                gr::wavegen::pulse_file::FORMAT_SC16 : gr::wavegen::pulse_file::FORMAT_FC32;
+            record_info.integrated_pulses = integ_config.num_pulses;
+            record_info.decimation = integ_config.decimation;
+        }
+        if (mf) {
+            record_info.format = gr::wavegen::pulse_file::FORMAT_FC32;
+            record_info.range_compressed = true;
+        }
+        if (not file.empty()) {
+            writer = gr::wavegen::pulse_file_writer::make(file, record_info, rec_config);
+        }
+        if (not ring_name.empty()) {
+            ring = gr::wavegen::pulse_ring_writer::make(ring_name, record_info, ring_config);
+        }
+        if (mf) {
+            pulse_consumer = boost::thread(boost::bind(&run_as, threads, gr::wavegen::thread_profile::ROLE_PROCESS, "pulse feeder",
+                boost::function<void()>(boost::bind(&compress_pulses, framer, integrator, mf, &framer_done, &compress_done))));
+            compress_consumer = boost::thread(boost::bind(&run_as, threads, gr::wavegen::thread_profile::ROLE_WRITE, "compressed writer",
+                boost::function<void()>(boost::bind(&record_compressed, mf, writer, ring, rd, cfar, det_out, &compress_done))));
+            if (rd) {
+                map_consumer = boost::thread(boost::bind(&run_as, threads, gr::wavegen::thread_profile::ROLE_PROCESS, "map reporter",
+                    boost::function<void()>(boost::bind(&report_maps, rd, cfar, det_out, &maps_done))));
+            }
+        } else if (writer or ring) {
+            pulse_consumer = boost::thread(boost::bind(&run_as, threads, gr::wavegen::thread_profile::ROLE_WRITE, "pulse writer",
+                boost::function<void()>(boost::bind(&record_pulses, framer, integrator, writer, ring, &framer_done))));
+        }
+    }
+
+    // With a converter we receive sc16 into its blocks; its workers
+    // convert them and a consumer thread records them in order.
+    boost::atomic<bool> converter_done(false);
+    boost::thread convert_consumer;
+    if (converter) {
+        convert_consumer = boost::thread(boost::bind(&run_as, threads, gr::wavegen::thread_profile::ROLE_WRITE, "converted writer",
+            boost::function<void()>(boost::bind(&record_converted, converter, recorder, &converter_done))));
+    }
+
     //setup streaming
     uhd::stream_cmd_t stream_cmd((num_requested_samples == 0)?
         uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS:
@@ -88,7 +451,29 @@ template<typename samp_type> void recv_to_file(
     ) {
         boost::system_time now = boost::get_system_time();
 
-        size_t num_rx_samps = rx_stream->recv(&buff.front(), buff.size(), md, 3.0);
+        if (recorder and not converter and not have_rec_buff) {
+            have_rec_buff = recorder->acquire(rec_buff);
+            rec_fill = 0;
+        }
+        samp_type *dst = &buff.front();
+        size_t max_samps = buff.size();
+        if (framer) {
+            dst = static_cast<samp_type *>(framer->recv_buffer(max_samps));
+            max_samps = std::min(samps_per_buff, max_samps);
+        } else if (converter) {
+            dst = reinterpret_cast<samp_type *>(converter->acquire());
+            max_samps = std::min(samps_per_buff, converter->get_config().block_samps);
+        } else if (have_rec_buff) {
+            dst = reinterpret_cast<samp_type *>(rec_buff.data + rec_fill);
+            max_samps = std::min(samps_per_buff, (rec_buff.size - rec_fill) / sizeof(samp_type));
+        }
+
+        size_t num_rx_samps = rx_stream->recv(dst, max_samps, md, 3.0);
+        if (framer) {
+            framer->push(num_rx_samps, md);
+        } else if (converter) {
+            converter->submit(num_rx_samps);
+        }
 
         if (md.error_code == uhd::rx_metadata_t::ERROR_CODE_TIMEOUT) {
             std::cout << boost::format("Timeout while streaming") << std::endl;
@@ -97,8 +482,8 @@ template<typename samp_type> void recv_to_file(
         if (md.error_code == uhd::rx_metadata_t::ERROR_CODE_OVERFLOW){
             if (overflow_message){
                 overflow_message = false;
-                std::cerr << "Got an overflow indication. If writing to disk, your\n"
-                             "write medium may not be able to keep up.\n";
+                std::cerr << "Got an overflow indication. If writing to disk, check the\n"
+                             "recorder statistics below for backpressure or drops.\n";
             }
             continue;
         }
@@ -114,8 +499,14 @@ template<typename samp_type> void recv_to_file(
         }
         num_total_samps += num_rx_samps;
 
-        if (outfile.is_open()) {
-            outfile.write((const char*)&buff.front(), num_rx_samps*sizeof(samp_type));
+        if (have_rec_buff) {
+            rec_fill += num_rx_samps*sizeof(samp_type);
+            if (rec_buff.size - rec_fill < sizeof(samp_type)) {
+                recorder->commit(rec_buff, rec_fill);
+                have_rec_buff = false;
+            }
+        } else if (recorder and not converter) {
+            recorder->drop(num_rx_samps*sizeof(samp_type));
         }
 
         if (bw_summary) {
@@ -125,6 +516,11 @@ template<typename samp_type> void recv_to_file(
                 double t = (double)update_diff.ticks() / (double)boost::posix_time::time_duration::ticks_per_second();
                 double r = (double)last_update_samps / t;
                 std::cout << boost::format("\t%f Msps") % (r/1e6) << std::endl;
+                if (ring) {
+                    const gr::wavegen::pulse_ring_writer::stats_t ring_stats = ring->get_stats();
+                    std::cout << boost::format("\tring: %d consumers, %d lagging, largest lag %d records")
+                        % ring_stats.consumers % ring_stats.lagging_consumers % ring_stats.max_lag << std::endl;
+                }
                 last_update_samps = 0;
                 last_update = now;
             }
@@ -142,8 +538,121 @@ template<typename samp_type> void recv_to_file(
     rx_stream->issue_stream_cmd(stream_cmd);
     std::cout << "Done" << std::endl;
 
-    if (outfile.is_open())
-        outfile.close();
+    if (framer) {
+        framer->flush();
+        framer_done.store(true);
+        if (pulse_consumer.joinable()) {
+            pulse_consumer.join();
+        }
+        const gr::wavegen::pulse_framer::stats_t framer_stats = framer->get_stats();
+        std::cout << boost::format(
+            "Pulses: %d framed of %d samples, %d truncated, %d discontinuities, %d dropped")
+            % framer_stats.pulses % pulse_info.rx_len % framer_stats.truncated
+            % framer_stats.discontinuities % framer_stats.dropped << std::endl;
+    }
+
+    // Each stage's cut in bytes: the FPGA's is nominal, from the record
+    // shape; the host integrator counts what went through it
+    if (integrator or pulse_info.integrated_pulses * pulse_info.decimation > 1) {
+        const double fpga_ratio = double(pulse_info.integrated_pulses) * pulse_info.decimation;
+        double host_ratio = 1.0;
+        if (integrator) {
+            const gr::wavegen::pulse_integrator::stats_t integ_stats = integrator->get_stats();
+            host_ratio = integ_stats.bytes_out ? double(integ_stats.bytes_in) / integ_stats.bytes_out : 0.0;
+            std::cout << boost::format(
+                "Integrator: %d pulses into %d records of %d samples, %d pulses missing, %d late\n"
+                "            %d bytes in, %d out, %.2f us per pulse")
+                % integ_stats.pulses % integ_stats.records % integrator->get_output_len()
+                % integ_stats.missing_pulses % integ_stats.late_pulses
+                % integ_stats.bytes_in % integ_stats.bytes_out
+                % (integ_stats.pulses ? integ_stats.process_ns / 1e3 / integ_stats.pulses : 0.0) << std::endl;
+        }
+        std::cout << boost::format("Data reduction: %.1fx in the FPGA, %.1fx on the host, %.1fx overall")
+            % fpga_ratio % host_ratio % (fpga_ratio * host_ratio) << std::endl;
+    }
+
+    if (mf) {
+        if (compress_consumer.joinable()) {
+            compress_consumer.join();
+        }
+        // Per-worker pulse rate against the PRF shows whether the
+        // filter keeps up
+        const gr::wavegen::matched_filter::stats_t mf_stats = mf->get_stats();
+        std::cout << boost::format(
+            "Matched filter: %d pulses, FFT size %d on %d workers, %.1f pulses/s per worker\n"
+            "                %d backpressure waits, most pulses pending %d")
+            % mf_stats.pulses % mf->get_fft_size() % mf->get_config().num_workers
+            % (mf_stats.process_ns ? 1e9 * mf_stats.pulses / mf_stats.process_ns : 0.0)
+            % mf_stats.backpressure_waits % mf_stats.max_pending << std::endl;
+    }
+
+    if (rd) {
+        // record_compressed() flushed the last CPI before it returned
+        maps_done.store(true);
+        if (map_consumer.joinable()) {
+            map_consumer.join();
+        }
+        const gr::wavegen::range_doppler::stats_t rd_stats = rd->get_stats();
+        std::cout << boost::format(
+            "Range-Doppler: %d CPIs of %d pulses, %d pulses missing, %d late, %.2f ms per CPI of worker time\n"
+            "               %d backpressure waits, most CPIs pending %d")
+            % rd_stats.cpis % rd->get_config().cpi_len % rd_stats.missing_pulses % rd_stats.late_pulses
+            % (rd_stats.cpis ? rd_stats.process_ns / 1e6 / rd_stats.cpis : 0.0)
+            % rd_stats.backpressure_waits % rd_stats.max_pending << std::endl;
+    }
+
+    if (cfar) {
+        const gr::wavegen::cfar_detector::stats_t cfar_stats = cfar->get_stats();
+        std::cout << boost::format("CFAR: %d detections in %d cells, %.1f Mcells/s")
+            % cfar_stats.detections % cfar_stats.cells
+            % (cfar_stats.process_ns ? 1e3 * cfar_stats.cells / cfar_stats.process_ns : 0.0) << std::endl;
+    }
+
+    if (converter) {
+        converter_done.store(true);
+        if (convert_consumer.joinable()) {
+            convert_consumer.join();
+        }
+        const gr::wavegen::sample_converter::stats_t conv_stats = converter->get_stats();
+        const size_t num_workers = converter->get_config().num_workers;
+        std::cout << boost::format(
+            "Converter: %d blocks, %d samples on %d workers, %.1f Msps per worker\n"
+            "           %d backpressure waits, most blocks pending %d")
+            % conv_stats.blocks % conv_stats.samples % num_workers
+            % (conv_stats.convert_ns ? 1e3 * conv_stats.samples / conv_stats.convert_ns : 0.0)
+            % conv_stats.backpressure_waits % conv_stats.max_pending << std::endl;
+    }
+
+    if (writer) {
+        writer->close();
+        const gr::wavegen::pulse_file_writer::stats_t file_stats = writer->get_stats();
+        std::cout << boost::format("Pulse file: %d pulses indexed, %d truncated, %d dropped")
+            % file_stats.pulses % file_stats.truncated % file_stats.dropped << std::endl;
+        print_recorder_stats(writer->get_recorder_stats());
+    }
+
+    if (ring) {
+        // Readers see the ring closed once they have taken the rest;
+        // the name is gone, so no new ones attach
+        const std::vector<gr::wavegen::pulse_ring_writer::consumer_info_t> consumers = ring->get_consumers();
+        ring->close();
+        const gr::wavegen::pulse_ring_writer::stats_t ring_stats = ring->get_stats();
+        std::cout << boost::format("Pulse ring %s: %d records published, %d truncated, %d consumers attached")
+            % ring->get_name() % ring_stats.records % ring_stats.truncated_pulses % consumers.size() << std::endl;
+        for (size_t i = 0; i < consumers.size(); i++) {
+            std::cout << boost::format("    pid %d: %d records taken, %d dropped, %d behind%s")
+                % consumers[i].pid % consumers[i].records % consumers[i].dropped % consumers[i].lag
+                % (consumers[i].overrun ? " (overrun)" : consumers[i].lagging ? " (lagging)" : "") << std::endl;
+        }
+    }
+
+    if (recorder) {
+        if (have_rec_buff) {
+            recorder->commit(rec_buff, rec_fill);
+        }
+        recorder->close();
+        print_recorder_stats(recorder->get_stats());
+    }
 
     if (stats){
         std::cout << std::endl;
@@ -211,6 +720,16 @@ int UHD_SAFE_MAIN(int argc, char *argv[])
     //variables to be set by po
     std::string args, file, format, wavegenid, blockid, blockid2, blockid3;
     size_t total_num_samps, spb, spp;
+    gr::wavegen::sample_recorder::config_t rec_config;
+    gr::wavegen::sample_converter::config_t conv_config;
+    gr::wavegen::pulse_integrator::config_t integ_config;
+    gr::wavegen::matched_filter::config_t mf_config;
+    gr::wavegen::range_doppler::config_t rd_config;
+    gr::wavegen::cfar_detector::config_t cfar_config;
+    gr::wavegen::pulse_ring_writer::config_t ring_config;
+    std::string cfar_method, det_file, ring_name;
+    typedef gr::wavegen::thread_profile tp;
+    std::string role_cpus[tp::NUM_ROLES], role_sched[tp::NUM_ROLES];
     double rate, total_time, setup_time, block_rate;
 
     //setup the program options
@@ -228,6 +747,44 @@ int UHD_SAFE_MAIN(int argc, char *argv[])
         ("rate", po::value<double>(&rate)->default_value(200e6), "rate at which samples are produced in the source")
         ("setup", po::value<double>(&setup_time)->default_value(1.0), "seconds of setup time")
         ("format", po::value<std::string>(&format)->default_value("sc16"), "File sample type: sc16, fc32, or fc64")
+        ("convert_threads", po::value<size_t>(&conv_config.num_workers)->default_value(2), "worker threads converting sc16 to fc32/fc64")
+        ("remove_dc", "subtract each block's mean when converting to fc32/fc64")
+        ("inline_convert", "let the streamer convert to fc32/fc64 on the receive thread")
+        ("writers", po::value<size_t>(&rec_config.num_writers)->default_value(2), "number of file writer threads")
+        ("buffers", po::value<size_t>(&rec_config.num_buffers)->default_value(64), "number of recorder buffers")
+        ("buffer_size", po::value<size_t>(&rec_config.buffer_size)->default_value(8 << 20), "bytes per recorder buffer, a multiple of 4096")
+        ("no_direct", "write through the page cache instead of O_DIRECT")
+        ("drop", "drop samples instead of stalling recv() when all recorder buffers are in use")
+        ("huge_pages", "back the recorder buffers with huge pages (reserved 2 MB pages, else transparent huge pages)")
+        ("lock_memory", "lock the recorder buffers into RAM (needs a large enough ulimit -l)")
+        ("pulses", "frame the stream into whole pulses of get_rx_len() samples and record an indexed pulse file")
+        ("integrate", po::value<size_t>(&integ_config.num_pulses)->default_value(1), "with --pulses, coherently sum this many pulses into each recorded pulse")
+        ("decimate", po::value<size_t>(&integ_config.decimation)->default_value(1), "with --pulses, sum this many adjacent samples of each pulse into one")
+        ("fpga_integrate", "do --integrate and --decimate in the wavegen block, before the link to the host")
+        ("compress", "with --pulses, range compress each pulse against the transmitted waveform and record fc32 range bins")
+        ("compress_threads", po::value<size_t>(&mf_config.num_workers)->default_value(2), "worker threads running the matched filter")
+        ("cpi", po::value<size_t>(&rd_config.cpi_len)->default_value(0), "with --compress, form range-Doppler maps over this many pulses and report their peaks")
+        ("doppler_threads", po::value<size_t>(&rd_config.num_workers)->default_value(2), "worker threads forming range-Doppler maps")
+        ("cfar", po::value<std::string>(&cfar_method), "with --compress, detect targets in each map (or each pulse without --cpi): ca, go, so or os")
+        ("pfa", po::value<double>(&cfar_config.pfa)->default_value(1e-6), "CFAR false alarm probability per cell")
+        ("guard_cells", po::value<size_t>(&cfar_config.guard_cells)->default_value(2), "CFAR guard cells on each side")
+        ("train_cells", po::value<size_t>(&cfar_config.train_cells)->default_value(16), "CFAR reference cells on each side")
+        ("detections", po::value<std::string>(&det_file), "write CFAR detections to this CSV file")
+        ("shm", po::value<std::string>(&ring_name), "with --pulses, also publish the recorded pulses to this shared memory ring (e.g. /wavegen_rx) for other processes")
+        ("shm_slots", po::value<size_t>(&ring_config.num_slots)->default_value(256), "pulses the shared memory ring holds, a power of two")
+        ("shm_consumers", po::value<size_t>(&ring_config.max_consumers)->default_value(16), "processes that can attach to the shared memory ring")
+        ("receive_cpus", po::value<std::string>(&role_cpus[tp::ROLE_RECEIVE]), "pin the receive thread to these cores, e.g. 2 or 4-7,9 (ideally isolated with isolcpus)")
+        ("convert_cpus", po::value<std::string>(&role_cpus[tp::ROLE_CONVERT]), "pin the converter workers to these cores")
+        ("write_cpus", po::value<std::string>(&role_cpus[tp::ROLE_WRITE]), "pin the file writer and recording threads to these cores")
+        ("process_cpus", po::value<std::string>(&role_cpus[tp::ROLE_PROCESS]), "pin the matched filter, range-Doppler and detection threads to these cores")
+        ("control_cpus", po::value<std::string>(&role_cpus[tp::ROLE_CONTROL]), "pin the main thread to these cores while it sets up the device")
+        ("receive_sched", po::value<std::string>(&role_sched[tp::ROLE_RECEIVE]), "receive thread scheduling: other, fifo:PRIO or rr:PRIO (PRIO 1 to 99)")
+        ("convert_sched", po::value<std::string>(&role_sched[tp::ROLE_CONVERT]), "converter worker scheduling")
+        ("write_sched", po::value<std::string>(&role_sched[tp::ROLE_WRITE]), "writer thread scheduling")
+        ("process_sched", po::value<std::string>(&role_sched[tp::ROLE_PROCESS]), "processing thread scheduling")
+        ("control_sched", po::value<std::string>(&role_sched[tp::ROLE_CONTROL]), "main thread scheduling during setup")
+        ("strict_threads", "exit if a thread cannot be pinned or scheduled as asked")
+        ("thread_stats", "show each thread's core, CPU time and context switches on exit")
         ("progress", "periodically display short-term bandwidth")
         ("stats", "show average bandwidth on exit")
         ("continue", "don't abort on a bad packet")
@@ -251,8 +808,64 @@ int UHD_SAFE_MAIN(int argc, char *argv[])
     bool bw_summary = vm.count("progress") > 0;
     bool stats = vm.count("stats") > 0;
     bool continue_on_bad_packet = vm.count("continue") > 0;
+    rec_config.direct_io = vm.count("no_direct") == 0;
+    if (vm.count("drop")) {
+        rec_config.policy = gr::wavegen::sample_recorder::POLICY_DROP;
+    }
+    if (vm.count("null")) {
+        file.clear();
+    }
+    // fc32/fc64 are received as sc16 and converted off the receive
+    // thread, except with pulse framing, which keeps whole pulses in
+    // the streamer's format.
+    const bool use_converter =
+        format != "sc16" and not vm.count("inline_convert") and not vm.count("pulses");
+    conv_config.output = (format == "fc64") ?
+        gr::wavegen::sample_converter::OUTPUT_FC64 : gr::wavegen::sample_converter::OUTPUT_FC32;
+    conv_config.block_samps = spb;
+    conv_config.remove_dc = vm.count("remove_dc") > 0;
 
     // Check settings
+    if (vm.count("compress") and not vm.count("pulses")) {
+        std::cout << "--compress works on framed pulses and needs --pulses." << std::endl;
+        return ~0;
+    }
+    const bool integrate = integ_config.num_pulses * integ_config.decimation > 1;
+    const bool fpga_integrate = integrate and vm.count("fpga_integrate");
+    if (integrate and not vm.count("pulses")) {
+        std::cout << "--integrate and --decimate work on framed pulses and need --pulses." << std::endl;
+        return ~0;
+    }
+    if (integrate and not fpga_integrate and format != "sc16" and format != "fc32") {
+        std::cout << "--integrate and --decimate take sc16 or fc32 pulses." << std::endl;
+        return ~0;
+    }
+    if (not ring_name.empty() and not vm.count("pulses")) {
+        std::cout << "--shm publishes framed pulses and needs --pulses." << std::endl;
+        return ~0;
+    }
+    if (rd_config.cpi_len > 0 and not vm.count("compress")) {
+        std::cout << "--cpi works on compressed pulses and needs --compress." << std::endl;
+        return ~0;
+    }
+    if (not cfar_method.empty() and not vm.count("compress")) {
+        std::cout << "--cfar works on compressed pulses and needs --compress." << std::endl;
+        return ~0;
+    }
+    if (not cfar_method.empty()) {
+        if (cfar_method == "ca") cfar_config.method = gr::wavegen::cfar_detector::CFAR_CA;
+        else if (cfar_method == "go") cfar_config.method = gr::wavegen::cfar_detector::CFAR_GO;
+        else if (cfar_method == "so") cfar_config.method = gr::wavegen::cfar_detector::CFAR_SO;
+        else if (cfar_method == "os") cfar_config.method = gr::wavegen::cfar_detector::CFAR_OS;
+        else {
+            std::cout << "Unknown CFAR method " << cfar_method << "; use ca, go, so or os." << std::endl;
+            return ~0;
+        }
+    }
+    if (vm.count("compress") and format != "sc16" and format != "fc32") {
+        std::cout << "--compress takes sc16 or fc32 pulses." << std::endl;
+        return ~0;
+    }
     if (not uhd::rfnoc::block_id_t::is_valid_block_id(wavegenid)) {
         std::cout << "Must specify a valid block ID for the null source." << std::endl;
         return ~0;
@@ -413,6 +1026,15 @@ int UHD_SAFE_MAIN(int argc, char *argv[])
         return ~0;
     }
 
+    // Integrating in the block makes its records what we frame
+    boost::uint32_t record_len = total_rx_len;
+    if (fpga_integrate) {
+        wavegen_ctrl->set_integration(integ_config.num_pulses, integ_config.decimation);
+        record_len = total_rx_len / integ_config.decimation;
+        std::cout << boost::format("FPGA integration: %d pulses, decimation %d, records of %d samples")
+            % integ_config.num_pulses % integ_config.decimation % record_len << std::endl;
+    }
+
     std::cout << "Setting AWG PRF..."<<std::endl;
     //wavegen_ctrl->set_policy_manual();
     boost::uint64_t prf_count = rate;
@@ -450,7 +1072,7 @@ int UHD_SAFE_MAIN(int argc, char *argv[])
     /////////////////////////////////////////////////////////////////////////
     //////// 6. Spawn receiver //////////////////////////////////////////////
     /////////////////////////////////////////////////////////////////////////
-    uhd::stream_args_t stream_args(format, "sc16");
+    uhd::stream_args_t stream_args(use_converter ? "sc16" : format, "sc16");
     stream_args.args = stream_args_args;
     stream_args.args["spp"] = boost::lexical_cast<std::string>(spp);
     UHD_MSG(status) << "Using streamer args: " << stream_args.args.to_string() << std::endl;
@@ -465,14 +1087,183 @@ int UHD_SAFE_MAIN(int argc, char *argv[])
     /////////////////////////////////////////////////////////////////////////
     //wavegen_ctrl->send_pulse();
 
+    // The pulse file header describes the setup, as read back from the
+    // block. The chirp settings have no readback, so they are what the
+    // block last wrote, and stay 0 if the chirp was never set up.
+    gr::wavegen::pulse_file::info_t pulse_info;
+    if (vm.count("pulses")) {
+        const uhd::rfnoc::wavegen_status status = wavegen_ctrl->get_status();
+        pulse_info.format = gr::wavegen::pulse_file::parse_format(format);
+        pulse_info.rate = rate;
+        pulse_info.rx_len = record_len;
+        pulse_info.waveform_known = status.waveform_known;
+        pulse_info.waveform_id = status.waveform_id;
+        pulse_info.waveform_len = status.waveform_len;
+        pulse_info.num_adc_samples = status.num_adc_samples;
+        pulse_info.ctrl_word = status.ctrl_word;
+        pulse_info.policy = status.policy;
+        pulse_info.prf_count = status.prf_count;
+        if (status.chirp_known) {
+            pulse_info.chirp_len = status.chirp_len;
+            pulse_info.chirp_tuning_coef = status.chirp_tuning_coef;
+            pulse_info.chirp_freq_offset = status.chirp_freq_offset;
+        }
+        if (fpga_integrate) {
+            pulse_info.integrated_pulses = integ_config.num_pulses;
+            pulse_info.decimation = integ_config.decimation;
+        }
+    }
+
+    // Otherwise framed pulses are integrated on the host, into sc16
+    // records when recording sc16 and fc32 ones for the matched filter
+    gr::wavegen::pulse_integrator::sptr integrator;
+    if (integrate and not fpga_integrate) {
+        integ_config.rx_len = record_len;
+        integ_config.input = (format == "fc32") ?
+            gr::wavegen::pulse_integrator::INPUT_FC32 : gr::wavegen::pulse_integrator::INPUT_SC16;
+        integ_config.output = (format == "sc16" and not vm.count("compress")) ?
+            gr::wavegen::pulse_integrator::OUTPUT_SC16 : gr::wavegen::pulse_integrator::OUTPUT_FC32;
+        integrator = gr::wavegen::pulse_integrator::make(integ_config);
+        record_len = integrator->get_output_len();
+    }
+
+    // The matched filter's reference is what the block transmits: the
+    // live AWG waveform or the chirp it was last set up with, decimated
+    // like the records.
+    gr::wavegen::matched_filter::sptr mf;
+    if (vm.count("compress")) {
+        mf_config.rx_len = record_len;
+        mf_config.input = (format == "fc32" or integrator) ?
+            gr::wavegen::matched_filter::INPUT_FC32 : gr::wavegen::matched_filter::INPUT_SC16;
+        std::vector<gr_complex> reference =
+            gr::wavegen::waveform_synth::unpack_sc16(wavegen_ctrl->get_reference_waveform());
+        if (integ_config.decimation > 1) {
+            reference = gr::wavegen::pulse_integrator::decimate(reference, integ_config.decimation);
+        }
+        mf = gr::wavegen::matched_filter::make(reference, mf_config);
+        std::cout << boost::format("Matched filter: FFT size %d") % mf->get_fft_size() << std::endl;
+    }
+
+    // Doppler bins follow from the pulse period the block counts in
+    // ticks at the sample rate; an integrated record spans several
+    gr::wavegen::range_doppler::sptr rd;
+    if (rd_config.cpi_len > 0) {
+        rd_config.num_bins = record_len;
+        rd_config.prf = gr::wavegen::range_doppler::prf_from_count(
+            pulse_info.prf_count * integ_config.num_pulses, rate);
+        rd = gr::wavegen::range_doppler::make(rd_config);
+        std::cout << boost::format("Range-Doppler: %d pulses per CPI at %.3f Hz PRF, %.3f Hz Doppler bins")
+            % rd_config.cpi_len % rd_config.prf % (rd_config.prf / rd_config.cpi_len) << std::endl;
+    }
+
+    // Thread placement. The main thread does control work until it
+    // starts receiving; the library and consumer threads enter their
+    // roles when they start.
+    tp::sptr threads;
+    bool use_threads = vm.count("thread_stats") > 0;
+    tp::config_t thread_config;
+    for (size_t r = 0; r < tp::NUM_ROLES; r++) {
+        tp::role_config_t &role = thread_config.roles[r];
+        role.cpus = tp::parse_cpus(role_cpus[r]);
+        if (not role_sched[r].empty()) {
+            const size_t colon = role_sched[r].find(':');
+            role.policy = tp::parse_policy(role_sched[r].substr(0, colon));
+            if (colon != std::string::npos) {
+                role.priority = boost::lexical_cast<int>(role_sched[r].substr(colon + 1));
+            }
+        }
+        use_threads = use_threads or not role_cpus[r].empty() or not role_sched[r].empty();
+    }
+    if (use_threads) {
+        thread_config.strict = vm.count("strict_threads") > 0;
+        threads = tp::make(thread_config);
+        const std::vector<std::string> problems = threads->check();
+        for (size_t i = 0; i < problems.size(); i++) {
+            std::cerr << "Thread profile: " << problems[i] << std::endl;
+        }
+        // With --strict_threads, fail here rather than in a worker thread
+        for (size_t r = 0; r < tp::NUM_ROLES; r++) {
+            threads->validate(tp::role_t(r));
+        }
+        threads->enter(tp::ROLE_CONTROL, "main");
+        rec_config.threads = threads;
+        conv_config.threads = threads;
+        mf_config.threads = threads;
+        rd_config.threads = threads;
+        wavegen_ctrl->set_thread_profile(threads);
+    }
+
+    gr::wavegen::cfar_detector::sptr cfar;
+    if (not cfar_method.empty()) {
+        cfar = gr::wavegen::cfar_detector::make(cfar_config);
+        std::cout << boost::format("CFAR: %s, threshold factor %.2f") % cfar_method
+            % cfar->get_threshold_factor() << std::endl;
+    }
+
+    // From here on the main thread receives. The buffers are touched
+    // here, on the receive thread, so they are placed on its NUMA node.
+    if (threads) {
+        threads->enter(tp::ROLE_RECEIVE, "receive");
+    }
+    gr::wavegen::buffer_pool::sptr pool;
+    if (not file.empty() and (vm.count("huge_pages") or vm.count("lock_memory"))) {
+        gr::wavegen::buffer_pool::config_t pool_config;
+        pool_config.num_buffers = rec_config.num_buffers;
+        pool_config.buffer_size = rec_config.buffer_size;
+        pool_config.huge_pages = vm.count("huge_pages") > 0;
+        pool_config.lock_memory = vm.count("lock_memory") > 0;
+        pool = gr::wavegen::buffer_pool::make(pool_config);
+        rec_config.pool = pool;
+        const char *pages[] = {"normal", "transparent huge", "huge"};
+        std::cout << boost::format("Buffer pool: %d buffers of %d bytes on %s pages, %s")
+            % pool->get_num_buffers() % pool->get_buffer_size() % pages[pool->get_page_mode()]
+            % (pool->is_locked() ? "locked" : "not locked") << std::endl;
+        if (pool_config.lock_memory and not pool->is_locked()) {
+            std::cerr << "Cannot lock the buffer pool; raise the locked memory limit (ulimit -l)." << std::endl;
+        }
+    }
+
 #define recv_to_file_args() \
-        (rx_stream, file, spb, total_num_samps, total_time, bw_summary, stats, continue_on_bad_packet)
+        (rx_stream, file, rec_config, spb, pulse_info, converter, integrator, mf, rd, cfar, det_file, ring_name, ring_config, total_num_samps, total_time, bw_summary, stats, continue_on_bad_packet)
     //recv to file
-    if (format == "fc64") recv_to_file<std::complex<double> >recv_to_file_args();
+    gr::wavegen::sample_converter::sptr converter;
+    if (use_converter) {
+        converter = gr::wavegen::sample_converter::make(conv_config);
+        recv_to_file<std::complex<short> >recv_to_file_args();
+    }
+    else if (format == "fc64") recv_to_file<std::complex<double> >recv_to_file_args();
     else if (format == "fc32") recv_to_file<std::complex<float> >recv_to_file_args();
     else if (format == "sc16") recv_to_file<std::complex<short> >recv_to_file_args();
     else throw std::runtime_error("Unknown type sample type: " + format);
 
+    if (pool) {
+        const gr::wavegen::buffer_pool::stats_t pool_stats = pool->get_stats();
+        std::cout << boost::format("Buffer pool: %d buffers handed out, most in use %d of %d, %d waits")
+            % pool_stats.acquires % pool_stats.max_in_use % pool->get_num_buffers()
+            % pool_stats.waits << std::endl;
+    }
+
+    if (threads) {
+        // A receive thread that was never preempted shows no involuntary
+        // switches
+        threads->leave();
+        const std::vector<tp::thread_stats_t> thread_stats = threads->get_thread_stats();
+        std::cout << "Threads:" << std::endl;
+        for (size_t i = 0; i < thread_stats.size(); i++) {
+            const tp::thread_stats_t &t = thread_stats[i];
+            std::cout << boost::format("    %-8s %-22s tid %-7d core %-3d %10.1f ms CPU, %d voluntary, %d involuntary switches%s")
+                % tp::role_name(t.role) % t.name % t.tid % t.last_cpu % (t.cpu_ns / 1e6)
+                % t.voluntary_switches % t.involuntary_switches
+                % (t.applied ? "" : " (" + t.error + ")") << std::endl;
+        }
+    }
+
+    if (fpga_integrate) {
+        const boost::uint64_t integ_state = wavegen_ctrl->get_integration_state();
+        std::cout << boost::format("FPGA integrator: %d records")
+            % (integ_state >> uhd::rfnoc::wavegen_core::INTEG_RECORDS_SHIFT) << std::endl;
+    }
+
     // Finished!
     std::cout << std::endl << "Done!" << std::endl << std::endl;
 
@@ -0,0 +1,193 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_WAVEGEN_BUFFER_POOL_H
+#define INCLUDED_WAVEGEN_BUFFER_POOL_H
+
+#include <wavegen/api.h>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace gr {
+  namespace wavegen {
+
+    /*!
+     * \brief Fixed pool of recording buffers handed out by reference.
+     * \ingroup wavegen
+     *
+     * The buffer store behind sample_recorder: the receive thread fills
+     * a buffer and the recorder's writers return it once it is on disk.
+     * The converter, framer and processing stages keep their own slot
+     * storage and do not use the pool.
+     *
+     * All buffers come from one mapping made up front, so taking and
+     * returning a buffer never touches the heap. A buffer is held
+     * through handle_t, which counts references like a shared_ptr, and
+     * goes back to the pool when the last copy goes away. Free buffers
+     * are kept on a lock-free stack, so the buffer returned most
+     * recently, whose pages are still in the cache and TLB, is handed
+     * out first.
+     *
+     * The mapping can be backed by huge pages, cutting TLB misses when
+     * hundreds of megabytes stream through the pool. Explicit huge
+     * pages (MAP_HUGETLB) need pages reserved in
+     * /proc/sys/vm/nr_hugepages; without them the pool asks for
+     * transparent huge pages instead, and get_page_mode() tells what it
+     * got. The pool can also be locked into RAM so a buffer is never
+     * paged out under the receive thread.
+     *
+     * Every page is touched when the pool is made, so the kernel
+     * places the memory on the NUMA node of the thread calling make().
+     * Make the pool on the thread that receives into it, after that
+     * thread is pinned.
+     *
+     * The pool must outlive its handles. Any thread may take and
+     * return buffers.
+     */
+    class WAVEGEN_API buffer_pool : boost::noncopyable
+    {
+    public:
+      typedef boost::shared_ptr<buffer_pool> sptr;
+
+      //! Buffer address and size alignment
+      static const size_t ALIGNMENT = 4096;
+      static const size_t HUGE_PAGE_SIZE = 2 << 20;
+
+      enum page_mode_t { PAGES_NORMAL, PAGES_TRANSPARENT_HUGE, PAGES_HUGE };
+
+      struct config_t {
+        config_t(void):
+          num_buffers(32), buffer_size(8 << 20), huge_pages(false),
+          lock_memory(false) {}
+        size_t num_buffers;
+        //! Bytes per buffer, a multiple of ALIGNMENT
+        size_t buffer_size;
+        //! Back the pool with huge pages where the system has them
+        bool huge_pages;
+        //! mlock() the pool; best effort, see is_locked()
+        bool lock_memory;
+      };
+
+      struct stats_t {
+        stats_t(void):
+          acquires(0), waits(0), empty(0), in_use(0), max_in_use(0) {}
+        //! Buffers handed out
+        boost::uint64_t acquires;
+        //! acquire() calls that had to wait for a buffer
+        boost::uint64_t waits;
+        //! try_acquire() calls and acquire() timeouts that got nothing
+        boost::uint64_t empty;
+        //! Buffers held now, and the most held at once
+        boost::uint64_t in_use;
+        boost::uint64_t max_in_use;
+      };
+
+      /*!
+       * \brief Counted reference to one buffer of a pool.
+       *
+       * Default constructed handles hold nothing. Copies share the
+       * buffer; reset() or destroying the last copy returns it. A
+       * handle is as cheap to pass as a pointer plus one atomic
+       * increment per copy.
+       */
+      class WAVEGEN_API handle_t
+      {
+      public:
+        handle_t(void);
+        handle_t(const handle_t &other);
+        handle_t &operator=(const handle_t &other);
+        ~handle_t();
+
+        //! Drop this reference; the buffer is free once none are left
+        void reset();
+
+        bool valid() const { return _pool != 0; }
+        char *data() const { return _data; }
+        size_t size() const;
+        //! Position of the buffer in the pool, 0 to num_buffers - 1
+        size_t index() const { return _index; }
+        //! References to the buffer, this one included
+        size_t use_count() const;
+
+      private:
+        friend class buffer_pool;
+        handle_t(buffer_pool *pool, size_t index, char *data);
+
+        buffer_pool *_pool;
+        size_t _index;
+        char *_data;
+      };
+
+      /*!
+       * Map and touch the pool. Throws std::invalid_argument for zero
+       * buffers or a size that is not a multiple of ALIGNMENT, and
+       * std::runtime_error if the memory cannot be mapped.
+       */
+      static sptr make(const config_t &config);
+
+      virtual ~buffer_pool() {}
+
+      //! Take a free buffer if there is one
+      virtual bool try_acquire(handle_t &handle) = 0;
+
+      /*!
+       * Take a buffer, waiting up to \p timeout seconds for one to be
+       * returned, or for ever if \p timeout is negative. Returns false
+       * on timeout.
+       */
+      virtual bool acquire(handle_t &handle, double timeout = -1.0) = 0;
+
+      //! Index of the buffer holding \p p. Throws std::invalid_argument.
+      virtual size_t index_of(const void *p) const = 0;
+
+      //! Start of buffer \p index, whether or not it is held
+      virtual char *data(size_t index) const = 0;
+
+      virtual size_t get_num_buffers() const = 0;
+      virtual size_t get_buffer_size() const = 0;
+      //! Buffers not held by any handle
+      virtual size_t available() const = 0;
+      virtual page_mode_t get_page_mode() const = 0;
+      //! Whether lock_memory was asked for and mlock() succeeded
+      virtual bool is_locked() const = 0;
+
+      virtual stats_t get_stats() = 0;
+      virtual config_t get_config() = 0;
+
+    protected:
+      //! A new handle to buffer \p index, whose count the caller has set to 1
+      handle_t make_handle(size_t index, char *data)
+      {
+        return handle_t(this, index, data);
+      }
+
+    private:
+      /* Called by handle_t; release() returns the buffer at zero */
+      virtual void retain(size_t index) = 0;
+      virtual void release(size_t index) = 0;
+      virtual size_t use_count(size_t index) const = 0;
+    };
+
+  } // namespace wavegen
+} // namespace gr
+
+#endif /* INCLUDED_WAVEGEN_BUFFER_POOL_H */
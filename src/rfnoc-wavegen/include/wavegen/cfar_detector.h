@@ -0,0 +1,148 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_WAVEGEN_CFAR_DETECTOR_H
+#define INCLUDED_WAVEGEN_CFAR_DETECTOR_H
+
+#include <wavegen/api.h>
+#include <wavegen/pulse_framer.h>
+#include <wavegen/range_doppler.h>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <vector>
+
+namespace gr {
+  namespace wavegen {
+
+    /*!
+     * \brief Constant false alarm rate detection along range.
+     * \ingroup wavegen
+     *
+     * Each cell's power is compared with a noise estimate from
+     * train_cells reference cells on either side in range, skipping
+     * guard_cells next to it, times a threshold factor set for the
+     * configured false alarm probability. At the ends of the range the
+     * cells that exist are used.
+     *
+     * - CFAR_CA averages both sides (cell averaging).
+     * - CFAR_GO and CFAR_SO take the greater or smaller side mean,
+     *   for clutter edges and close targets respectively.
+     * - CFAR_OS takes the os_rank-th smallest reference cell (ordered
+     *   statistic), which tolerates targets in the reference window.
+     *
+     * The sums behind CA, GO and SO are kept as running sums, added
+     * to and taken from as the window slides, so a cell costs the same
+     * whatever the window size. A range-Doppler map is processed a
+     * block of range rows at a time with every Doppler column side by
+     * side. Thresholds and comparisons then go through VOLK over the
+     * whole block, and only the parts holding a crossing are scanned
+     * for detections.
+     *
+     * The output is a list of crossings, normally a tiny fraction of
+     * the cells. A detector keeps scratch space between calls and is
+     * meant for one thread; use one per channel.
+     */
+    class WAVEGEN_API cfar_detector : boost::noncopyable
+    {
+    public:
+      typedef boost::shared_ptr<cfar_detector> sptr;
+
+      enum method_t { CFAR_CA, CFAR_GO, CFAR_SO, CFAR_OS };
+
+      struct config_t {
+        config_t(void):
+          method(CFAR_CA), guard_cells(2), train_cells(16), pfa(1e-6),
+          os_rank(0), threshold_factor(0.0f) {}
+        method_t method;
+        //! Cells skipped on each side of the cell under test
+        size_t guard_cells;
+        //! Reference cells on each side
+        size_t train_cells;
+        //! False alarm probability per cell in exponentially distributed noise
+        double pfa;
+        //! CFAR_OS rank out of 2 * train_cells, 0 for three quarters
+        size_t os_rank;
+        //! Overrides the factor derived from pfa when positive
+        float threshold_factor;
+      };
+
+      //! One threshold crossing
+      struct detection_t {
+        detection_t(void):
+          index(0), has_time(false), range_bin(0), doppler_bin(0),
+          power(0.0f), noise(0.0f) {}
+        //! Pulse index, or CPI index for a map
+        boost::uint64_t index;
+        bool has_time;
+        //! Time of the pulse, or of the CPI's first pulse
+        uhd::time_spec_t time;
+        boost::uint32_t range_bin;
+        //! Map column, 0 for a single pulse
+        boost::uint32_t doppler_bin;
+        float power;
+        //! Noise estimate the threshold was derived from
+        float noise;
+      };
+
+      struct stats_t {
+        stats_t(void): cells(0), detections(0), process_ns(0) {}
+        boost::uint64_t cells;
+        boost::uint64_t detections;
+        boost::uint64_t process_ns;
+      };
+
+      /*!
+       * Throws std::invalid_argument for no reference cells, a pfa
+       * outside (0, 1) or an os_rank above 2 * train_cells.
+       */
+      static sptr make(const config_t &config);
+
+      virtual ~cfar_detector() {}
+
+      //! Multiplier from noise estimate to threshold
+      virtual float get_threshold_factor() const = 0;
+
+      /*!
+       * Detect in \p power, num_bins range rows of \p width cells each
+       * (range-major, as range_doppler::map_t::data). Detections are
+       * appended to \p detections with index and time left unset;
+       * returns how many.
+       */
+      virtual size_t detect(const float *power, size_t num_bins, size_t width,
+                            std::vector<detection_t> &detections) = 0;
+
+      //! Detect in a range-compressed pulse of gr_complex range bins
+      virtual size_t detect(const pulse_framer::pulse_t &pulse,
+                            std::vector<detection_t> &detections) = 0;
+
+      //! Detect along range in every Doppler column of a map; magnitudes are squared
+      virtual size_t detect(const range_doppler::map_t &map,
+                            std::vector<detection_t> &detections) = 0;
+
+      virtual stats_t get_stats() = 0;
+      virtual config_t get_config() = 0;
+    };
+
+  } // namespace wavegen
+} // namespace gr
+
+#endif /* INCLUDED_WAVEGEN_CFAR_DETECTOR_H */
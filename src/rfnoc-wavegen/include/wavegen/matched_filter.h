@@ -0,0 +1,145 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_WAVEGEN_MATCHED_FILTER_H
+#define INCLUDED_WAVEGEN_MATCHED_FILTER_H
+
+#include <wavegen/api.h>
+#include <wavegen/pulse_framer.h>
+#include <wavegen/thread_profile.h>
+#include <gnuradio/gr_complex.h>
+#include <gnuradio/fft/window.h>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <vector>
+
+namespace gr {
+  namespace wavegen {
+
+    /*!
+     * \brief Pulse compression of pulse records against the transmitted waveform.
+     * \ingroup wavegen
+     *
+     * Correlates each received pulse with the reference by fast
+     * convolution: the pulse is zero padded to the FFT size,
+     * transformed, multiplied by the conjugate spectrum of the
+     * reference and transformed back. Range bin n of the output is
+     * the correlation at a delay of n samples, for n from 0 to
+     * rx_len - 1, with no circular wrap. The output is not normalised
+     * beyond the inverse FFT's 1/N, so a matched echo peaks at its
+     * amplitude times the reference's energy.
+     *
+     * The reference is normally
+     * waveform_synth::unpack_sc16(wavegen_block_ctrl::get_reference_waveform()),
+     * optionally windowed here for lower range sidelobes. Its spectrum
+     * is computed once. The complex multiply and the sc16 conversion
+     * go through VOLK. FFT plans come from a process-wide cache, so
+     * only the first engine of a size pays for planning.
+     *
+     * process() compresses one pulse on the calling thread. For a
+     * live stream, submit() hands pulses to a pool of workers, one
+     * pulse per worker at a time, and front()/pop() return the
+     * compressed pulses in submission order. One thread submits and
+     * one consumes; slots are allocated once and submit() waits when
+     * all of them are in use.
+     */
+    class WAVEGEN_API matched_filter : boost::noncopyable
+    {
+    public:
+      typedef boost::shared_ptr<matched_filter> sptr;
+
+      enum input_t { INPUT_SC16, INPUT_FC32 };
+
+      struct config_t {
+        config_t(void):
+          rx_len(0), input(INPUT_SC16), scale(32767.0f),
+          window(gr::fft::window::WIN_NONE), num_workers(2),
+          num_slots(32), fft_size(0) {}
+        //! Samples per pulse record, and range bins per compressed pulse
+        size_t rx_len;
+        input_t input;
+        //! sc16 input is divided by this
+        float scale;
+        //! Taper applied to the reference
+        gr::fft::window::win_type window;
+        size_t num_workers;
+        size_t num_slots;
+        //! 0 for the smallest power of two of at least rx_len + reference length - 1
+        size_t fft_size;
+        //! Worker threads enter its process role
+        thread_profile::sptr threads;
+      };
+
+      struct stats_t {
+        stats_t(void): pulses(0), process_ns(0), backpressure_waits(0), max_pending(0) {}
+        //! Pulses compressed by the workers
+        boost::uint64_t pulses;
+        //! Worker time spent on them, summed over workers
+        boost::uint64_t process_ns;
+        //! submit() calls that had to wait for a free slot
+        boost::uint64_t backpressure_waits;
+        //! Most pulses submitted and not yet compressed at once
+        boost::uint64_t max_pending;
+      };
+
+      /*!
+       * Throws std::invalid_argument for an empty reference, a zero
+       * rx_len, worker or slot count, or an FFT size too small for
+       * linear correlation.
+       */
+      static sptr make(const std::vector<gr_complex> &reference, const config_t &config);
+
+      virtual ~matched_filter() {}
+
+      /*!
+       * Compress \p nsamps samples (at most rx_len, the rest counts
+       * as zeros) from \p in into rx_len range bins at \p out, on the
+       * calling thread. Safe to call from several threads at once.
+       */
+      virtual void process(const void *in, size_t nsamps, gr_complex *out) = 0;
+
+      /* Pipeline */
+
+      //! Copy \p pulse in and queue it; waits for a free slot
+      virtual void submit(const pulse_framer::pulse_t &pulse) = 0;
+
+      /*!
+       * Oldest pulse, if it has been compressed: the input's index,
+       * time and truncated flag, with rx_len range bins of gr_complex.
+       */
+      virtual bool front(pulse_framer::pulse_t &pulse) = 0;
+
+      //! Hand the oldest slot back to submit()
+      virtual void pop() = 0;
+
+      //! Pulses submitted and not yet popped
+      virtual size_t size() = 0;
+
+      virtual size_t get_fft_size() const = 0;
+      virtual stats_t get_stats() = 0;
+      virtual config_t get_config() = 0;
+    };
+
+  } // namespace wavegen
+} // namespace gr
+
+#endif /* INCLUDED_WAVEGEN_MATCHED_FILTER_H */
@@ -0,0 +1,170 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_WAVEGEN_PULSE_FILE_H
+#define INCLUDED_WAVEGEN_PULSE_FILE_H
+
+#include <wavegen/api.h>
+#include <boost/cstdint.hpp>
+#include <cstddef>
+#include <string>
+
+namespace gr {
+  namespace wavegen {
+
+    /*!
+     * \brief On-disk layout of a pulse recording.
+     * \ingroup wavegen
+     *
+     * A pulse file is a HEADER_SIZE byte header, the pulses' samples
+     * back to back, and an index with one index_entry_t per pulse:
+     *
+     *   [header_t, zero padded][pulse 0][pulse 1]...[index_entry_t x N]
+     *
+     * The header records how the block was set up (rate, rx_len,
+     * waveform, PRF, chirp settings) and where the index starts.
+     * Entries give each pulse's byte offset, so pulse N is found with
+     * one lookup, and its timestamp in ticks of the file's rate, so a
+     * time is found with a binary search. All fields are little-endian
+     * and naturally aligned.
+     *
+     * pulse_file_writer fills the header's num_pulses and index_offset
+     * only when it closes the file; until then index_offset is 0 and
+     * readers reject the file.
+     */
+    class WAVEGEN_API pulse_file
+    {
+    public:
+      static const char MAGIC[8];
+      static const boost::uint32_t VERSION = 1;
+      //! Samples start here, so they stay aligned for direct I/O
+      static const size_t HEADER_SIZE = 4096;
+
+      enum sample_format_t { FORMAT_SC16 = 0, FORMAT_FC32 = 1, FORMAT_FC64 = 2 };
+
+      //! Flags in header_t::flags
+      static const boost::uint32_t HEADER_WAVEFORM_KNOWN = 0x1;
+      //! Pulses hold matched filter output (range bins), not raw samples
+      static const boost::uint32_t HEADER_RANGE_COMPRESSED = 0x2;
+
+      //! Flags in index_entry_t::flags
+      static const boost::uint32_t PULSE_HAS_TIME = 0x1;
+      static const boost::uint32_t PULSE_TRUNCATED = 0x2;
+
+      //! What the recording is of, as passed to pulse_file_writer::make()
+      struct info_t {
+        info_t(void):
+          format(FORMAT_SC16), rate(0.0), rx_len(0), waveform_known(false),
+          waveform_id(0), waveform_len(0), num_adc_samples(0), ctrl_word(0),
+          policy(0), prf_count(0), chirp_len(0), chirp_tuning_coef(0),
+          chirp_freq_offset(0), range_compressed(false), integrated_pulses(1),
+          decimation(1) {}
+        sample_format_t format;
+        //! Sample rate; also the tick rate of the index timestamps
+        double rate;
+        //! Samples in a complete pulse
+        boost::uint32_t rx_len;
+        //! Library id of the waveform that was playing, if known
+        bool waveform_known;
+        boost::uint64_t waveform_id;
+        /* Block configuration, normally from wavegen_block_ctrl::get_status() */
+        boost::uint32_t waveform_len;
+        boost::uint32_t num_adc_samples;
+        boost::uint32_t ctrl_word;
+        boost::uint32_t policy;
+        boost::uint64_t prf_count;
+        /* Chirp settings, as last written; the block has no readback for these */
+        boost::uint32_t chirp_len;
+        boost::uint32_t chirp_tuning_coef;
+        boost::uint32_t chirp_freq_offset;
+        //! Written by a matched_filter; samples are range bins
+        bool range_compressed;
+        /*!
+         * Written by a pulse_integrator: pulses summed into each record
+         * and samples into each of its samples. Samples are then
+         * decimation / rate apart; rate stays the tick rate.
+         */
+        boost::uint32_t integrated_pulses;
+        boost::uint32_t decimation;
+      };
+
+      //! The header as stored at offset 0
+      struct header_t {
+        char magic[8];
+        boost::uint32_t version;
+        boost::uint32_t header_size;
+        boost::uint32_t format;
+        boost::uint32_t item_size;
+        double rate;
+        boost::uint64_t num_pulses;
+        boost::uint64_t index_offset;
+        boost::uint64_t data_offset;
+        boost::uint32_t rx_len;
+        boost::uint32_t flags;
+        boost::uint64_t waveform_id;
+        boost::uint32_t waveform_len;
+        boost::uint32_t num_adc_samples;
+        boost::uint32_t ctrl_word;
+        boost::uint32_t policy;
+        boost::uint64_t prf_count;
+        boost::uint32_t chirp_len;
+        boost::uint32_t chirp_tuning_coef;
+        boost::uint32_t chirp_freq_offset;
+        //! 0 in files from before integration, read as 1
+        boost::uint32_t integrated_pulses;
+        boost::uint32_t decimation;
+        boost::uint32_t reserved;
+      };
+
+      //! One pulse in the index
+      struct index_entry_t {
+        //! Byte offset of the first sample from the start of the file
+        boost::uint64_t offset;
+        //! Pulse number from pulse_framer, counting dropped pulses
+        boost::uint64_t index;
+        //! Time of the first sample in ticks at the file's rate
+        boost::int64_t ticks;
+        boost::uint32_t nsamps;
+        boost::uint32_t flags;
+      };
+
+      //! Bytes per sample of \p format
+      static size_t item_size(sample_format_t format);
+
+      //! "sc16", "fc32" or "fc64"; throws std::invalid_argument otherwise
+      static sample_format_t parse_format(const std::string &format);
+
+      //! Fill \p header from \p info; the counts and offsets are left at 0
+      static void encode_header(const info_t &info, header_t &header);
+
+      /*!
+       * Check \p header and return its info. Throws std::runtime_error
+       * for a foreign or newer file, or one that was never closed.
+       * pulse_ring headers describe a live stream and have no index;
+       * they are decoded with \p need_index false.
+       */
+      static info_t decode_header(const header_t &header, bool need_index = true);
+    };
+
+  } // namespace wavegen
+} // namespace gr
+
+#endif /* INCLUDED_WAVEGEN_PULSE_FILE_H */
@@ -0,0 +1,95 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_WAVEGEN_PULSE_FILE_READER_H
+#define INCLUDED_WAVEGEN_PULSE_FILE_READER_H
+
+#include <wavegen/api.h>
+#include <wavegen/pulse_file.h>
+#include <wavegen/pulse_framer.h>
+#include <uhd/types/time_spec.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <string>
+
+namespace gr {
+  namespace wavegen {
+
+    /*!
+     * \brief Random access to a pulse file through a read-only mapping.
+     * \ingroup wavegen
+     *
+     * The whole file is mapped once. pulse() is one index lookup and
+     * returns a view whose samples point into the mapping, so nothing
+     * is copied and pages are read only when touched. Views stay valid
+     * while the reader exists.
+     *
+     * All methods are const and the reader holds no cursor, so several
+     * threads can share one reader, e.g. each processing its own range
+     * of pulses.
+     */
+    class WAVEGEN_API pulse_file_reader : boost::noncopyable
+    {
+    public:
+      typedef boost::shared_ptr<pulse_file_reader> sptr;
+
+      /*!
+       * Map \p path and check its header and index. Throws
+       * std::runtime_error if it cannot be read or is not a complete
+       * pulse file.
+       */
+      static sptr make(const std::string &path);
+
+      virtual ~pulse_file_reader() {}
+
+      virtual const pulse_file::info_t &get_info() const = 0;
+      virtual size_t get_item_size() const = 0;
+      virtual boost::uint64_t num_pulses() const = 0;
+
+      /*!
+       * Pulse \p n of num_pulses(), counted in the file (pulse_t::index
+       * has the framer's number). Throws std::out_of_range.
+       */
+      virtual pulse_framer::pulse_t pulse(boost::uint64_t n) const = 0;
+
+      //! The raw index entry of pulse \p n. Throws std::out_of_range.
+      virtual const pulse_file::index_entry_t &entry(boost::uint64_t n) const = 0;
+
+      /*!
+       * First pulse starting at or after \p time, or num_pulses() if
+       * there is none. A binary search, so it relies on the timestamps
+       * increasing through the file, as they do in a recording. A pulse
+       * without a timestamp counts as time 0.
+       */
+      virtual boost::uint64_t find(const uhd::time_spec_t &time) const = 0;
+
+      /*!
+       * Tell the kernel pulses [first, first + count) will be read soon
+       * (MADV_WILLNEED), e.g. before handing a range to a worker.
+       */
+      virtual void prefetch(boost::uint64_t first, boost::uint64_t count) const = 0;
+    };
+
+  } // namespace wavegen
+} // namespace gr
+
+#endif /* INCLUDED_WAVEGEN_PULSE_FILE_READER_H */
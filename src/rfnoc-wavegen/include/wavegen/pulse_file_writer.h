@@ -0,0 +1,97 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_WAVEGEN_PULSE_FILE_WRITER_H
+#define INCLUDED_WAVEGEN_PULSE_FILE_WRITER_H
+
+#include <wavegen/api.h>
+#include <wavegen/pulse_file.h>
+#include <wavegen/pulse_framer.h>
+#include <wavegen/sample_recorder.h>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <string>
+
+namespace gr {
+  namespace wavegen {
+
+    /*!
+     * \brief Records pulses from a pulse_framer into a pulse file.
+     * \ingroup wavegen
+     *
+     * Samples go through a sample_recorder, so the disk is written from
+     * its writer threads. The index is buffered and spilled to an
+     * anonymous temporary file, and is appended after the samples,
+     * together with the final header, by close().
+     *
+     * If the recorder runs out of buffers (sample_recorder::POLICY_DROP)
+     * a pulse that has not started is dropped whole and left out of the
+     * index; one that has started is kept as far as it got and marked
+     * truncated. Offsets in the index are always exact.
+     *
+     * write() is meant to be called from one thread.
+     */
+    class WAVEGEN_API pulse_file_writer : boost::noncopyable
+    {
+    public:
+      typedef boost::shared_ptr<pulse_file_writer> sptr;
+
+      struct stats_t {
+        stats_t(void): pulses(0), truncated(0), dropped(0), bytes(0) {}
+        //! Pulses in the index
+        boost::uint64_t pulses;
+        //! Of those, cut short by the framer or the recorder
+        boost::uint64_t truncated;
+        //! Pulses left out because the recorder had no buffer
+        boost::uint64_t dropped;
+        //! Sample bytes written
+        boost::uint64_t bytes;
+      };
+
+      /*!
+       * Create (or truncate) \p path. \p info.rate must be positive.
+       * Throws std::invalid_argument for a bad info or recorder config
+       * and std::runtime_error if the file cannot be created.
+       */
+      static sptr make(const std::string &path, const pulse_file::info_t &info,
+                       const sample_recorder::config_t &config = sample_recorder::config_t());
+
+      virtual ~pulse_file_writer() {}
+
+      //! Copy \p pulse into the file and index it
+      virtual void write(const pulse_framer::pulse_t &pulse) = 0;
+
+      /*!
+       * Flush the samples, append the index and write the header.
+       * Called by the destructor. Throws std::runtime_error if any
+       * write failed.
+       */
+      virtual void close() = 0;
+
+      virtual stats_t get_stats() = 0;
+      virtual sample_recorder::stats_t get_recorder_stats() = 0;
+    };
+
+  } // namespace wavegen
+} // namespace gr
+
+#endif /* INCLUDED_WAVEGEN_PULSE_FILE_WRITER_H */
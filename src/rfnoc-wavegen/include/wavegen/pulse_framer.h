@@ -0,0 +1,140 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_WAVEGEN_PULSE_FRAMER_H
+#define INCLUDED_WAVEGEN_PULSE_FRAMER_H
+
+#include <wavegen/api.h>
+#include <uhd/types/metadata.hpp>
+#include <uhd/types/time_spec.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace gr {
+  namespace wavegen {
+
+    /*!
+     * \brief Cuts the RX stream into whole pulse records.
+     * \ingroup wavegen
+     *
+     * Every pulse returns rx_len samples (wavegen_block_ctrl::get_rx_len()).
+     * The framer owns a ring of slots of that size, allocated once. The
+     * receive thread asks recv_buffer() where to receive to and how
+     * many samples still fit in the current pulse, calls recv() with
+     * exactly that, and reports the result with push(). A slot is
+     * published as soon as it holds rx_len samples, with the timestamp
+     * of its first sample and a running pulse index.
+     *
+     * A pulse is cut short (and published with truncated set) when
+     * the stream breaks inside it: an end or start of burst, an error,
+     * or, if a sample rate is given, a timestamp that does not follow
+     * on from the previous samples. The next pulse starts on the next
+     * packet.
+     *
+     * One thread produces and one consumes; the ring indices are
+     * lock-free. If the consumer falls behind, whole pulses are
+     * dropped at the receive side and counted, so the ring never
+     * stalls recv().
+     */
+    class WAVEGEN_API pulse_framer : boost::noncopyable
+    {
+    public:
+      typedef boost::shared_ptr<pulse_framer> sptr;
+
+      struct config_t {
+        config_t(void): rx_len(0), item_size(4), num_slots(64), rate(0.0) {}
+        //! Samples per pulse
+        size_t rx_len;
+        //! Bytes per sample, 4 for sc16
+        size_t item_size;
+        size_t num_slots;
+        //! Sample rate for the timestamp continuity check; 0 disables it
+        double rate;
+      };
+
+      //! A published pulse, valid until pop()
+      struct pulse_t {
+        pulse_t(void):
+          index(0), has_time(false), nsamps(0), truncated(false), samples(NULL) {}
+        //! Pulses seen so far, including dropped ones
+        boost::uint64_t index;
+        bool has_time;
+        //! Time of the first sample
+        uhd::time_spec_t time;
+        //! rx_len, or fewer if truncated
+        size_t nsamps;
+        bool truncated;
+        const void *samples;
+      };
+
+      struct stats_t {
+        stats_t(void): pulses(0), truncated(0), dropped(0), discontinuities(0) {}
+        //! Pulses published
+        boost::uint64_t pulses;
+        //! Of those, cut short
+        boost::uint64_t truncated;
+        //! Pulses lost because the ring was full
+        boost::uint64_t dropped;
+        //! Timestamp jumps inside a pulse
+        boost::uint64_t discontinuities;
+      };
+
+      //! Throws std::invalid_argument if rx_len, item_size or num_slots is 0
+      static sptr make(const config_t &config);
+
+      virtual ~pulse_framer() {}
+
+      /* Receive side */
+
+      /*!
+       * Where the next recv() should write, and in \p max_samps the
+       * samples left in the current pulse. Never NULL: with the ring
+       * full this is a scratch slot whose pulse will be dropped.
+       */
+      virtual void *recv_buffer(size_t &max_samps) = 0;
+
+      //! Account for \p nsamps samples received into recv_buffer()
+      virtual void push(size_t nsamps, const uhd::rx_metadata_t &md) = 0;
+
+      //! Publish a partial pulse, e.g. at the end of the stream
+      virtual void flush() = 0;
+
+      /* Consumer side */
+
+      //! Oldest published pulse; false if there is none
+      virtual bool front(pulse_t &pulse) = 0;
+
+      //! Hand the oldest pulse's slot back to the receive side
+      virtual void pop() = 0;
+
+      //! Published pulses not yet popped
+      virtual size_t size() = 0;
+
+      virtual stats_t get_stats() = 0;
+      virtual config_t get_config() = 0;
+    };
+
+  } // namespace wavegen
+} // namespace gr
+
+#endif /* INCLUDED_WAVEGEN_PULSE_FRAMER_H */
@@ -0,0 +1,145 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_WAVEGEN_PULSE_INTEGRATOR_H
+#define INCLUDED_WAVEGEN_PULSE_INTEGRATOR_H
+
+#include <wavegen/api.h>
+#include <wavegen/pulse_framer.h>
+#include <gnuradio/gr_complex.h>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <vector>
+
+namespace gr {
+  namespace wavegen {
+
+    /*!
+     * \brief Coherent pulse integration and range decimation.
+     * \ingroup wavegen
+     *
+     * Cuts the data rate of a pulse stream before it is written or
+     * processed further. Each pulse of rx_len samples is first
+     * decimated in range: every decimation adjacent samples are summed
+     * into one (integrate and dump), giving rx_len / decimation
+     * samples. Then num_pulses pulses are summed sample by sample into
+     * one record. Summing is coherent, so a stationary echo grows with
+     * the number of samples summed and uncorrelated noise only with
+     * its square root.
+     *
+     * Pulses are grouped by pulse index: record k sums pulses
+     * k * num_pulses to (k + 1) * num_pulses - 1, so a dropped pulse
+     * shortens its record instead of shifting the rest. A record is
+     * handed out when its last pulse arrives or a pulse of a later
+     * record does. A truncated pulse counts as zeros past its end.
+     *
+     * With average set (and always for sc16 output) a record is the
+     * mean of the samples that went into it, so it keeps the input's
+     * scale; otherwise it is their sum. Conversion and accumulation go
+     * through VOLK. The integrator is meant for one thread; it runs in
+     * the thread that takes pulses off the framer.
+     */
+    class WAVEGEN_API pulse_integrator : boost::noncopyable
+    {
+    public:
+      typedef boost::shared_ptr<pulse_integrator> sptr;
+
+      enum input_t { INPUT_SC16, INPUT_FC32 };
+      enum output_t { OUTPUT_FC32, OUTPUT_SC16 };
+
+      struct config_t {
+        config_t(void):
+          rx_len(0), num_pulses(1), decimation(1), input(INPUT_SC16),
+          output(OUTPUT_FC32), scale(32767.0f), average(true) {}
+        //! Samples per input pulse
+        size_t rx_len;
+        //! Pulses summed into one record
+        size_t num_pulses;
+        //! Adjacent samples summed into one; must divide rx_len
+        size_t decimation;
+        input_t input;
+        output_t output;
+        //! sc16 input is divided by this for fc32 output
+        float scale;
+        //! Divide by the samples summed; sc16 output always does
+        bool average;
+      };
+
+      struct stats_t {
+        stats_t(void):
+          pulses(0), records(0), missing_pulses(0), late_pulses(0),
+          bytes_in(0), bytes_out(0), process_ns(0) {}
+        //! Pulses added to a record
+        boost::uint64_t pulses;
+        //! Records handed out
+        boost::uint64_t records;
+        //! Pulses absent from the records they belonged to
+        boost::uint64_t missing_pulses;
+        //! Pulses discarded because their record was already handed out
+        boost::uint64_t late_pulses;
+        //! Sample bytes taken in and handed out; their ratio is the reduction
+        boost::uint64_t bytes_in;
+        boost::uint64_t bytes_out;
+        boost::uint64_t process_ns;
+      };
+
+      /*!
+       * Throws std::invalid_argument for a zero rx_len, num_pulses or
+       * decimation, a decimation that does not divide rx_len, sc16
+       * output from fc32 input or a scale that is not positive.
+       */
+      static sptr make(const config_t &config);
+
+      /*!
+       * \p reference decimated the same way as the pulses, so a
+       * matched filter behind the integrator still matches. Trailing
+       * samples short of a whole group are summed as they are.
+       */
+      static std::vector<gr_complex> decimate(const std::vector<gr_complex> &reference,
+                                              size_t decimation);
+
+      virtual ~pulse_integrator() {}
+
+      //! Samples per record, rx_len / decimation
+      virtual size_t get_output_len() const = 0;
+
+      /*!
+       * Add a pulse. Returns true when this completes a record, which
+       * is then in \p record until the next call: the record number as
+       * index, the time of its earliest pulse, get_output_len() samples
+       * in the output format, and truncated set if fewer than
+       * num_pulses pulses went into it.
+       */
+      virtual bool add(const pulse_framer::pulse_t &pulse,
+                       pulse_framer::pulse_t &record) = 0;
+
+      //! Hand out the partial record at the end of a stream, if there is one
+      virtual bool flush(pulse_framer::pulse_t &record) = 0;
+
+      virtual stats_t get_stats() = 0;
+      virtual config_t get_config() = 0;
+    };
+
+  } // namespace wavegen
+} // namespace gr
+
+#endif /* INCLUDED_WAVEGEN_PULSE_INTEGRATOR_H */
@@ -0,0 +1,145 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_WAVEGEN_PULSE_RING_H
+#define INCLUDED_WAVEGEN_PULSE_RING_H
+
+#include <wavegen/api.h>
+#include <wavegen/pulse_file.h>
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <cstddef>
+
+namespace gr {
+  namespace wavegen {
+
+    /*!
+     * \brief Shared memory layout of a pulse ring.
+     * \ingroup wavegen
+     *
+     * A pulse ring hands a stream of pulses from one process to any
+     * number of processes on the same host without copying them again.
+     * pulse_ring_writer creates a POSIX shared memory segment and copies
+     * each pulse into the next slot; pulse_ring_reader maps the same
+     * segment, with the slots read-only, and returns views into it.
+     *
+     *   [control_t][producer_t][consumer_t x max_consumers][slot 0]...
+     *
+     * The control block is written once at creation and holds the
+     * stream's pulse_file header, so a ring and a recording of it
+     * describe the same data. producer_t holds write_seq, the number of
+     * records published so far; record n lives in slot n % num_slots.
+     * Each reader claims one consumer_t and publishes its read cursor
+     * there, which is how the writer sees how far each consumer lags.
+     * producer_t and every consumer_t sit on cache lines of their own,
+     * so cursors written by different processes never share a line.
+     *
+     * Nothing is locked. The writer never waits for readers: a reader
+     * more than num_slots records behind loses the oldest ones and
+     * counts them as dropped. Each slot starts with a sequence number
+     * that is odd while the writer fills it and 2n + 2 once it holds
+     * record n, so a reader can tell whether a record it looked at was
+     * overwritten underneath it.
+     *
+     * The cursors are lock-free 64-bit atomics, which are address-free
+     * and therefore work across processes. All other fields are
+     * little-endian and naturally aligned; the ring is for one host.
+     */
+    class WAVEGEN_API pulse_ring
+    {
+    public:
+      static const char MAGIC[8];
+      static const boost::uint32_t VERSION = 1;
+      static const size_t CACHE_LINE = 64;
+      //! Offsets of producer_t and the first consumer_t in the segment
+      static const size_t PRODUCER_OFFSET = 256;
+      static const size_t CONSUMERS_OFFSET = 512;
+      //! Bytes before a slot's samples, so they stay aligned for VOLK
+      static const size_t SLOT_HEADER_SIZE = 64;
+
+      //! consumer_t::state
+      enum consumer_state_t { CONSUMER_FREE = 0, CONSUMER_CLAIMED = 1, CONSUMER_ACTIVE = 2 };
+
+      //! Written once by the writer at offset 0
+      struct control_t {
+        char magic[8];
+        boost::uint32_t version;
+        boost::uint32_t num_slots;
+        boost::uint32_t max_consumers;
+        //! Process id of the writer, so readers notice when it dies
+        boost::uint32_t writer_pid;
+        //! Bytes from one slot to the next, a multiple of CACHE_LINE
+        boost::uint64_t slot_size;
+        //! Offset of slot 0, a multiple of the page size
+        boost::uint64_t slots_offset;
+        boost::uint64_t segment_size;
+        //! What the records are; has no index
+        pulse_file::header_t stream;
+      };
+
+      //! Written by the writer only
+      struct producer_t {
+        //! Records published; record n is complete once this exceeds n
+        boost::atomic<boost::uint64_t> write_seq;
+        //! Set when the writer closes the ring; no more records follow
+        boost::atomic<boost::uint32_t> closed;
+      };
+
+      //! One per reader, written by that reader only
+      struct consumer_t {
+        boost::atomic<boost::uint32_t> state;
+        boost::uint32_t pid;
+        //! The next record this reader takes
+        boost::atomic<boost::uint64_t> read_seq;
+        //! Records taken intact
+        boost::atomic<boost::uint64_t> records;
+        //! Records overwritten before the reader took them or while it held them
+        boost::atomic<boost::uint64_t> dropped;
+      };
+
+      //! Start of each slot; the samples follow at SLOT_HEADER_SIZE
+      struct slot_t {
+        //! 2n + 1 while record n is written, 2n + 2 once it is complete
+        boost::atomic<boost::uint64_t> seq;
+        //! Pulse number from pulse_framer, or record number from a pulse_integrator
+        boost::uint64_t index;
+        //! Time of the first sample in ticks at the stream's rate
+        boost::int64_t ticks;
+        boost::uint32_t nsamps;
+        //! pulse_file::PULSE_HAS_TIME and PULSE_TRUNCATED
+        boost::uint32_t flags;
+      };
+
+      //! Whether process \p pid still exists
+      static bool process_alive(boost::uint32_t pid);
+
+      /*!
+       * Free \p consumer if it is active but its process has died, so
+       * a reader that crashed does not hold an entry, or count as
+       * lagging, forever. Returns true if it was freed.
+       */
+      static bool reap_consumer(consumer_t &consumer);
+    };
+
+  } // namespace wavegen
+} // namespace gr
+
+#endif /* INCLUDED_WAVEGEN_PULSE_RING_H */
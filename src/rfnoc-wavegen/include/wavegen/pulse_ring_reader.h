@@ -0,0 +1,123 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_WAVEGEN_PULSE_RING_READER_H
+#define INCLUDED_WAVEGEN_PULSE_RING_READER_H
+
+#include <wavegen/api.h>
+#include <wavegen/pulse_file.h>
+#include <wavegen/pulse_framer.h>
+#include <wavegen/pulse_ring.h>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <string>
+
+namespace gr {
+  namespace wavegen {
+
+    /*!
+     * \brief Takes pulses from a pulse ring published by another process.
+     * \ingroup wavegen
+     *
+     * Attaching maps the ring's slots read-only and claims an entry in
+     * its consumer table, where the reader keeps its cursor for the
+     * writer to see. Every reader gets every record; readers do not
+     * affect each other or the writer.
+     *
+     * front() returns a view of the next record whose samples point
+     * into the shared slot, so nothing is copied. The writer may reuse
+     * the slot once it is num_slots records ahead, so work on the view
+     * and then call pop(), which tells whether the record stayed intact
+     * meanwhile; if not, whatever was computed from it should be
+     * discarded. A reader that falls more than num_slots records behind
+     * skips to the oldest record still in the ring and counts the ones
+     * it missed as dropped.
+     *
+     *   pulse_framer::pulse_t p;
+     *   while (not reader->closed()) {
+     *     if (not reader->front(p)) { sleep briefly; continue; }
+     *     process(p);
+     *     if (not reader->pop()) { discard the result; }
+     *   }
+     *
+     * A reader is meant for one thread; attach one reader per thread.
+     */
+    class WAVEGEN_API pulse_ring_reader : boost::noncopyable
+    {
+    public:
+      typedef boost::shared_ptr<pulse_ring_reader> sptr;
+
+      struct stats_t {
+        stats_t(void):
+          records(0), dropped(0), torn(0), lag(0) {}
+        //! Records taken intact
+        boost::uint64_t records;
+        //! Records overwritten before front() got to them
+        boost::uint64_t dropped;
+        //! Records overwritten between front() and pop()
+        boost::uint64_t torn;
+        //! Records published and not yet taken
+        boost::uint64_t lag;
+      };
+
+      /*!
+       * Attach to the ring \p name. The reader starts with the next
+       * record published, or with \p oldest the oldest one still in the
+       * ring. Throws std::runtime_error if the ring does not exist, is
+       * not a pulse ring or has no free consumer entry.
+       */
+      static sptr make(const std::string &name, bool oldest = false);
+
+      virtual ~pulse_ring_reader() {}
+
+      virtual const pulse_file::info_t &get_info() const = 0;
+      virtual size_t get_item_size() const = 0;
+      virtual size_t get_num_slots() const = 0;
+
+      /*!
+       * The next record, if one is ready, without taking it. Returns
+       * the same record until pop().
+       */
+      virtual bool front(pulse_framer::pulse_t &pulse) = 0;
+
+      /*!
+       * Take the record returned by front(). Returns false if the
+       * writer overwrote it in the meantime, or if there was none.
+       */
+      virtual bool pop() = 0;
+
+      //! Records published and not yet taken
+      virtual boost::uint64_t lag() const = 0;
+
+      /*!
+       * The writer has closed the ring or died and every record was
+       * taken; nothing more will come.
+       */
+      virtual bool closed() const = 0;
+
+      virtual stats_t get_stats() const = 0;
+    };
+
+  } // namespace wavegen
+} // namespace gr
+
+#endif /* INCLUDED_WAVEGEN_PULSE_RING_READER_H */
@@ -0,0 +1,150 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_WAVEGEN_PULSE_RING_WRITER_H
+#define INCLUDED_WAVEGEN_PULSE_RING_WRITER_H
+
+#include <wavegen/api.h>
+#include <wavegen/pulse_file.h>
+#include <wavegen/pulse_framer.h>
+#include <wavegen/pulse_ring.h>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <string>
+#include <vector>
+
+namespace gr {
+  namespace wavegen {
+
+    /*!
+     * \brief Publishes pulses to other processes through a pulse ring.
+     * \ingroup wavegen
+     *
+     * Creates the shared memory segment \p name (as for shm_open(), e.g.
+     * "/wavegen_rx") with num_slots slots of info.rx_len samples each,
+     * and removes the name again when closed; processes already
+     * attached keep their mapping. publish() copies one pulse into the
+     * next slot and never waits: consumers that fall more than
+     * num_slots records behind lose records, and the writer's
+     * get_consumers() shows which ones do. The copy into the slot is
+     * the only one; readers work on the slot in place.
+     *
+     * The writer is meant for one thread, normally the one taking
+     * pulses off the framer or integrator. get_consumers() and
+     * get_stats() may be called from any thread.
+     */
+    class WAVEGEN_API pulse_ring_writer : boost::noncopyable
+    {
+    public:
+      typedef boost::shared_ptr<pulse_ring_writer> sptr;
+
+      struct config_t {
+        config_t(void):
+          num_slots(256), max_consumers(16), lag_threshold(0) {}
+        //! Records the ring holds; a power of two
+        size_t num_slots;
+        //! Readers that can attach at once
+        size_t max_consumers;
+        //! A consumer this many records behind counts as lagging; 0 for half the ring
+        size_t lag_threshold;
+      };
+
+      struct consumer_info_t {
+        consumer_info_t(void):
+          slot(0), pid(0), read_seq(0), lag(0), records(0), dropped(0),
+          lagging(false), overrun(false) {}
+        //! Entry in the consumer table
+        size_t slot;
+        boost::uint32_t pid;
+        boost::uint64_t read_seq;
+        //! Records published that the consumer has not taken yet
+        boost::uint64_t lag;
+        boost::uint64_t records;
+        boost::uint64_t dropped;
+        //! lag is at least lag_threshold
+        bool lagging;
+        //! lag exceeds the ring; the consumer will drop records
+        bool overrun;
+      };
+
+      struct stats_t {
+        stats_t(void):
+          records(0), bytes(0), truncated_pulses(0), consumers(0),
+          lagging_consumers(0), max_lag(0), consumer_drops(0),
+          reaped_consumers(0) {}
+        //! Records published and their sample bytes
+        boost::uint64_t records;
+        boost::uint64_t bytes;
+        //! Pulses longer than a slot, published cut short
+        boost::uint64_t truncated_pulses;
+        //! Attached consumers, and those lagging
+        boost::uint64_t consumers;
+        boost::uint64_t lagging_consumers;
+        //! Largest lag among them
+        boost::uint64_t max_lag;
+        //! Records dropped, summed over attached consumers
+        boost::uint64_t consumer_drops;
+        //! Entries freed because their process had died
+        boost::uint64_t reaped_consumers;
+      };
+
+      /*!
+       * Create the ring \p name for pulses described by \p info. A
+       * segment of that name left behind by a writer that died is
+       * replaced. Throws std::invalid_argument for a bad name, zero
+       * rx_len or consumers, or a slot count that is not a power of
+       * two, and std::runtime_error if the name is in use by a live
+       * writer or the segment cannot be created.
+       */
+      static sptr make(const std::string &name, const pulse_file::info_t &info,
+                       const config_t &config);
+
+      virtual ~pulse_ring_writer() {}
+
+      virtual const std::string &get_name() const = 0;
+
+      /*!
+       * Copy \p pulse into the next slot and publish it. A pulse longer
+       * than rx_len is cut to rx_len and marked truncated.
+       */
+      virtual void publish(const pulse_framer::pulse_t &pulse) = 0;
+
+      /*!
+       * Mark the ring closed, so readers know no more records follow,
+       * and remove its name. Idempotent; the destructor calls it.
+       */
+      virtual void close() = 0;
+
+      /*!
+       * The attached consumers and how far behind each one is. Entries
+       * of consumers whose process has died are freed on the way.
+       */
+      virtual std::vector<consumer_info_t> get_consumers() = 0;
+
+      virtual stats_t get_stats() = 0;
+      virtual config_t get_config() = 0;
+    };
+
+  } // namespace wavegen
+} // namespace gr
+
+#endif /* INCLUDED_WAVEGEN_PULSE_RING_WRITER_H */
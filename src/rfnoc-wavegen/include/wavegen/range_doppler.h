@@ -0,0 +1,189 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_WAVEGEN_RANGE_DOPPLER_H
+#define INCLUDED_WAVEGEN_RANGE_DOPPLER_H
+
+#include <wavegen/api.h>
+#include <wavegen/pulse_framer.h>
+#include <wavegen/thread_profile.h>
+#include <gnuradio/gr_complex.h>
+#include <gnuradio/fft/window.h>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace gr {
+  namespace wavegen {
+
+    /*!
+     * \brief Range-Doppler maps over a coherent processing interval.
+     * \ingroup wavegen
+     *
+     * Collects cpi_len range-compressed pulses (normally
+     * matched_filter output) into a CPI, then for every range bin
+     * takes the windowed FFT across the pulses and outputs its
+     * magnitude (or power). Pulses are placed by pulse index: CPI k
+     * holds pulses k * cpi_len to (k + 1) * cpi_len - 1, so a dropped
+     * pulse leaves a zero column instead of shifting the rest, and a
+     * pulse from a later CPI completes the current one.
+     *
+     * add() stores each pulse as it comes, pulse-major. The corner
+     * turn to range-major happens on the workers, a tile of range bins
+     * at a time so reads stay sequential along each pulse, followed
+     * by the Doppler FFTs of that tile. The range bins of one CPI are
+     * split across all workers, so a single CPI uses every core.
+     * FFT plans come from the process-wide plan cache.
+     *
+     * Every CPI slot holds num_bins * cpi_len gr_complex in and
+     * num_bins * doppler_size floats out, allocated once; at 1024
+     * pulses by 64k bins that is 768 MiB per slot. One thread adds
+     * pulses and one consumes maps; add() waits when all slots are in
+     * use.
+     */
+    class WAVEGEN_API range_doppler : boost::noncopyable
+    {
+    public:
+      typedef boost::shared_ptr<range_doppler> sptr;
+
+      enum output_t { OUTPUT_MAGNITUDE, OUTPUT_POWER };
+
+      struct config_t {
+        config_t(void):
+          num_bins(0), cpi_len(64), doppler_size(0),
+          window(gr::fft::window::WIN_HAMMING), output(OUTPUT_MAGNITUDE),
+          prf(0.0), num_workers(2), num_cpis(2) {}
+        //! Range bins per pulse (matched_filter rx_len)
+        size_t num_bins;
+        //! Pulses per CPI
+        size_t cpi_len;
+        //! Doppler FFT size, 0 for cpi_len; larger zero pads
+        size_t doppler_size;
+        //! Taper across the pulses of a CPI
+        gr::fft::window::win_type window;
+        output_t output;
+        //! Pulse repetition frequency in Hz, see prf_from_count()
+        double prf;
+        size_t num_workers;
+        //! CPI slots; two lets one fill while the other is processed
+        size_t num_cpis;
+        //! Worker threads enter its process role
+        thread_profile::sptr threads;
+      };
+
+      //! A finished map, valid until pop()
+      struct map_t {
+        map_t(void):
+          index(0), first_pulse(0), pulses(0), has_time(false),
+          num_bins(0), doppler_size(0), output(OUTPUT_MAGNITUDE), data(NULL) {}
+        //! CPI number, first_pulse / cpi_len
+        boost::uint64_t index;
+        boost::uint64_t first_pulse;
+        //! Pulses received; the rest of the CPI was zero
+        size_t pulses;
+        bool has_time;
+        //! Time of the CPI's first pulse, extrapolated at the PRF if it was missing
+        uhd::time_spec_t time;
+        size_t num_bins;
+        size_t doppler_size;
+        //! What data holds, from the config
+        output_t output;
+        /*!
+         * Range-major: data[bin * doppler_size + k], with zero Doppler
+         * at k = doppler_size / 2 (see doppler_frequency()).
+         */
+        const float *data;
+      };
+
+      struct stats_t {
+        stats_t(void):
+          cpis(0), pulses(0), missing_pulses(0), late_pulses(0),
+          process_ns(0), backpressure_waits(0), max_pending(0) {}
+        //! Maps finished by the workers
+        boost::uint64_t cpis;
+        //! Pulses added to a CPI
+        boost::uint64_t pulses;
+        //! Pulses absent from the CPIs they belonged to
+        boost::uint64_t missing_pulses;
+        //! Pulses discarded because their CPI was already handed on or repeated
+        boost::uint64_t late_pulses;
+        //! Worker time spent on corner turns and FFTs, summed over workers
+        boost::uint64_t process_ns;
+        //! add() calls that had to wait for a free CPI slot
+        boost::uint64_t backpressure_waits;
+        //! Most CPIs handed on and not yet finished at once
+        boost::uint64_t max_pending;
+      };
+
+      /*!
+       * Throws std::invalid_argument for a zero num_bins, cpi_len,
+       * worker or slot count, a doppler_size below cpi_len or a PRF
+       * that is not positive.
+       */
+      static sptr make(const config_t &config);
+
+      /*!
+       * PRF in Hz for the pulse period programmed with
+       * wavegen_block_ctrl::set_prf_count(), in ticks at \p tick_rate.
+       */
+      static double prf_from_count(boost::uint64_t prf_count, double tick_rate);
+
+      virtual ~range_doppler() {}
+
+      /*!
+       * Map one whole CPI on the calling thread. \p cube holds cpi_len
+       * pulses of num_bins, pulse-major; \p out takes num_bins *
+       * doppler_size values laid out as map_t::data.
+       */
+      virtual void process(const gr_complex *cube, float *out) = 0;
+
+      //! Doppler shift in Hz of map column \p k
+      virtual double doppler_frequency(size_t k) const = 0;
+
+      /* Pipeline */
+
+      /*!
+       * Copy in a pulse of gr_complex range bins (at most num_bins, the
+       * rest count as zeros). A pulse of a later CPI hands the current
+       * one on first; waits for a free slot.
+       */
+      virtual void add(const pulse_framer::pulse_t &pulse) = 0;
+
+      //! Hand on the current CPI as it is, at the end of a stream
+      virtual void flush() = 0;
+
+      //! Oldest map, if it has been finished
+      virtual bool front(map_t &map) = 0;
+
+      //! Hand the oldest slot back to add()
+      virtual void pop() = 0;
+
+      //! CPIs handed on and not yet popped
+      virtual size_t size() = 0;
+
+      virtual stats_t get_stats() = 0;
+      virtual config_t get_config() = 0;
+    };
+
+  } // namespace wavegen
+} // namespace gr
+
+#endif /* INCLUDED_WAVEGEN_RANGE_DOPPLER_H */
@@ -0,0 +1,139 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_WAVEGEN_SAMPLE_CONVERTER_H
+#define INCLUDED_WAVEGEN_SAMPLE_CONVERTER_H
+
+#include <wavegen/api.h>
+#include <wavegen/thread_profile.h>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <complex>
+
+namespace gr {
+  namespace wavegen {
+
+    /*!
+     * \brief Converts sc16 blocks to fc32 or fc64 on a pool of workers.
+     * \ingroup wavegen
+     *
+     * Lets the receive thread stream sc16, the cheapest format to
+     * receive, and moves the conversion off it. The receive thread
+     * takes an input block with acquire(), receives into it and hands
+     * it over with submit(). Workers convert blocks in parallel through
+     * VOLK, which picks the SSE/AVX/NEON kernels for the host. The
+     * consumer gets the converted blocks back in submission order with
+     * front() and pop().
+     *
+     * Blocks are allocated once. acquire() waits only when every block
+     * is queued or not yet popped; those waits are counted.
+     *
+     * Output is sample / scale, so the default matches UHD's own sc16
+     * to fc32 conversion. With remove_dc, each block's own mean is
+     * subtracted, so the result does not depend on which worker
+     * converted which block.
+     *
+     * One thread calls acquire() and submit(), one calls front() and
+     * pop(); get_stats() may be called from anywhere.
+     */
+    class WAVEGEN_API sample_converter : boost::noncopyable
+    {
+    public:
+      typedef boost::shared_ptr<sample_converter> sptr;
+
+      enum output_t { OUTPUT_FC32, OUTPUT_FC64 };
+
+      struct config_t {
+        config_t(void):
+          output(OUTPUT_FC32), num_workers(2), num_blocks(32),
+          block_samps(10000), scale(32767.0f), remove_dc(false) {}
+        output_t output;
+        size_t num_workers;
+        size_t num_blocks;
+        //! Most samples per block
+        size_t block_samps;
+        float scale;
+        bool remove_dc;
+        //! Worker threads enter its convert role
+        thread_profile::sptr threads;
+      };
+
+      //! A converted block, valid until pop()
+      struct block_t {
+        block_t(void): samples(NULL), nsamps(0) {}
+        const void *samples;
+        size_t nsamps;
+      };
+
+      struct stats_t {
+        stats_t(void):
+          blocks(0), samples(0), convert_ns(0), backpressure_waits(0),
+          max_pending(0) {}
+        //! Blocks converted
+        boost::uint64_t blocks;
+        boost::uint64_t samples;
+        //! Time the workers spent converting, summed over workers
+        boost::uint64_t convert_ns;
+        //! acquire() calls that had to wait for a free block
+        boost::uint64_t backpressure_waits;
+        //! Most blocks submitted and not yet converted at once
+        boost::uint64_t max_pending;
+      };
+
+      //! Throws std::invalid_argument for a zero count or size or a bad scale
+      static sptr make(const config_t &config);
+
+      virtual ~sample_converter() {}
+
+      /* Receive side */
+
+      /*!
+       * The next input block, block_samps samples long, waiting for the
+       * consumer to pop() one if none is free.
+       */
+      virtual std::complex<short> *acquire(void) = 0;
+
+      //! Queue the first \p nsamps samples of the acquired block
+      virtual void submit(size_t nsamps) = 0;
+
+      /* Consumer side */
+
+      //! Oldest block, if it has been converted
+      virtual bool front(block_t &block) = 0;
+
+      //! Hand the oldest block back to the receive side
+      virtual void pop(void) = 0;
+
+      //! Blocks submitted and not yet popped, converted or not
+      virtual size_t size(void) = 0;
+
+      //! Bytes per output sample
+      virtual size_t output_item_size(void) const = 0;
+
+      virtual stats_t get_stats(void) = 0;
+      virtual config_t get_config(void) = 0;
+    };
+
+  } // namespace wavegen
+} // namespace gr
+
+#endif /* INCLUDED_WAVEGEN_SAMPLE_CONVERTER_H */
@@ -0,0 +1,164 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_WAVEGEN_SAMPLE_RECORDER_H
+#define INCLUDED_WAVEGEN_SAMPLE_RECORDER_H
+
+#include <wavegen/api.h>
+#include <wavegen/buffer_pool.h>
+#include <wavegen/thread_profile.h>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <string>
+
+namespace gr {
+  namespace wavegen {
+
+    /*!
+     * \brief Writes a sample stream to disk from writer threads.
+     * \ingroup wavegen
+     *
+     * The receive thread takes a buffer from a preallocated pool with
+     * acquire(), fills it (typically with several recv() calls) and
+     * hands it over with commit(). Free and filled buffers are passed
+     * through lock-free queues, so the receive thread never waits on
+     * the disk unless the whole pool is full. Writer threads write each
+     * buffer at its own file offset with pwrite(), coalescing buffers
+     * that follow each other into one pwritev() call.
+     *
+     * Buffers are aligned to ALIGNMENT bytes. With direct I/O, full
+     * buffers at aligned offsets bypass the page cache (O_DIRECT);
+     * anything unaligned, normally only the last buffer, goes through a
+     * second, buffered descriptor.
+     *
+     * The buffers come from a buffer_pool, the recorder's own unless
+     * one is passed in the config. Passing one lets the recorder use
+     * huge, locked pages.
+     * A buffer is held from acquire() until it is written.
+     *
+     * When the pool runs dry, acquire() either waits for a writer
+     * (POLICY_BLOCK, the default) or returns nothing and the caller
+     * drops the data (POLICY_DROP). Both are counted in the stats.
+     *
+     * acquire(), commit() and drop() are meant to be called from the
+     * one receive thread; get_stats() may be called from anywhere.
+     */
+    class WAVEGEN_API sample_recorder : boost::noncopyable
+    {
+    public:
+      typedef boost::shared_ptr<sample_recorder> sptr;
+
+      //! Buffer address, size and file offset alignment for direct I/O
+      static const size_t ALIGNMENT = 4096;
+
+      enum full_policy_t { POLICY_BLOCK, POLICY_DROP };
+
+      struct config_t {
+        config_t(void):
+          num_buffers(32), buffer_size(8 << 20), num_writers(1),
+          max_batch(4), direct_io(true), policy(POLICY_BLOCK) {}
+        //! Ignored with a pool, which sets them
+        size_t num_buffers;
+        //! Bytes per buffer, a multiple of ALIGNMENT
+        size_t buffer_size;
+        size_t num_writers;
+        //! Most buffers one writer coalesces into a single write
+        size_t max_batch;
+        //! Use O_DIRECT where the platform and file system allow it
+        bool direct_io;
+        full_policy_t policy;
+        //! Take buffers from this pool instead of allocating them
+        buffer_pool::sptr pool;
+        //! Worker threads enter its write role
+        thread_profile::sptr threads;
+      };
+
+      struct buffer_t {
+        char *data;
+        size_t size;
+      };
+
+      struct stats_t {
+        stats_t(void):
+          buffers_written(0), bytes_written(0), writes(0),
+          buffers_dropped(0), bytes_dropped(0), backpressure_waits(0),
+          max_queued(0), max_write_us(0), direct_io(false) {}
+        boost::uint64_t buffers_written;
+        boost::uint64_t bytes_written;
+        //! pwrite()/pwritev() calls
+        boost::uint64_t writes;
+        //! acquire() calls that found no buffer under POLICY_DROP
+        boost::uint64_t buffers_dropped;
+        //! Bytes reported through drop()
+        boost::uint64_t bytes_dropped;
+        //! acquire() calls that had to wait for a writer
+        boost::uint64_t backpressure_waits;
+        //! Most buffers waiting for a writer at once
+        boost::uint64_t max_queued;
+        //! Slowest single write
+        boost::uint64_t max_write_us;
+        //! O_DIRECT is actually in use
+        bool direct_io;
+      };
+
+      /*!
+       * Create (or truncate) \p path and start the writer threads.
+       * Throws std::invalid_argument for a bad config and
+       * std::runtime_error if the file cannot be opened.
+       */
+      static sptr make(const std::string &path, const config_t &config = config_t());
+
+      virtual ~sample_recorder() {}
+
+      /*!
+       * Take an empty buffer. Returns false only under POLICY_DROP when
+       * no buffer is free; the caller should then receive into scratch
+       * memory and report it with drop(). Throws std::runtime_error
+       * after a write error.
+       */
+      virtual bool acquire(buffer_t &buffer) = 0;
+
+      /*!
+       * Queue the first \p nbytes of \p buffer to be written after
+       * everything committed before it. A buffer committed with 0 bytes
+       * is just returned to the pool.
+       */
+      virtual void commit(const buffer_t &buffer, size_t nbytes) = 0;
+
+      //! Count \p nbytes of samples that could not be recorded
+      virtual void drop(size_t nbytes) = 0;
+
+      /*!
+       * Write everything committed, stop the writers and close the
+       * file. Called by the destructor. Throws std::runtime_error if
+       * any write failed.
+       */
+      virtual void close() = 0;
+
+      virtual stats_t get_stats() = 0;
+    };
+
+  } // namespace wavegen
+} // namespace gr
+
+#endif /* INCLUDED_WAVEGEN_SAMPLE_RECORDER_H */
@@ -0,0 +1,188 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_WAVEGEN_THREAD_PROFILE_H
+#define INCLUDED_WAVEGEN_THREAD_PROFILE_H
+
+#include <wavegen/api.h>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <string>
+#include <vector>
+
+namespace gr {
+  namespace wavegen {
+
+    /*!
+     * \brief CPU placement and scheduling of the pipeline's threads.
+     * \ingroup wavegen
+     *
+     * Each thread of the receive pipeline plays one role: receiving,
+     * converting, writing to disk, processing pulses, or control. The
+     * profile gives each role a set of cores and a scheduling policy
+     * and priority. A thread takes on its role by calling enter() (or
+     * holding a scoped_role) when it starts. The library's worker
+     * threads do this when their config carries a profile.
+     *
+     * A thread that enters runs with its role's policy, SCHED_OTHER
+     * unless configured, rather than one inherited from the thread that
+     * created it. Likewise a role without cores runs on any core the
+     * process could when the profile was made, not only on its
+     * creator's. A thread that enters is also tracked. get_thread_stats() reports its
+     * CPU time and its voluntary and involuntary context switches since
+     * it entered its current role. They are read from /proc while the
+     * thread runs and from getrusage() when it leaves. An involuntary
+     * switch count that stays at 0 shows that a receive thread was
+     * never preempted.
+     *
+     * Real-time policies and pinning usually need privileges
+     * (CAP_SYS_NICE or an rtprio limit). A failure is recorded in the
+     * thread's stats and is not fatal unless config_t::strict is set.
+     * A worker thread has nobody to throw to, so the library's
+     * components call validate() for their role before they start
+     * their threads, and report a strict failure from make().
+     * check() lists setup problems that undo the point of pinning: a
+     * receive core that is not isolated, cores shared between receive
+     * and other roles, cores outside the process's allowed set, and RT
+     * throttling.
+     *
+     * All methods are thread safe.
+     */
+    class WAVEGEN_API thread_profile : boost::noncopyable
+    {
+    public:
+      typedef boost::shared_ptr<thread_profile> sptr;
+
+      enum role_t { ROLE_RECEIVE, ROLE_CONVERT, ROLE_WRITE, ROLE_PROCESS, ROLE_CONTROL, NUM_ROLES };
+      enum policy_t { POLICY_OTHER, POLICY_FIFO, POLICY_RR };
+
+      struct role_config_t {
+        role_config_t(void):
+          policy(POLICY_OTHER), priority(0) {}
+        //! Cores the role's threads may run on; empty for any
+        std::vector<int> cpus;
+        policy_t policy;
+        //! 1 to 99 for POLICY_FIFO and POLICY_RR, 0 for POLICY_OTHER
+        int priority;
+      };
+
+      struct config_t {
+        config_t(void):
+          strict(false) {}
+        role_config_t roles[NUM_ROLES];
+        //! Throw from enter() and validate() if a thread cannot be pinned or scheduled
+        bool strict;
+      };
+
+      struct thread_stats_t {
+        thread_stats_t(void):
+          role(ROLE_CONTROL), tid(0), applied(false), running(false),
+          cpu_ns(0), voluntary_switches(0), involuntary_switches(0),
+          last_cpu(-1) {}
+        role_t role;
+        std::string name;
+        //! Kernel thread id
+        int tid;
+        //! Placement and policy took effect; otherwise error says why
+        bool applied;
+        std::string error;
+        //! Still running, i.e. it has not left
+        bool running;
+        boost::uint64_t cpu_ns;
+        boost::uint64_t voluntary_switches;
+        boost::uint64_t involuntary_switches;
+        //! Core it last ran on, -1 if unknown
+        int last_cpu;
+      };
+
+      /*!
+       * \brief Holds a role for the life of a scope.
+       *
+       * Enters on construction and leaves on destruction. Does nothing
+       * with a null profile, so worker loops can use it unconditionally.
+       * Never throws, even with config_t::strict; a failure is only
+       * recorded in the thread's stats, so call validate() before
+       * starting the thread.
+       */
+      class WAVEGEN_API scoped_role : boost::noncopyable
+      {
+      public:
+        scoped_role(sptr profile, role_t role, const std::string &name);
+        ~scoped_role();
+
+      private:
+        sptr _profile;
+      };
+
+      /*!
+       * Throws std::invalid_argument for a core outside 0 to
+       * CPU_SETSIZE - 1, a priority outside 1 to 99 with POLICY_FIFO or
+       * POLICY_RR, or a non-zero priority with POLICY_OTHER.
+       */
+      static sptr make(const config_t &config);
+
+      /*!
+       * Parse a core list such as "2", "2,3" or "4-7,9". An empty string
+       * is an empty list. Throws std::invalid_argument.
+       */
+      static std::vector<int> parse_cpus(const std::string &list);
+
+      //! "other", "fifo" or "rr"; throws std::invalid_argument otherwise
+      static policy_t parse_policy(const std::string &policy);
+
+      //! "receive", "convert", "write", "process" or "control"
+      static const char *role_name(role_t role);
+
+      virtual ~thread_profile() {}
+
+      /*!
+       * Pin and schedule the calling thread for \p role and track it
+       * under \p name. Entering again changes the thread's role. With
+       * strict set, throws std::runtime_error if the placement or policy
+       * could not be applied.
+       */
+      virtual void enter(role_t role, const std::string &name) = 0;
+
+      /*!
+       * With strict set, try the placement and policy of \p role on a
+       * short-lived thread and throw std::runtime_error if they cannot
+       * be applied. Does nothing otherwise. The calling thread keeps
+       * its own placement.
+       */
+      virtual void validate(role_t role) = 0;
+
+      //! Record the calling thread's final counts; call before it exits
+      virtual void leave() = 0;
+
+      //! Problems with the profile on this system, one line each
+      virtual std::vector<std::string> check() = 0;
+
+      //! Every thread that entered, in the order they entered
+      virtual std::vector<thread_stats_t> get_thread_stats() = 0;
+
+      virtual config_t get_config() = 0;
+    };
+
+  } // namespace wavegen
+} // namespace gr
+
+#endif /* INCLUDED_WAVEGEN_THREAD_PROFILE_H */
@@ -0,0 +1,161 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_WAVEGEN_WAVEFORM_SYNTH_H
+#define INCLUDED_WAVEGEN_WAVEFORM_SYNTH_H
+
+#include <wavegen/api.h>
+#include <gnuradio/gr_complex.h>
+#include <gnuradio/fft/window.h>
+#include <boost/cstdint.hpp>
+#include <vector>
+
+namespace gr {
+  namespace wavegen {
+
+    /*!
+     * \brief Host-side waveform synthesis for the wavegen AWG.
+     * \ingroup wavegen
+     *
+     * Frequencies are normalized to the sample rate (cycles/sample,
+     * -0.5 to 0.5). Generators return unit-amplitude complex samples;
+     * apply_window() shapes them and pack_sc16() turns them into the
+     * words set_waveform() takes. The trig, windowing and conversion
+     * loops run through VOLK, which dispatches to SSE/AVX/NEON kernels
+     * where the machine has them and to generic C otherwise.
+     *
+     * Phases are accumulated in double precision and wrapped before
+     * the single-precision sin/cos, so long waveforms keep their
+     * frequency accuracy.
+     */
+    class WAVEGEN_API waveform_synth
+    {
+    public:
+      //! Width of the chirp generator's phase and frequency accumulators
+      static const int DDS_ACCUM_BITS = 32;
+
+      //! Phase bits addressing the chirp generator's sin/cos table
+      static const int DDS_LUT_BITS = 16;
+
+      //! Peak sc16 value of the chirp generator's table
+      static const int DDS_AMPLITUDE = 32767;
+
+      //! Chirp generator programming, as taken by setup_chirp()
+      struct chirp_coefs_t {
+        boost::uint32_t len;
+        boost::uint32_t tuning_coef;
+        boost::uint32_t freq_offset;
+      };
+
+      /*!
+       * Linear FM sweep of \p bandwidth centred on \p center_freq.
+       * Sample n has instantaneous frequency f0 + k*n with
+       * f0 = center_freq - bandwidth/2 and k = bandwidth/num_samps,
+       * and phase 2*pi*(f0*n + k*n*(n-1)/2), the sum of the
+       * frequencies before it, which is how the chirp generator
+       * accumulates it.
+       */
+      static std::vector<gr_complex> lfm(size_t num_samps, double bandwidth,
+                                         double center_freq = 0.0);
+
+      /*!
+       * Tangent-FM nonlinear sweep of \p bandwidth centred on
+       * \p center_freq. The instantaneous frequency is
+       * (bandwidth/2) * tan(2*beta*u) / tan(beta) for u from -1/2 to
+       * 1/2, so it dwells longer near the centre and the spectrum is
+       * tapered without an amplitude window. \p beta is in (0, pi/2);
+       * small values approach lfm().
+       */
+      static std::vector<gr_complex> nlfm(size_t num_samps, double bandwidth,
+                                          double beta, double center_freq = 0.0);
+
+      //! Binary phases (0 or pi) of the Barker code of length 2, 3, 4, 5, 7, 11 or 13
+      static std::vector<float> barker_code(size_t len);
+
+      //! Phases of the Frank code with \p m steps (m*m chips)
+      static std::vector<float> frank_code(size_t m);
+
+      //! Phases of the P4 polyphase code of \p len chips
+      static std::vector<float> p4_code(size_t len);
+
+      /*!
+       * Phase-coded pulse: chip i is exp(j*phases[i]) held for
+       * \p samps_per_chip samples.
+       */
+      static std::vector<gr_complex> phase_coded(const std::vector<float> &phases,
+                                                 size_t samps_per_chip);
+
+      /*!
+       * Stepped-frequency pulse train: \p num_steps tones of
+       * \p samps_per_step samples each, the i-th at
+       * start_freq + i*freq_step. Phase is continuous across steps.
+       */
+      static std::vector<gr_complex> stepped_frequency(size_t num_steps,
+                                                       size_t samps_per_step,
+                                                       double start_freq,
+                                                       double freq_step);
+
+      /*!
+       * Multiply \p samples in place by a window of their length.
+       * \p beta is only used by the Kaiser window.
+       */
+      static void apply_window(std::vector<gr_complex> &samples,
+                               gr::fft::window::win_type type,
+                               double beta = 6.76);
+
+      /*!
+       * Convert to AWG words: I in the upper 16 bits, Q in the lower,
+       * each rounded from sample*scale and saturated to int16.
+       */
+      static std::vector<boost::uint32_t> pack_sc16(const std::vector<gr_complex> &samples,
+                                                    float scale = 32767.0f);
+
+      //! Inverse of pack_sc16()
+      static std::vector<gr_complex> unpack_sc16(const std::vector<boost::uint32_t> &words,
+                                                 float scale = 32767.0f);
+
+      /*!
+       * Chirp generator settings for the same sweep as
+       * lfm(len, bandwidth, center_freq), rounded to the accumulator
+       * resolution of 2^-32 cycles/sample.
+       */
+      static chirp_coefs_t chirp_coefs(size_t len, double bandwidth,
+                                       double center_freq = 0.0);
+
+      /*!
+       * The samples the FPGA chirp source plays for setup_chirp(len,
+       * tuning_coef, freq_offset), as AWG words. The model: the
+       * frequency accumulator starts at freq_offset and the phase
+       * accumulator at 0; each sample is the table entry addressed by
+       * the top DDS_LUT_BITS of the phase, after which phase += freq and
+       * freq += tuning_coef, both modulo 2^32. The table holds
+       * round(DDS_AMPLITUDE * cos/sin) of each address. All of it is
+       * integer arithmetic, so the result is the same on every host.
+       */
+      static std::vector<boost::uint32_t> hw_chirp(boost::uint32_t len,
+                                                   boost::uint32_t tuning_coef,
+                                                   boost::uint32_t freq_offset);
+    };
+
+  } // namespace wavegen
+} // namespace gr
+
+#endif /* INCLUDED_WAVEGEN_WAVEFORM_SYNTH_H */
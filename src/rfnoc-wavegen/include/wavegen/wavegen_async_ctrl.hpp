@@ -0,0 +1,113 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_WAVEGEN_WAVEGEN_ASYNC_CTRL_HPP
+#define INCLUDED_WAVEGEN_WAVEGEN_ASYNC_CTRL_HPP
+
+#include <wavegen/api.h>
+#include <wavegen/wavegen_core.hpp>
+#include <wavegen/wavegen_config.hpp>
+#include <wavegen/thread_profile.h>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/future.hpp>
+#include <vector>
+
+namespace uhd {
+    namespace rfnoc {
+
+/*! \brief Runs controller commands on a dedicated thread.
+ *
+ * Commands are pushed onto a lock-free queue and executed in order by
+ * a control thread, so a thread that also services recv() never waits
+ * on the settings bus. Each call returns a future that is ready when
+ * the command has been applied (or holds the value of a readback).
+ * Any number of threads may post commands.
+ *
+ * Queue entries come from a pool of queue_depth requests allocated up
+ * front. The caller's thread still allocates the promise behind each
+ * future, and a command whose bound arguments do not fit in
+ * boost::function's small buffer (a waveform, a config) is copied to
+ * the heap.
+ */
+class WAVEGEN_API wavegen_async_ctrl : boost::noncopyable
+{
+public:
+    typedef boost::shared_ptr<wavegen_async_ctrl> sptr;
+
+    typedef boost::function<void(wavegen_core &)> command_t;
+    typedef boost::function<boost::uint64_t(wavegen_core &)> readback_t;
+
+    typedef boost::shared_future<void> done_future_t;
+    typedef boost::shared_future<boost::uint64_t> readback_future_t;
+
+    //! Commands that can be queued before post() has to wait for room
+    static const size_t DEFAULT_QUEUE_DEPTH = 256;
+
+    //! Time from posting a command to its completion
+    struct latency_stats_t {
+        latency_stats_t(void):
+            num_commands(0), num_errors(0), mean_us(0), max_us(0), last_us(0) {}
+        size_t num_commands;
+        //! Commands that completed with an exception
+        size_t num_errors;
+        double mean_us;
+        double max_us;
+        double last_us;
+    };
+
+    /*!
+     * \param core controller to apply the commands to
+     * \param queue_depth commands that can wait; throws uhd::value_error
+     *        for 0 or above 65534
+     * \param threads if given, the control thread runs in its ROLE_CONTROL
+     */
+    static sptr make(
+        wavegen_core::sptr core,
+        const size_t queue_depth = DEFAULT_QUEUE_DEPTH,
+        gr::wavegen::thread_profile::sptr threads = gr::wavegen::thread_profile::sptr()
+    );
+
+    virtual ~wavegen_async_ctrl(void) {}
+
+    //! Queue an arbitrary command; exceptions are delivered via the future
+    virtual done_future_t post(const command_t &command) = 0;
+
+    //! Queue a readback
+    virtual readback_future_t read(const readback_t &readback) = 0;
+
+    /* Shorthands for the common reconfigurations */
+    virtual done_future_t set_waveform(const std::vector<boost::uint32_t> &samples) = 0;
+    virtual done_future_t set_prf_count(const boost::uint64_t prf_count) = 0;
+    virtual done_future_t commit(const wavegen_config &config) = 0;
+    virtual readback_future_t get_state(void) = 0;
+
+    //! Block until every command posted so far has completed
+    virtual void flush(void) = 0;
+
+    virtual latency_stats_t get_latency_stats(void) = 0;
+    virtual void reset_latency_stats(void) = 0;
+
+}; /* class wavegen_async_ctrl */
+
+}} /* namespace uhd::rfnoc */
+
+#endif /* INCLUDED_WAVEGEN_WAVEGEN_ASYNC_CTRL_HPP */
@@ -24,6 +24,16 @@
 
 #include <uhd/rfnoc/source_block_ctrl_base.hpp>
 #include <uhd/rfnoc/sink_block_ctrl_base.hpp>
+#include <uhd/stream.hpp>
+#include <wavegen/wavegen_core.hpp>
+#include <wavegen/wavegen_config.hpp>
+#include <wavegen/wavegen_pulse_scheduler.hpp>
+#include <wavegen/wavegen_async_ctrl.hpp>
+#include <wavegen/wavegen_waveform_library.hpp>
+#include <wavegen/wavegen_sequencer.hpp>
+#include <wavegen/wavegen_reg_iface.hpp>
+#include <wavegen/wavegen_metrics.hpp>
+#include <wavegen/wavegen_status_monitor.hpp>
 
 namespace uhd {
     namespace rfnoc {
@@ -58,6 +68,140 @@ public:
     virtual void setup_chirp(boost::uint32_t len, boost::uint32_t tuning_coef, boost::uint32_t freq_offset) = 0;
     virtual void clear_commands() = 0;
 
+    /*!
+     * Apply a staged set of settings in one burst, optionally at the
+     * config's command time. See wavegen_config.
+     */
+    virtual void commit(const wavegen_config &config) = 0;
+
+    /*!
+     * Give the block a way to read the device time, in ticks at the
+     * block's tick rate. This starts the pulse scheduler used by
+     * schedule_pulses() and schedule_burst(); clear_commands() cancels
+     * its schedule. Throws uhd::runtime_error if set_rate() has not
+     * been called.
+     */
+    virtual void set_pulse_time_source(
+        wavegen_pulse_scheduler::tick_source_t tick_source,
+        size_t queue_depth = wavegen_pulse_scheduler::DEFAULT_QUEUE_DEPTH
+    ) = 0;
+    virtual void schedule_pulses(const std::vector<boost::uint64_t> &ticks) = 0;
+    virtual void schedule_burst(boost::uint64_t start, boost::uint64_t interval, size_t count) = 0;
+    virtual wavegen_pulse_scheduler::sptr get_pulse_scheduler() = 0;
+
+    /*!
+     * Control front-end that applies commands on its own thread, for
+     * callers that must not stall their recv() loop. Started on first
+     * use.
+     */
+    virtual wavegen_async_ctrl::sptr get_async_ctrl() = 0;
+
+    /*!
+     * Select how set_waveform() moves samples to the AWG.
+     * UPLOAD_MODE_STREAM requires a streamer from set_upload_streamer().
+     */
+    virtual void set_upload_mode(wavegen_core::upload_mode_t mode) = 0;
+    virtual wavegen_core::upload_mode_t get_upload_mode() = 0;
+
+    /*!
+     * Provide a TX streamer connected to this block's sink port, used
+     * by UPLOAD_MODE_STREAM. It must use the sc16 CPU and wire formats
+     * so every item is one 32-bit word, and its spp bounds the upload
+     * packet size.
+     */
+    virtual void set_upload_streamer(uhd::tx_streamer::sptr tx_stream) = 0;
+
+    /*!
+     * Select the upload header layout. The default picks the wide
+     * (32-bit length and segment index) header only for waveforms
+     * longer than 65535 samples.
+     */
+    virtual void set_waveform_header_format(wavegen_core::header_format_t format) = 0;
+
+    /*!
+     * Host-side shadow register cache: unchanged writes are skipped and
+     * readbacks come from the cache. refresh() forgets the shadowed
+     * state; verify mode sends every readback to the hardware.
+     */
+    virtual void set_cache_enabled(bool enable) = 0;
+    virtual void set_readback_verify(bool verify) = 0;
+    virtual void refresh() = 0;
+    virtual wavegen_core::cache_stats_t get_cache_stats() = 0;
+
+    /*!
+     * set_waveform() goes through this library, so re-sending the
+     * waveform that is already in the AWG costs no upload. Add
+     * waveforms here ahead of time and select() them by id to switch.
+     */
+    virtual wavegen_waveform_library::sptr get_waveform_library() = 0;
+
+    /*!
+     * Ping-pong waveform banks: load_next_waveform() writes the idle
+     * bank while the live one keeps playing, swap_waveform_bank()
+     * switches at the next pulse boundary (or the first one after the
+     * given time). With banks enabled set_waveform() loads the idle bank
+     * and swaps. get_live_bank() reads the bank playing now.
+     */
+    virtual void set_waveform_banks_enabled(bool enable) = 0;
+    virtual void load_next_waveform(const std::vector<boost::uint32_t> &samples) = 0;
+    virtual void swap_waveform_bank() = 0;
+    virtual void swap_waveform_bank(const uhd::time_spec_t &time) = 0;
+    virtual size_t get_live_bank() = 0;
+
+    /*!
+     * Per-pulse sequencer: each entry gives the waveform (a library id),
+     * source select, chirp tuning and rx length for one pulse. The table
+     * is uploaded once; in AUTO policy the controller steps through it
+     * on every pulse, wrapping at the end. Up to two distinct AWG
+     * waveforms with banks enabled, one without.
+     */
+    virtual void set_sequence(const std::vector<wavegen_sequencer::entry_t> &entries) = 0;
+    virtual void start_sequence() = 0;
+    virtual void stop_sequence() = 0;
+    virtual size_t get_sequence_index() = 0;
+
+    /*!
+     * Pulse integration in the FPGA, ahead of the link to the host:
+     * num_pulses pulses of get_rx_len() samples, each decimated by
+     * summing decimation adjacent samples, come out as one record of
+     * rx_len / decimation samples, their mean. The stream shrinks by
+     * num_pulses * decimation. 1 and 1, the default, turn it off. Set
+     * the rx length first. get_integration_state() reads the raw
+     * RB_INTEG word; gr::wavegen::pulse_integrator does the same on
+     * the host.
+     */
+    virtual void set_integration(size_t num_pulses, size_t decimation) = 0;
+    virtual boost::uint64_t get_integration_state() = 0;
+
+    /*!
+     * Drive another register backend, such as a wavegen_emulator,
+     * instead of this block's registers. The controller starts over on
+     * the new backend: library, sequencer, pulse scheduler, status
+     * monitor and async front-end are recreated, so
+     * set_pulse_time_source() and a running status monitor must be
+     * started again. An empty pointer returns to the block's own
+     * registers.
+     */
+    virtual void set_backend(wavegen_reg_iface::sptr backend) = 0;
+
+    /*!
+     * Run the block's control threads (status monitor poll, async
+     * front-end, pulse scheduler refill) in the profile's ROLE_CONTROL.
+     * Call it before starting them: the status monitor and async
+     * front-end are recreated, and a pulse scheduler takes the profile
+     * at the next set_pulse_time_source(). Throws uhd::runtime_error
+     * while the status monitor is running.
+     */
+    virtual void set_thread_profile(gr::wavegen::thread_profile::sptr threads) = 0;
+
+    /*!
+     * Per-method call counts and time spent, and the register traffic
+     * the controller put on its backend. Counting is lock-free and
+     * always on; reset_metrics() zeroes everything.
+     */
+    virtual wavegen_metrics::snapshot_t get_metrics() = 0;
+    virtual void reset_metrics() = 0;
+
     virtual std::string get_src() = 0;
     virtual std::string get_policy() = 0;
 
@@ -69,6 +213,26 @@ public:
     virtual boost::uint64_t get_prf_count() = 0;
     virtual boost::uint64_t get_state() = 0;
 
+    /*!
+     * Decoded status from one batched readback of all the readback
+     * registers. Watchdogs and other frequent readers should start the
+     * status monitor instead and read its latest snapshot, which costs
+     * no bus traffic however many of them there are.
+     */
+    virtual wavegen_status get_status() = 0;
+    virtual wavegen_status_monitor::sptr get_status_monitor() = 0;
+
+    /*!
+     * The AWG words the block transmits, as a matched filter reference.
+     * With the AWG source this is the live bank's waveform from the
+     * waveform library; with the chirp source it is the chirp
+     * generator's output for the settings in the core's shadow
+     * registers (see wavegen_core::get_chirp() and
+     * waveform_synth::hw_chirp()). Throws if the waveform is not known.
+     * A running sequence may play other waveforms.
+     */
+    virtual std::vector<boost::uint32_t> get_reference_waveform() = 0;
+
 
 }; /* class wavegen_block_ctrl*/
 
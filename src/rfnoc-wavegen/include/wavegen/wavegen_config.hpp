@@ -0,0 +1,91 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_WAVEGEN_WAVEGEN_CONFIG_HPP
+#define INCLUDED_WAVEGEN_WAVEGEN_CONFIG_HPP
+
+#include <wavegen/api.h>
+#include <wavegen/wavegen_reg_iface.hpp>
+#include <uhd/types/time_spec.hpp>
+#include <boost/optional.hpp>
+
+namespace uhd {
+    namespace rfnoc {
+
+/*! \brief Staged set of radar controller settings.
+ *
+ * Collect the settings for a dwell, then hand the object to
+ * wavegen_core::commit(). Only the settings that differ from the
+ * hardware are written, in one burst, optionally as a timed command.
+ *
+ * \code
+ * wavegen_config cfg;
+ * cfg.setup_chirp(len, coef, offset).set_prf_count(prf).set_num_adc_samples(n);
+ * cfg.set_command_time(uhd::time_spec_t(2.0));
+ * wavegen_ctrl->commit(cfg);
+ * \endcode
+ */
+class WAVEGEN_API wavegen_config
+{
+public:
+    wavegen_config &set_chirp_counter(const boost::uint32_t chirp_counter);
+    wavegen_config &set_chirp_tuning_coef(const boost::uint32_t tuning_coef);
+    wavegen_config &set_chirp_freq_offset(const boost::uint32_t freq_offset);
+    wavegen_config &setup_chirp(const boost::uint32_t len, const boost::uint32_t tuning_coef, const boost::uint32_t freq_offset);
+    wavegen_config &set_ctrl_word(const boost::uint32_t ctrl_word);
+    wavegen_config &set_src_awg(void);
+    wavegen_config &set_src_chirp(void);
+    wavegen_config &set_prf_count(const boost::uint64_t prf_count);
+    wavegen_config &set_num_adc_samples(const boost::uint32_t n);
+    wavegen_config &set_policy(const boost::uint32_t policy);
+
+    //! Apply the whole configuration at this device time
+    wavegen_config &set_command_time(const uhd::time_spec_t &time);
+    wavegen_config &clear_command_time(void);
+
+    bool has_command_time(void) const;
+    uhd::time_spec_t get_command_time(void) const;
+
+    //! True if no setting has been staged
+    bool empty(void) const;
+
+    /*!
+     * The staged settings as register writes, in commit order: chirp
+     * parameters, source select, ADC window and PRF first, the policy
+     * last, so a switch to AUTO only starts pulsing once the rest of the
+     * dwell is in place.
+     */
+    wavegen_reg_iface::sr_burst_t get_writes(void) const;
+
+private:
+    boost::optional<boost::uint32_t> _chirp_counter;
+    boost::optional<boost::uint32_t> _tuning_coef;
+    boost::optional<boost::uint32_t> _freq_offset;
+    boost::optional<boost::uint32_t> _ctrl_word;
+    boost::optional<boost::uint32_t> _adc_samples;
+    boost::optional<boost::uint64_t> _prf_count;
+    boost::optional<boost::uint32_t> _policy;
+    boost::optional<uhd::time_spec_t> _command_time;
+}; /* class wavegen_config */
+
+}} /* namespace uhd::rfnoc */
+
+#endif /* INCLUDED_WAVEGEN_WAVEGEN_CONFIG_HPP */
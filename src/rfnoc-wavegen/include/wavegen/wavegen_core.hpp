@@ -0,0 +1,368 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_WAVEGEN_WAVEGEN_CORE_HPP
+#define INCLUDED_WAVEGEN_WAVEGEN_CORE_HPP
+
+#include <wavegen/api.h>
+#include <wavegen/wavegen_reg_iface.hpp>
+#include <wavegen/wavegen_status.hpp>
+#include <uhd/types/time_spec.hpp>
+#include <boost/noncopyable.hpp>
+#include <vector>
+
+namespace uhd {
+    namespace rfnoc {
+
+class wavegen_config;
+
+/*! \brief Register-level model of the wavegen radar controller.
+ *
+ * Holds the register map and the waveform upload framing. All bus
+ * traffic goes through a wavegen_reg_iface, so the same code drives
+ * the hardware block and any mock backend. All methods are safe to
+ * call from several threads.
+ */
+class WAVEGEN_API wavegen_core : boost::noncopyable
+{
+public:
+    typedef boost::shared_ptr<wavegen_core> sptr;
+
+    static const boost::uint32_t SR_CH_COUNTER_ADDR = 200;
+    static const boost::uint32_t SR_CH_TUNING_COEF_ADDR = 201;
+    static const boost::uint32_t SR_CH_FREQ_OFFSET_ADDR = 202;
+    static const boost::uint32_t SR_AWG_CTRL_WORD_ADDR = 203;
+
+    static const boost::uint32_t SR_PRF_INT_ADDR = 204;
+    static const boost::uint32_t SR_PRF_FRAC_ADDR = 205;
+    static const boost::uint32_t SR_ADC_SAMPLE_ADDR = 206;
+
+    static const boost::uint32_t SR_RADAR_CTRL_POLICY = 207;
+    static const boost::uint32_t SR_RADAR_CTRL_COMMAND = 208;
+    static const boost::uint32_t SR_RADAR_CTRL_TIME_HI = 209;
+    static const boost::uint32_t SR_RADAR_CTRL_TIME_LO = 210;
+    static const boost::uint32_t SR_RADAR_CTRL_CLEAR_CMDS = 211;
+    static const boost::uint32_t SR_AWG_RELOAD = 212;
+    static const boost::uint32_t SR_AWG_RELOAD_LAST = 213;
+    static const boost::uint32_t SR_AWG_LOAD_BANK = 214;
+    static const boost::uint32_t SR_AWG_BANK_SEL = 215;
+    static const boost::uint32_t SR_SEQ_ADDR = 216;
+    static const boost::uint32_t SR_SEQ_DATA = 217;
+    static const boost::uint32_t SR_SEQ_CTRL = 218;
+    static const boost::uint32_t SR_INTEG_NUM_PULSES = 219;
+    static const boost::uint32_t SR_INTEG_DECIM = 220;
+    static const boost::uint32_t SR_INTEG_LEN = 221;
+    static const boost::uint32_t SR_INTEG_SHIFT = 222;
+
+    /* Control readback registers */
+
+    static const boost::uint32_t RB_AWG_LEN              = 5;
+    static const boost::uint32_t RB_ADC_LEN              = 6;
+    static const boost::uint32_t RB_AWG_CTRL             = 7;
+    static const boost::uint32_t RB_AWG_PRF              = 8;
+    static const boost::uint32_t RB_AWG_POLICY           = 9;
+    static const boost::uint32_t RB_AWG_STATE            = 10;
+    /* {load bank, swap pending, live bank} */
+    static const boost::uint32_t RB_AWG_BANK             = 11;
+    /* Sequencer table entry used for the current pulse */
+    static const boost::uint32_t RB_SEQ_INDEX            = 12;
+    /* {records out[31:0], pulse in record[15:0], 15'b0, active} */
+    static const boost::uint32_t RB_INTEG                = 13;
+
+     /* Constant settings values */
+    static const boost::uint32_t CTRL_WORD_SEL_CHIRP = 0x00000010;
+    static const boost::uint32_t CTRL_WORD_SEL_AWG = 0x00000310;
+
+    static const boost::uint32_t RADAR_POLICY_AUTO = 0;
+    static const boost::uint32_t RADAR_POLICY_MANUAL = 1;
+
+    /* Ping-pong waveform banks */
+    static const size_t NUM_AWG_BANKS = 2;
+    static const boost::uint32_t AWG_BANK_LIVE_MASK = 0x1;
+    static const boost::uint32_t AWG_BANK_SWAP_PENDING = 0x2;
+    static const boost::uint32_t AWG_BANK_LOAD_MASK = 0x4;
+
+    /* RB_AWG_STATE: {pulse count[31:0], queued commands[15:0],
+     * flags[7:0], controller state[7:0]} */
+    static const boost::uint64_t AWG_STATE_MASK = 0xFF;
+    static const boost::uint64_t AWG_STATE_IDLE = 1;
+    //! Commands queued or AUTO repeat armed, no pulse playing
+    static const boost::uint64_t AWG_STATE_WAIT = 2;
+    static const boost::uint64_t AWG_STATE_PULSE = 3;
+    //! Live bank holds a complete waveform
+    static const boost::uint64_t AWG_STATE_LOADED = 0x100;
+    static const boost::uint64_t AWG_STATE_SEQ_ENABLED = 0x200;
+    //! Sticky: a timed command was latched after its time had passed
+    static const boost::uint64_t AWG_STATE_LATE = 0x400;
+    //! Sticky: an AWG pulse fired with nothing in its bank
+    static const boost::uint64_t AWG_STATE_UNDERRUN = 0x800;
+    //! SR_RADAR_CTRL_CLEAR_CMDS also clears these
+    static const boost::uint64_t AWG_STATE_STICKY_MASK = 0xC00;
+    static const int AWG_STATE_QUEUE_SHIFT = 16;
+    static const int AWG_STATE_COUNT_SHIFT = 32;
+
+    /* Radar controller command word bits, as built by issue_stream_cmd() */
+    static const boost::uint32_t CMD_STOP = 0x10000000;
+    //! TIME_HI with this bit set runs the command at once
+    static const boost::uint32_t CMD_TIME_NOW = 0x80000000;
+
+    /* Pulse sequencer table: SR_SEQ_ADDR sets the word address, each
+     * SR_SEQ_DATA write stores a word and advances it. SR_SEQ_CTRL holds
+     * the enable bit and the number of entries minus one. */
+    static const size_t SEQ_MAX_ENTRIES = 256;
+    static const size_t SEQ_WORDS_PER_ENTRY = 5;
+    static const boost::uint32_t SEQ_CTRL_ENABLE = 0x80000000;
+
+    /* Pulse integrator on the output path. The accumulators are 32 bits
+     * and the record RAM holds INTEG_MAX_LEN samples. */
+    static const size_t INTEG_MAX_PULSES = 65535;
+    static const size_t INTEG_MAX_DECIM = 255;
+    static const size_t INTEG_MAX_LEN = 4096;
+    static const boost::uint64_t INTEG_ACTIVE = 0x1;
+    static const int INTEG_PULSE_SHIFT = 16;
+    static const int INTEG_RECORDS_SHIFT = 32;
+
+    /*Waveform Data Upload Header Command Identifier */
+    static const boost::uint16_t WAVEFORM_WRITE_CMD = 0x5744;
+    /* Wide header: {cmd, id}, 32-bit length, 32-bit segment index */
+    static const boost::uint16_t WAVEFORM_WRITE_WIDE_CMD = 0x5745;
+
+    /* Segment size used when set_waveform() is not given an spp */
+    static const size_t MAX_SEGMENT_SAMPS = 65535;
+
+    /*!
+     * How waveform samples are moved to the AWG. Every mode sends the
+     * same packets: the header words followed by the samples.
+     */
+    enum upload_mode_t {
+        //! One settings bus write per word (SR_AWG_RELOAD / SR_AWG_RELOAD_LAST)
+        UPLOAD_MODE_SR,
+        //! Each packet handed to the backend as one sr_write_burst()
+        UPLOAD_MODE_BURST,
+        //! Each packet pushed through the block's sink port
+        UPLOAD_MODE_STREAM
+    };
+
+    /*!
+     * Upload header layout. The narrow header packs length and segment
+     * index into 16 bits each; the wide header gives each its own word.
+     */
+    enum header_format_t {
+        //! Narrow header when the waveform fits, wide header otherwise
+        HEADER_FORMAT_AUTO,
+        //! Always narrow; waveforms longer than 65535 samples throw
+        HEADER_FORMAT_NARROW,
+        //! Always wide
+        HEADER_FORMAT_WIDE
+    };
+
+    /*!
+     * One pulse of the sequencer table, in register form. In AUTO
+     * policy the controller applies entry i to pulse i and wraps after
+     * the last entry.
+     */
+    struct seq_entry_t {
+        seq_entry_t(void):
+            bank(0), ctrl_word(CTRL_WORD_SEL_CHIRP), tuning_coef(0),
+            freq_offset(0), adc_samples(0) {}
+        boost::uint32_t bank;
+        boost::uint32_t ctrl_word;
+        boost::uint32_t tuning_coef;
+        boost::uint32_t freq_offset;
+        //! SR_ADC_SAMPLE_ADDR value for this pulse
+        boost::uint32_t adc_samples;
+    };
+
+    //! Bus traffic saved by the shadow register cache
+    struct cache_stats_t {
+        cache_stats_t(void):
+            sr_writes(0), writes_skipped(0), rb_reads(0), reads_avoided(0) {}
+        //! Settings writes sent to the backend, waveform upload words excluded
+        size_t sr_writes;
+        //! Settings writes dropped because the register already held the value
+        size_t writes_skipped;
+        //! Readbacks fetched from the backend
+        size_t rb_reads;
+        //! Readbacks served from the cache
+        size_t reads_avoided;
+    };
+
+    static sptr make(wavegen_reg_iface::sptr iface);
+
+    virtual ~wavegen_core(void) {}
+
+    virtual void set_upload_mode(const upload_mode_t mode) = 0;
+    virtual upload_mode_t get_upload_mode(void) = 0;
+
+    virtual void set_header_format(const header_format_t format) = 0;
+    virtual header_format_t get_header_format(void) = 0;
+
+    /*!
+     * Upload a waveform as a single packet. Waveforms longer than
+     * MAX_SEGMENT_SAMPS are sent as a stream of segments, and stream
+     * mode splits at the backend's maximum packet size.
+     */
+    virtual void set_waveform(const std::vector<boost::uint32_t> &samples) = 0;
+
+    //! Upload a waveform in packets of \p spp samples
+    virtual void set_waveform(const std::vector<boost::uint32_t> &samples, const size_t spp) = 0;
+
+    virtual void send_pulse(void) = 0;
+    virtual void send_pulse(const boost::uint64_t ticks) = 0;
+
+    //! Queue a radar controller command; the TIME_LO write latches it
+    virtual void send_command(const boost::uint32_t cmd_word, const boost::uint64_t ticks) = 0;
+
+    /*!
+     * Queue one timed command per entry of \p ticks in a single burst.
+     * COMMAND and TIME_HI are only rewritten when they change, so a
+     * schedule costs about one settings write per pulse.
+     */
+    virtual void send_commands(const boost::uint32_t cmd_word, const std::vector<boost::uint64_t> &ticks) = 0;
+
+    virtual void set_ctrl_word(const boost::uint32_t ctrl_word) = 0;
+    virtual void set_policy(const boost::uint32_t policy) = 0;
+    virtual void set_num_adc_samples(const boost::uint32_t n) = 0;
+    virtual void set_rx_len(const boost::uint32_t rx_len) = 0;
+    virtual void set_prf_count(const boost::uint64_t prf_count) = 0;
+    virtual void set_chirp_counter(const boost::uint32_t chirp_counter) = 0;
+    virtual void set_chirp_tuning_coef(const boost::uint32_t tuning_coef) = 0;
+    virtual void set_chirp_freq_offset(const boost::uint32_t freq_offset) = 0;
+    virtual void setup_chirp(const boost::uint32_t len, const boost::uint32_t tuning_coef, const boost::uint32_t freq_offset) = 0;
+
+    /*!
+     * Chirp settings as last written (SR 200-202 have no readback),
+     * with \p len in samples. False if any of them has not been written
+     * since the last refresh().
+     */
+    virtual bool get_chirp(boost::uint32_t &len, boost::uint32_t &tuning_coef, boost::uint32_t &freq_offset) = 0;
+    virtual void clear_commands(void) = 0;
+
+    /*!
+     * Apply a staged configuration as one settings burst. Registers that
+     * already hold the staged value are left alone. If the config has a
+     * command time, the whole burst is issued as timed commands so the
+     * new dwell takes effect at once. The readbacks of the registers it
+     * writes are then read from the hardware every time, since the
+     * writes land later; refresh() once the time has passed to cache
+     * them again.
+     */
+    virtual void commit(const wavegen_config &config) = 0;
+
+    virtual boost::uint32_t get_ctrl_word(void) = 0;
+    virtual boost::uint32_t get_policy_word(void) = 0;
+    virtual boost::uint32_t get_num_adc_samples(void) = 0;
+    virtual boost::uint32_t get_rx_len(void) = 0;
+
+    //! Length of the live waveform; not cached once banks are in use
+    virtual boost::uint32_t get_waveform_len(void) = 0;
+    virtual boost::uint64_t get_prf_count(void) = 0;
+    virtual boost::uint64_t get_state(void) = 0;
+
+    /*!
+     * Read every status and readback register (RB_AWG_LEN through
+     * RB_SEQ_INDEX) in one batched readback and decode them. Always
+     * goes to the hardware; the cache is neither used nor updated.
+     * waveform_id is left unset, the core does not know the ids.
+     */
+    virtual wavegen_status get_status(void) = 0;
+
+    /*!
+     * Select the bank the next uploads are written to. The live bank
+     * keeps playing while the other one is loaded.
+     */
+    virtual void set_load_bank(const size_t bank) = 0;
+
+    /*!
+     * Request playback from \p bank. The FPGA holds the request until
+     * the current pulse has finished, so no pulse mixes the two banks.
+     */
+    virtual void select_bank(const size_t bank) = 0;
+
+    //! As select_bank(), issued as a timed command
+    virtual void select_bank(const size_t bank, const uhd::time_spec_t &time) = 0;
+
+    //! Bank playing now, read from the hardware
+    virtual size_t get_live_bank(void) = 0;
+
+    //! Raw RB_AWG_BANK word, see the AWG_BANK_* masks
+    virtual boost::uint32_t get_bank_state(void) = 0;
+
+    /*!
+     * Write the sequencer table in one burst. The sequencer is left
+     * disabled; start it with enable_sequence().
+     */
+    virtual void set_sequence(const std::vector<seq_entry_t> &entries) = 0;
+
+    /*!
+     * Start or stop the sequencer. While it runs, the waveform and ADC
+     * lengths change every entry and are always read from the hardware.
+     */
+    virtual void enable_sequence(const bool enable) = 0;
+
+    //! Table entry the controller is on, read from the hardware
+    virtual size_t get_sequence_index(void) = 0;
+
+    /*!
+     * Integrate output records in the FPGA: every \p decimation
+     * adjacent samples and \p num_pulses pulses of \p pulse_len
+     * samples are summed into one record of pulse_len / decimation
+     * samples, shifted right by \p shift bits. A negative shift takes
+     * ceil(log2(num_pulses * decimation)), the mean for powers of two.
+     * num_pulses and decimation of 1 bypass the integrator. Registers
+     * are written only when they change, and any change restarts the
+     * pulse grouping, so set this before streaming.
+     */
+    virtual void set_integration(const size_t num_pulses, const size_t decimation,
+                                 const boost::uint32_t pulse_len, const int shift = -1) = 0;
+
+    //! Raw RB_INTEG word, read from the hardware
+    virtual boost::uint64_t get_integration_state(void) = 0;
+
+    /*!
+     * Enable the shadow register cache (on by default). Writes of an
+     * unchanged value are skipped and readbacks are served from the
+     * cache until a related settings write invalidates them. Command
+     * strobes and the status readbacks (RB_AWG_STATE, RB_AWG_BANK,
+     * RB_SEQ_INDEX, RB_INTEG) always go to the hardware.
+     */
+    virtual void set_cache_enabled(const bool enable) = 0;
+
+    //! When set, every readback goes to the hardware and refreshes the cache
+    virtual void set_readback_verify(const bool verify) = 0;
+
+    /*!
+     * Forget all shadowed state, e.g. after the block was reset behind
+     * our back. The next write and readback of each register goes to
+     * the hardware.
+     */
+    virtual void refresh(void) = 0;
+
+    virtual cache_stats_t get_cache_stats(void) = 0;
+
+    //! Waveform uploads started so far, including ones that failed
+    virtual size_t get_num_uploads(void) = 0;
+
+}; /* class wavegen_core */
+
+}} /* namespace uhd::rfnoc */
+
+#endif /* INCLUDED_WAVEGEN_WAVEGEN_CORE_HPP */
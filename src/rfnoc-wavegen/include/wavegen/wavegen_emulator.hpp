@@ -0,0 +1,149 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_WAVEGEN_WAVEGEN_EMULATOR_HPP
+#define INCLUDED_WAVEGEN_WAVEGEN_EMULATOR_HPP
+
+#include <wavegen/api.h>
+#include <wavegen/wavegen_reg_iface.hpp>
+#include <wavegen/wavegen_core.hpp>
+#include <vector>
+
+namespace uhd {
+    namespace rfnoc {
+
+/*! \brief In-process model of the wavegen radar controller.
+ *
+ * A register backend that behaves like the block: it keeps the
+ * settings registers, answers the RB_* readbacks, reassembles waveform
+ * uploads from the settings bus or the stream path into the AWG banks,
+ * queues the TIME_LO-latched commands, runs the AUTO/MANUAL policies
+ * and the PRF counter, applies timed writes and the sequencer table,
+ * and turns every pulse into an sc16 output record.
+ *
+ * Time only moves when run_until() or run_for() is called, so a test
+ * sees the same pulses on every run. One tick is one sample; a pulse
+ * keeps the controller busy for its TX or RX length, whichever is
+ * longer, and bank swaps wait for the end of the pulse.
+ */
+class WAVEGEN_API wavegen_emulator : public wavegen_reg_iface
+{
+public:
+    typedef boost::shared_ptr<wavegen_emulator> sptr;
+
+    //! Commands the controller holds before dropping new ones
+    static const size_t CMD_FIFO_DEPTH = 64;
+
+    //! Stream packet size, in 32-bit words, offered to stream uploads
+    static const size_t DEFAULT_MAX_STREAM_WORDS = 2000;
+
+    //! Pulse records kept for recv_pulse() before the oldest is dropped
+    static const size_t DEFAULT_MAX_PULSES = 1024;
+
+    //! One pulse played by the controller
+    struct pulse_t {
+        pulse_t(void):
+            ticks(0), cmd_word(0), ctrl_word(0), bank(0),
+            seq_index(0), rx_len(0) {}
+        //! Tick the pulse started at
+        boost::uint64_t ticks;
+        //! Command that started it; AUTO repeats carry the last one
+        boost::uint32_t cmd_word;
+        boost::uint32_t ctrl_word;
+        //! AWG bank played (meaningless for chirp pulses)
+        size_t bank;
+        //! Sequencer entry used, 0 when the sequencer is off
+        size_t seq_index;
+        //! Samples in the receive window
+        boost::uint32_t rx_len;
+        //! TX samples as sc16 words, empty unless set_keep_samples()
+        std::vector<boost::uint32_t> samples;
+    };
+
+    struct stats_t {
+        stats_t(void):
+            sr_writes(0), timed_writes(0), readbacks(0), stream_packets(0),
+            uploads(0), framing_errors(0), commands(0), late_commands(0),
+            commands_dropped(0), pulses(0), pulses_dropped(0) {}
+        size_t sr_writes;
+        //! Writes held for a command time
+        size_t timed_writes;
+        size_t readbacks;
+        size_t stream_packets;
+        //! Waveforms completely received into a bank
+        size_t uploads;
+        //! Upload packets rejected: bad command, id, index or length
+        size_t framing_errors;
+        size_t commands;
+        //! Commands whose time had passed when they were latched
+        size_t late_commands;
+        //! Commands that found the FIFO full
+        size_t commands_dropped;
+        size_t pulses;
+        //! Pulse records lost because nobody called recv_pulse()
+        size_t pulses_dropped;
+    };
+
+    /*!
+     * \param tick_rate rate used to turn command times into ticks
+     * \param max_stream_words stream packet limit; 0 disables the stream path
+     */
+    static sptr make(
+        const double tick_rate,
+        const size_t max_stream_words = DEFAULT_MAX_STREAM_WORDS
+    );
+
+    virtual ~wavegen_emulator(void) {}
+
+    //! Back to the power-on state, at tick 0
+    virtual void reset(void) = 0;
+
+    virtual boost::uint64_t get_time_ticks(void) = 0;
+
+    //! Play everything due up to and including \p ticks
+    virtual void run_until(const boost::uint64_t ticks) = 0;
+    virtual void run_for(const boost::uint64_t ticks) = 0;
+
+    /*!
+     * Fill pulse_t::samples for each pulse (off by default). With it
+     * off the emulator only records pulse metadata, which is what
+     * throughput runs want.
+     */
+    virtual void set_keep_samples(const bool keep) = 0;
+    virtual void set_max_pulses(const size_t max_pulses) = 0;
+
+    //! Pop the oldest pulse record; false if there is none
+    virtual bool recv_pulse(pulse_t &pulse) = 0;
+    virtual size_t get_num_pulses_queued(void) = 0;
+
+    //! Contents of an AWG bank
+    virtual std::vector<boost::uint32_t> get_bank(const size_t bank) = 0;
+
+    //! Current value of a settings register
+    virtual boost::uint32_t get_sr(const boost::uint32_t reg) = 0;
+
+    virtual stats_t get_stats(void) = 0;
+}; /* class wavegen_emulator */
+
+}} /* namespace uhd::rfnoc */
+
+#endif /* INCLUDED_WAVEGEN_WAVEGEN_EMULATOR_HPP */
@@ -0,0 +1,116 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_WAVEGEN_WAVEGEN_METRICS_HPP
+#define INCLUDED_WAVEGEN_WAVEGEN_METRICS_HPP
+
+#include <wavegen/api.h>
+#include <wavegen/wavegen_reg_iface.hpp>
+#include <boost/chrono.hpp>
+#include <boost/noncopyable.hpp>
+#include <string>
+#include <vector>
+
+namespace uhd {
+    namespace rfnoc {
+
+/*! \brief Call and bus traffic counters for the wavegen controller.
+ *
+ * Each instrumented method has a slot with a call count and the
+ * cumulative time spent in it; wrap() puts a counter on the register
+ * backend. Everything is a relaxed atomic increment, so recording
+ * never takes a lock and snapshot() can run from any thread while the
+ * controller is busy. A snapshot is not a single instant: counters are
+ * read one by one.
+ */
+class WAVEGEN_API wavegen_metrics : boost::noncopyable
+{
+public:
+    typedef boost::shared_ptr<wavegen_metrics> sptr;
+
+    struct method_stats_t {
+        method_stats_t(void): calls(0), total_ns(0) {}
+        std::string name;
+        boost::uint64_t calls;
+        //! Wall time spent in the method, summed over calls
+        boost::uint64_t total_ns;
+    };
+
+    struct snapshot_t {
+        snapshot_t(void):
+            sr_writes(0), sr_bursts(0), rb_reads(0), rb_bursts(0),
+            stream_packets(0), stream_words(0) {}
+        std::vector<method_stats_t> methods;
+        //! Settings register writes handed to the backend
+        boost::uint64_t sr_writes;
+        //! sr_write_burst() calls (their writes are in sr_writes)
+        boost::uint64_t sr_bursts;
+        boost::uint64_t rb_reads;
+        //! user_reg_read64_burst() calls (their reads are in rb_reads)
+        boost::uint64_t rb_bursts;
+        boost::uint64_t stream_packets;
+        boost::uint64_t stream_words;
+    };
+
+    //! Times one call from construction to destruction
+    class scoped_call
+    {
+    public:
+        scoped_call(wavegen_metrics &metrics, const size_t method):
+            _metrics(metrics), _method(method),
+            _start(boost::chrono::steady_clock::now())
+        {
+        }
+
+        ~scoped_call(void)
+        {
+            _metrics.record_call(_method, boost::uint64_t(
+                boost::chrono::duration_cast<boost::chrono::nanoseconds>(
+                    boost::chrono::steady_clock::now() - _start).count()));
+        }
+
+    private:
+        wavegen_metrics &_metrics;
+        const size_t _method;
+        const boost::chrono::steady_clock::time_point _start;
+    };
+
+    //! One slot per name; the method index is the position in \p method_names
+    static sptr make(const std::vector<std::string> &method_names);
+
+    virtual ~wavegen_metrics(void) {}
+
+    virtual void record_call(const size_t method, const boost::uint64_t ns) = 0;
+
+    /*!
+     * Backend that forwards to \p backend and counts its traffic into
+     * these metrics.
+     */
+    virtual wavegen_reg_iface::sptr wrap(wavegen_reg_iface::sptr backend) = 0;
+
+    virtual snapshot_t snapshot(void) = 0;
+    virtual void reset(void) = 0;
+}; /* class wavegen_metrics */
+
+}} /* namespace uhd::rfnoc */
+
+#endif /* INCLUDED_WAVEGEN_WAVEGEN_METRICS_HPP */
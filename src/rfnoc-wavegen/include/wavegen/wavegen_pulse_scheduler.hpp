@@ -0,0 +1,114 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_WAVEGEN_WAVEGEN_PULSE_SCHEDULER_HPP
+#define INCLUDED_WAVEGEN_WAVEGEN_PULSE_SCHEDULER_HPP
+
+#include <wavegen/api.h>
+#include <wavegen/wavegen_core.hpp>
+#include <wavegen/thread_profile.h>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <vector>
+
+namespace uhd {
+    namespace rfnoc {
+
+/*! \brief Feeds long timed pulse schedules to the radar controller.
+ *
+ * The controller's command queue only holds a few entries, so pulses
+ * are kept on the host and handed over in bursts as the queue drains.
+ * The queue fill is estimated from the device time: a command whose
+ * time has passed has left the queue. A background thread sleeps until
+ * the queue is half empty and then tops it up. If a refill fails, the
+ * thread stops refilling and schedule_pulses() and wait_done() throw
+ * uhd::runtime_error until cancel().
+ */
+class WAVEGEN_API wavegen_pulse_scheduler : boost::noncopyable
+{
+public:
+    typedef boost::shared_ptr<wavegen_pulse_scheduler> sptr;
+
+    //! Returns the current device time in ticks
+    typedef boost::function<boost::uint64_t(void)> tick_source_t;
+
+    //! Commands kept in the controller queue when none is given to make()
+    static const size_t DEFAULT_QUEUE_DEPTH = 32;
+
+    struct stats_t {
+        stats_t(void):
+            pulses_scheduled(0), pulses_issued(0), bursts(0),
+            late_pulses(0), max_queue_depth(0) {}
+        size_t pulses_scheduled;
+        //! Pulses written to the controller
+        size_t pulses_issued;
+        //! Bursts of timed commands sent to the controller
+        size_t bursts;
+        //! Pulses whose time had already passed when they were issued
+        size_t late_pulses;
+        size_t max_queue_depth;
+    };
+
+    /*!
+     * \param core controller to queue the commands on
+     * \param tick_source current device time, in the controller's ticks
+     * \param tick_rate ticks per second, used to time the refills
+     * \param queue_depth most commands kept in the controller queue
+     * \param threads if given, the refill thread runs in its ROLE_CONTROL
+     */
+    static sptr make(
+        wavegen_core::sptr core,
+        tick_source_t tick_source,
+        const double tick_rate,
+        const size_t queue_depth = DEFAULT_QUEUE_DEPTH,
+        gr::wavegen::thread_profile::sptr threads = gr::wavegen::thread_profile::sptr()
+    );
+
+    virtual ~wavegen_pulse_scheduler(void) {}
+
+    /*!
+     * Append pulses to the schedule. Times must be increasing and later
+     * than everything scheduled before.
+     */
+    virtual void schedule_pulses(const std::vector<boost::uint64_t> &ticks) = 0;
+
+    //! Append \p count pulses, \p interval ticks apart, starting at \p start
+    virtual void schedule_burst(const boost::uint64_t start, const boost::uint64_t interval, const size_t count) = 0;
+
+    //! Commands estimated to be waiting in the controller queue
+    virtual size_t get_queue_depth(void) = 0;
+
+    //! Pulses still held on the host
+    virtual size_t get_num_pending(void) = 0;
+
+    //! Wait until every scheduled pulse has fired; false on timeout
+    virtual bool wait_done(const double timeout) = 0;
+
+    //! Drop the rest of the schedule, clear the controller queue and any refill error
+    virtual void cancel(void) = 0;
+
+    virtual stats_t get_stats(void) = 0;
+
+}; /* class wavegen_pulse_scheduler */
+
+}} /* namespace uhd::rfnoc */
+
+#endif /* INCLUDED_WAVEGEN_WAVEGEN_PULSE_SCHEDULER_HPP */
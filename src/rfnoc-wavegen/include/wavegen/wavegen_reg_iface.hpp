@@ -0,0 +1,152 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_WAVEGEN_WAVEGEN_REG_IFACE_HPP
+#define INCLUDED_WAVEGEN_WAVEGEN_REG_IFACE_HPP
+
+#include <wavegen/api.h>
+#include <uhd/exception.hpp>
+#include <uhd/types/time_spec.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <cstring>
+#include <vector>
+
+namespace uhd {
+    namespace rfnoc {
+
+/*! \brief Register and stream backend used by the wavegen controller.
+ *
+ * The block controller implements this on top of its settings bus and
+ * user readback registers. Anything else (mocks, emulators) can be
+ * plugged into wavegen_core in its place.
+ */
+class WAVEGEN_API wavegen_reg_iface
+{
+public:
+    typedef boost::shared_ptr<wavegen_reg_iface> sptr;
+
+    //! One settings register write
+    struct sr_op_t {
+        sr_op_t(boost::uint32_t reg_ = 0, boost::uint32_t data_ = 0):
+            reg(reg_), data(data_) {}
+        boost::uint32_t reg;
+        boost::uint32_t data;
+    };
+    typedef std::vector<sr_op_t> sr_burst_t;
+
+    virtual ~wavegen_reg_iface(void) {}
+
+    //! Write a 32-bit settings register
+    virtual void sr_write(const boost::uint32_t reg, const boost::uint32_t data) = 0;
+
+    /*!
+     * Write a sequence of settings registers in order.
+     *
+     * Backends that can carry several writes per control transaction
+     * should override this. The default issues one sr_write() per op.
+     */
+    virtual void sr_write_burst(const sr_burst_t &ops)
+    {
+        for (size_t i = 0; i < ops.size(); i++) {
+            sr_write(ops[i].reg, ops[i].data);
+        }
+    }
+
+    /*!
+     * Make the following settings writes timed commands that execute
+     * at the given time, until clear_command_time() is called.
+     */
+    virtual void set_command_time(const uhd::time_spec_t &)
+    {
+        throw uhd::not_implemented_error("wavegen_reg_iface: backend has no timed commands");
+    }
+
+    virtual void clear_command_time(void)
+    {
+    }
+
+    //! Read a 64-bit user readback register
+    virtual boost::uint64_t user_reg_read64(const boost::uint32_t addr) = 0;
+
+    /*!
+     * Read several user readback registers into \p values, in order.
+     *
+     * Backends that can sample several registers in one transaction
+     * should override this. The default issues one user_reg_read64()
+     * per address.
+     */
+    virtual void user_reg_read64_burst(
+        const std::vector<boost::uint32_t> &addrs,
+        std::vector<boost::uint64_t> &values
+    ) {
+        values.resize(addrs.size());
+        for (size_t i = 0; i < addrs.size(); i++) {
+            values[i] = user_reg_read64(addrs[i]);
+        }
+    }
+
+    //! True if stream_write() can push data into the block's sink port
+    virtual bool has_stream(void) { return false; }
+
+    //! Largest number of 32-bit words stream_write() accepts per packet
+    virtual size_t get_max_stream_words(void) { return 0; }
+
+    /*!
+     * Send one packet into the block's sink port. The final item is
+     * marked with tlast.
+     *
+     * Each element is an sc16 item in host layout, as handed to an sc16
+     * TX streamer; use pack_sc16() to build it from the 32-bit word the
+     * block should receive.
+     */
+    virtual void stream_write(const boost::uint32_t *, const size_t)
+    {
+        throw uhd::not_implemented_error("wavegen_reg_iface: backend has no stream path");
+    }
+
+    /*!
+     * The sc16 item that reaches the sink port as \p word. The sc16
+     * converter puts the real part in the upper 16 bits of the wire
+     * word, so the upper half of \p word becomes the real part.
+     */
+    static boost::uint32_t pack_sc16(const boost::uint32_t word)
+    {
+        const boost::int16_t iq[2] = {
+            boost::int16_t(word >> 16), boost::int16_t(word & 0xFFFF)
+        };
+        boost::uint32_t item;
+        std::memcpy(&item, iq, sizeof(item));
+        return item;
+    }
+
+    //! The word the sink port receives for an sc16 item
+    static boost::uint32_t unpack_sc16(const boost::uint32_t item)
+    {
+        boost::int16_t iq[2];
+        std::memcpy(iq, &item, sizeof(item));
+        return (boost::uint32_t(boost::uint16_t(iq[0])) << 16) | boost::uint16_t(iq[1]);
+    }
+}; /* class wavegen_reg_iface */
+
+}} /* namespace uhd::rfnoc */
+
+#endif /* INCLUDED_WAVEGEN_WAVEGEN_REG_IFACE_HPP */
@@ -0,0 +1,86 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_WAVEGEN_WAVEGEN_SEQUENCER_HPP
+#define INCLUDED_WAVEGEN_WAVEGEN_SEQUENCER_HPP
+
+#include <wavegen/api.h>
+#include <wavegen/wavegen_core.hpp>
+#include <wavegen/wavegen_waveform_library.hpp>
+#include <boost/noncopyable.hpp>
+#include <vector>
+
+namespace uhd {
+    namespace rfnoc {
+
+/*! \brief Pulse-to-pulse waveform agility.
+ *
+ * Turns a table of per-pulse settings into the controller's sequencer
+ * table. Waveforms named in the table are placed in the AWG banks
+ * first, so the table can only use as many distinct AWG waveforms as
+ * there are banks (two with banks enabled in the library, else one).
+ * Once started, the controller steps through the table on every pulse
+ * in AUTO policy without any host traffic.
+ */
+class WAVEGEN_API wavegen_sequencer : boost::noncopyable
+{
+public:
+    typedef boost::shared_ptr<wavegen_sequencer> sptr;
+
+    struct entry_t {
+        entry_t(void):
+            waveform(0), ctrl_word(wavegen_core::CTRL_WORD_SEL_CHIRP),
+            tuning_coef(0), freq_offset(0), rx_len(1) {}
+        //! Library waveform played when ctrl_word selects the AWG
+        wavegen_waveform_library::waveform_id_t waveform;
+        //! wavegen_core::CTRL_WORD_SEL_AWG or CTRL_WORD_SEL_CHIRP
+        boost::uint32_t ctrl_word;
+        boost::uint32_t tuning_coef;
+        boost::uint32_t freq_offset;
+        /*!
+         * Samples received per pulse, as for set_rx_len(). For AWG
+         * pulses this includes the waveform; chirp pulses have no
+         * uploaded waveform, so all of it is ADC window.
+         */
+        boost::uint32_t rx_len;
+    };
+
+    static sptr make(wavegen_core::sptr core, wavegen_waveform_library::sptr library);
+
+    virtual ~wavegen_sequencer(void) {}
+
+    /*!
+     * Place the waveforms and write the table. Stops a running sequence;
+     * call start() to run the new one.
+     */
+    virtual void set_sequence(const std::vector<entry_t> &entries) = 0;
+
+    virtual void start(void) = 0;
+    virtual void stop(void) = 0;
+
+    //! Table entry of the current pulse
+    virtual size_t get_index(void) = 0;
+
+}; /* class wavegen_sequencer */
+
+}} /* namespace uhd::rfnoc */
+
+#endif /* INCLUDED_WAVEGEN_WAVEGEN_SEQUENCER_HPP */
@@ -0,0 +1,96 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_WAVEGEN_WAVEGEN_STATUS_HPP
+#define INCLUDED_WAVEGEN_WAVEGEN_STATUS_HPP
+
+#include <boost/cstdint.hpp>
+#include <cstddef>
+
+namespace uhd {
+    namespace rfnoc {
+
+/*! \brief Decoded snapshot of the wavegen readback registers.
+ *
+ * Filled by wavegen_core::get_status() from one batched readback, so
+ * all fields describe the same moment. The chirp settings have no
+ * readback and come from what the core last wrote. Plain data, cheap
+ * to copy.
+ */
+struct wavegen_status
+{
+    wavegen_status(void):
+        sequence(0), raw_state(0), state(0), busy(false), loaded(false),
+        seq_enabled(false), late(false), underrun(false), queue_depth(0),
+        pulse_count(0), live_bank(0), load_bank(0), swap_pending(false),
+        seq_index(0), waveform_known(false), waveform_id(0), waveform_len(0),
+        num_adc_samples(0), ctrl_word(0), policy(0), prf_count(0),
+        chirp_known(false), chirp_len(0), chirp_tuning_coef(0), chirp_freq_offset(0) {}
+
+    //! Publication number from wavegen_status_monitor; 0 if never read
+    boost::uint64_t sequence;
+
+    /* RB_AWG_STATE */
+    boost::uint64_t raw_state;
+    //! Controller state, one of wavegen_core::AWG_STATE_IDLE/WAIT/PULSE
+    boost::uint8_t state;
+    //! A pulse is playing
+    bool busy;
+    //! The live bank holds a complete waveform
+    bool loaded;
+    bool seq_enabled;
+    //! A timed command arrived after its time (sticky)
+    bool late;
+    //! An AWG pulse fired from an empty bank (sticky)
+    bool underrun;
+    //! Commands waiting in the controller FIFO
+    boost::uint16_t queue_depth;
+    //! Pulses played, wraps at 2^32
+    boost::uint32_t pulse_count;
+
+    /* RB_AWG_BANK, RB_SEQ_INDEX */
+    size_t live_bank;
+    size_t load_bank;
+    bool swap_pending;
+    size_t seq_index;
+
+    //! Library id of the waveform in the live bank, if known
+    bool waveform_known;
+    boost::uint64_t waveform_id;
+
+    /* Configuration readbacks */
+    boost::uint32_t waveform_len;
+    boost::uint32_t num_adc_samples;
+    boost::uint32_t ctrl_word;
+    boost::uint32_t policy;
+    boost::uint64_t prf_count;
+
+    //! Chirp settings from the core's shadow registers, if written
+    bool chirp_known;
+    boost::uint32_t chirp_len;
+    boost::uint32_t chirp_tuning_coef;
+    boost::uint32_t chirp_freq_offset;
+};
+
+}} /* namespace uhd::rfnoc */
+
+#endif /* INCLUDED_WAVEGEN_WAVEGEN_STATUS_HPP */
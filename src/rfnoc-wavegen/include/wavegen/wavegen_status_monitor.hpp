@@ -0,0 +1,88 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_WAVEGEN_WAVEGEN_STATUS_MONITOR_HPP
+#define INCLUDED_WAVEGEN_WAVEGEN_STATUS_MONITOR_HPP
+
+#include <wavegen/api.h>
+#include <wavegen/wavegen_core.hpp>
+#include <wavegen/wavegen_status.hpp>
+#include <wavegen/wavegen_waveform_library.hpp>
+#include <wavegen/thread_profile.h>
+#include <boost/noncopyable.hpp>
+
+namespace uhd {
+    namespace rfnoc {
+
+/*! \brief Publishes wavegen_status snapshots to any number of readers.
+ *
+ * poll() takes one batched readback and publishes it; start() does so
+ * from a background thread at a fixed rate. get_status() returns the
+ * latest published snapshot without touching the bus or taking a lock,
+ * so the monitoring cost is set by the poll rate alone, not by how
+ * many threads read the status.
+ */
+class WAVEGEN_API wavegen_status_monitor : boost::noncopyable
+{
+public:
+    typedef boost::shared_ptr<wavegen_status_monitor> sptr;
+
+    struct stats_t {
+        stats_t(void): polls(0), errors(0), read_retries(0) {}
+        boost::uint64_t polls;
+        //! Polls that threw; the previous snapshot stays published
+        boost::uint64_t errors;
+        //! get_status() calls that raced a publication and read again
+        boost::uint64_t read_retries;
+    };
+
+    /*!
+     * \param core controller to read
+     * \param library if given, used to fill in waveform_id
+     * \param threads if given, the poll thread runs in its ROLE_CONTROL
+     */
+    static sptr make(
+        wavegen_core::sptr core,
+        wavegen_waveform_library::sptr library = wavegen_waveform_library::sptr(),
+        gr::wavegen::thread_profile::sptr threads = gr::wavegen::thread_profile::sptr()
+    );
+
+    virtual ~wavegen_status_monitor(void) {}
+
+    //! Read the status now, publish it and return it
+    virtual wavegen_status poll(void) = 0;
+
+    //! Poll from a background thread \p rate times per second
+    virtual void start(const double rate) = 0;
+    virtual void stop(void) = 0;
+    virtual bool is_running(void) = 0;
+
+    //! Latest published snapshot; sequence is 0 before the first poll
+    virtual wavegen_status get_status(void) = 0;
+
+    virtual stats_t get_stats(void) = 0;
+
+}; /* class wavegen_status_monitor */
+
+}} /* namespace uhd::rfnoc */
+
+#endif /* INCLUDED_WAVEGEN_WAVEGEN_STATUS_MONITOR_HPP */
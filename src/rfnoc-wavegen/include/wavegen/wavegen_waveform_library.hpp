@@ -0,0 +1,170 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_WAVEGEN_WAVEGEN_WAVEFORM_LIBRARY_HPP
+#define INCLUDED_WAVEGEN_WAVEGEN_WAVEFORM_LIBRARY_HPP
+
+#include <wavegen/api.h>
+#include <wavegen/wavegen_core.hpp>
+#include <boost/noncopyable.hpp>
+#include <vector>
+
+namespace uhd {
+    namespace rfnoc {
+
+/*! \brief Host-side store of waveforms, keyed by content hash.
+ *
+ * Waveforms are identified by a 64-bit hash of their samples, so
+ * adding the same samples twice yields the same id and one copy.
+ * Selecting the waveform that is already resident in the AWG costs no
+ * bus traffic; anything else is uploaded through the core.
+ *
+ * With two banks enabled (set_num_banks()), new waveforms are loaded
+ * into the idle bank while the live one keeps playing, and the banks
+ * are swapped at a pulse boundary. A waveform still held in the idle
+ * bank is reselected with a single bank select write.
+ *
+ * Uploads made directly on the core are noticed via
+ * wavegen_core::get_num_uploads() and drop the residency record.
+ *
+ * The store holds at most get_capacity() waveforms. Adding past that
+ * drops the least recently used waveform that is not in a bank;
+ * resident waveforms are never dropped, so the store may run over by
+ * up to the number of banks.
+ */
+class WAVEGEN_API wavegen_waveform_library : boost::noncopyable
+{
+public:
+    typedef boost::shared_ptr<wavegen_waveform_library> sptr;
+    typedef boost::uint64_t waveform_id_t;
+
+    struct stats_t {
+        stats_t(void):
+            hits(0), misses(0), bank_swaps(0), evictions(0), bytes_uploaded(0), bytes_avoided(0) {}
+        //! Selections served by the resident waveform
+        size_t hits;
+        //! Selections that needed an upload
+        size_t misses;
+        size_t bank_swaps;
+        //! Waveforms dropped from the store to stay within capacity
+        size_t evictions;
+        boost::uint64_t bytes_uploaded;
+        //! Sample bytes not sent because the waveform was resident
+        boost::uint64_t bytes_avoided;
+    };
+
+    //! Waveforms kept by default
+    static const size_t DEFAULT_CAPACITY = 64;
+
+    static sptr make(wavegen_core::sptr core);
+
+    //! Content hash used as the waveform id (64-bit FNV-1a over the words)
+    static waveform_id_t hash(const std::vector<boost::uint32_t> &samples);
+
+    virtual ~wavegen_waveform_library(void) {}
+
+    /*!
+     * Use 1 bank (the whole AWG memory, the default) or
+     * wavegen_core::NUM_AWG_BANKS ping-pong banks. Requires an FPGA
+     * image with bank support. Forgets what is resident.
+     */
+    virtual void set_num_banks(const size_t num_banks) = 0;
+    virtual size_t get_num_banks(void) = 0;
+
+    /*!
+     * Most waveforms to keep, at least 1. Lowering it evicts straight
+     * away.
+     */
+    virtual void set_capacity(const size_t capacity) = 0;
+    virtual size_t get_capacity(void) = 0;
+
+    //! Store a waveform without uploading it; returns its id
+    virtual waveform_id_t add(const std::vector<boost::uint32_t> &samples) = 0;
+
+    virtual void remove(const waveform_id_t id) = 0;
+
+    virtual bool contains(const waveform_id_t id) = 0;
+
+    virtual size_t size(void) = 0;
+
+    //! Number of samples in waveform \p id
+    virtual size_t get_length(const waveform_id_t id) = 0;
+
+    //! A copy of the samples of waveform \p id
+    virtual std::vector<boost::uint32_t> get_samples(const waveform_id_t id) = 0;
+
+    /*!
+     * Make a stored waveform the active AWG waveform, uploading it only
+     * if it is not resident. \p spp of 0 uses the core's default
+     * packetisation.
+     */
+    virtual void select(const waveform_id_t id, const size_t spp = 0) = 0;
+
+    /*!
+     * As select(), but the bank swap is a timed command that takes
+     * effect at the first pulse boundary after \p time. Needs two banks.
+     */
+    virtual void select_at(const waveform_id_t id, const uhd::time_spec_t &time, const size_t spp = 0) = 0;
+
+    /*!
+     * Load a waveform into the idle bank ahead of time, unless it is
+     * already in one of the banks. Needs two banks.
+     */
+    virtual void prefetch(const waveform_id_t id, const size_t spp = 0) = 0;
+
+    //! Swap to the idle bank now, or at \p time. Needs two banks.
+    virtual void swap(void) = 0;
+    virtual void swap(const uhd::time_spec_t &time) = 0;
+
+    /*!
+     * Upload \p id into \p bank without selecting it, even if that bank
+     * is live. Used to lay out waveforms for the sequencer.
+     */
+    virtual void load(const waveform_id_t id, const size_t bank, const size_t spp = 0) = 0;
+
+    //! Bank holding \p id; throws if it is not resident
+    virtual size_t get_bank(const waveform_id_t id) = 0;
+
+    //! Waveform held in \p bank; false if the bank's content is unknown
+    virtual bool get_bank_id(const size_t bank, waveform_id_t &id) = 0;
+
+    //! Bank most recently selected by this library
+    virtual size_t get_live_bank(void) = 0;
+
+    //! add() followed by select()
+    virtual waveform_id_t set_waveform(const std::vector<boost::uint32_t> &samples, const size_t spp = 0) = 0;
+
+    //! True if \p id is in the AWG (in either bank)
+    virtual bool is_resident(const waveform_id_t id) = 0;
+
+    //! True if \p id is in the live bank
+    virtual bool is_live(const waveform_id_t id) = 0;
+
+    //! Forget what is resident, e.g. after the block was reset
+    virtual void invalidate(void) = 0;
+
+    virtual stats_t get_stats(void) = 0;
+
+}; /* class wavegen_waveform_library */
+
+}} /* namespace uhd::rfnoc */
+
+#endif /* INCLUDED_WAVEGEN_WAVEGEN_WAVEFORM_LIBRARY_HPP */
@@ -0,0 +1,584 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Control-path benchmark against the mock register backend.
+ *
+ * - Per-call latency of the wavegen_core API (percentiles and a log2
+ *   histogram) and the register transactions each call costs, with
+ *   the shadow cache on and off.
+ * - Waveform upload throughput across sizes, spp and upload modes.
+ *   Host time is measured; bus time is modelled as a fixed latency per
+ *   control transaction so the modes can be compared without hardware.
+ *   The block's settings bus carries one write per transaction, so a
+ *   burst upload costs as many transactions as an sr upload; only the
+ *   stream path packs many words into one.
+ * - waveform_synth on a 1M-sample waveform.
+ * - range_doppler CPIs from 64 to 1024 pulses by 4k to 64k range bins,
+ *   on one worker and on every core, as time per CPI and the PRF that
+ *   keeps up. The largest case needs about 1 GB.
+ *
+ * Usage: bench-wavegen [--latency-us US] [--iters N] [--no-cpi] [--json FILE|-]
+ * A bare number as the first argument is taken as --latency-us.
+ */
+
+#include <wavegen/wavegen_core.hpp>
+#include <wavegen/wavegen_config.hpp>
+#include <wavegen/waveform_synth.h>
+#include <wavegen/range_doppler.h>
+#include "wavegen_mock_reg_iface.h"
+#include <boost/chrono.hpp>
+#include <boost/format.hpp>
+#include <boost/function.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/thread.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace uhd::rfnoc;
+
+typedef boost::chrono::steady_clock bench_clock;
+
+static const size_t STREAM_MAX_WORDS = 2000;
+
+/* Log2 histogram buckets: 2^4 ns (16 ns) up to 2^26 ns (67 ms) */
+static const int HIST_MIN_LOG2 = 4;
+static const int HIST_MAX_LOG2 = 26;
+
+static double
+since_ns(const bench_clock::time_point &start)
+{
+  return double(boost::chrono::duration_cast<boost::chrono::nanoseconds>(
+    bench_clock::now() - start).count());
+}
+
+/***********************************************************************
+ * Results
+ **********************************************************************/
+struct call_result_t {
+  std::string name;
+  bool cache;
+  size_t iters;
+  double txn_per_call;
+  double sr_writes_per_call;
+  double reads_per_call;
+  double mean_ns, p50_ns, p99_ns, p999_ns, max_ns;
+  std::vector<size_t> hist;
+};
+
+struct upload_result_t {
+  std::string mode;
+  size_t samples;
+  size_t spp;
+  double txn_per_upload;
+  double host_msps;
+  double modelled_ksps;
+};
+
+struct synth_result_t {
+  std::string op;
+  size_t samples;
+  double ms;
+};
+
+struct cpi_result_t {
+  size_t pulses;
+  size_t bins;
+  size_t workers;
+  double ms_per_cpi;
+  double max_prf;
+};
+
+static double
+percentile(const std::vector<double> &sorted, double p)
+{
+  const size_t i = std::min(sorted.size() - 1, size_t(p * sorted.size()));
+  return sorted[i];
+}
+
+static std::vector<size_t>
+log2_histogram(const std::vector<double> &ns)
+{
+  std::vector<size_t> hist(HIST_MAX_LOG2 - HIST_MIN_LOG2 + 1, 0);
+  for (size_t i = 0; i < ns.size(); i++) {
+    /* Bucket b counts latencies <= 2^(HIST_MIN_LOG2 + b) ns */
+    int b = 0;
+    while (b + 1 < int(hist.size()) and ns[i] > double(boost::uint64_t(1) << (HIST_MIN_LOG2 + b))) {
+      b++;
+    }
+    hist[b]++;
+  }
+  return hist;
+}
+
+/***********************************************************************
+ * Control calls
+ **********************************************************************/
+/* One API call; the argument is the iteration, so writes can change value */
+typedef boost::function<void(wavegen_core::sptr, size_t)> call_t;
+
+static void do_set_waveform(wavegen_core::sptr core, size_t i)
+{
+  static std::vector<boost::uint32_t> samples(256, 0);
+  samples[0] = boost::uint32_t(i);
+  core->set_waveform(samples);
+}
+
+static void do_setup_chirp(wavegen_core::sptr core, size_t i)
+{
+  core->setup_chirp(1024, boost::uint32_t(0x10000 + i), 0xF0000000);
+}
+
+static void do_set_prf_count(wavegen_core::sptr core, size_t i)
+{
+  core->set_prf_count(100000 + i);
+}
+
+static void do_send_pulse(wavegen_core::sptr core, size_t i)
+{
+  core->send_pulse(boost::uint64_t(1000000) + 1000 * i);
+}
+
+static void do_commit(wavegen_core::sptr core, size_t i)
+{
+  wavegen_config config;
+  config.setup_chirp(1024, boost::uint32_t(0x10000 + i), 0xF0000000)
+        .set_prf_count(100000 + i)
+        .set_num_adc_samples(2048);
+  core->commit(config);
+}
+
+static void do_get_state(wavegen_core::sptr core, size_t)      { core->get_state(); }
+static void do_get_prf_count(wavegen_core::sptr core, size_t)  { core->get_prf_count(); }
+static void do_get_ctrl_word(wavegen_core::sptr core, size_t)  { core->get_ctrl_word(); }
+static void do_get_rx_len(wavegen_core::sptr core, size_t)     { core->get_rx_len(); }
+
+static call_result_t
+bench_call(const std::string &name, call_t call, bool cache, size_t iters)
+{
+  wavegen_mock_reg_iface::sptr iface(new wavegen_mock_reg_iface());
+  iface->record = false;
+  iface->burst_per_op = true;
+  iface->rb[wavegen_core::RB_AWG_STATE] = wavegen_core::AWG_STATE_IDLE;
+  wavegen_core::sptr core = wavegen_core::make(iface);
+  core->set_cache_enabled(cache);
+
+  /* Warm up: first-call allocations and the cache fill are not steady state */
+  for (size_t i = 0; i < std::min<size_t>(iters / 10 + 1, 1000); i++) {
+    call(core, i);
+  }
+  iface->reset_counters();
+
+  std::vector<double> ns(iters);
+  for (size_t i = 0; i < iters; i++) {
+    const bench_clock::time_point start = bench_clock::now();
+    call(core, i + iters);
+    ns[i] = since_ns(start);
+  }
+
+  call_result_t r;
+  r.name = name;
+  r.cache = cache;
+  r.iters = iters;
+  r.txn_per_call = double(iface->num_transactions) / iters;
+  r.sr_writes_per_call = double(iface->num_sr_writes) / iters;
+  r.reads_per_call = double(iface->num_reads) / iters;
+  r.hist = log2_histogram(ns);
+
+  double sum = 0.0;
+  for (size_t i = 0; i < ns.size(); i++) {
+    sum += ns[i];
+  }
+  std::sort(ns.begin(), ns.end());
+  r.mean_ns = sum / iters;
+  r.p50_ns = percentile(ns, 0.50);
+  r.p99_ns = percentile(ns, 0.99);
+  r.p999_ns = percentile(ns, 0.999);
+  r.max_ns = ns.back();
+  return r;
+}
+
+/***********************************************************************
+ * Uploads and synthesis
+ **********************************************************************/
+static const char *mode_name(wavegen_core::upload_mode_t mode)
+{
+  switch (mode) {
+  case wavegen_core::UPLOAD_MODE_SR:     return "sr";
+  case wavegen_core::UPLOAD_MODE_BURST:  return "burst";
+  case wavegen_core::UPLOAD_MODE_STREAM: return "stream";
+  }
+  return "?";
+}
+
+static upload_result_t
+bench_upload(wavegen_core::upload_mode_t mode, size_t num_samps, size_t spp, double txn_latency)
+{
+  wavegen_mock_reg_iface::sptr iface(new wavegen_mock_reg_iface(STREAM_MAX_WORDS));
+  iface->record = false;
+  iface->burst_per_op = true;
+  wavegen_core::sptr core = wavegen_core::make(iface);
+  core->set_upload_mode(mode);
+
+  std::vector<boost::uint32_t> samples(num_samps);
+  for (size_t i = 0; i < num_samps; i++) {
+    samples[i] = boost::uint32_t(i);
+  }
+
+  const size_t reps = std::max<size_t>(1, (size_t(1) << 22) / num_samps);
+  const bench_clock::time_point start = bench_clock::now();
+  for (size_t r = 0; r < reps; r++) {
+    core->set_waveform(samples, spp);
+  }
+  const double host_secs = since_ns(start) / 1e9;
+  const double total_samps = double(num_samps) * reps;
+  const double bus_secs = host_secs + iface->num_transactions * txn_latency;
+
+  upload_result_t r;
+  r.mode = mode_name(mode);
+  r.samples = num_samps;
+  r.spp = spp;
+  r.txn_per_upload = double(iface->num_transactions) / reps;
+  r.host_msps = total_samps / host_secs / 1e6;
+  r.modelled_ksps = total_samps / bus_secs / 1e3;
+  return r;
+}
+
+static void
+add_synth(std::vector<synth_result_t> &results, const std::string &op, size_t num_samps,
+          const bench_clock::time_point &start)
+{
+  synth_result_t r;
+  r.op = op;
+  r.samples = num_samps;
+  r.ms = since_ns(start) / 1e6;
+  results.push_back(r);
+}
+
+static std::vector<synth_result_t>
+bench_synth(size_t num_samps)
+{
+  using gr::wavegen::waveform_synth;
+  std::vector<synth_result_t> results;
+  bench_clock::time_point start;
+
+  start = bench_clock::now();
+  std::vector<gr_complex> lfm = waveform_synth::lfm(num_samps, 0.8);
+  add_synth(results, "lfm", num_samps, start);
+
+  start = bench_clock::now();
+  std::vector<gr_complex> nlfm = waveform_synth::nlfm(num_samps, 0.8, 1.2);
+  add_synth(results, "nlfm", num_samps, start);
+
+  start = bench_clock::now();
+  waveform_synth::apply_window(lfm, gr::fft::window::WIN_HAMMING);
+  add_synth(results, "window", num_samps, start);
+
+  start = bench_clock::now();
+  std::vector<boost::uint32_t> words = waveform_synth::pack_sc16(lfm);
+  add_synth(results, "pack_sc16", num_samps, start);
+
+  const waveform_synth::chirp_coefs_t coefs = waveform_synth::chirp_coefs(num_samps, 0.8);
+  start = bench_clock::now();
+  std::vector<boost::uint32_t> hw = waveform_synth::hw_chirp(coefs.len, coefs.tuning_coef, coefs.freq_offset);
+  add_synth(results, "hw_chirp", num_samps, start);
+
+  return results;
+}
+
+/***********************************************************************
+ * Range-Doppler
+ **********************************************************************/
+static cpi_result_t
+bench_cpi(size_t cpi_len, size_t num_bins, size_t num_workers)
+{
+  using gr::wavegen::range_doppler;
+  using gr::wavegen::pulse_framer;
+
+  range_doppler::config_t config;
+  config.num_bins = num_bins;
+  config.cpi_len = cpi_len;
+  config.prf = 1000.0;
+  config.num_workers = num_workers;
+  config.num_cpis = 1;
+  range_doppler::sptr rd = range_doppler::make(config);
+
+  std::vector<gr_complex> bins(num_bins);
+  for (size_t i = 0; i < num_bins; i++) {
+    bins[i] = gr_complex(float(i % 7), float(i % 3));
+  }
+  pulse_framer::pulse_t pulse;
+  pulse.nsamps = num_bins;
+  pulse.samples = &bins[0];
+
+  /* The first CPI touches every page and plans the FFT; not timed */
+  const size_t reps = 1 + std::max<size_t>(1, (size_t(1) << 26) / (cpi_len * num_bins));
+  double ns = 0.0;
+  for (size_t r = 0; r < reps; r++) {
+    for (size_t p = 0; p < cpi_len; p++) {
+      pulse.index = r * cpi_len + p;
+      rd->add(pulse);
+    }
+    /* Only the corner turn and FFTs after the last pulse are timed */
+    const bench_clock::time_point start = bench_clock::now();
+    rd->flush();
+    range_doppler::map_t map;
+    while (not rd->front(map)) {
+      boost::this_thread::yield();
+    }
+    if (r > 0) {
+      ns += since_ns(start);
+    }
+    rd->pop();
+  }
+
+  cpi_result_t result;
+  result.pulses = cpi_len;
+  result.bins = num_bins;
+  result.workers = num_workers;
+  result.ms_per_cpi = ns / (reps - 1) / 1e6;
+  result.max_prf = cpi_len / (result.ms_per_cpi / 1e3);
+  return result;
+}
+
+static std::vector<cpi_result_t>
+bench_cpis(void)
+{
+  const size_t pulses[] = {64, 256, 1024};
+  const size_t bins[] = {4096, 16384, 65536};
+  const size_t cores = std::max<size_t>(1, boost::thread::hardware_concurrency());
+  std::vector<cpi_result_t> results;
+  for (size_t p = 0; p < sizeof(pulses) / sizeof(pulses[0]); p++) {
+    for (size_t b = 0; b < sizeof(bins) / sizeof(bins[0]); b++) {
+      results.push_back(bench_cpi(pulses[p], bins[b], 1));
+      if (cores > 1) {
+        results.push_back(bench_cpi(pulses[p], bins[b], cores));
+      }
+    }
+  }
+  return results;
+}
+
+/***********************************************************************
+ * Output
+ **********************************************************************/
+static void
+write_json(std::ostream &os, double txn_latency_us, size_t iters,
+           const std::vector<call_result_t> &calls,
+           const std::vector<upload_result_t> &uploads,
+           const std::vector<synth_result_t> &synth,
+           const std::vector<cpi_result_t> &cpis)
+{
+  os << "{\n";
+  os << "  \"benchmark\": \"bench-wavegen\",\n";
+  os << boost::format("  \"config\": {\"txn_latency_us\": %g, \"iterations\": %d},\n")
+    % txn_latency_us % iters;
+
+  os << "  \"calls\": [\n";
+  for (size_t i = 0; i < calls.size(); i++) {
+    const call_result_t &c = calls[i];
+    os << boost::format("    {\"name\": \"%s\", \"cache\": %s, \"iterations\": %d, "
+                        "\"txn_per_call\": %g, \"sr_writes_per_call\": %g, \"reads_per_call\": %g,\n")
+      % c.name % (c.cache ? "true" : "false") % c.iters
+      % c.txn_per_call % c.sr_writes_per_call % c.reads_per_call;
+    os << boost::format("     \"latency_ns\": {\"mean\": %.1f, \"p50\": %.1f, \"p99\": %.1f, "
+                        "\"p999\": %.1f, \"max\": %.1f},\n")
+      % c.mean_ns % c.p50_ns % c.p99_ns % c.p999_ns % c.max_ns;
+    os << "     \"histogram\": [";
+    bool first = true;
+    for (size_t b = 0; b < c.hist.size(); b++) {
+      if (c.hist[b] == 0) {
+        continue;
+      }
+      os << boost::format("%s{\"le_ns\": %d, \"count\": %d}")
+        % (first ? "" : ", ") % (boost::uint64_t(1) << (HIST_MIN_LOG2 + b)) % c.hist[b];
+      first = false;
+    }
+    os << "]}" << ((i + 1 < calls.size()) ? "," : "") << "\n";
+  }
+  os << "  ],\n";
+
+  os << "  \"uploads\": [\n";
+  for (size_t i = 0; i < uploads.size(); i++) {
+    const upload_result_t &u = uploads[i];
+    os << boost::format("    {\"mode\": \"%s\", \"samples\": %d, \"spp\": %d, \"txn_per_upload\": %g, "
+                        "\"host_msps\": %.3f, \"modelled_ksps\": %.3f}%s\n")
+      % u.mode % u.samples % u.spp % u.txn_per_upload % u.host_msps % u.modelled_ksps
+      % ((i + 1 < uploads.size()) ? "," : "");
+  }
+  os << "  ],\n";
+
+  os << "  \"synth\": [\n";
+  for (size_t i = 0; i < synth.size(); i++) {
+    os << boost::format("    {\"op\": \"%s\", \"samples\": %d, \"ms\": %.3f}%s\n")
+      % synth[i].op % synth[i].samples % synth[i].ms
+      % ((i + 1 < synth.size()) ? "," : "");
+  }
+  os << "  ],\n";
+
+  os << "  \"range_doppler\": [\n";
+  for (size_t i = 0; i < cpis.size(); i++) {
+    os << boost::format("    {\"pulses\": %d, \"bins\": %d, \"workers\": %d, "
+                        "\"ms_per_cpi\": %.3f, \"max_prf\": %.1f}%s\n")
+      % cpis[i].pulses % cpis[i].bins % cpis[i].workers % cpis[i].ms_per_cpi % cpis[i].max_prf
+      % ((i + 1 < cpis.size()) ? "," : "");
+  }
+  os << "  ]\n";
+  os << "}\n";
+}
+
+static void
+print_tables(std::ostream &os, double txn_latency_us,
+             const std::vector<call_result_t> &calls,
+             const std::vector<upload_result_t> &uploads,
+             const std::vector<synth_result_t> &synth,
+             const std::vector<cpi_result_t> &cpis)
+{
+  os << "Control calls (latency in ns)" << std::endl;
+  os << boost::format("%-14s %-5s %8s %8s %9s %9s %9s %9s")
+    % "call" % "cache" % "txn" % "writes" % "p50" % "p99" % "p999" % "max" << std::endl;
+  for (size_t i = 0; i < calls.size(); i++) {
+    const call_result_t &c = calls[i];
+    os << boost::format("%-14s %-5s %8.2f %8.2f %9.0f %9.0f %9.0f %9.0f")
+      % c.name % (c.cache ? "on" : "off") % c.txn_per_call % c.sr_writes_per_call
+      % c.p50_ns % c.p99_ns % c.p999_ns % c.max_ns << std::endl;
+  }
+
+  os << std::endl;
+  os << boost::format("Waveform upload, modelled bus latency %.2f us per transaction, one register write per transaction")
+    % txn_latency_us << std::endl;
+  os << boost::format("%-7s %9s %6s %12s %12s %14s")
+    % "mode" % "samples" % "spp" % "txn/upload" % "host Msps" % "modelled ksps"
+    << std::endl;
+  for (size_t i = 0; i < uploads.size(); i++) {
+    const upload_result_t &u = uploads[i];
+    os << boost::format("%-7s %9d %6d %12.0f %12.2f %14.1f")
+      % u.mode % u.samples % u.spp % u.txn_per_upload % u.host_msps % u.modelled_ksps
+      << std::endl;
+  }
+
+  os << std::endl << "Waveform synthesis" << std::endl;
+  os << boost::format("%-10s %9s %10s") % "op" % "samples" % "ms" << std::endl;
+  for (size_t i = 0; i < synth.size(); i++) {
+    os << boost::format("%-10s %9d %10.2f") % synth[i].op % synth[i].samples % synth[i].ms
+      << std::endl;
+  }
+
+  if (cpis.empty()) {
+    return;
+  }
+  os << std::endl << "Range-Doppler, time from the last pulse of a CPI to its map" << std::endl;
+  os << boost::format("%7s %7s %8s %12s %12s")
+    % "pulses" % "bins" % "workers" % "ms/CPI" % "max PRF" << std::endl;
+  for (size_t i = 0; i < cpis.size(); i++) {
+    os << boost::format("%7d %7d %8d %12.2f %12.0f")
+      % cpis[i].pulses % cpis[i].bins % cpis[i].workers % cpis[i].ms_per_cpi % cpis[i].max_prf
+      << std::endl;
+  }
+}
+
+int
+main(int argc, char **argv)
+{
+  double txn_latency_us = 10.0;
+  size_t iters = 100000;
+  std::string json_path;
+  bool cpi = true;
+
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--latency-us" and i + 1 < argc) {
+      txn_latency_us = boost::lexical_cast<double>(argv[++i]);
+    } else if (arg == "--iters" and i + 1 < argc) {
+      iters = boost::lexical_cast<size_t>(argv[++i]);
+    } else if (arg == "--no-cpi") {
+      cpi = false;
+    } else if (arg == "--json" and i + 1 < argc) {
+      json_path = argv[++i];
+    } else if (i == 1 and arg[0] != '-') {
+      txn_latency_us = boost::lexical_cast<double>(arg);
+    } else {
+      std::cerr << "Usage: " << argv[0]
+                << " [--latency-us US] [--iters N] [--no-cpi] [--json FILE|-]" << std::endl;
+      return 1;
+    }
+  }
+  iters = std::max<size_t>(iters, 1);
+
+  static const struct {
+    const char *name;
+    void (*fn)(wavegen_core::sptr, size_t);
+  } calls_to_bench[] = {
+    {"set_waveform", do_set_waveform},
+    {"setup_chirp", do_setup_chirp},
+    {"set_prf_count", do_set_prf_count},
+    {"send_pulse", do_send_pulse},
+    {"commit", do_commit},
+    {"get_state", do_get_state},
+    {"get_prf_count", do_get_prf_count},
+    {"get_ctrl_word", do_get_ctrl_word},
+    {"get_rx_len", do_get_rx_len}
+  };
+
+  std::vector<call_result_t> calls;
+  for (size_t c = 0; c < sizeof(calls_to_bench) / sizeof(calls_to_bench[0]); c++) {
+    for (int cache = 1; cache >= 0; cache--) {
+      calls.push_back(bench_call(calls_to_bench[c].name, calls_to_bench[c].fn, cache != 0, iters));
+    }
+  }
+
+  const size_t sizes[] = {256, 4096, 65535, 1048576};
+  const size_t spps[] = {64, 1024};
+  const wavegen_core::upload_mode_t modes[] = {
+    wavegen_core::UPLOAD_MODE_SR,
+    wavegen_core::UPLOAD_MODE_BURST,
+    wavegen_core::UPLOAD_MODE_STREAM
+  };
+
+  std::vector<upload_result_t> uploads;
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    for (size_t p = 0; p < sizeof(spps) / sizeof(spps[0]); p++) {
+      for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        uploads.push_back(bench_upload(modes[m], sizes[s], spps[p], txn_latency_us / 1e6));
+      }
+    }
+  }
+
+  const std::vector<synth_result_t> synth = bench_synth(1048576);
+  const std::vector<cpi_result_t> cpis = cpi ? bench_cpis() : std::vector<cpi_result_t>();
+
+  /* With JSON on stdout the tables go to stderr so the output stays parseable */
+  print_tables((json_path == "-") ? std::cerr : std::cout, txn_latency_us, calls, uploads, synth, cpis);
+
+  if (json_path == "-") {
+    write_json(std::cout, txn_latency_us, iters, calls, uploads, synth, cpis);
+  } else if (not json_path.empty()) {
+    std::ofstream ofs(json_path.c_str());
+    if (not ofs) {
+      std::cerr << "Cannot open " << json_path << std::endl;
+      return 1;
+    }
+    write_json(ofs, txn_latency_us, iters, calls, uploads, synth, cpis);
+  }
+
+  return 0;
+}
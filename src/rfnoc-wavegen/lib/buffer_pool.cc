@@ -0,0 +1,374 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <wavegen/buffer_pool.h>
+#include "worker_ring.h"
+#include <boost/lockfree/stack.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/format.hpp>
+#include <boost/scoped_array.hpp>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace gr {
+  namespace wavegen {
+
+    const size_t buffer_pool::ALIGNMENT;
+    const size_t buffer_pool::HUGE_PAGE_SIZE;
+
+    buffer_pool::handle_t::handle_t(void):
+      _pool(NULL), _index(0), _data(NULL)
+    {
+    }
+
+    buffer_pool::handle_t::handle_t(buffer_pool *pool, size_t index, char *data):
+      _pool(pool), _index(index), _data(data)
+    {
+    }
+
+    buffer_pool::handle_t::handle_t(const handle_t &other):
+      _pool(other._pool), _index(other._index), _data(other._data)
+    {
+      if (_pool) {
+        _pool->retain(_index);
+      }
+    }
+
+    buffer_pool::handle_t &
+    buffer_pool::handle_t::operator=(const handle_t &other)
+    {
+      /* Take the new reference before dropping the old one, so
+       * self-assignment is harmless */
+      buffer_pool *pool = other._pool;
+      const size_t index = other._index;
+      char *data = other._data;
+      if (pool) {
+        pool->retain(index);
+      }
+      reset();
+      _pool = pool;
+      _index = index;
+      _data = data;
+      return *this;
+    }
+
+    buffer_pool::handle_t::~handle_t()
+    {
+      reset();
+    }
+
+    void
+    buffer_pool::handle_t::reset()
+    {
+      /* Empty the handle first: once released, the buffer may be
+       * handed out and this handle reassigned from another thread */
+      if (_pool) {
+        buffer_pool *pool = _pool;
+        _pool = NULL;
+        _data = NULL;
+        pool->release(_index);
+      }
+    }
+
+    size_t
+    buffer_pool::handle_t::size() const
+    {
+      return _pool ? _pool->get_buffer_size() : 0;
+    }
+
+    size_t
+    buffer_pool::handle_t::use_count() const
+    {
+      return _pool ? _pool->use_count(_index) : 0;
+    }
+
+    class buffer_pool_impl : public buffer_pool
+    {
+    public:
+      buffer_pool_impl(const config_t &config):
+        _config(config),
+        _memory(NULL),
+        _mapped(0),
+        _page_mode(PAGES_NORMAL),
+        _locked(false),
+        _refs(new refcount_t[config.num_buffers]),
+        _free(config.num_buffers),
+        _waiters(0)
+      {
+        if (config.num_buffers == 0) {
+          throw std::invalid_argument("buffer_pool: num_buffers must be non-zero");
+        }
+        if (config.buffer_size == 0 or config.buffer_size % ALIGNMENT) {
+          throw std::invalid_argument(str(
+            boost::format("buffer_pool: buffer size %d is not a multiple of %d")
+            % config.buffer_size % ALIGNMENT));
+        }
+
+        const size_t size = config.num_buffers * config.buffer_size;
+        map(size);
+        /* First touch places each page on this thread's NUMA node and
+         * takes the page faults now rather than in the receive loop */
+        const size_t page = size_t(::sysconf(_SC_PAGESIZE));
+        for (size_t offset = 0; offset < size; offset += page) {
+          _memory[offset] = 0;
+        }
+        if (config.lock_memory) {
+          _locked = ::mlock(_memory, _mapped) == 0;
+        }
+
+        for (size_t i = 0; i < config.num_buffers; i++) {
+          _refs[i].count.store(0, boost::memory_order_relaxed);
+        }
+        /* Pushed in reverse so buffer 0 is handed out first */
+        for (size_t i = config.num_buffers; i > 0; i--) {
+          _free.bounded_push(i - 1);
+        }
+        _acquires.store(0, boost::memory_order_relaxed);
+        _waits.store(0, boost::memory_order_relaxed);
+        _empty.store(0, boost::memory_order_relaxed);
+        _in_use.store(0, boost::memory_order_relaxed);
+        _max_in_use.store(0, boost::memory_order_relaxed);
+      }
+
+      ~buffer_pool_impl()
+      {
+        if (_locked) {
+          ::munlock(_memory, _mapped);
+        }
+        ::munmap(_memory, _mapped);
+      }
+
+      bool
+      try_acquire(handle_t &handle)
+      {
+        size_t index;
+        if (not _free.pop(index)) {
+          count(_empty);
+          return false;
+        }
+        handle = take(index);
+        return true;
+      }
+
+      bool
+      acquire(handle_t &handle, double timeout)
+      {
+        size_t index;
+        if (not _free.pop(index)) {
+          count(_waits);
+          const boost::system_time deadline = boost::get_system_time()
+            + boost::posix_time::microseconds(boost::int64_t(timeout * 1e6));
+          boost::mutex::scoped_lock lock(_free_mutex);
+          _waiters.fetch_add(1);
+          while (not _free.pop(index)) {
+            if (timeout >= 0.0 and boost::get_system_time() >= deadline) {
+              _waiters.fetch_sub(1);
+              count(_empty);
+              return false;
+            }
+            _free_cond.timed_wait(lock, WAKE_INTERVAL);
+          }
+          _waiters.fetch_sub(1);
+        }
+        handle = take(index);
+        return true;
+      }
+
+      size_t
+      index_of(const void *p) const
+      {
+        const char *c = static_cast<const char *>(p);
+        const size_t size = _config.num_buffers * _config.buffer_size;
+        if (c < _memory or c >= _memory + size) {
+          throw std::invalid_argument("buffer_pool: address is not in the pool");
+        }
+        return size_t(c - _memory) / _config.buffer_size;
+      }
+
+      char *
+      data(size_t index) const
+      {
+        return _memory + index * _config.buffer_size;
+      }
+
+      size_t
+      get_num_buffers() const
+      {
+        return _config.num_buffers;
+      }
+
+      size_t
+      get_buffer_size() const
+      {
+        return _config.buffer_size;
+      }
+
+      size_t
+      available() const
+      {
+        return _config.num_buffers - size_t(_in_use.load(boost::memory_order_relaxed));
+      }
+
+      page_mode_t
+      get_page_mode() const
+      {
+        return _page_mode;
+      }
+
+      bool
+      is_locked() const
+      {
+        return _locked;
+      }
+
+      stats_t
+      get_stats()
+      {
+        stats_t stats;
+        stats.acquires = _acquires.load(boost::memory_order_relaxed);
+        stats.waits = _waits.load(boost::memory_order_relaxed);
+        stats.empty = _empty.load(boost::memory_order_relaxed);
+        stats.in_use = _in_use.load(boost::memory_order_relaxed);
+        stats.max_in_use = _max_in_use.load(boost::memory_order_relaxed);
+        return stats;
+      }
+
+      config_t
+      get_config()
+      {
+        return _config;
+      }
+
+    private:
+      /* Map \p size bytes, with huge pages if asked and available */
+      void
+      map(size_t size)
+      {
+        void *memory = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        if (_config.huge_pages) {
+          _mapped = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+          memory = ::mmap(NULL, _mapped, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+          if (memory != MAP_FAILED) {
+            _page_mode = PAGES_HUGE;
+          }
+        }
+#endif
+        if (memory == MAP_FAILED) {
+          _mapped = size;
+          memory = ::mmap(NULL, _mapped, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+          if (memory == MAP_FAILED) {
+            throw std::runtime_error(str(
+              boost::format("buffer_pool: cannot map %d bytes: %s") % size % std::strerror(errno)));
+          }
+#ifdef MADV_HUGEPAGE
+          /* Only advice; the kernel may still use small pages */
+          if (_config.huge_pages and ::madvise(memory, _mapped, MADV_HUGEPAGE) == 0) {
+            _page_mode = PAGES_TRANSPARENT_HUGE;
+          }
+#endif
+        }
+        _memory = static_cast<char *>(memory);
+      }
+
+      handle_t
+      take(size_t index)
+      {
+        _refs[index].count.store(1, boost::memory_order_relaxed);
+        count(_acquires);
+        raise_max(_max_in_use, _in_use.fetch_add(1, boost::memory_order_relaxed) + 1);
+        return make_handle(index, data(index));
+      }
+
+      void
+      retain(size_t index)
+      {
+        _refs[index].count.fetch_add(1, boost::memory_order_relaxed);
+      }
+
+      void
+      release(size_t index)
+      {
+        /* The last holder's writes to the buffer happen before the
+         * next owner's */
+        if (_refs[index].count.fetch_sub(1, boost::memory_order_acq_rel) != 1) {
+          return;
+        }
+        _in_use.fetch_sub(1, boost::memory_order_relaxed);
+        _free.bounded_push(index);
+        if (_waiters.load()) {
+          _free_cond.notify_one();
+        }
+      }
+
+      size_t
+      use_count(size_t index) const
+      {
+        return _refs[index].count.load(boost::memory_order_relaxed);
+      }
+
+      /* Each count on its own cache line; handles of different buffers
+       * are passed between different threads */
+      struct refcount_t {
+        boost::atomic<boost::uint32_t> count;
+        char pad[64 - sizeof(boost::atomic<boost::uint32_t>)];
+      };
+
+      const config_t _config;
+      char *_memory;
+      size_t _mapped;
+      page_mode_t _page_mode;
+      bool _locked;
+      boost::scoped_array<refcount_t> _refs;
+
+      /* Free buffer indices, most recently returned on top */
+      boost::lockfree::stack<size_t> _free;
+      boost::atomic<size_t> _waiters;
+      boost::mutex _free_mutex;
+      boost::condition_variable _free_cond;
+
+      counter_t _acquires;
+      counter_t _waits;
+      counter_t _empty;
+      counter_t _in_use;
+      counter_t _max_in_use;
+    };
+
+    buffer_pool::sptr
+    buffer_pool::make(const config_t &config)
+    {
+      return sptr(new buffer_pool_impl(config));
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
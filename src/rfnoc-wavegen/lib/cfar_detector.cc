@@ -0,0 +1,371 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <wavegen/cfar_detector.h>
+#include "worker_ring.h"
+#include <volk/volk.h>
+#include <boost/atomic.hpp>
+#include <boost/chrono.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace gr {
+  namespace wavegen {
+
+    /* Cells per block of rows; noise, cell and excess for one block
+     * stay in cache between the sums and the VOLK passes */
+    static const size_t BLOCK_CELLS = 16384;
+
+    /* The excess over threshold is searched for a crossing this many
+     * cells at a time */
+    static const size_t SCAN_CELLS = 256;
+
+    /* pfa of OS-CFAR with rank k of n cells at threshold factor t */
+    static double
+    os_pfa(size_t n, size_t k, double t)
+    {
+      double pfa = 1.0;
+      for (size_t i = 0; i < k; i++) {
+        pfa *= double(n - i) / (double(n - i) + t);
+      }
+      return pfa;
+    }
+
+    class cfar_detector_impl : public cfar_detector
+    {
+    public:
+      cfar_detector_impl(const config_t &config):
+        _config(config)
+      {
+        if (config.train_cells == 0) {
+          throw std::invalid_argument("cfar_detector: train_cells must be non-zero");
+        }
+        if (not (config.pfa > 0.0 and config.pfa < 1.0)) {
+          throw std::invalid_argument("cfar_detector: pfa must be between 0 and 1");
+        }
+        const size_t n = 2 * config.train_cells;
+        if (config.os_rank > n) {
+          throw std::invalid_argument("cfar_detector: os_rank is above 2 * train_cells");
+        }
+        if (_config.os_rank == 0) {
+          _config.os_rank = std::max<size_t>(1, 3 * n / 4);
+        }
+
+        if (config.threshold_factor > 0.0f) {
+          _alpha = config.threshold_factor;
+        } else if (config.method == CFAR_OS) {
+          /* pfa falls monotonically with the factor; bisect for it */
+          double lo = 0.0, hi = 1.0;
+          while (os_pfa(n, _config.os_rank, hi) > config.pfa) {
+            hi *= 2.0;
+          }
+          for (int i = 0; i < 100; i++) {
+            const double mid = 0.5 * (lo + hi);
+            (os_pfa(n, _config.os_rank, mid) > config.pfa ? lo : hi) = mid;
+          }
+          _alpha = float(hi);
+        } else {
+          /* Exact for CA; GO and SO come out slightly below and above pfa */
+          _alpha = float(double(n) * (std::pow(config.pfa, -1.0 / double(n)) - 1.0));
+        }
+
+        _cells.store(0, boost::memory_order_relaxed);
+        _detections.store(0, boost::memory_order_relaxed);
+        _process_ns.store(0, boost::memory_order_relaxed);
+      }
+
+      float
+      get_threshold_factor() const
+      {
+        return _alpha;
+      }
+
+      size_t
+      detect(const float *power, size_t num_bins, size_t width,
+             std::vector<detection_t> &detections)
+      {
+        return timed_detect<false>(power, num_bins, width, detections);
+      }
+
+      size_t
+      detect(const pulse_framer::pulse_t &pulse, std::vector<detection_t> &detections)
+      {
+        _power.resize(pulse.nsamps);
+        if (pulse.nsamps == 0) {
+          return 0;
+        }
+        volk_32fc_magnitude_squared_32f(&_power[0], static_cast<const gr_complex *>(pulse.samples),
+                                        pulse.nsamps);
+        const size_t first = detections.size();
+        const size_t found = timed_detect<false>(&_power[0], pulse.nsamps, 1, detections);
+        for (size_t i = first; i < detections.size(); i++) {
+          detections[i].index = pulse.index;
+          detections[i].has_time = pulse.has_time;
+          detections[i].time = pulse.time;
+        }
+        return found;
+      }
+
+      size_t
+      detect(const range_doppler::map_t &map, std::vector<detection_t> &detections)
+      {
+        const size_t first = detections.size();
+        const size_t found = (map.output == range_doppler::OUTPUT_MAGNITUDE) ?
+          timed_detect<true>(map.data, map.num_bins, map.doppler_size, detections) :
+          timed_detect<false>(map.data, map.num_bins, map.doppler_size, detections);
+        for (size_t i = first; i < detections.size(); i++) {
+          detections[i].index = map.index;
+          detections[i].has_time = map.has_time;
+          detections[i].time = map.time;
+        }
+        return found;
+      }
+
+      stats_t
+      get_stats()
+      {
+        stats_t stats;
+        stats.cells = _cells.load(boost::memory_order_relaxed);
+        stats.detections = _detections.load(boost::memory_order_relaxed);
+        stats.process_ns = _process_ns.load(boost::memory_order_relaxed);
+        return stats;
+      }
+
+      config_t
+      get_config()
+      {
+        return _config;
+      }
+
+    private:
+      template<bool SQUARE> static float
+      cell(float v)
+      {
+        return SQUARE ? v * v : v;
+      }
+
+      //! sum += sign * row, column by column
+      template<bool SQUARE> static void
+      accumulate(std::vector<double> &sum, const float *row, size_t width, double sign)
+      {
+        for (size_t c = 0; c < width; c++) {
+          sum[c] += sign * cell<SQUARE>(row[c]);
+        }
+      }
+
+      template<bool SQUARE> size_t
+      timed_detect(const float *data, size_t rows, size_t width,
+                   std::vector<detection_t> &detections)
+      {
+        if (rows == 0 or width == 0) {
+          return 0;
+        }
+        const boost::chrono::steady_clock::time_point start = boost::chrono::steady_clock::now();
+        const size_t found = detect_grid<SQUARE>(data, rows, width, detections);
+        count(_process_ns, boost::chrono::duration_cast<boost::chrono::nanoseconds>(
+                boost::chrono::steady_clock::now() - start).count());
+        count(_cells, rows * width);
+        count(_detections, found);
+        return found;
+      }
+
+      template<bool SQUARE> size_t
+      detect_grid(const float *data, size_t rows, size_t width,
+                  std::vector<detection_t> &detections)
+      {
+        const size_t g = _config.guard_cells;
+        const size_t w = _config.train_cells;
+        const bool os = (_config.method == CFAR_OS);
+        const size_t block_rows = std::max<size_t>(1, BLOCK_CELLS / width);
+
+        /* Running sums of the leading (lower range) and lagging windows,
+         * in double so adding and removing strong cells leaves no residue */
+        _lead.assign(width, 0.0);
+        _lag.assign(width, 0.0);
+        if (not os) {
+          for (size_t r = g + 1; r <= g + w and r < rows; r++) {
+            accumulate<SQUARE>(_lag, data + r * width, width, 1.0);
+          }
+        } else {
+          _ref.resize(width * 2 * w);
+        }
+        _noise.resize(block_rows * width);
+        _cell.resize(block_rows * width);
+        _excess.resize(block_rows * width);
+
+        size_t found = 0;
+        for (size_t b0 = 0; b0 < rows; b0 += block_rows) {
+          const size_t nb = std::min(block_rows, rows - b0);
+          for (size_t b = b0; b < b0 + nb; b++) {
+            const size_t nl = (b >= g + 1) ? std::min(w, b - g) : 0;
+            const size_t nr = (b + g + 1 < rows) ? std::min(w, rows - (b + g + 1)) : 0;
+            float *noise = &_noise[(b - b0) * width];
+            float *cells = &_cell[(b - b0) * width];
+            const float *row = data + b * width;
+            for (size_t c = 0; c < width; c++) {
+              cells[c] = cell<SQUARE>(row[c]);
+            }
+
+            if (os) {
+              ordered_statistic<SQUARE>(data, b, nl, nr, width, noise);
+              continue;
+            }
+            estimate(nl, nr, width, noise);
+
+            /* Slide both windows on to b + 1 */
+            if (b >= g) {
+              accumulate<SQUARE>(_lead, data + (b - g) * width, width, 1.0);
+            }
+            if (b >= g + w) {
+              accumulate<SQUARE>(_lead, data + (b - g - w) * width, width, -1.0);
+            }
+            if (b + g + 1 < rows) {
+              accumulate<SQUARE>(_lag, data + (b + g + 1) * width, width, -1.0);
+            }
+            if (b + g + w + 1 < rows) {
+              accumulate<SQUARE>(_lag, data + (b + g + w + 1) * width, width, 1.0);
+            }
+          }
+          found += compare(b0, nb * width, width, detections);
+        }
+        return found;
+      }
+
+      //! Noise estimate for CA, GO or SO from the running sums
+      void
+      estimate(size_t nl, size_t nr, size_t width, float *noise)
+      {
+        const float inf = std::numeric_limits<float>::infinity();
+        if (nl + nr == 0) {
+          std::fill(noise, noise + width, inf);
+          return;
+        }
+        if (_config.method == CFAR_CA or nl == 0 or nr == 0) {
+          const double scale = 1.0 / double(nl + nr);
+          for (size_t c = 0; c < width; c++) {
+            noise[c] = float((_lead[c] + _lag[c]) * scale);
+          }
+          return;
+        }
+        const double sl = 1.0 / double(nl), sr = 1.0 / double(nr);
+        for (size_t c = 0; c < width; c++) {
+          const double lead = _lead[c] * sl, lag = _lag[c] * sr;
+          noise[c] = float((_config.method == CFAR_GO) ? std::max(lead, lag) : std::min(lead, lag));
+        }
+      }
+
+      //! Noise estimate for OS: a ranked reference cell per column
+      template<bool SQUARE> void
+      ordered_statistic(const float *data, size_t b, size_t nl, size_t nr,
+                        size_t width, float *noise)
+      {
+        const size_t g = _config.guard_cells;
+        const size_t n = nl + nr;
+        if (n == 0) {
+          std::fill(noise, noise + width, std::numeric_limits<float>::infinity());
+          return;
+        }
+        /* Rows are read in order; each column's reference cells end up together */
+        size_t j = 0;
+        for (size_t r = b - g - nl; j < nl; r++, j++) {
+          for (size_t c = 0; c < width; c++) {
+            _ref[c * n + j] = cell<SQUARE>(data[r * width + c]);
+          }
+        }
+        for (size_t r = b + g + 1; j < n; r++, j++) {
+          for (size_t c = 0; c < width; c++) {
+            _ref[c * n + j] = cell<SQUARE>(data[r * width + c]);
+          }
+        }
+        /* The rank scales with the cells there are at the ends */
+        const size_t k = std::max<size_t>(1, _config.os_rank * n / (2 * _config.train_cells));
+        for (size_t c = 0; c < width; c++) {
+          float *ref = &_ref[c * n];
+          std::nth_element(ref, ref + k - 1, ref + n);
+          noise[c] = ref[k - 1];
+        }
+      }
+
+      //! Threshold the block and append its crossings
+      size_t
+      compare(size_t b0, size_t ncells, size_t width, std::vector<detection_t> &detections)
+      {
+        float *noise = &_noise[0];
+        float *cells = &_cell[0];
+        float *excess = &_excess[0];
+        /* excess = cell - alpha * noise; noise is kept for the detections */
+        volk_32f_s32f_multiply_32f(excess, noise, _alpha, ncells);
+        volk_32f_x2_subtract_32f(excess, cells, excess, ncells);
+
+        size_t found = 0;
+        for (size_t off = 0; off < ncells; off += SCAN_CELLS) {
+          const size_t n = std::min(SCAN_CELLS, ncells - off);
+          boost::uint32_t peak = 0;
+          volk_32f_index_max_32u(&peak, excess + off, n);
+          if (not (excess[off + peak] > 0.0f)) {
+            continue;
+          }
+          for (size_t i = off; i < off + n; i++) {
+            if (excess[i] > 0.0f) {
+              detection_t d;
+              d.range_bin = boost::uint32_t(b0 + i / width);
+              d.doppler_bin = boost::uint32_t(i % width);
+              d.power = cells[i];
+              d.noise = noise[i];
+              detections.push_back(d);
+              found++;
+            }
+          }
+        }
+        return found;
+      }
+
+      config_t _config;
+      float _alpha;
+
+      /* Scratch, kept between calls */
+      std::vector<double> _lead;
+      std::vector<double> _lag;
+      std::vector<float> _noise;
+      std::vector<float> _cell;
+      std::vector<float> _excess;
+      std::vector<float> _ref;
+      std::vector<float> _power;
+
+      counter_t _cells;
+      counter_t _detections;
+      counter_t _process_ns;
+    };
+
+    cfar_detector::sptr
+    cfar_detector::make(const config_t &config)
+    {
+      return sptr(new cfar_detector_impl(config));
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
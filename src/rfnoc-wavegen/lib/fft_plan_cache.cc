@@ -0,0 +1,116 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fft_plan_cache.h"
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <utility>
+
+namespace gr {
+  namespace wavegen {
+
+    namespace {
+
+      typedef std::pair<int, bool> plan_key_t;
+
+      class plan_pool
+      {
+      public:
+        plan_pool(void): _created(0) {}
+
+        ~plan_pool()
+        {
+          for (pool_t::iterator it = _idle.begin(); it != _idle.end(); ++it) {
+            delete it->second;
+          }
+        }
+
+        gr::fft::fft_complex *
+        take(int size, bool forward)
+        {
+          {
+            boost::mutex::scoped_lock lock(_mutex);
+            pool_t::iterator it = _idle.find(plan_key_t(size, forward));
+            if (it != _idle.end()) {
+              gr::fft::fft_complex *fft = it->second;
+              _idle.erase(it);
+              return fft;
+            }
+            _created++;
+          }
+          /* Planning takes FFTW's own planner lock; keep ours free */
+          return new gr::fft::fft_complex(size, forward, 1);
+        }
+
+        void
+        give(int size, bool forward, gr::fft::fft_complex *fft)
+        {
+          boost::mutex::scoped_lock lock(_mutex);
+          _idle.insert(std::make_pair(plan_key_t(size, forward), fft));
+        }
+
+        size_t
+        created(void)
+        {
+          boost::mutex::scoped_lock lock(_mutex);
+          return _created;
+        }
+
+      private:
+        typedef std::multimap<plan_key_t, gr::fft::fft_complex *> pool_t;
+        boost::mutex _mutex;
+        pool_t _idle;
+        size_t _created;
+      };
+
+      plan_pool &
+      get_pool(void)
+      {
+        static plan_pool pool;
+        return pool;
+      }
+
+    } /* anonymous namespace */
+
+    fft_plan_cache::plan::plan(int size, bool forward):
+      _size(size),
+      _forward(forward),
+      _fft(get_pool().take(size, forward))
+    {
+    }
+
+    fft_plan_cache::plan::~plan()
+    {
+      get_pool().give(_size, _forward, _fft);
+    }
+
+    size_t
+    fft_plan_cache::num_created(void)
+    {
+      return get_pool().created();
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
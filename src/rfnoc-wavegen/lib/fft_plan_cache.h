@@ -0,0 +1,64 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_WAVEGEN_FFT_PLAN_CACHE_H
+#define INCLUDED_WAVEGEN_FFT_PLAN_CACHE_H
+
+#include <gnuradio/fft/fft.h>
+#include <boost/noncopyable.hpp>
+
+namespace gr {
+  namespace wavegen {
+
+    /*!
+     * Process-wide pool of FFT objects. Creating one plans the
+     * transform, which is slow and serialised inside FFTW, so workers
+     * borrow a plan of the size and direction they need and give it
+     * back when they are done; the next engine of the same size reuses
+     * it. A borrowed plan (and its buffers) belongs to one thread.
+     */
+    class fft_plan_cache
+    {
+    public:
+      //! Borrowed plan, returned to the pool on destruction
+      class plan : boost::noncopyable
+      {
+      public:
+        plan(int size, bool forward);
+        ~plan();
+
+        gr_complex *in() const { return _fft->get_inbuf(); }
+        gr_complex *out() const { return _fft->get_outbuf(); }
+        void execute() { _fft->execute(); }
+
+      private:
+        const int _size;
+        const bool _forward;
+        gr::fft::fft_complex *_fft;
+      };
+
+      //! Plans created so far, for tests and benchmarks
+      static size_t num_created(void);
+    };
+
+  } /* namespace wavegen */
+} /* namespace gr */
+
+#endif /* INCLUDED_WAVEGEN_FFT_PLAN_CACHE_H */
@@ -0,0 +1,243 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <wavegen/matched_filter.h>
+#include <wavegen/waveform_synth.h>
+#include "fft_plan_cache.h"
+#include "worker_ring.h"
+#include <volk/volk.h>
+#include <boost/chrono.hpp>
+#include <boost/format.hpp>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace gr {
+  namespace wavegen {
+
+    static size_t
+    next_pow2(size_t n)
+    {
+      size_t p = 1;
+      while (p < n) {
+        p <<= 1;
+      }
+      return p;
+    }
+
+    class matched_filter_impl : public matched_filter
+    {
+    public:
+      matched_filter_impl(const std::vector<gr_complex> &reference, const config_t &config):
+        _config(config),
+        _item_size(config.input == INPUT_SC16 ? sizeof(std::complex<short>) : sizeof(gr_complex)),
+        _fft_size(config.fft_size),
+        _pulses(config.num_slots),
+        _ring(config.num_slots)
+      {
+        if (reference.empty() or config.rx_len == 0
+            or config.num_workers == 0 or config.num_slots == 0) {
+          throw std::invalid_argument(
+            "matched_filter: reference, rx_len, workers and slots must be non-empty");
+        }
+        if (not (config.scale > 0.0f)) {
+          throw std::invalid_argument("matched_filter: scale must be positive");
+        }
+        const size_t min_size = config.rx_len + reference.size() - 1;
+        if (_fft_size == 0) {
+          _fft_size = next_pow2(min_size);
+        }
+        if (_fft_size < min_size) {
+          throw std::invalid_argument(str(
+            boost::format("matched_filter: FFT size %d is below rx_len + reference length - 1 = %d")
+            % _fft_size % min_size));
+        }
+
+        /* conj(FFT(reference)) / N, so the inverse FFT comes out scaled */
+        std::vector<gr_complex> ref(reference);
+        waveform_synth::apply_window(ref, config.window);
+        _ref_spectrum.resize(_fft_size);
+        {
+          fft_plan_cache::plan fwd(int(_fft_size), true);
+          std::copy(ref.begin(), ref.end(), fwd.in());
+          std::fill(fwd.in() + ref.size(), fwd.in() + _fft_size, gr_complex(0.0f));
+          fwd.execute();
+          volk_32fc_conjugate_32fc(&_ref_spectrum[0], fwd.out(), _fft_size);
+          volk_32fc_s32f_multiply_32fc(&_ref_spectrum[0], &_ref_spectrum[0],
+                                       1.0f / float(_fft_size), _fft_size);
+        }
+
+        _input.resize(config.num_slots * config.rx_len * _item_size);
+        _output.resize(config.num_slots * config.rx_len);
+        _num_pulses.store(0, boost::memory_order_relaxed);
+        _process_ns.store(0, boost::memory_order_relaxed);
+        if (config.threads) {
+          config.threads->validate(thread_profile::ROLE_PROCESS);
+        }
+        _ring.start(config.num_workers, boost::bind(&matched_filter_impl::worker_loop, this));
+      }
+
+      ~matched_filter_impl()
+      {
+        _ring.stop();
+      }
+
+      void
+      process(const void *in, size_t nsamps, gr_complex *out)
+      {
+        fft_plan_cache::plan fwd(int(_fft_size), true);
+        fft_plan_cache::plan inv(int(_fft_size), false);
+        compress(fwd, inv, in, nsamps, out);
+      }
+
+      void
+      submit(const pulse_framer::pulse_t &pulse)
+      {
+        if (pulse.nsamps > _config.rx_len) {
+          throw std::invalid_argument(str(
+            boost::format("matched_filter: pulse of %d samples is longer than rx_len %d")
+            % pulse.nsamps % _config.rx_len));
+        }
+        const size_t slot = _ring.acquire();
+        std::memcpy(&_input[slot * _config.rx_len * _item_size], pulse.samples,
+                    pulse.nsamps * _item_size);
+        _pulses[slot] = pulse;
+        _ring.commit();
+      }
+
+      bool
+      front(pulse_framer::pulse_t &pulse)
+      {
+        size_t slot;
+        if (not _ring.front(slot)) {
+          return false;
+        }
+        pulse = _pulses[slot];
+        pulse.nsamps = _config.rx_len;
+        pulse.samples = &_output[slot * _config.rx_len];
+        return true;
+      }
+
+      void
+      pop()
+      {
+        if (not _ring.pop()) {
+          throw std::runtime_error("matched_filter: pop() without a compressed pulse");
+        }
+      }
+
+      size_t
+      size()
+      {
+        return _ring.size();
+      }
+
+      size_t
+      get_fft_size() const
+      {
+        return _fft_size;
+      }
+
+      stats_t
+      get_stats()
+      {
+        stats_t stats;
+        stats.pulses = _num_pulses.load(boost::memory_order_relaxed);
+        stats.process_ns = _process_ns.load(boost::memory_order_relaxed);
+        stats.backpressure_waits = _ring.backpressure_waits();
+        stats.max_pending = _ring.max_pending();
+        return stats;
+      }
+
+      config_t
+      get_config()
+      {
+        return _config;
+      }
+
+    private:
+      void
+      compress(fft_plan_cache::plan &fwd, fft_plan_cache::plan &inv,
+               const void *in, size_t nsamps, gr_complex *out)
+      {
+        nsamps = std::min(nsamps, _config.rx_len);
+        gr_complex *x = fwd.in();
+        if (_config.input == INPUT_SC16) {
+          volk_16i_s32f_convert_32f(reinterpret_cast<float *>(x),
+                                    static_cast<const boost::int16_t *>(in),
+                                    _config.scale, 2 * nsamps);
+        } else {
+          std::memcpy(x, in, nsamps * sizeof(gr_complex));
+        }
+        std::fill(x + nsamps, x + _fft_size, gr_complex(0.0f));
+        fwd.execute();
+        volk_32fc_x2_multiply_32fc(inv.in(), fwd.out(), &_ref_spectrum[0], _fft_size);
+        inv.execute();
+        std::memcpy(out, inv.out(), _config.rx_len * sizeof(gr_complex));
+      }
+
+      void
+      worker_loop()
+      {
+        thread_profile::scoped_role role(_config.threads, thread_profile::ROLE_PROCESS, "matched filter worker");
+        fft_plan_cache::plan fwd(int(_fft_size), true);
+        fft_plan_cache::plan inv(int(_fft_size), false);
+        size_t slot;
+        while (_ring.next(slot)) {
+          const boost::chrono::steady_clock::time_point start = boost::chrono::steady_clock::now();
+          compress(fwd, inv, &_input[slot * _config.rx_len * _item_size],
+                   _pulses[slot].nsamps, &_output[slot * _config.rx_len]);
+          count(_process_ns, boost::chrono::duration_cast<boost::chrono::nanoseconds>(
+                  boost::chrono::steady_clock::now() - start).count());
+          count(_num_pulses);
+          _ring.finish(slot);
+        }
+      }
+
+      const config_t _config;
+      const size_t _item_size;
+      size_t _fft_size;
+      std::vector<gr_complex> _ref_spectrum;
+
+      /* Per slot: input samples, pulse metadata, compressed output.
+       * submit() fills the ring's head, pop() releases its tail. */
+      std::vector<char> _input;
+      std::vector<pulse_framer::pulse_t> _pulses;
+      std::vector<gr_complex> _output;
+      worker_ring _ring;
+
+      counter_t _num_pulses;
+      counter_t _process_ns;
+    };
+
+    matched_filter::sptr
+    matched_filter::make(const std::vector<gr_complex> &reference, const config_t &config)
+    {
+      return sptr(new matched_filter_impl(reference, config));
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
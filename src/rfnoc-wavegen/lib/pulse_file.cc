@@ -0,0 +1,135 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <wavegen/pulse_file.h>
+#include <boost/static_assert.hpp>
+#include <algorithm>
+#include <complex>
+#include <cstring>
+#include <stdexcept>
+
+namespace gr {
+  namespace wavegen {
+
+    const char pulse_file::MAGIC[8] = {'W', 'G', 'P', 'U', 'L', 'S', 'E', '\0'};
+    const boost::uint32_t pulse_file::VERSION;
+    const size_t pulse_file::HEADER_SIZE;
+    const boost::uint32_t pulse_file::HEADER_WAVEFORM_KNOWN;
+    const boost::uint32_t pulse_file::HEADER_RANGE_COMPRESSED;
+    const boost::uint32_t pulse_file::PULSE_HAS_TIME;
+    const boost::uint32_t pulse_file::PULSE_TRUNCATED;
+
+    /* The layout is part of the file format; no padding anywhere */
+    BOOST_STATIC_ASSERT(sizeof(pulse_file::header_t) == 120);
+    BOOST_STATIC_ASSERT(sizeof(pulse_file::index_entry_t) == 32);
+    BOOST_STATIC_ASSERT(sizeof(pulse_file::header_t) <= pulse_file::HEADER_SIZE);
+
+    size_t
+    pulse_file::item_size(sample_format_t format)
+    {
+      switch (format) {
+      case FORMAT_SC16: return sizeof(std::complex<short>);
+      case FORMAT_FC32: return sizeof(std::complex<float>);
+      case FORMAT_FC64: return sizeof(std::complex<double>);
+      }
+      throw std::invalid_argument("pulse_file: unknown sample format");
+    }
+
+    pulse_file::sample_format_t
+    pulse_file::parse_format(const std::string &format)
+    {
+      if (format == "sc16") return FORMAT_SC16;
+      if (format == "fc32") return FORMAT_FC32;
+      if (format == "fc64") return FORMAT_FC64;
+      throw std::invalid_argument("pulse_file: unknown sample format " + format);
+    }
+
+    void
+    pulse_file::encode_header(const info_t &info, header_t &header)
+    {
+      std::memset(&header, 0, sizeof(header));
+      std::memcpy(header.magic, MAGIC, sizeof(header.magic));
+      header.version = VERSION;
+      header.header_size = HEADER_SIZE;
+      header.format = info.format;
+      header.item_size = item_size(info.format);
+      header.rate = info.rate;
+      header.data_offset = HEADER_SIZE;
+      header.rx_len = info.rx_len;
+      header.flags = (info.waveform_known ? HEADER_WAVEFORM_KNOWN : 0)
+                     | (info.range_compressed ? HEADER_RANGE_COMPRESSED : 0);
+      header.waveform_id = info.waveform_id;
+      header.waveform_len = info.waveform_len;
+      header.num_adc_samples = info.num_adc_samples;
+      header.ctrl_word = info.ctrl_word;
+      header.policy = info.policy;
+      header.prf_count = info.prf_count;
+      header.chirp_len = info.chirp_len;
+      header.chirp_tuning_coef = info.chirp_tuning_coef;
+      header.chirp_freq_offset = info.chirp_freq_offset;
+      header.integrated_pulses = info.integrated_pulses;
+      header.decimation = info.decimation;
+    }
+
+    pulse_file::info_t
+    pulse_file::decode_header(const header_t &header, bool need_index)
+    {
+      if (std::memcmp(header.magic, MAGIC, sizeof(header.magic))) {
+        throw std::runtime_error("pulse_file: not a pulse file");
+      }
+      /* A big-endian writer's version reads back as a huge number */
+      if (header.version == 0 or header.version > VERSION) {
+        throw std::runtime_error("pulse_file: unsupported version or byte order");
+      }
+      if (need_index and header.index_offset == 0) {
+        throw std::runtime_error("pulse_file: recording was not closed, the file has no index");
+      }
+      if (header.format > FORMAT_FC64
+          or header.item_size != item_size(sample_format_t(header.format))) {
+        throw std::runtime_error("pulse_file: bad sample format");
+      }
+
+      info_t info;
+      info.format = sample_format_t(header.format);
+      info.rate = header.rate;
+      info.rx_len = header.rx_len;
+      info.waveform_known = (header.flags & HEADER_WAVEFORM_KNOWN) != 0;
+      info.range_compressed = (header.flags & HEADER_RANGE_COMPRESSED) != 0;
+      info.waveform_id = header.waveform_id;
+      info.waveform_len = header.waveform_len;
+      info.num_adc_samples = header.num_adc_samples;
+      info.ctrl_word = header.ctrl_word;
+      info.policy = header.policy;
+      info.prf_count = header.prf_count;
+      info.chirp_len = header.chirp_len;
+      info.chirp_tuning_coef = header.chirp_tuning_coef;
+      info.chirp_freq_offset = header.chirp_freq_offset;
+      info.integrated_pulses = std::max<boost::uint32_t>(header.integrated_pulses, 1);
+      info.decimation = std::max<boost::uint32_t>(header.decimation, 1);
+      return info;
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
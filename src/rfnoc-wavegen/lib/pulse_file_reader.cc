@@ -0,0 +1,205 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <wavegen/pulse_file_reader.h>
+#include <boost/format.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace gr {
+  namespace wavegen {
+
+    class pulse_file_reader_impl : public pulse_file_reader
+    {
+    public:
+      pulse_file_reader_impl(const std::string &path):
+        _base(NULL),
+        _size(0),
+        _index(NULL),
+        _num_pulses(0)
+      {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+          throw std::runtime_error(str(
+            boost::format("pulse_file_reader: cannot open %s: %s") % path % std::strerror(errno)));
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0 or size_t(st.st_size) < pulse_file::HEADER_SIZE) {
+          ::close(fd);
+          throw std::runtime_error("pulse_file_reader: " + path + " is too short for a pulse file");
+        }
+        _size = size_t(st.st_size);
+        void *base = ::mmap(NULL, _size, PROT_READ, MAP_SHARED, fd, 0);
+        /* The mapping keeps the file open */
+        ::close(fd);
+        if (base == MAP_FAILED) {
+          throw std::runtime_error(str(
+            boost::format("pulse_file_reader: cannot map %s: %s") % path % std::strerror(errno)));
+        }
+        _base = static_cast<const char *>(base);
+
+        try {
+          const pulse_file::header_t *header =
+            reinterpret_cast<const pulse_file::header_t *>(_base);
+          _info = pulse_file::decode_header(*header);
+          _item_size = header->item_size;
+          _data_offset = header->data_offset;
+          _index_offset = header->index_offset;
+          _num_pulses = header->num_pulses;
+
+          const boost::uint64_t index_bytes =
+            _num_pulses * sizeof(pulse_file::index_entry_t);
+          if (_data_offset < sizeof(pulse_file::header_t)
+              or _index_offset < _data_offset
+              or _index_offset % sizeof(boost::uint64_t)
+              or _num_pulses > _size / sizeof(pulse_file::index_entry_t)
+              or _index_offset + index_bytes > _size) {
+            throw std::runtime_error("pulse_file_reader: " + path + " has a bad index");
+          }
+          _index = reinterpret_cast<const pulse_file::index_entry_t *>(_base + _index_offset);
+        }
+        catch (...) {
+          ::munmap(const_cast<char *>(_base), _size);
+          throw;
+        }
+      }
+
+      ~pulse_file_reader_impl()
+      {
+        ::munmap(const_cast<char *>(_base), _size);
+      }
+
+      const pulse_file::info_t &
+      get_info() const
+      {
+        return _info;
+      }
+
+      size_t
+      get_item_size() const
+      {
+        return _item_size;
+      }
+
+      boost::uint64_t
+      num_pulses() const
+      {
+        return _num_pulses;
+      }
+
+      const pulse_file::index_entry_t &
+      entry(boost::uint64_t n) const
+      {
+        if (n >= _num_pulses) {
+          throw std::out_of_range(str(
+            boost::format("pulse_file_reader: pulse %d of %d") % n % _num_pulses));
+        }
+        return _index[n];
+      }
+
+      pulse_framer::pulse_t
+      pulse(boost::uint64_t n) const
+      {
+        const pulse_file::index_entry_t &e = entry(n);
+        if (e.offset < _data_offset
+            or e.offset + boost::uint64_t(e.nsamps) * _item_size > _index_offset) {
+          throw std::runtime_error(str(
+            boost::format("pulse_file_reader: pulse %d lies outside the sample data") % n));
+        }
+
+        pulse_framer::pulse_t p;
+        p.index = e.index;
+        p.has_time = (e.flags & pulse_file::PULSE_HAS_TIME) != 0;
+        if (p.has_time) {
+          p.time = uhd::time_spec_t::from_ticks(e.ticks, _info.rate);
+        }
+        p.nsamps = e.nsamps;
+        p.truncated = (e.flags & pulse_file::PULSE_TRUNCATED) != 0;
+        p.samples = _base + e.offset;
+        return p;
+      }
+
+      boost::uint64_t
+      find(const uhd::time_spec_t &time) const
+      {
+        const boost::int64_t ticks = time.to_ticks(_info.rate);
+        boost::uint64_t lo = 0, hi = _num_pulses;
+        while (lo < hi) {
+          const boost::uint64_t mid = lo + (hi - lo) / 2;
+          const boost::int64_t t =
+            (_index[mid].flags & pulse_file::PULSE_HAS_TIME) ? _index[mid].ticks : 0;
+          if (t < ticks) {
+            lo = mid + 1;
+          } else {
+            hi = mid;
+          }
+        }
+        return lo;
+      }
+
+      void
+      prefetch(boost::uint64_t first, boost::uint64_t count) const
+      {
+        if (count == 0 or first >= _num_pulses) {
+          return;
+        }
+        const boost::uint64_t last = std::min(first + count, _num_pulses) - 1;
+        const boost::uint64_t begin = _index[first].offset;
+        const boost::uint64_t end =
+          _index[last].offset + boost::uint64_t(_index[last].nsamps) * _item_size;
+        if (end <= begin or end > _index_offset) {
+          return;
+        }
+        const boost::uint64_t page = boost::uint64_t(::sysconf(_SC_PAGESIZE));
+        const boost::uint64_t aligned = begin - begin % page;
+        /* Only a hint; failure just means no read-ahead */
+        ::madvise(const_cast<char *>(_base) + aligned, size_t(end - aligned), MADV_WILLNEED);
+      }
+
+    private:
+      const char *_base;
+      size_t _size;
+      pulse_file::info_t _info;
+      size_t _item_size;
+      boost::uint64_t _data_offset;
+      boost::uint64_t _index_offset;
+      const pulse_file::index_entry_t *_index;
+      boost::uint64_t _num_pulses;
+    };
+
+    pulse_file_reader::sptr
+    pulse_file_reader::make(const std::string &path)
+    {
+      return sptr(new pulse_file_reader_impl(path));
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
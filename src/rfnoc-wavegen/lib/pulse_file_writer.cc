@@ -0,0 +1,271 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <wavegen/pulse_file_writer.h>
+#include <boost/format.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace gr {
+  namespace wavegen {
+
+    /* Index entries held in memory before they go to the spill file */
+    static const size_t INDEX_CHUNK = 32768;
+
+    static void
+    pwrite_all(int fd, const void *data, size_t nbytes, boost::uint64_t offset)
+    {
+      const char *p = static_cast<const char *>(data);
+      while (nbytes > 0) {
+        const ssize_t ret = ::pwrite(fd, p, nbytes, off_t(offset));
+        if (ret < 0 and errno == EINTR) {
+          continue;
+        }
+        if (ret <= 0) {
+          throw std::runtime_error(str(
+            boost::format("pulse_file_writer: write failed: %s") % std::strerror(errno)));
+        }
+        p += ret;
+        nbytes -= size_t(ret);
+        offset += boost::uint64_t(ret);
+      }
+    }
+
+    class pulse_file_writer_impl : public pulse_file_writer
+    {
+    public:
+      pulse_file_writer_impl(const std::string &path, const pulse_file::info_t &info,
+                             const sample_recorder::config_t &config):
+        _path(path),
+        _info(info),
+        _item_size(pulse_file::item_size(info.format)),
+        _spill(NULL),
+        _have_buff(false),
+        _fill(0),
+        _offset(pulse_file::HEADER_SIZE),
+        _closed(false)
+      {
+        if (not (info.rate > 0.0)) {
+          throw std::invalid_argument("pulse_file_writer: the sample rate must be positive");
+        }
+        _recorder = sample_recorder::make(path, config);
+        _spill = std::tmpfile();
+        if (_spill == NULL) {
+          throw std::runtime_error("pulse_file_writer: cannot create the index spill file");
+        }
+        _index.reserve(INDEX_CHUNK);
+
+        /* Samples start after the header. Its space is written as zeros
+         * now and filled in by close(). Buffer sizes are multiples of
+         * sample_recorder::ALIGNMENT, so the first buffer has room. */
+        if (not _recorder->acquire(_buff)) {
+          std::fclose(_spill);
+          throw std::runtime_error("pulse_file_writer: no recorder buffer for the header");
+        }
+        _have_buff = true;
+        std::memset(_buff.data, 0, pulse_file::HEADER_SIZE);
+        _fill = pulse_file::HEADER_SIZE;
+      }
+
+      ~pulse_file_writer_impl()
+      {
+        try {
+          close();
+        }
+        catch (const std::exception &) {
+          /* Reported by an explicit close() */
+        }
+        if (_spill != NULL) {
+          std::fclose(_spill);
+        }
+      }
+
+      void
+      write(const pulse_framer::pulse_t &pulse)
+      {
+        if (_closed) {
+          throw std::runtime_error("pulse_file_writer: write() after close()");
+        }
+
+        const char *src = static_cast<const char *>(pulse.samples);
+        const size_t nbytes = pulse.nsamps * _item_size;
+        size_t done = 0;
+        while (done < nbytes) {
+          if (not _have_buff) {
+            if (not _recorder->acquire(_buff)) {
+              _recorder->drop(nbytes - done);
+              break;
+            }
+            _have_buff = true;
+            _fill = 0;
+          }
+          const size_t n = std::min(nbytes - done, _buff.size - _fill);
+          std::memcpy(_buff.data + _fill, src + done, n);
+          _fill += n;
+          done += n;
+          if (_fill == _buff.size) {
+            _recorder->commit(_buff, _fill);
+            _have_buff = false;
+          }
+        }
+        if (done == 0 and nbytes > 0) {
+          _stats.dropped++;
+          return;
+        }
+
+        /* Buffers hold a whole number of samples, so a pulse the
+         * recorder cut short still ends on a sample boundary */
+        pulse_file::index_entry_t entry;
+        entry.offset = _offset;
+        entry.index = pulse.index;
+        entry.ticks = pulse.has_time ? pulse.time.to_ticks(_info.rate) : 0;
+        entry.nsamps = boost::uint32_t(done / _item_size);
+        entry.flags = 0;
+        if (pulse.has_time) {
+          entry.flags |= pulse_file::PULSE_HAS_TIME;
+        }
+        if (pulse.truncated or done < nbytes) {
+          entry.flags |= pulse_file::PULSE_TRUNCATED;
+          _stats.truncated++;
+        }
+        _index.push_back(entry);
+        if (_index.size() == INDEX_CHUNK) {
+          spill();
+        }
+
+        _offset += done;
+        _stats.pulses++;
+        _stats.bytes += done;
+      }
+
+      void
+      close()
+      {
+        if (_closed) {
+          return;
+        }
+        _closed = true;
+
+        if (_have_buff) {
+          _recorder->commit(_buff, _fill);
+          _have_buff = false;
+        }
+        _recorder->close();
+        spill();
+        if (std::fflush(_spill) != 0) {
+          throw std::runtime_error("pulse_file_writer: cannot flush the index spill file");
+        }
+
+        const int fd = ::open(_path.c_str(), O_WRONLY);
+        if (fd < 0) {
+          throw std::runtime_error(str(
+            boost::format("pulse_file_writer: cannot reopen %s: %s") % _path % std::strerror(errno)));
+        }
+        try {
+          /* The index follows the last sample */
+          std::rewind(_spill);
+          std::vector<char> chunk(INDEX_CHUNK * sizeof(pulse_file::index_entry_t));
+          boost::uint64_t offset = _offset;
+          size_t n;
+          while ((n = std::fread(&chunk[0], 1, chunk.size(), _spill)) > 0) {
+            pwrite_all(fd, &chunk[0], n, offset);
+            offset += n;
+          }
+          if (std::ferror(_spill)) {
+            throw std::runtime_error("pulse_file_writer: cannot read the index spill file");
+          }
+
+          pulse_file::header_t header;
+          pulse_file::encode_header(_info, header);
+          header.num_pulses = _stats.pulses;
+          header.index_offset = _offset;
+          pwrite_all(fd, &header, sizeof(header), 0);
+        }
+        catch (...) {
+          ::close(fd);
+          throw;
+        }
+        if (::close(fd) != 0) {
+          throw std::runtime_error(str(
+            boost::format("pulse_file_writer: closing %s failed: %s") % _path % std::strerror(errno)));
+        }
+      }
+
+      stats_t
+      get_stats()
+      {
+        return _stats;
+      }
+
+      sample_recorder::stats_t
+      get_recorder_stats()
+      {
+        return _recorder->get_stats();
+      }
+
+    private:
+      void
+      spill()
+      {
+        if (_index.empty()) {
+          return;
+        }
+        if (std::fwrite(&_index[0], sizeof(_index[0]), _index.size(), _spill) != _index.size()) {
+          throw std::runtime_error("pulse_file_writer: cannot write the index spill file");
+        }
+        _index.clear();
+      }
+
+      const std::string _path;
+      const pulse_file::info_t _info;
+      const size_t _item_size;
+      sample_recorder::sptr _recorder;
+      std::FILE *_spill;
+      std::vector<pulse_file::index_entry_t> _index;
+
+      sample_recorder::buffer_t _buff;
+      bool _have_buff;
+      size_t _fill;
+      //! File offset the next sample byte lands at
+      boost::uint64_t _offset;
+      bool _closed;
+      stats_t _stats;
+    };
+
+    pulse_file_writer::sptr
+    pulse_file_writer::make(const std::string &path, const pulse_file::info_t &info,
+                            const sample_recorder::config_t &config)
+    {
+      return sptr(new pulse_file_writer_impl(path, info, config));
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
@@ -0,0 +1,274 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <wavegen/pulse_framer.h>
+#include <boost/atomic.hpp>
+#include <boost/scoped_array.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace gr {
+  namespace wavegen {
+
+    /* Slots start on a cache line so SIMD consumers get aligned data */
+    static const size_t SLOT_ALIGNMENT = 64;
+
+    class pulse_framer_impl : public pulse_framer
+    {
+    public:
+      pulse_framer_impl(const config_t &config):
+        _config(config),
+        _memory(NULL),
+        _slots(new slot_t[config.num_slots + 1]),
+        _head(0),
+        _tail(0),
+        _index(0),
+        _fill(0),
+        _started(false),
+        _dropping(false)
+      {
+        if (config.rx_len == 0 or config.item_size == 0 or config.num_slots == 0) {
+          throw std::invalid_argument("pulse_framer: rx_len, item_size and num_slots must be non-zero");
+        }
+        _slot_bytes = (config.rx_len * config.item_size + SLOT_ALIGNMENT - 1)
+          / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+
+        /* One slot more than the ring holds: the scratch slot drops go to */
+        void *memory = NULL;
+        if (posix_memalign(&memory, SLOT_ALIGNMENT, (config.num_slots + 1) * _slot_bytes)) {
+          throw std::runtime_error("pulse_framer: cannot allocate the pulse ring");
+        }
+        _memory = static_cast<char *>(memory);
+        for (size_t i = 0; i <= config.num_slots; i++) {
+          _slots[i].samples = _memory + i * _slot_bytes;
+        }
+        _stats_pulses.store(0);
+        _stats_truncated.store(0);
+        _stats_dropped.store(0);
+        _stats_discontinuities.store(0);
+      }
+
+      ~pulse_framer_impl()
+      {
+        std::free(_memory);
+      }
+
+      void *
+      recv_buffer(size_t &max_samps)
+      {
+        if (not _started) {
+          start_pulse();
+        }
+        max_samps = _config.rx_len - _fill;
+        return current().samples + _fill * _config.item_size;
+      }
+
+      void
+      push(size_t nsamps, const uhd::rx_metadata_t &md)
+      {
+        if (md.error_code != uhd::rx_metadata_t::ERROR_CODE_NONE) {
+          /* Whatever follows does not continue this pulse */
+          if (_fill > 0) {
+            publish(true);
+          }
+          return;
+        }
+        if (nsamps == 0) {
+          return;
+        }
+        if (not _started or _fill + nsamps > _config.rx_len) {
+          throw std::invalid_argument("pulse_framer: push() of more than recv_buffer() offered");
+        }
+
+        /* A packet that does not follow on ends the pulse before it */
+        if (_fill > 0 and (md.start_of_burst or not follows_on(md))) {
+          if (not md.start_of_burst) {
+            _stats_discontinuities.fetch_add(1, boost::memory_order_relaxed);
+          }
+          const char *received = current().samples + _fill * _config.item_size;
+          publish(true);
+          start_pulse();
+          std::memmove(current().samples, received, nsamps * _config.item_size);
+        }
+
+        slot_t &slot = current();
+        if (_fill == 0) {
+          slot.has_time = md.has_time_spec;
+          slot.time = md.time_spec;
+        }
+        _fill += nsamps;
+        if (_fill == _config.rx_len) {
+          publish(false);
+        } else if (md.end_of_burst) {
+          publish(true);
+        }
+      }
+
+      void
+      flush()
+      {
+        if (_fill > 0) {
+          publish(true);
+        }
+      }
+
+      bool
+      front(pulse_t &pulse)
+      {
+        const size_t tail = _tail.load(boost::memory_order_relaxed);
+        if (tail == _head.load(boost::memory_order_acquire)) {
+          return false;
+        }
+        const slot_t &slot = _slots[tail % _config.num_slots];
+        pulse.index = slot.index;
+        pulse.has_time = slot.has_time;
+        pulse.time = slot.time;
+        pulse.nsamps = slot.nsamps;
+        pulse.truncated = slot.truncated;
+        pulse.samples = slot.samples;
+        return true;
+      }
+
+      void
+      pop()
+      {
+        const size_t tail = _tail.load(boost::memory_order_relaxed);
+        if (tail == _head.load(boost::memory_order_acquire)) {
+          throw std::runtime_error("pulse_framer: pop() with no pulse");
+        }
+        _tail.store(tail + 1, boost::memory_order_release);
+      }
+
+      size_t
+      size()
+      {
+        return _head.load(boost::memory_order_acquire) - _tail.load(boost::memory_order_acquire);
+      }
+
+      stats_t
+      get_stats()
+      {
+        stats_t stats;
+        stats.pulses = _stats_pulses.load(boost::memory_order_relaxed);
+        stats.truncated = _stats_truncated.load(boost::memory_order_relaxed);
+        stats.dropped = _stats_dropped.load(boost::memory_order_relaxed);
+        stats.discontinuities = _stats_discontinuities.load(boost::memory_order_relaxed);
+        return stats;
+      }
+
+      config_t
+      get_config()
+      {
+        return _config;
+      }
+
+    private:
+      struct slot_t {
+        char *samples;
+        boost::uint64_t index;
+        bool has_time;
+        uhd::time_spec_t time;
+        size_t nsamps;
+        bool truncated;
+      };
+
+      slot_t &
+      current()
+      {
+        return _dropping ? _slots[_config.num_slots]
+          : _slots[_head.load(boost::memory_order_relaxed) % _config.num_slots];
+      }
+
+      /* Claim the next slot, or the scratch slot if the ring is full */
+      void
+      start_pulse()
+      {
+        const size_t head = _head.load(boost::memory_order_relaxed);
+        _dropping = (head - _tail.load(boost::memory_order_acquire)) >= _config.num_slots;
+        current().index = _index++;
+        current().has_time = false;
+        _started = true;
+      }
+
+      bool
+      follows_on(const uhd::rx_metadata_t &md)
+      {
+        const slot_t &slot = current();
+        if (_config.rate <= 0 or not md.has_time_spec or not slot.has_time) {
+          return true;
+        }
+        return md.time_spec.to_ticks(_config.rate)
+          == slot.time.to_ticks(_config.rate) + (long long)(_fill);
+      }
+
+      void
+      publish(bool truncated)
+      {
+        slot_t &slot = current();
+        slot.nsamps = _fill;
+        slot.truncated = truncated;
+        _fill = 0;
+        _started = false;
+        if (_dropping) {
+          _stats_dropped.fetch_add(1, boost::memory_order_relaxed);
+          return;
+        }
+        _stats_pulses.fetch_add(1, boost::memory_order_relaxed);
+        if (truncated) {
+          _stats_truncated.fetch_add(1, boost::memory_order_relaxed);
+        }
+        _head.store(_head.load(boost::memory_order_relaxed) + 1, boost::memory_order_release);
+      }
+
+      const config_t _config;
+      size_t _slot_bytes;
+      char *_memory;
+      boost::scoped_array<slot_t> _slots;
+
+      /* Published pulses are [_tail, _head); written by one side each */
+      boost::atomic<size_t> _head;
+      boost::atomic<size_t> _tail;
+
+      /* Receive side state */
+      boost::uint64_t _index;
+      size_t _fill;
+      bool _started;
+      bool _dropping;
+
+      boost::atomic<boost::uint64_t> _stats_pulses;
+      boost::atomic<boost::uint64_t> _stats_truncated;
+      boost::atomic<boost::uint64_t> _stats_dropped;
+      boost::atomic<boost::uint64_t> _stats_discontinuities;
+    };
+
+    pulse_framer::sptr
+    pulse_framer::make(const config_t &config)
+    {
+      return sptr(new pulse_framer_impl(config));
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
@@ -0,0 +1,289 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <wavegen/pulse_integrator.h>
+#include "worker_ring.h"
+#include <volk/volk.h>
+#include <boost/atomic.hpp>
+#include <boost/chrono.hpp>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace gr {
+  namespace wavegen {
+
+    /* Sum each run of decimation complex samples into one */
+    static void
+    decimate_into(const float *in, size_t out_len, size_t decimation, float *out)
+    {
+      for (size_t j = 0; j < out_len; j++) {
+        const float *x = in + 2 * j * decimation;
+        float re = 0.0f, im = 0.0f;
+        for (size_t k = 0; k < decimation; k++) {
+          re += x[2 * k];
+          im += x[2 * k + 1];
+        }
+        out[2 * j] = re;
+        out[2 * j + 1] = im;
+      }
+    }
+
+    class pulse_integrator_impl : public pulse_integrator
+    {
+    public:
+      pulse_integrator_impl(const config_t &config):
+        _config(config),
+        _out_len(0),
+        _in_item(config.input == INPUT_SC16 ? 4 : 8),
+        _out_item(config.output == OUTPUT_SC16 ? 4 : 8),
+        _have(false),
+        _group(0),
+        _next_group(0),
+        _count(0),
+        _first_index(0),
+        _has_time(false)
+      {
+        if (config.rx_len == 0 or config.num_pulses == 0 or config.decimation == 0) {
+          throw std::invalid_argument("pulse_integrator: rx_len, num_pulses and decimation must be non-zero");
+        }
+        if (config.rx_len % config.decimation) {
+          throw std::invalid_argument("pulse_integrator: decimation must divide rx_len");
+        }
+        if (config.output == OUTPUT_SC16 and config.input != INPUT_SC16) {
+          throw std::invalid_argument("pulse_integrator: sc16 output needs sc16 input");
+        }
+        if (not (config.scale > 0.0f)) {
+          throw std::invalid_argument("pulse_integrator: scale must be positive");
+        }
+        _out_len = config.rx_len / config.decimation;
+
+        _in.resize(2 * config.rx_len);
+        if (config.decimation > 1) {
+          _dec.resize(2 * _out_len);
+        }
+        _acc.resize(2 * _out_len);
+        _out.resize(2 * _out_len);
+        if (config.output == OUTPUT_SC16) {
+          _out16.resize(2 * _out_len);
+        }
+
+        _pulses.store(0, boost::memory_order_relaxed);
+        _records.store(0, boost::memory_order_relaxed);
+        _missing.store(0, boost::memory_order_relaxed);
+        _late.store(0, boost::memory_order_relaxed);
+        _bytes_in.store(0, boost::memory_order_relaxed);
+        _bytes_out.store(0, boost::memory_order_relaxed);
+        _process_ns.store(0, boost::memory_order_relaxed);
+      }
+
+      size_t
+      get_output_len() const
+      {
+        return _out_len;
+      }
+
+      bool
+      add(const pulse_framer::pulse_t &pulse, pulse_framer::pulse_t &record)
+      {
+        const boost::uint64_t group = pulse.index / _config.num_pulses;
+        if (group < (_have ? _group : _next_group)) {
+          count(_late);
+          return false;
+        }
+
+        const boost::chrono::steady_clock::time_point start = boost::chrono::steady_clock::now();
+        bool done = false;
+        if (_have and group > _group) {
+          finish(record);
+          done = true;
+        }
+        if (not _have) {
+          count(_missing, (group - _next_group) * _config.num_pulses);
+          _have = true;
+          _group = group;
+          _count = 0;
+          _has_time = false;
+        }
+        accumulate(pulse);
+        if (_count == _config.num_pulses) {
+          finish(record);
+          done = true;
+        }
+        count(_process_ns, boost::chrono::duration_cast<boost::chrono::nanoseconds>(
+                boost::chrono::steady_clock::now() - start).count());
+        return done;
+      }
+
+      bool
+      flush(pulse_framer::pulse_t &record)
+      {
+        if (not _have) {
+          return false;
+        }
+        finish(record);
+        return true;
+      }
+
+      stats_t
+      get_stats()
+      {
+        stats_t stats;
+        stats.pulses = _pulses.load(boost::memory_order_relaxed);
+        stats.records = _records.load(boost::memory_order_relaxed);
+        stats.missing_pulses = _missing.load(boost::memory_order_relaxed);
+        stats.late_pulses = _late.load(boost::memory_order_relaxed);
+        stats.bytes_in = _bytes_in.load(boost::memory_order_relaxed);
+        stats.bytes_out = _bytes_out.load(boost::memory_order_relaxed);
+        stats.process_ns = _process_ns.load(boost::memory_order_relaxed);
+        return stats;
+      }
+
+      config_t
+      get_config()
+      {
+        return _config;
+      }
+
+    private:
+      void
+      accumulate(const pulse_framer::pulse_t &pulse)
+      {
+        const size_t nsamps = std::min(pulse.nsamps, _config.rx_len);
+        const float *x = &_in[0];
+        if (_config.input == INPUT_SC16) {
+          /* Raw counts for sc16 output, scaled only at the end */
+          const float scale = (_config.output == OUTPUT_SC16) ? 1.0f : _config.scale;
+          volk_16i_s32f_convert_32f(&_in[0], static_cast<const boost::int16_t *>(pulse.samples),
+                                    scale, 2 * nsamps);
+        } else if (nsamps < _config.rx_len) {
+          std::memcpy(&_in[0], pulse.samples, nsamps * sizeof(gr_complex));
+        } else {
+          x = static_cast<const float *>(pulse.samples);
+        }
+        if (nsamps < _config.rx_len) {
+          std::fill(_in.begin() + 2 * nsamps, _in.end(), 0.0f);
+        }
+
+        if (_config.decimation > 1) {
+          decimate_into(x, _out_len, _config.decimation, &_dec[0]);
+          x = &_dec[0];
+        }
+        if (_count == 0) {
+          std::memcpy(&_acc[0], x, _acc.size() * sizeof(float));
+        } else {
+          volk_32f_x2_add_32f(&_acc[0], &_acc[0], x, _acc.size());
+        }
+
+        if (pulse.has_time and (not _has_time or pulse.index < _first_index)) {
+          _has_time = true;
+          _time = pulse.time;
+          _first_index = pulse.index;
+        }
+        _count++;
+        count(_pulses);
+        count(_bytes_in, pulse.nsamps * _in_item);
+      }
+
+      void
+      finish(pulse_framer::pulse_t &record)
+      {
+        /* The sum becomes the output; the old output buffer is the
+         * next accumulator, overwritten by its first pulse */
+        _acc.swap(_out);
+        const float mean = 1.0f / float(_count * _config.decimation);
+        if (_config.output == OUTPUT_SC16) {
+          volk_32f_s32f_convert_16i(&_out16[0], &_out[0], mean, _out16.size());
+        } else if (_config.average and _count * _config.decimation > 1) {
+          volk_32f_s32f_multiply_32f(&_out[0], &_out[0], mean, _out.size());
+        }
+
+        record.index = _group;
+        record.has_time = _has_time;
+        record.time = _time;
+        record.nsamps = _out_len;
+        record.truncated = (_count < _config.num_pulses);
+        record.samples = (_config.output == OUTPUT_SC16) ?
+          static_cast<const void *>(&_out16[0]) : static_cast<const void *>(&_out[0]);
+
+        count(_missing, _config.num_pulses - _count);
+        count(_records);
+        count(_bytes_out, _out_len * _out_item);
+        _have = false;
+        _next_group = _group + 1;
+      }
+
+      config_t _config;
+      size_t _out_len;
+      const size_t _in_item;
+      const size_t _out_item;
+
+      /* Converted pulse, its decimation, the running sum and the
+       * finished record */
+      std::vector<float> _in;
+      std::vector<float> _dec;
+      std::vector<float> _acc;
+      std::vector<float> _out;
+      std::vector<boost::int16_t> _out16;
+
+      /* The record being summed */
+      bool _have;
+      boost::uint64_t _group;
+      boost::uint64_t _next_group;
+      size_t _count;
+      boost::uint64_t _first_index;
+      bool _has_time;
+      uhd::time_spec_t _time;
+
+      counter_t _pulses;
+      counter_t _records;
+      counter_t _missing;
+      counter_t _late;
+      counter_t _bytes_in;
+      counter_t _bytes_out;
+      counter_t _process_ns;
+    };
+
+    pulse_integrator::sptr
+    pulse_integrator::make(const config_t &config)
+    {
+      return sptr(new pulse_integrator_impl(config));
+    }
+
+    std::vector<gr_complex>
+    pulse_integrator::decimate(const std::vector<gr_complex> &reference, size_t decimation)
+    {
+      if (decimation == 0) {
+        throw std::invalid_argument("pulse_integrator: decimation must be non-zero");
+      }
+      std::vector<gr_complex> out((reference.size() + decimation - 1) / decimation);
+      for (size_t i = 0; i < reference.size(); i++) {
+        out[i / decimation] += reference[i];
+      }
+      return out;
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
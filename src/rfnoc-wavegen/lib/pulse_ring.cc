@@ -0,0 +1,73 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <wavegen/pulse_ring.h>
+#include <boost/static_assert.hpp>
+#include <cerrno>
+#include <signal.h>
+
+namespace gr {
+  namespace wavegen {
+
+    const char pulse_ring::MAGIC[8] = {'W', 'G', 'R', 'I', 'N', 'G', '\0', '\0'};
+    const boost::uint32_t pulse_ring::VERSION;
+    const size_t pulse_ring::CACHE_LINE;
+    const size_t pulse_ring::PRODUCER_OFFSET;
+    const size_t pulse_ring::CONSUMERS_OFFSET;
+    const size_t pulse_ring::SLOT_HEADER_SIZE;
+
+    /* Cursors shared between processes must not fall back to a lock,
+     * which would live in one process only */
+#if BOOST_ATOMIC_LLONG_LOCK_FREE != 2 || BOOST_ATOMIC_INT_LOCK_FREE != 2
+#error "pulse_ring needs lock-free 32 and 64-bit atomics"
+#endif
+    BOOST_STATIC_ASSERT(sizeof(boost::atomic<boost::uint64_t>) == 8);
+    BOOST_STATIC_ASSERT(sizeof(pulse_ring::control_t) <= pulse_ring::PRODUCER_OFFSET);
+    BOOST_STATIC_ASSERT(sizeof(pulse_ring::producer_t) <= pulse_ring::CACHE_LINE);
+    BOOST_STATIC_ASSERT(pulse_ring::PRODUCER_OFFSET + pulse_ring::CACHE_LINE <= pulse_ring::CONSUMERS_OFFSET);
+    BOOST_STATIC_ASSERT(sizeof(pulse_ring::consumer_t) <= pulse_ring::CACHE_LINE);
+    BOOST_STATIC_ASSERT(sizeof(pulse_ring::slot_t) <= pulse_ring::SLOT_HEADER_SIZE);
+
+    bool
+    pulse_ring::process_alive(boost::uint32_t pid)
+    {
+      /* EPERM means it exists but belongs to someone else */
+      return pid != 0 and (::kill(pid_t(pid), 0) == 0 or errno == EPERM);
+    }
+
+    bool
+    pulse_ring::reap_consumer(consumer_t &consumer)
+    {
+      if (consumer.state.load(boost::memory_order_acquire) != CONSUMER_ACTIVE
+          or process_alive(consumer.pid)) {
+        return false;
+      }
+      boost::uint32_t active = CONSUMER_ACTIVE;
+      return consumer.state.compare_exchange_strong(active, CONSUMER_FREE,
+                                                    boost::memory_order_acq_rel);
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
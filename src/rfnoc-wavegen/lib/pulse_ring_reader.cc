@@ -0,0 +1,317 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <wavegen/pulse_ring_reader.h>
+#include <boost/atomic.hpp>
+#include <boost/format.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace gr {
+  namespace wavegen {
+
+    static void
+    count(boost::atomic<boost::uint64_t> &c, boost::uint64_t n = 1)
+    {
+      /* Only this reader writes its entry, so no read-modify-write */
+      c.store(c.load(boost::memory_order_relaxed) + n, boost::memory_order_relaxed);
+    }
+
+    class pulse_ring_reader_impl : public pulse_ring_reader
+    {
+    public:
+      pulse_ring_reader_impl(const std::string &name, bool oldest):
+        _control(NULL),
+        _slots(NULL),
+        _consumer(NULL),
+        _next(0),
+        _held(false),
+        _torn(0)
+      {
+        const int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0) {
+          throw std::runtime_error(str(
+            boost::format("pulse_ring_reader: cannot open %s: %s") % name % std::strerror(errno)));
+        }
+        pulse_ring::control_t control;
+        struct stat st;
+        if (::fstat(fd, &st) != 0
+            or ::pread(fd, &control, sizeof(control), 0) != ssize_t(sizeof(control))
+            or std::memcmp(control.magic, pulse_ring::MAGIC, sizeof(control.magic))) {
+          ::close(fd);
+          throw std::runtime_error("pulse_ring_reader: " + name + " is not a pulse ring");
+        }
+        if (control.version == 0 or control.version > pulse_ring::VERSION
+            or control.num_slots == 0 or (control.num_slots & (control.num_slots - 1))
+            or control.slots_offset < pulse_ring::CONSUMERS_OFFSET
+                                      + control.max_consumers * pulse_ring::CACHE_LINE
+            or control.slots_offset % ::sysconf(_SC_PAGESIZE)
+            or control.segment_size != control.slots_offset
+                                       + boost::uint64_t(control.num_slots) * control.slot_size
+            or boost::uint64_t(st.st_size) < control.segment_size) {
+          ::close(fd);
+          throw std::runtime_error("pulse_ring_reader: " + name + " has an unsupported or bad layout");
+        }
+
+        /* Cursors read-write, samples read-only */
+        _control_size = control.slots_offset;
+        _slots_size = control.segment_size - control.slots_offset;
+        void *base = ::mmap(NULL, _control_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        void *slots = (base == MAP_FAILED) ? MAP_FAILED :
+          ::mmap(NULL, _slots_size, PROT_READ, MAP_SHARED, fd, off_t(control.slots_offset));
+        const int err = errno;
+        /* The mappings keep the segment open */
+        ::close(fd);
+        if (slots == MAP_FAILED) {
+          if (base != MAP_FAILED) {
+            ::munmap(base, _control_size);
+          }
+          throw std::runtime_error(str(
+            boost::format("pulse_ring_reader: cannot map %s: %s") % name % std::strerror(err)));
+        }
+        _control = static_cast<char *>(base);
+        _slots = static_cast<const char *>(slots);
+
+        try {
+          _info = pulse_file::decode_header(control.stream, false);
+          if (control.stream.item_size * boost::uint64_t(_info.rx_len) + pulse_ring::SLOT_HEADER_SIZE
+              > control.slot_size) {
+            throw std::runtime_error("pulse_ring_reader: " + name + " has slots too small for its pulses");
+          }
+          _item_size = control.stream.item_size;
+          _num_slots = control.num_slots;
+          _slot_size = control.slot_size;
+          _writer_pid = control.writer_pid;
+          _producer = reinterpret_cast<const pulse_ring::producer_t *>(_control + pulse_ring::PRODUCER_OFFSET);
+          attach(control.max_consumers, oldest);
+        }
+        catch (...) {
+          ::munmap(const_cast<char *>(_slots), _slots_size);
+          ::munmap(_control, _control_size);
+          throw;
+        }
+      }
+
+      ~pulse_ring_reader_impl()
+      {
+        _consumer->state.store(pulse_ring::CONSUMER_FREE, boost::memory_order_release);
+        ::munmap(const_cast<char *>(_slots), _slots_size);
+        ::munmap(_control, _control_size);
+      }
+
+      const pulse_file::info_t &
+      get_info() const
+      {
+        return _info;
+      }
+
+      size_t
+      get_item_size() const
+      {
+        return _item_size;
+      }
+
+      size_t
+      get_num_slots() const
+      {
+        return _num_slots;
+      }
+
+      bool
+      front(pulse_framer::pulse_t &pulse)
+      {
+        for (;;) {
+          const boost::uint64_t w = _producer->write_seq.load(boost::memory_order_acquire);
+          if (_next >= w) {
+            return false;
+          }
+          if (w - _next > _num_slots) {
+            /* Lapped: everything before the oldest record is gone */
+            skip(w - _num_slots - _next);
+          }
+
+          const pulse_ring::slot_t *s = slot(_next);
+          const boost::uint64_t seq = s->seq.load(boost::memory_order_acquire);
+          if (seq == 2 * _next + 2) {
+            pulse.index = s->index;
+            pulse.has_time = (s->flags & pulse_file::PULSE_HAS_TIME) != 0;
+            pulse.time = pulse.has_time ?
+              uhd::time_spec_t::from_ticks(s->ticks, _info.rate) : uhd::time_spec_t();
+            pulse.nsamps = std::min<size_t>(s->nsamps, _info.rx_len);
+            pulse.truncated = (s->flags & pulse_file::PULSE_TRUNCATED) != 0;
+            pulse.samples = reinterpret_cast<const char *>(s) + pulse_ring::SLOT_HEADER_SIZE;
+
+            /* Re-check after the copy: if the writer started on the
+             * slot meanwhile, the fields above may be torn */
+            boost::atomic_thread_fence(boost::memory_order_acquire);
+            if (s->seq.load(boost::memory_order_relaxed) == seq) {
+              _held = true;
+              return true;
+            }
+          }
+          /* Overwritten since write_seq was read */
+          skip(1);
+        }
+      }
+
+      bool
+      pop()
+      {
+        if (not _held) {
+          return false;
+        }
+        /* Whatever was read from the samples happened before this */
+        boost::atomic_thread_fence(boost::memory_order_acquire);
+        const bool intact = slot(_next)->seq.load(boost::memory_order_relaxed) == 2 * _next + 2;
+        if (intact) {
+          count(_consumer->records);
+        } else {
+          _torn++;
+          count(_consumer->dropped);
+        }
+        _held = false;
+        _next++;
+        _consumer->read_seq.store(_next, boost::memory_order_release);
+        return intact;
+      }
+
+      boost::uint64_t
+      lag() const
+      {
+        const boost::uint64_t w = _producer->write_seq.load(boost::memory_order_acquire);
+        return (w > _next) ? w - _next : 0;
+      }
+
+      bool
+      closed() const
+      {
+        if (lag() > 0) {
+          return false;
+        }
+        if (_producer->closed.load(boost::memory_order_acquire)) {
+          return true;
+        }
+        /* A writer that died never set closed; check for anything it
+         * published just before */
+        return not pulse_ring::process_alive(_writer_pid) and lag() == 0;
+      }
+
+      stats_t
+      get_stats() const
+      {
+        stats_t stats;
+        stats.records = _consumer->records.load(boost::memory_order_relaxed);
+        stats.torn = _torn;
+        stats.dropped = _consumer->dropped.load(boost::memory_order_relaxed) - _torn;
+        stats.lag = lag();
+        return stats;
+      }
+
+    private:
+      /* Claim a free consumer entry, freeing those of dead readers if
+       * the table is full */
+      void
+      attach(size_t max_consumers, bool oldest)
+      {
+        for (int pass = 0; pass < 2 and _consumer == NULL; pass++) {
+          for (size_t i = 0; i < max_consumers and _consumer == NULL; i++) {
+            pulse_ring::consumer_t *c = consumer(i);
+            if (pass > 0) {
+              pulse_ring::reap_consumer(*c);
+            }
+            boost::uint32_t state = pulse_ring::CONSUMER_FREE;
+            if (c->state.compare_exchange_strong(state, pulse_ring::CONSUMER_CLAIMED,
+                                                 boost::memory_order_acq_rel)) {
+              _consumer = c;
+            }
+          }
+        }
+        if (_consumer == NULL) {
+          throw std::runtime_error("pulse_ring_reader: no free consumer entry");
+        }
+
+        const boost::uint64_t w = _producer->write_seq.load(boost::memory_order_acquire);
+        _next = (oldest and w > _num_slots) ? w - _num_slots : (oldest ? 0 : w);
+        _consumer->pid = boost::uint32_t(::getpid());
+        _consumer->read_seq.store(_next, boost::memory_order_relaxed);
+        _consumer->records.store(0, boost::memory_order_relaxed);
+        _consumer->dropped.store(0, boost::memory_order_relaxed);
+        _consumer->state.store(pulse_ring::CONSUMER_ACTIVE, boost::memory_order_release);
+      }
+
+      void
+      skip(boost::uint64_t n)
+      {
+        count(_consumer->dropped, n);
+        _next += n;
+        _consumer->read_seq.store(_next, boost::memory_order_release);
+      }
+
+      pulse_ring::consumer_t *
+      consumer(size_t i)
+      {
+        return reinterpret_cast<pulse_ring::consumer_t *>(
+          _control + pulse_ring::CONSUMERS_OFFSET + i * pulse_ring::CACHE_LINE);
+      }
+
+      const pulse_ring::slot_t *
+      slot(boost::uint64_t n) const
+      {
+        return reinterpret_cast<const pulse_ring::slot_t *>(
+          _slots + (n & (_num_slots - 1)) * _slot_size);
+      }
+
+      char *_control;
+      size_t _control_size;
+      const char *_slots;
+      size_t _slots_size;
+      pulse_file::info_t _info;
+      size_t _item_size;
+      size_t _num_slots;
+      size_t _slot_size;
+      boost::uint32_t _writer_pid;
+      const pulse_ring::producer_t *_producer;
+      pulse_ring::consumer_t *_consumer;
+
+      /* The next record, and whether front() handed it out */
+      boost::uint64_t _next;
+      bool _held;
+      boost::uint64_t _torn;
+    };
+
+    pulse_ring_reader::sptr
+    pulse_ring_reader::make(const std::string &name, bool oldest)
+    {
+      return sptr(new pulse_ring_reader_impl(name, oldest));
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
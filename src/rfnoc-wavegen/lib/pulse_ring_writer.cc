@@ -0,0 +1,324 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <wavegen/pulse_ring_writer.h>
+#include "worker_ring.h"
+#include <boost/atomic.hpp>
+#include <boost/format.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace gr {
+  namespace wavegen {
+
+    static size_t
+    round_up(size_t n, size_t align)
+    {
+      return (n + align - 1) / align * align;
+    }
+
+    class pulse_ring_writer_impl : public pulse_ring_writer
+    {
+    public:
+      pulse_ring_writer_impl(const std::string &name, const pulse_file::info_t &info,
+                             const config_t &config):
+        _name(name),
+        _config(config),
+        _base(NULL),
+        _size(0),
+        _write_seq(0),
+        _closed(false)
+      {
+        if (name.size() < 2 or name[0] != '/' or name.find('/', 1) != std::string::npos) {
+          throw std::invalid_argument("pulse_ring_writer: name must be one '/' followed by a name, e.g. /wavegen_rx");
+        }
+        if (info.rx_len == 0 or config.max_consumers == 0) {
+          throw std::invalid_argument("pulse_ring_writer: rx_len and max_consumers must be non-zero");
+        }
+        if (config.num_slots < 2 or (config.num_slots & (config.num_slots - 1))) {
+          throw std::invalid_argument("pulse_ring_writer: num_slots must be a power of two");
+        }
+        if (_config.lag_threshold == 0) {
+          _config.lag_threshold = config.num_slots / 2;
+        }
+
+        _item_size = pulse_file::item_size(info.format);
+        _slot_size = round_up(pulse_ring::SLOT_HEADER_SIZE + info.rx_len * _item_size,
+                              pulse_ring::CACHE_LINE);
+        const size_t page = size_t(::sysconf(_SC_PAGESIZE));
+        _slots_offset = round_up(pulse_ring::CONSUMERS_OFFSET
+                                 + config.max_consumers * pulse_ring::CACHE_LINE, page);
+        _size = _slots_offset + config.num_slots * _slot_size;
+        _mask = config.num_slots - 1;
+        _rx_len = info.rx_len;
+        _rate = info.rate;
+
+        const int fd = create();
+        if (::ftruncate(fd, off_t(_size)) != 0) {
+          const int err = errno;
+          ::close(fd);
+          ::shm_unlink(name.c_str());
+          throw std::runtime_error(str(
+            boost::format("pulse_ring_writer: cannot size %s to %d bytes: %s")
+            % name % _size % std::strerror(err)));
+        }
+        void *base = ::mmap(NULL, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        /* The mapping keeps the segment open */
+        ::close(fd);
+        if (base == MAP_FAILED) {
+          const int err = errno;
+          ::shm_unlink(name.c_str());
+          throw std::runtime_error(str(
+            boost::format("pulse_ring_writer: cannot map %s: %s") % name % std::strerror(err)));
+        }
+        _base = static_cast<char *>(base);
+
+        /* The segment starts out zeroed; construct the shared atomics
+         * in place and write the magic last, so a reader attaching
+         * early sees no ring rather than half of one */
+        _producer = new (_base + pulse_ring::PRODUCER_OFFSET) pulse_ring::producer_t();
+        _producer->write_seq.store(0, boost::memory_order_relaxed);
+        _producer->closed.store(0, boost::memory_order_relaxed);
+        for (size_t i = 0; i < config.max_consumers; i++) {
+          new (consumer(i)) pulse_ring::consumer_t();
+          consumer(i)->state.store(pulse_ring::CONSUMER_FREE, boost::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < config.num_slots; i++) {
+          new (_base + _slots_offset + i * _slot_size) pulse_ring::slot_t();
+          slot(i)->seq.store(0, boost::memory_order_relaxed);
+        }
+
+        pulse_ring::control_t *control = reinterpret_cast<pulse_ring::control_t *>(_base);
+        control->version = pulse_ring::VERSION;
+        control->num_slots = config.num_slots;
+        control->max_consumers = config.max_consumers;
+        control->writer_pid = boost::uint32_t(::getpid());
+        control->slot_size = _slot_size;
+        control->slots_offset = _slots_offset;
+        control->segment_size = _size;
+        pulse_file::encode_header(info, control->stream);
+        boost::atomic_thread_fence(boost::memory_order_release);
+        std::memcpy(control->magic, pulse_ring::MAGIC, sizeof(control->magic));
+
+        _records.store(0, boost::memory_order_relaxed);
+        _bytes.store(0, boost::memory_order_relaxed);
+        _truncated.store(0, boost::memory_order_relaxed);
+        _reaped.store(0, boost::memory_order_relaxed);
+      }
+
+      ~pulse_ring_writer_impl()
+      {
+        close();
+        ::munmap(_base, _size);
+      }
+
+      const std::string &
+      get_name() const
+      {
+        return _name;
+      }
+
+      void
+      publish(const pulse_framer::pulse_t &pulse)
+      {
+        const boost::uint64_t n = _write_seq;
+        pulse_ring::slot_t *s = slot(n & _mask);
+        const size_t nsamps = std::min(pulse.nsamps, _rx_len);
+
+        /* Odd while the slot is being written; the fence keeps the
+         * writes below from becoming visible before it */
+        s->seq.store(2 * n + 1, boost::memory_order_relaxed);
+        boost::atomic_thread_fence(boost::memory_order_release);
+        s->index = pulse.index;
+        s->ticks = pulse.has_time ? pulse.time.to_ticks(_rate) : 0;
+        s->nsamps = boost::uint32_t(nsamps);
+        s->flags = (pulse.has_time ? pulse_file::PULSE_HAS_TIME : 0)
+                   | ((pulse.truncated or nsamps < pulse.nsamps) ? pulse_file::PULSE_TRUNCATED : 0);
+        std::memcpy(reinterpret_cast<char *>(s) + pulse_ring::SLOT_HEADER_SIZE,
+                    pulse.samples, nsamps * _item_size);
+        s->seq.store(2 * n + 2, boost::memory_order_release);
+
+        _write_seq = n + 1;
+        _producer->write_seq.store(_write_seq, boost::memory_order_release);
+        count(_records);
+        count(_bytes, nsamps * _item_size);
+        if (nsamps < pulse.nsamps) {
+          count(_truncated);
+        }
+      }
+
+      void
+      close()
+      {
+        if (_closed) {
+          return;
+        }
+        _closed = true;
+        _producer->closed.store(1, boost::memory_order_release);
+        ::shm_unlink(_name.c_str());
+      }
+
+      std::vector<consumer_info_t>
+      get_consumers()
+      {
+        const boost::uint64_t w = _producer->write_seq.load(boost::memory_order_acquire);
+        std::vector<consumer_info_t> consumers;
+        for (size_t i = 0; i < _config.max_consumers; i++) {
+          pulse_ring::consumer_t *c = consumer(i);
+          if (pulse_ring::reap_consumer(*c)) {
+            count(_reaped);
+            continue;
+          }
+          if (c->state.load(boost::memory_order_acquire) != pulse_ring::CONSUMER_ACTIVE) {
+            continue;
+          }
+          consumer_info_t info;
+          info.slot = i;
+          info.pid = c->pid;
+          info.read_seq = c->read_seq.load(boost::memory_order_acquire);
+          info.lag = (w > info.read_seq) ? w - info.read_seq : 0;
+          info.records = c->records.load(boost::memory_order_relaxed);
+          info.dropped = c->dropped.load(boost::memory_order_relaxed);
+          info.lagging = info.lag >= _config.lag_threshold;
+          info.overrun = info.lag > _config.num_slots;
+          consumers.push_back(info);
+        }
+        return consumers;
+      }
+
+      stats_t
+      get_stats()
+      {
+        stats_t stats;
+        stats.records = _records.load(boost::memory_order_relaxed);
+        stats.bytes = _bytes.load(boost::memory_order_relaxed);
+        stats.truncated_pulses = _truncated.load(boost::memory_order_relaxed);
+        const std::vector<consumer_info_t> consumers = get_consumers();
+        stats.consumers = consumers.size();
+        for (size_t i = 0; i < consumers.size(); i++) {
+          stats.lagging_consumers += consumers[i].lagging ? 1 : 0;
+          stats.max_lag = std::max(stats.max_lag, consumers[i].lag);
+          stats.consumer_drops += consumers[i].dropped;
+        }
+        stats.reaped_consumers = _reaped.load(boost::memory_order_relaxed);
+        return stats;
+      }
+
+      config_t
+      get_config()
+      {
+        return _config;
+      }
+
+    private:
+      /* Create the segment, replacing one left by a writer that died */
+      int
+      create()
+      {
+        int fd = ::shm_open(_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0666);
+        int err = errno;
+        if (fd < 0 and err == EEXIST and stale()) {
+          ::shm_unlink(_name.c_str());
+          fd = ::shm_open(_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0666);
+          err = errno;
+        }
+        if (fd < 0) {
+          throw std::runtime_error(str(
+            boost::format("pulse_ring_writer: cannot create %s: %s") % _name
+            % (err == EEXIST ? "in use by another writer" : std::strerror(err))));
+        }
+        return fd;
+      }
+
+      /* Whether the existing segment is not a live writer's ring */
+      bool
+      stale()
+      {
+        const int fd = ::shm_open(_name.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+          return errno == ENOENT;
+        }
+        pulse_ring::control_t control;
+        const ssize_t n = ::pread(fd, &control, sizeof(control), 0);
+        ::close(fd);
+        if (n != ssize_t(sizeof(control))
+            or std::memcmp(control.magic, pulse_ring::MAGIC, sizeof(control.magic))) {
+          /* Someone else's segment, or a writer still setting up */
+          return false;
+        }
+        return not pulse_ring::process_alive(control.writer_pid);
+      }
+
+      pulse_ring::consumer_t *
+      consumer(size_t i)
+      {
+        return reinterpret_cast<pulse_ring::consumer_t *>(
+          _base + pulse_ring::CONSUMERS_OFFSET + i * pulse_ring::CACHE_LINE);
+      }
+
+      pulse_ring::slot_t *
+      slot(size_t i)
+      {
+        return reinterpret_cast<pulse_ring::slot_t *>(_base + _slots_offset + i * _slot_size);
+      }
+
+      const std::string _name;
+      config_t _config;
+      char *_base;
+      size_t _size;
+      size_t _item_size;
+      size_t _slot_size;
+      size_t _slots_offset;
+      size_t _mask;
+      size_t _rx_len;
+      double _rate;
+      pulse_ring::producer_t *_producer;
+
+      /* Only the publishing thread touches these */
+      boost::uint64_t _write_seq;
+      bool _closed;
+
+      counter_t _records;
+      counter_t _bytes;
+      counter_t _truncated;
+      counter_t _reaped;
+    };
+
+    pulse_ring_writer::sptr
+    pulse_ring_writer::make(const std::string &name, const pulse_file::info_t &info,
+                            const config_t &config)
+    {
+      return sptr(new pulse_ring_writer_impl(name, info, config));
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
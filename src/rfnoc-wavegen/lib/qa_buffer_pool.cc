@@ -0,0 +1,154 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include "qa_buffer_pool.h"
+#include <wavegen/buffer_pool.h>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace gr {
+  namespace wavegen {
+
+    void
+    qa_buffer_pool::t1()
+    {
+      // Handles count references and return the buffer with the last one
+      buffer_pool::config_t config;
+      config.num_buffers = 3;
+      config.buffer_size = 2 * buffer_pool::ALIGNMENT;
+      buffer_pool::sptr pool = buffer_pool::make(config);
+      CPPUNIT_ASSERT_EQUAL(size_t(3), pool->available());
+      CPPUNIT_ASSERT(pool->get_page_mode() == buffer_pool::PAGES_NORMAL);
+      CPPUNIT_ASSERT(not pool->is_locked());
+
+      buffer_pool::handle_t a, b, c, d;
+      CPPUNIT_ASSERT(not a.valid());
+      CPPUNIT_ASSERT_EQUAL(size_t(0), a.size());
+      CPPUNIT_ASSERT(pool->try_acquire(a));
+      CPPUNIT_ASSERT(pool->try_acquire(b));
+      CPPUNIT_ASSERT(pool->acquire(c, 0.0));
+      CPPUNIT_ASSERT(not pool->try_acquire(d));
+      CPPUNIT_ASSERT(not pool->acquire(d, 0.01));
+      CPPUNIT_ASSERT(not d.valid());
+      CPPUNIT_ASSERT_EQUAL(size_t(0), pool->available());
+
+      CPPUNIT_ASSERT_EQUAL(config.buffer_size, a.size());
+      CPPUNIT_ASSERT_EQUAL(size_t(0), size_t(a.data() - (char *)0) % buffer_pool::ALIGNMENT);
+      CPPUNIT_ASSERT(a.data() != b.data() and b.data() != c.data() and a.data() != c.data());
+      CPPUNIT_ASSERT_EQUAL(a.index(), pool->index_of(a.data() + 100));
+      CPPUNIT_ASSERT_EQUAL(a.data(), pool->data(a.index()));
+      CPPUNIT_ASSERT_THROW(pool->index_of(&config), std::invalid_argument);
+      std::memset(a.data(), 0x5a, a.size());
+
+      // Copies share the buffer; it comes back when the last one goes
+      {
+        buffer_pool::handle_t copy(a), other;
+        other = copy;
+        CPPUNIT_ASSERT_EQUAL(size_t(3), a.use_count());
+        CPPUNIT_ASSERT_EQUAL(a.data(), other.data());
+        a.reset();
+        CPPUNIT_ASSERT(not a.valid());
+        CPPUNIT_ASSERT_EQUAL(size_t(0), pool->available());
+        other = other;
+        CPPUNIT_ASSERT_EQUAL(size_t(2), copy.use_count());
+      }
+      CPPUNIT_ASSERT_EQUAL(size_t(1), pool->available());
+
+      // The most recently returned buffer is handed out first
+      const size_t index = b.index();
+      b.reset();
+      CPPUNIT_ASSERT(pool->try_acquire(d));
+      CPPUNIT_ASSERT_EQUAL(index, d.index());
+      d = c;
+      CPPUNIT_ASSERT_EQUAL(size_t(2), pool->available());
+
+      buffer_pool::stats_t stats = pool->get_stats();
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(4), stats.acquires);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(1), stats.waits);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(2), stats.empty);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(1), stats.in_use);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(3), stats.max_in_use);
+
+      config.buffer_size = 1000;
+      CPPUNIT_ASSERT_THROW(buffer_pool::make(config), std::invalid_argument);
+      config.buffer_size = buffer_pool::ALIGNMENT;
+      config.num_buffers = 0;
+      CPPUNIT_ASSERT_THROW(buffer_pool::make(config), std::invalid_argument);
+    }
+
+    static void
+    pass_along(buffer_pool::sptr pool, size_t rounds)
+    {
+      for (size_t i = 0; i < rounds; i++) {
+        buffer_pool::handle_t h;
+        pool->acquire(h);
+        h.data()[0] = char(i);
+        buffer_pool::handle_t copy = h;
+        h.reset();
+      }
+    }
+
+    void
+    qa_buffer_pool::t2()
+    {
+      // Huge and locked pages are best effort; threads share the pool
+      buffer_pool::config_t config;
+      config.num_buffers = 4;
+      config.buffer_size = buffer_pool::HUGE_PAGE_SIZE;
+      config.huge_pages = true;
+      config.lock_memory = true;
+      buffer_pool::sptr pool = buffer_pool::make(config);
+      if (pool->get_page_mode() == buffer_pool::PAGES_HUGE) {
+        CPPUNIT_ASSERT_EQUAL(size_t(0), size_t(pool->data(0) - (char *)0) % buffer_pool::HUGE_PAGE_SIZE);
+      }
+
+      buffer_pool::handle_t h;
+      CPPUNIT_ASSERT(pool->acquire(h));
+      std::memset(h.data(), 1, h.size());
+      h.reset();
+
+      // A waiter gets the buffer another thread returns
+      std::vector<buffer_pool::handle_t> held(4);
+      for (size_t i = 0; i < held.size(); i++) {
+        CPPUNIT_ASSERT(pool->try_acquire(held[i]));
+      }
+      boost::thread returner(boost::bind(&buffer_pool::handle_t::reset, &held[2]));
+      CPPUNIT_ASSERT(pool->acquire(h, 5.0));
+      returner.join();
+      held.clear();
+      h.reset();
+
+      boost::thread_group threads;
+      for (size_t i = 0; i < 4; i++) {
+        threads.create_thread(boost::bind(&pass_along, pool, 2000));
+      }
+      threads.join_all();
+      CPPUNIT_ASSERT_EQUAL(size_t(4), pool->available());
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(0), pool->get_stats().in_use);
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
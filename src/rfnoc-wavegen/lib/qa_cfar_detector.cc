@@ -0,0 +1,227 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include "qa_cfar_detector.h"
+#include <wavegen/cfar_detector.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace gr {
+  namespace wavegen {
+
+    static const size_t ROWS = 300;
+    static const size_t WIDTH = 24;
+
+    /* Exponentially distributed noise power, mean 1, from a fixed LCG */
+    static std::vector<float>
+    noise_grid(size_t rows, size_t width)
+    {
+      std::vector<float> grid(rows * width);
+      boost::uint32_t state = 12345;
+      for (size_t i = 0; i < grid.size(); i++) {
+        state = state * 1664525u + 1013904223u;
+        grid[i] = float(-std::log((double(state >> 8) + 0.5) / double(1 << 24)));
+      }
+      return grid;
+    }
+
+    /* The noise estimate for one cell, from scratch */
+    static float
+    reference_noise(const std::vector<float> &grid, size_t rows, size_t width,
+                    size_t b, size_t c, const cfar_detector::config_t &config)
+    {
+      const size_t g = config.guard_cells, w = config.train_cells;
+      std::vector<float> lead, lag;
+      for (size_t r = (b > g + w) ? b - g - w : 0; r + g < b; r++) {
+        lead.push_back(grid[r * width + c]);
+      }
+      for (size_t r = b + g + 1; r <= b + g + w and r < rows; r++) {
+        lag.push_back(grid[r * width + c]);
+      }
+      double sl = 0.0, sr = 0.0;
+      for (size_t i = 0; i < lead.size(); i++) sl += lead[i];
+      for (size_t i = 0; i < lag.size(); i++) sr += lag[i];
+      const size_t n = lead.size() + lag.size();
+      switch (config.method) {
+      case cfar_detector::CFAR_OS: {
+        std::vector<float> all(lead);
+        all.insert(all.end(), lag.begin(), lag.end());
+        std::sort(all.begin(), all.end());
+        const size_t rank = config.os_rank ? config.os_rank : 3 * 2 * w / 4;
+        return all[std::max<size_t>(1, rank * n / (2 * w)) - 1];
+      }
+      case cfar_detector::CFAR_GO:
+      case cfar_detector::CFAR_SO:
+        if (not lead.empty() and not lag.empty()) {
+          const double l = sl / lead.size(), r = sr / lag.size();
+          return float((config.method == cfar_detector::CFAR_GO) ? std::max(l, r) : std::min(l, r));
+        }
+        /* fall through */
+      default:
+        return float((sl + sr) / n);
+      }
+    }
+
+    /* Detections match a from-scratch CFAR, except for cells right at the threshold */
+    static void
+    check_against_reference(const std::vector<float> &grid, const cfar_detector::config_t &config)
+    {
+      cfar_detector::sptr cfar = cfar_detector::make(config);
+      std::vector<cfar_detector::detection_t> detections;
+      cfar->detect(&grid[0], ROWS, WIDTH, detections);
+      std::vector<bool> hit(ROWS * WIDTH, false);
+      for (size_t i = 0; i < detections.size(); i++) {
+        const cfar_detector::detection_t &d = detections[i];
+        const float noise = reference_noise(grid, ROWS, WIDTH, d.range_bin, d.doppler_bin, config);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(noise, d.noise, 1e-4 * noise);
+        CPPUNIT_ASSERT_EQUAL(grid[d.range_bin * WIDTH + d.doppler_bin], d.power);
+        hit[d.range_bin * WIDTH + d.doppler_bin] = true;
+      }
+      const float alpha = cfar->get_threshold_factor();
+      for (size_t b = 0; b < ROWS; b++) {
+        for (size_t c = 0; c < WIDTH; c++) {
+          const float thr = alpha * reference_noise(grid, ROWS, WIDTH, b, c, config);
+          if (std::abs(grid[b * WIDTH + c] - thr) > 1e-3f * thr) {
+            CPPUNIT_ASSERT_EQUAL(grid[b * WIDTH + c] > thr, bool(hit[b * WIDTH + c]));
+          }
+        }
+      }
+    }
+
+    void
+    qa_cfar_detector::t1()
+    {
+      // Running sums agree with a from-scratch CFAR, edges included
+      std::vector<float> grid = noise_grid(ROWS, WIDTH);
+      const size_t targets[][2] = {{0, 3}, {40, 0}, {41, 0}, {150, 23}, {299, 10}};
+      for (size_t i = 0; i < sizeof(targets) / sizeof(targets[0]); i++) {
+        grid[targets[i][0] * WIDTH + targets[i][1]] = 1e4f;
+      }
+
+      cfar_detector::config_t config;
+      config.guard_cells = 1;
+      config.train_cells = 8;
+      config.pfa = 1e-3;
+      const cfar_detector::method_t methods[] = {
+        cfar_detector::CFAR_CA, cfar_detector::CFAR_GO, cfar_detector::CFAR_SO, cfar_detector::CFAR_OS
+      };
+      for (size_t m = 0; m < sizeof(methods) / sizeof(methods[0]); m++) {
+        config.method = methods[m];
+        check_against_reference(grid, config);
+
+        // Every target is found and false alarms stay near pfa
+        std::vector<cfar_detector::detection_t> detections;
+        cfar_detector::make(config)->detect(&grid[0], ROWS, WIDTH, detections);
+        for (size_t i = 0; i < sizeof(targets) / sizeof(targets[0]); i++) {
+          bool found = false;
+          for (size_t j = 0; j < detections.size(); j++) {
+            found |= (detections[j].range_bin == targets[i][0]
+                      and detections[j].doppler_bin == targets[i][1]);
+          }
+          CPPUNIT_ASSERT(found or (methods[m] == cfar_detector::CFAR_GO and targets[i][0] >= 40
+                                   and targets[i][0] <= 41));
+        }
+        CPPUNIT_ASSERT(detections.size() < 5 + 10 * size_t(1e-3 * ROWS * WIDTH));
+      }
+
+      // The threshold factor follows pfa: CA closed form, OS rank 12 of 16
+      config.method = cfar_detector::CFAR_CA;
+      config.pfa = 1e-6;
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(16.0 * (std::pow(1e-6, -1.0 / 16.0) - 1.0),
+                                   cfar_detector::make(config)->get_threshold_factor(), 1e-4);
+      config.method = cfar_detector::CFAR_OS;
+      const float alpha = cfar_detector::make(config)->get_threshold_factor();
+      double pfa = 1.0;
+      for (size_t i = 0; i < 12; i++) {
+        pfa *= (16.0 - i) / (16.0 - i + alpha);
+      }
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(1e-6, pfa, 1e-9);
+      config.threshold_factor = 3.0f;
+      CPPUNIT_ASSERT_EQUAL(3.0f, cfar_detector::make(config)->get_threshold_factor());
+    }
+
+    void
+    qa_cfar_detector::t2()
+    {
+      // Pulses and maps carry their index and time; magnitudes are squared
+      cfar_detector::config_t config;
+      config.pfa = 1e-6;
+      cfar_detector::sptr cfar = cfar_detector::make(config);
+
+      const std::vector<float> power = noise_grid(1000, 1);
+      std::vector<gr_complex> bins(1000);
+      for (size_t i = 0; i < bins.size(); i++) {
+        bins[i] = gr_complex(std::sqrt(power[i]), 0.0f);
+      }
+      bins[123] = gr_complex(30.0f, 40.0f);
+      pulse_framer::pulse_t pulse;
+      pulse.index = 77;
+      pulse.has_time = true;
+      pulse.time = uhd::time_spec_t(2.5);
+      pulse.nsamps = bins.size();
+      pulse.samples = &bins[0];
+      std::vector<cfar_detector::detection_t> detections;
+      CPPUNIT_ASSERT_EQUAL(size_t(1), cfar->detect(pulse, detections));
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(123), detections[0].range_bin);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(0), detections[0].doppler_bin);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(2500.0, detections[0].power, 1e-2);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(77), detections[0].index);
+      CPPUNIT_ASSERT(detections[0].has_time);
+
+      std::vector<float> magnitude(ROWS * WIDTH);
+      const std::vector<float> grid = noise_grid(ROWS, WIDTH);
+      for (size_t i = 0; i < grid.size(); i++) {
+        magnitude[i] = std::sqrt(grid[i]);
+      }
+      magnitude[200 * WIDTH + 5] = 100.0f;
+      range_doppler::map_t map;
+      map.index = 9;
+      map.num_bins = ROWS;
+      map.doppler_size = WIDTH;
+      map.output = range_doppler::OUTPUT_MAGNITUDE;
+      map.data = &magnitude[0];
+      detections.clear();
+      CPPUNIT_ASSERT_EQUAL(size_t(1), cfar->detect(map, detections));
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(200), detections[0].range_bin);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(5), detections[0].doppler_bin);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(1e4, detections[0].power, 1e-1);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(9), detections[0].index);
+
+      const cfar_detector::stats_t stats = cfar->get_stats();
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(1000 + ROWS * WIDTH), stats.cells);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(2), stats.detections);
+
+      config.train_cells = 0;
+      CPPUNIT_ASSERT_THROW(cfar_detector::make(config), std::invalid_argument);
+      config.train_cells = 4;
+      config.os_rank = 9;
+      CPPUNIT_ASSERT_THROW(cfar_detector::make(config), std::invalid_argument);
+      config.os_rank = 0;
+      config.pfa = 1.0;
+      CPPUNIT_ASSERT_THROW(cfar_detector::make(config), std::invalid_argument);
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
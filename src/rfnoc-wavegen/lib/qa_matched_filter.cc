@@ -0,0 +1,164 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include "qa_matched_filter.h"
+#include "fft_plan_cache.h"
+#include <wavegen/matched_filter.h>
+#include <wavegen/waveform_synth.h>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+#include <cmath>
+#include <stdexcept>
+
+namespace gr {
+  namespace wavegen {
+
+    static const size_t RX_LEN = 300;
+
+    /* An echo of \p ref delayed by \p delay samples, as sc16 */
+    static std::vector<std::complex<short> >
+    echo(const std::vector<gr_complex> &ref, size_t delay, float amplitude)
+    {
+      std::vector<std::complex<short> > rx(RX_LEN);
+      for (size_t k = 0; k < ref.size() and delay + k < RX_LEN; k++) {
+        const gr_complex s = ref[k] * amplitude * 32767.0f;
+        rx[delay + k] = std::complex<short>(short(std::floor(s.real() + 0.5f)),
+                                            short(std::floor(s.imag() + 0.5f)));
+      }
+      return rx;
+    }
+
+    static size_t
+    peak(const gr_complex *bins, size_t n)
+    {
+      size_t best = 0;
+      for (size_t i = 1; i < n; i++) {
+        if (std::norm(bins[i]) > std::norm(bins[best])) {
+          best = i;
+        }
+      }
+      return best;
+    }
+
+    void
+    qa_matched_filter::t1()
+    {
+      // Fast convolution matches direct correlation, fc32 and sc16 in
+      const std::vector<gr_complex> ref = waveform_synth::lfm(64, 0.5);
+      matched_filter::config_t config;
+      config.rx_len = RX_LEN;
+      config.input = matched_filter::INPUT_FC32;
+      config.num_workers = 1;
+      matched_filter::sptr mf = matched_filter::make(ref, config);
+      CPPUNIT_ASSERT_EQUAL(size_t(512), mf->get_fft_size());
+
+      std::vector<gr_complex> rx(RX_LEN);
+      for (size_t i = 0; i < RX_LEN; i++) {
+        rx[i] = gr_complex(std::cos(0.37f * i), std::sin(0.11f * i * i));
+      }
+      std::vector<gr_complex> out(RX_LEN);
+      mf->process(&rx[0], RX_LEN, &out[0]);
+      for (size_t n = 0; n < RX_LEN; n++) {
+        gr_complex expected(0.0f);
+        for (size_t k = 0; k < ref.size() and n + k < RX_LEN; k++) {
+          expected += rx[n + k] * std::conj(ref[k]);
+        }
+        CPPUNIT_ASSERT(std::abs(out[n] - expected) < 1e-3f);
+      }
+
+      config.input = matched_filter::INPUT_SC16;
+      mf = matched_filter::make(ref, config);
+      const std::vector<std::complex<short> > sc16 = echo(ref, 100, 0.5f);
+      mf->process(&sc16[0], RX_LEN, &out[0]);
+      CPPUNIT_ASSERT_EQUAL(size_t(100), peak(&out[0], RX_LEN));
+      CPPUNIT_ASSERT(std::abs(std::abs(out[100]) - 32.0f) < 0.05f);
+
+      // A short record is zero padded; a tapered reference keeps the peak
+      mf->process(&sc16[0], 120, &out[0]);
+      CPPUNIT_ASSERT(std::abs(out[200]) < 1e-6f);
+      config.window = gr::fft::window::WIN_HAMMING;
+      mf = matched_filter::make(ref, config);
+      mf->process(&sc16[0], RX_LEN, &out[0]);
+      CPPUNIT_ASSERT_EQUAL(size_t(100), peak(&out[0], RX_LEN));
+    }
+
+    static void
+    feed(matched_filter::sptr mf, const std::vector<gr_complex> *ref, size_t num_pulses)
+    {
+      for (size_t p = 0; p < num_pulses; p++) {
+        const std::vector<std::complex<short> > rx = echo(*ref, p % 200, 0.25f);
+        pulse_framer::pulse_t pulse;
+        pulse.index = p;
+        pulse.has_time = true;
+        pulse.time = uhd::time_spec_t(double(p));
+        pulse.nsamps = RX_LEN;
+        pulse.truncated = (p % 7 == 0);
+        pulse.samples = &rx[0];
+        mf->submit(pulse);
+      }
+    }
+
+    void
+    qa_matched_filter::t2()
+    {
+      // Worker pool keeps pulse order; plans are reused across engines
+      const std::vector<gr_complex> ref = waveform_synth::lfm(64, 0.5);
+      matched_filter::config_t config;
+      config.rx_len = RX_LEN;
+      config.num_workers = 3;
+      config.num_slots = 4;
+      const size_t num_pulses = 200;
+      {
+        matched_filter::sptr mf = matched_filter::make(ref, config);
+        boost::thread producer(boost::bind(&feed, mf, &ref, num_pulses));
+        for (size_t p = 0; p < num_pulses; p++) {
+          pulse_framer::pulse_t pulse;
+          while (not mf->front(pulse)) {
+            boost::this_thread::yield();
+          }
+          CPPUNIT_ASSERT_EQUAL(boost::uint64_t(p), pulse.index);
+          CPPUNIT_ASSERT_EQUAL(p % 7 == 0, pulse.truncated);
+          CPPUNIT_ASSERT_EQUAL(RX_LEN, pulse.nsamps);
+          CPPUNIT_ASSERT_EQUAL(p % 200, peak(static_cast<const gr_complex *>(pulse.samples), RX_LEN));
+          mf->pop();
+        }
+        producer.join();
+        CPPUNIT_ASSERT_EQUAL(size_t(0), mf->size());
+        CPPUNIT_ASSERT_EQUAL(boost::uint64_t(num_pulses), mf->get_stats().pulses);
+
+        pulse_framer::pulse_t pulse;
+        pulse.nsamps = RX_LEN + 1;
+        CPPUNIT_ASSERT_THROW(mf->submit(pulse), std::invalid_argument);
+      }
+      const size_t created = fft_plan_cache::num_created();
+      matched_filter::make(ref, config);
+      CPPUNIT_ASSERT_EQUAL(created, fft_plan_cache::num_created());
+
+      config.fft_size = RX_LEN + ref.size() - 2;
+      CPPUNIT_ASSERT_THROW(matched_filter::make(ref, config), std::invalid_argument);
+      config.fft_size = 0;
+      CPPUNIT_ASSERT_THROW(matched_filter::make(std::vector<gr_complex>(), config), std::invalid_argument);
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
@@ -0,0 +1,195 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include "qa_pulse_file.h"
+#include <wavegen/pulse_file_writer.h>
+#include <wavegen/pulse_file_reader.h>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace gr {
+  namespace wavegen {
+
+    static const double RATE = 1e6;
+    static const size_t RX_LEN = 100;
+
+    static std::string
+    temp_path()
+    {
+      return (boost::filesystem::temp_directory_path()
+              / boost::filesystem::unique_path("qa_pulse_file-%%%%-%%%%.dat")).string();
+    }
+
+    static pulse_file::info_t
+    test_info()
+    {
+      pulse_file::info_t info;
+      info.format = pulse_file::FORMAT_SC16;
+      info.rate = RATE;
+      info.rx_len = RX_LEN;
+      info.waveform_known = true;
+      info.waveform_id = 42;
+      info.waveform_len = 128;
+      info.num_adc_samples = 99;
+      info.ctrl_word = 0x1;
+      info.policy = 0x2;
+      info.prf_count = 1000;
+      info.chirp_len = 64;
+      info.chirp_tuning_coef = 3;
+      info.chirp_freq_offset = 5;
+      info.integrated_pulses = 8;
+      return info;
+    }
+
+    /* Pulse n starts at tick 1000 * n and holds its sample numbers;
+     * every tenth pulse is cut to half length */
+    static size_t
+    test_nsamps(size_t n)
+    {
+      return (n % 10 == 9) ? RX_LEN / 2 : RX_LEN;
+    }
+
+    void
+    qa_pulse_file::t1()
+    {
+      // Write through small recorder buffers, read back every pulse
+      const std::string path = temp_path();
+      sample_recorder::config_t config;
+      config.num_buffers = 4;
+      config.buffer_size = 2 * sample_recorder::ALIGNMENT;
+      const size_t num_pulses = 300;
+      {
+        pulse_file_writer::sptr writer = pulse_file_writer::make(path, test_info(), config);
+        std::vector<boost::uint32_t> samples(RX_LEN);
+        for (size_t n = 0; n < num_pulses; n++) {
+          for (size_t i = 0; i < RX_LEN; i++) {
+            samples[i] = boost::uint32_t(n * RX_LEN + i);
+          }
+          pulse_framer::pulse_t pulse;
+          pulse.index = n + 5;
+          pulse.has_time = (n != 7);
+          pulse.time = uhd::time_spec_t::from_ticks(1000 * n, RATE);
+          pulse.nsamps = test_nsamps(n);
+          pulse.truncated = (pulse.nsamps < RX_LEN);
+          pulse.samples = &samples[0];
+          writer->write(pulse);
+        }
+        writer->close();
+        const pulse_file_writer::stats_t stats = writer->get_stats();
+        CPPUNIT_ASSERT_EQUAL(boost::uint64_t(num_pulses), stats.pulses);
+        CPPUNIT_ASSERT_EQUAL(boost::uint64_t(num_pulses / 10), stats.truncated);
+        CPPUNIT_ASSERT_EQUAL(boost::uint64_t(0), stats.dropped);
+        CPPUNIT_ASSERT_THROW(writer->write(pulse_framer::pulse_t()), std::runtime_error);
+      }
+
+      pulse_file_reader::sptr reader = pulse_file_reader::make(path);
+      const pulse_file::info_t &info = reader->get_info();
+      CPPUNIT_ASSERT_EQUAL(RATE, info.rate);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(RX_LEN), info.rx_len);
+      CPPUNIT_ASSERT(info.waveform_known);
+      CPPUNIT_ASSERT(not info.range_compressed);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(42), info.waveform_id);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(1000), info.prf_count);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(3), info.chirp_tuning_coef);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(8), info.integrated_pulses);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(1), info.decimation);
+      CPPUNIT_ASSERT_EQUAL(size_t(4), reader->get_item_size());
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(num_pulses), reader->num_pulses());
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(pulse_file::HEADER_SIZE), reader->entry(0).offset);
+
+      for (size_t n = 0; n < num_pulses; n++) {
+        const pulse_framer::pulse_t pulse = reader->pulse(n);
+        CPPUNIT_ASSERT_EQUAL(boost::uint64_t(n + 5), pulse.index);
+        CPPUNIT_ASSERT_EQUAL(test_nsamps(n), pulse.nsamps);
+        CPPUNIT_ASSERT_EQUAL(test_nsamps(n) < RX_LEN, pulse.truncated);
+        CPPUNIT_ASSERT_EQUAL(n != 7, pulse.has_time);
+        if (pulse.has_time) {
+          CPPUNIT_ASSERT_EQUAL(1000LL * n, pulse.time.to_ticks(RATE));
+        }
+        const boost::uint32_t *samples = static_cast<const boost::uint32_t *>(pulse.samples);
+        CPPUNIT_ASSERT_EQUAL(boost::uint32_t(n * RX_LEN), samples[0]);
+        CPPUNIT_ASSERT_EQUAL(boost::uint32_t(n * RX_LEN + pulse.nsamps - 1), samples[pulse.nsamps - 1]);
+      }
+
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(0), reader->find(uhd::time_spec_t(0.0)));
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(123), reader->find(uhd::time_spec_t::from_ticks(123000, RATE)));
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(124), reader->find(uhd::time_spec_t::from_ticks(123001, RATE)));
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(num_pulses), reader->find(uhd::time_spec_t(1.0)));
+      reader->prefetch(100, 50);
+      CPPUNIT_ASSERT_THROW(reader->pulse(num_pulses), std::out_of_range);
+
+      reader.reset();
+      boost::filesystem::remove(path);
+    }
+
+    void
+    qa_pulse_file::t2()
+    {
+      // Files the reader must refuse, and bad writer arguments
+      const std::string path = temp_path();
+      pulse_file::info_t info = test_info();
+      info.rate = 0.0;
+      CPPUNIT_ASSERT_THROW(pulse_file_writer::make(path, info), std::invalid_argument);
+      CPPUNIT_ASSERT_THROW(pulse_file::parse_format("sc8"), std::invalid_argument);
+      CPPUNIT_ASSERT_EQUAL(pulse_file::FORMAT_FC32, pulse_file::parse_format("fc32"));
+      CPPUNIT_ASSERT_THROW(pulse_file_reader::make("/nonexistent/file.dat"), std::runtime_error);
+
+      {
+        std::ofstream out(path.c_str(), std::ios::binary);
+        out << std::string(pulse_file::HEADER_SIZE, 'x');
+      }
+      CPPUNIT_ASSERT_THROW(pulse_file_reader::make(path), std::runtime_error);
+
+      // A header that was never finalised
+      {
+        pulse_file::header_t header;
+        pulse_file::encode_header(test_info(), header);
+        std::ofstream out(path.c_str(), std::ios::binary);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out << std::string(pulse_file::HEADER_SIZE - sizeof(header), '\0');
+      }
+      CPPUNIT_ASSERT_THROW(pulse_file_reader::make(path), std::runtime_error);
+
+      // An empty recording is fine; the same file cut short is not
+      pulse_file_writer::make(path, test_info())->close();
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(0), pulse_file_reader::make(path)->num_pulses());
+      {
+        pulse_file_writer::sptr writer = pulse_file_writer::make(path, test_info());
+        std::vector<boost::uint32_t> samples(RX_LEN);
+        pulse_framer::pulse_t pulse;
+        pulse.nsamps = RX_LEN;
+        pulse.samples = &samples[0];
+        writer->write(pulse);
+        writer->write(pulse);
+      }
+      const boost::uintmax_t size = boost::filesystem::file_size(path);
+      CPPUNIT_ASSERT_EQUAL(boost::uintmax_t(pulse_file::HEADER_SIZE + 2 * (RX_LEN * 4 + 32)), size);
+      boost::filesystem::resize_file(path, size - 1);
+      CPPUNIT_ASSERT_THROW(pulse_file_reader::make(path), std::runtime_error);
+      boost::filesystem::remove(path);
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
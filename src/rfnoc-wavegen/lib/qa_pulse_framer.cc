@@ -0,0 +1,169 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include "qa_pulse_framer.h"
+#include <wavegen/pulse_framer.h>
+#include <stdexcept>
+
+namespace gr {
+  namespace wavegen {
+
+    static const double RATE = 1000.0;
+
+    static uhd::rx_metadata_t
+    metadata(long long ticks)
+    {
+      uhd::rx_metadata_t md;
+      md.error_code = uhd::rx_metadata_t::ERROR_CODE_NONE;
+      md.has_time_spec = true;
+      md.time_spec = uhd::time_spec_t::from_ticks(ticks, RATE);
+      md.start_of_burst = false;
+      md.end_of_burst = false;
+      md.more_fragments = false;
+      md.fragment_offset = 0;
+      md.out_of_sequence = false;
+      return md;
+    }
+
+    /* Receive one packet of up to n samples counting up from ticks;
+     * returns how many fit */
+    static size_t
+    recv_packet(pulse_framer::sptr framer, size_t n, long long ticks,
+                const uhd::rx_metadata_t &md)
+    {
+      size_t max_samps;
+      boost::uint32_t *buff = static_cast<boost::uint32_t *>(framer->recv_buffer(max_samps));
+      n = std::min(n, max_samps);
+      for (size_t i = 0; i < n; i++) {
+        buff[i] = boost::uint32_t(ticks + i);
+      }
+      framer->push(n, md);
+      return n;
+    }
+
+    static void
+    stream(pulse_framer::sptr framer, long long start, long long end, size_t spp)
+    {
+      for (long long t = start; t < end; ) {
+        t += recv_packet(framer, std::min<long long>(spp, end - t), t, metadata(t));
+      }
+    }
+
+    static bool
+    check_pulse(pulse_framer::sptr framer, boost::uint64_t index, long long ticks,
+                size_t nsamps, bool truncated)
+    {
+      pulse_framer::pulse_t pulse;
+      if (not framer->front(pulse)) {
+        return false;
+      }
+      const boost::uint32_t *samples = static_cast<const boost::uint32_t *>(pulse.samples);
+      bool ok = pulse.index == index and pulse.has_time
+        and pulse.time.to_ticks(RATE) == ticks and pulse.nsamps == nsamps
+        and pulse.truncated == truncated;
+      for (size_t i = 0; ok and i < nsamps; i++) {
+        ok = samples[i] == boost::uint32_t(ticks + i);
+      }
+      framer->pop();
+      return ok;
+    }
+
+    void
+    qa_pulse_framer::t1()
+    {
+      // Whole pulses across packet boundaries, and drops when full
+      pulse_framer::config_t config;
+      config.rx_len = 100;
+      config.num_slots = 2;
+      config.rate = RATE;
+      pulse_framer::sptr framer = pulse_framer::make(config);
+
+      stream(framer, 0, 300, 30);
+      CPPUNIT_ASSERT_EQUAL(size_t(2), framer->size());
+      CPPUNIT_ASSERT(check_pulse(framer, 0, 0, 100, false));
+      CPPUNIT_ASSERT(check_pulse(framer, 1, 100, 100, false));
+      CPPUNIT_ASSERT_EQUAL(size_t(0), framer->size());
+
+      stream(framer, 300, 400, 64);
+      CPPUNIT_ASSERT(check_pulse(framer, 3, 300, 100, false));
+
+      const pulse_framer::stats_t stats = framer->get_stats();
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(3), stats.pulses);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(1), stats.dropped);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(0), stats.truncated);
+      CPPUNIT_ASSERT_THROW(framer->pop(), std::runtime_error);
+
+      config.rx_len = 0;
+      CPPUNIT_ASSERT_THROW(pulse_framer::make(config), std::invalid_argument);
+    }
+
+    void
+    qa_pulse_framer::t2()
+    {
+      // Broken pulses are cut short and the next pulse starts cleanly
+      pulse_framer::config_t config;
+      config.rx_len = 100;
+      config.num_slots = 8;
+      config.rate = RATE;
+      pulse_framer::sptr framer = pulse_framer::make(config);
+
+      // A timestamp gap: the packet after it opens the next pulse
+      stream(framer, 0, 40, 40);
+      stream(framer, 1000, 1100, 50);
+      CPPUNIT_ASSERT(check_pulse(framer, 0, 0, 40, true));
+      CPPUNIT_ASSERT(check_pulse(framer, 1, 1000, 100, false));
+
+      // End of burst, start of burst and an error
+      uhd::rx_metadata_t md = metadata(2000);
+      md.end_of_burst = true;
+      recv_packet(framer, 30, 2000, md);
+      CPPUNIT_ASSERT(check_pulse(framer, 2, 2000, 30, true));
+
+      recv_packet(framer, 30, 3000, metadata(3000));
+      md = metadata(3030);
+      md.start_of_burst = true;
+      recv_packet(framer, 30, 3030, md);
+      CPPUNIT_ASSERT(check_pulse(framer, 3, 3000, 30, true));
+
+      md = metadata(0);
+      md.error_code = uhd::rx_metadata_t::ERROR_CODE_OVERFLOW;
+      framer->push(0, md);
+      CPPUNIT_ASSERT(check_pulse(framer, 4, 3030, 30, true));
+
+      recv_packet(framer, 10, 4000, metadata(4000));
+      framer->flush();
+      CPPUNIT_ASSERT(check_pulse(framer, 5, 4000, 10, true));
+      CPPUNIT_ASSERT_EQUAL(size_t(0), framer->size());
+
+      const pulse_framer::stats_t stats = framer->get_stats();
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(6), stats.pulses);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(5), stats.truncated);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(1), stats.discontinuities);
+
+      size_t max_samps;
+      framer->recv_buffer(max_samps);
+      CPPUNIT_ASSERT_THROW(framer->push(max_samps + 1, metadata(5000)), std::invalid_argument);
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
@@ -0,0 +1,200 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include "qa_pulse_integrator.h"
+#include <wavegen/pulse_integrator.h>
+#include <stdexcept>
+
+namespace gr {
+  namespace wavegen {
+
+    static const size_t RX_LEN = 48;
+
+    /* sc16 words for pulse p, a different ramp per pulse */
+    static std::vector<boost::int16_t>
+    sc16_pulse(size_t p)
+    {
+      std::vector<boost::int16_t> x(2 * RX_LEN);
+      for (size_t n = 0; n < RX_LEN; n++) {
+        x[2 * n] = boost::int16_t(100 * n + 7 * p);
+        x[2 * n + 1] = boost::int16_t(-50 * int(n) + 3 * int(p));
+      }
+      return x;
+    }
+
+    static pulse_framer::pulse_t
+    make_pulse(boost::uint64_t index, const void *samples)
+    {
+      pulse_framer::pulse_t pulse;
+      pulse.index = index;
+      pulse.has_time = true;
+      pulse.time = uhd::time_spec_t(1.0 + 0.001 * double(index));
+      pulse.nsamps = RX_LEN;
+      pulse.samples = samples;
+      return pulse;
+    }
+
+    void
+    qa_pulse_integrator::t1()
+    {
+      /* Decimated and integrated records against a direct sum */
+      const size_t K = 4, D = 3;
+      std::vector<std::vector<boost::int16_t> > pulses;
+      for (size_t p = 0; p < K; p++) {
+        pulses.push_back(sc16_pulse(p));
+      }
+
+      pulse_integrator::config_t config;
+      config.rx_len = RX_LEN;
+      config.num_pulses = K;
+      config.decimation = D;
+      config.average = false;
+      config.scale = 1.0f;
+      pulse_integrator::sptr sum = pulse_integrator::make(config);
+      CPPUNIT_ASSERT_EQUAL(RX_LEN / D, sum->get_output_len());
+      config.output = pulse_integrator::OUTPUT_SC16;
+      pulse_integrator::sptr mean = pulse_integrator::make(config);
+
+      pulse_framer::pulse_t rec_sum, rec_mean;
+      for (size_t p = 0; p < K; p++) {
+        const pulse_framer::pulse_t pulse = make_pulse(p, &pulses[p][0]);
+        CPPUNIT_ASSERT_EQUAL(p == K - 1, sum->add(pulse, rec_sum));
+        CPPUNIT_ASSERT_EQUAL(p == K - 1, mean->add(pulse, rec_mean));
+      }
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(0), rec_sum.index);
+      CPPUNIT_ASSERT_EQUAL(RX_LEN / D, rec_sum.nsamps);
+      CPPUNIT_ASSERT(not rec_sum.truncated);
+      CPPUNIT_ASSERT(rec_sum.has_time);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(1.0, rec_sum.time.get_real_secs(), 1e-9);
+
+      const gr_complex *out = static_cast<const gr_complex *>(rec_sum.samples);
+      const boost::int16_t *out16 = static_cast<const boost::int16_t *>(rec_mean.samples);
+      for (size_t j = 0; j < RX_LEN / D; j++) {
+        double re = 0.0, im = 0.0;
+        for (size_t p = 0; p < K; p++) {
+          for (size_t k = 0; k < D; k++) {
+            re += pulses[p][2 * (j * D + k)];
+            im += pulses[p][2 * (j * D + k) + 1];
+          }
+        }
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(re, out[j].real(), 1e-3);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(im, out[j].imag(), 1e-3);
+        CPPUNIT_ASSERT(std::abs(re / (K * D) - out16[2 * j]) <= 0.5);
+        CPPUNIT_ASSERT(std::abs(im / (K * D) - out16[2 * j + 1]) <= 0.5);
+      }
+
+      /* 4 * 3 sc16 pulses into one sc16 record, 12x; fc32 out is half that */
+      const pulse_integrator::stats_t s16 = mean->get_stats();
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(K * RX_LEN * 4), s16.bytes_in);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(RX_LEN / D * 4), s16.bytes_out);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(RX_LEN / D * 8), sum->get_stats().bytes_out);
+
+      /* Averaging fc32 input gives back a pulse repeated K times */
+      std::vector<gr_complex> fc(RX_LEN);
+      for (size_t n = 0; n < RX_LEN; n++) {
+        fc[n] = gr_complex(float(n), -0.5f * float(n));
+      }
+      pulse_integrator::config_t fconfig;
+      fconfig.rx_len = RX_LEN;
+      fconfig.num_pulses = K;
+      fconfig.input = pulse_integrator::INPUT_FC32;
+      pulse_integrator::sptr avg = pulse_integrator::make(fconfig);
+      pulse_framer::pulse_t rec;
+      for (size_t p = 0; p < K; p++) {
+        avg->add(make_pulse(p, &fc[0]), rec);
+      }
+      out = static_cast<const gr_complex *>(rec.samples);
+      for (size_t n = 0; n < RX_LEN; n++) {
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(fc[n].real(), out[n].real(), 1e-4);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(fc[n].imag(), out[n].imag(), 1e-4);
+      }
+
+      /* The reference decimates the same way */
+      const std::vector<gr_complex> ref = pulse_integrator::decimate(fc, D);
+      CPPUNIT_ASSERT_EQUAL(RX_LEN / D, ref.size());
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(3.0 + 4.0 + 5.0, ref[1].real(), 1e-4);
+
+      fconfig.decimation = 5;
+      CPPUNIT_ASSERT_THROW(pulse_integrator::make(fconfig), std::invalid_argument);
+      fconfig.decimation = 1;
+      fconfig.output = pulse_integrator::OUTPUT_SC16;
+      CPPUNIT_ASSERT_THROW(pulse_integrator::make(fconfig), std::invalid_argument);
+      fconfig.output = pulse_integrator::OUTPUT_FC32;
+      fconfig.num_pulses = 0;
+      CPPUNIT_ASSERT_THROW(pulse_integrator::make(fconfig), std::invalid_argument);
+    }
+
+    void
+    qa_pulse_integrator::t2()
+    {
+      /* Records follow the pulse index through drops and stragglers */
+      const size_t K = 4;
+      const std::vector<boost::int16_t> x = sc16_pulse(1);
+      pulse_integrator::config_t config;
+      config.rx_len = RX_LEN;
+      config.num_pulses = K;
+      config.scale = 1.0f;
+      pulse_integrator::sptr integ = pulse_integrator::make(config);
+      pulse_framer::pulse_t rec;
+
+      /* Record 0 misses pulse 0 and is completed by pulse 5 */
+      CPPUNIT_ASSERT(not integ->add(make_pulse(1, &x[0]), rec));
+      CPPUNIT_ASSERT(not integ->add(make_pulse(2, &x[0]), rec));
+      CPPUNIT_ASSERT(not integ->add(make_pulse(3, &x[0]), rec));
+      CPPUNIT_ASSERT(integ->add(make_pulse(5, &x[0]), rec));
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(0), rec.index);
+      CPPUNIT_ASSERT(rec.truncated);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(1.001, rec.time.get_real_secs(), 1e-9);
+      /* Still a mean with a pulse missing */
+      const gr_complex *out = static_cast<const gr_complex *>(rec.samples);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(x[2 * 10], out[10].real(), 1e-3);
+
+      /* Pulse 2 is too late for record 0 */
+      CPPUNIT_ASSERT(not integ->add(make_pulse(2, &x[0]), rec));
+
+      /* Pulse 13 hands on record 1 and starts record 3; record 2 never came */
+      CPPUNIT_ASSERT(integ->add(make_pulse(13, &x[0]), rec));
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(1), rec.index);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(1.005, rec.time.get_real_secs(), 1e-9);
+
+      /* A truncated pulse counts as zeros past its end, so the tail
+       * of record 3 averages to half */
+      pulse_framer::pulse_t short_pulse = make_pulse(14, &x[0]);
+      short_pulse.nsamps = RX_LEN / 2;
+      short_pulse.truncated = true;
+      CPPUNIT_ASSERT(not integ->add(short_pulse, rec));
+      CPPUNIT_ASSERT(integ->flush(rec));
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(3), rec.index);
+      out = static_cast<const gr_complex *>(rec.samples);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(x[2 * 10], out[10].real(), 1e-3);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(0.5 * x[2 * (RX_LEN - 1)], out[RX_LEN - 1].real(), 1e-3);
+      CPPUNIT_ASSERT(not integ->flush(rec));
+
+      const pulse_integrator::stats_t stats = integ->get_stats();
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(6), stats.pulses);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(3), stats.records);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(1), stats.late_pulses);
+      /* 1 from record 0, 3 from record 1, 4 for record 2, 2 from record 3 */
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(10), stats.missing_pulses);
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
@@ -0,0 +1,256 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include "qa_pulse_ring.h"
+#include <wavegen/pulse_ring_writer.h>
+#include <wavegen/pulse_ring_reader.h>
+#include <boost/format.hpp>
+#include <complex>
+#include <stdexcept>
+#include <vector>
+#include <unistd.h>
+#include <sys/wait.h>
+
+namespace gr {
+  namespace wavegen {
+
+    static const double RATE = 1e6;
+    static const size_t RX_LEN = 100;
+    static const size_t NUM_SLOTS = 8;
+
+    static std::string
+    ring_name(const char *test)
+    {
+      return str(boost::format("/qa_pulse_ring_%s_%d") % test % ::getpid());
+    }
+
+    static pulse_file::info_t
+    test_info()
+    {
+      pulse_file::info_t info;
+      info.format = pulse_file::FORMAT_SC16;
+      info.rate = RATE;
+      info.rx_len = RX_LEN;
+      info.prf_count = 1000;
+      info.integrated_pulses = 4;
+      return info;
+    }
+
+    /* Pulse n starts at tick 1000 * n and its samples are n + i */
+    static void
+    publish(pulse_ring_writer::sptr writer, size_t n, size_t nsamps = RX_LEN)
+    {
+      std::vector<std::complex<short> > samples(nsamps);
+      for (size_t i = 0; i < nsamps; i++) {
+        samples[i] = std::complex<short>(short(n + i), short(-int(n)));
+      }
+      pulse_framer::pulse_t pulse;
+      pulse.index = n;
+      pulse.has_time = true;
+      pulse.time = uhd::time_spec_t::from_ticks(1000 * n, RATE);
+      pulse.nsamps = nsamps;
+      pulse.truncated = false;
+      pulse.samples = &samples[0];
+      writer->publish(pulse);
+    }
+
+    static bool
+    check(const pulse_framer::pulse_t &pulse, size_t n)
+    {
+      if (pulse.index != n or not pulse.has_time
+          or pulse.time.to_ticks(RATE) != boost::int64_t(1000 * n)) {
+        return false;
+      }
+      const std::complex<short> *x = static_cast<const std::complex<short> *>(pulse.samples);
+      for (size_t i = 0; i < pulse.nsamps; i++) {
+        if (x[i] != std::complex<short>(short(n + i), short(-int(n)))) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    void
+    qa_pulse_ring::t1()
+    {
+      // Two readers each see every record, in place
+      const std::string name = ring_name("t1");
+      pulse_ring_writer::config_t config;
+      config.num_slots = NUM_SLOTS;
+      config.max_consumers = 2;
+      pulse_ring_writer::sptr writer = pulse_ring_writer::make(name, test_info(), config);
+      CPPUNIT_ASSERT_THROW(pulse_ring_writer::make(name, test_info(), config), std::runtime_error);
+
+      pulse_ring_reader::sptr a = pulse_ring_reader::make(name);
+      pulse_ring_reader::sptr b = pulse_ring_reader::make(name);
+      CPPUNIT_ASSERT_THROW(pulse_ring_reader::make(name), std::runtime_error);
+      CPPUNIT_ASSERT_EQUAL(RX_LEN, size_t(a->get_info().rx_len));
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(4), a->get_info().integrated_pulses);
+      CPPUNIT_ASSERT_EQUAL(size_t(4), a->get_item_size());
+      CPPUNIT_ASSERT_EQUAL(NUM_SLOTS, a->get_num_slots());
+
+      pulse_framer::pulse_t p;
+      CPPUNIT_ASSERT(not a->front(p));
+      CPPUNIT_ASSERT(not a->pop());
+      for (size_t n = 0; n < 5; n++) {
+        publish(writer, n, (n == 3) ? RX_LEN / 2 : RX_LEN);
+      }
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(5), a->lag());
+
+      for (size_t n = 0; n < 5; n++) {
+        CPPUNIT_ASSERT(a->front(p));
+        CPPUNIT_ASSERT(check(p, n));
+        CPPUNIT_ASSERT_EQUAL((n == 3) ? RX_LEN / 2 : RX_LEN, p.nsamps);
+        // front() again gives the same record
+        pulse_framer::pulse_t q;
+        CPPUNIT_ASSERT(a->front(q));
+        CPPUNIT_ASSERT_EQUAL(p.samples, q.samples);
+        CPPUNIT_ASSERT(a->pop());
+      }
+      CPPUNIT_ASSERT(not a->front(p));
+
+      // b is independent of a
+      std::vector<pulse_ring_writer::consumer_info_t> consumers = writer->get_consumers();
+      CPPUNIT_ASSERT_EQUAL(size_t(2), consumers.size());
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(0), consumers[0].lag);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(5), consumers[0].records);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(5), consumers[1].lag);
+      CPPUNIT_ASSERT(consumers[1].lagging);
+      CPPUNIT_ASSERT(not consumers[1].overrun);
+      CPPUNIT_ASSERT(b->front(p));
+      CPPUNIT_ASSERT(check(p, 0));
+
+      // A pulse longer than a slot is cut short
+      publish(writer, 5, RX_LEN + 10);
+      CPPUNIT_ASSERT(a->front(p));
+      CPPUNIT_ASSERT_EQUAL(RX_LEN, p.nsamps);
+      CPPUNIT_ASSERT(p.truncated);
+      CPPUNIT_ASSERT(check(p, 5));
+      CPPUNIT_ASSERT(a->pop());
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(1), writer->get_stats().truncated_pulses);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(6), writer->get_stats().records);
+
+      // Closing ends the stream only once it is read, and frees the name
+      CPPUNIT_ASSERT(not a->closed());
+      writer->close();
+      CPPUNIT_ASSERT(a->closed());
+      CPPUNIT_ASSERT(not b->closed());
+      CPPUNIT_ASSERT_THROW(pulse_ring_reader::make(name), std::runtime_error);
+      pulse_ring_writer::make(name, test_info(), config);
+
+      // A detached reader frees its entry
+      a.reset();
+      CPPUNIT_ASSERT_EQUAL(size_t(1), writer->get_consumers().size());
+
+      pulse_ring_writer::config_t bad = config;
+      bad.num_slots = 6;
+      CPPUNIT_ASSERT_THROW(pulse_ring_writer::make(name + "_bad", test_info(), bad), std::invalid_argument);
+      CPPUNIT_ASSERT_THROW(pulse_ring_writer::make("no_slash", test_info(), config), std::invalid_argument);
+    }
+
+    void
+    qa_pulse_ring::t2()
+    {
+      // Lapped, torn and dead readers
+      const std::string name = ring_name("t2");
+      pulse_ring_writer::config_t config;
+      config.num_slots = NUM_SLOTS;
+      config.max_consumers = 2;
+      config.lag_threshold = 6;
+      pulse_ring_writer::sptr writer = pulse_ring_writer::make(name, test_info(), config);
+      pulse_ring_reader::sptr r = pulse_ring_reader::make(name);
+
+      // 20 records into 8 slots: the first 12 are gone
+      for (size_t n = 0; n < 20; n++) {
+        publish(writer, n);
+      }
+      std::vector<pulse_ring_writer::consumer_info_t> consumers = writer->get_consumers();
+      CPPUNIT_ASSERT_EQUAL(size_t(1), consumers.size());
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(::getpid()), consumers[0].pid);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(20), consumers[0].lag);
+      CPPUNIT_ASSERT(consumers[0].lagging);
+      CPPUNIT_ASSERT(consumers[0].overrun);
+
+      pulse_framer::pulse_t p;
+      for (size_t n = 12; n < 20; n++) {
+        CPPUNIT_ASSERT(r->front(p));
+        CPPUNIT_ASSERT(check(p, n));
+        CPPUNIT_ASSERT(r->pop());
+      }
+      pulse_ring_reader::stats_t stats = r->get_stats();
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(8), stats.records);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(12), stats.dropped);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(0), stats.lag);
+
+      // Overwritten while held: pop() reports it
+      publish(writer, 20);
+      CPPUNIT_ASSERT(r->front(p));
+      CPPUNIT_ASSERT(check(p, 20));
+      for (size_t n = 21; n < 21 + NUM_SLOTS; n++) {
+        publish(writer, n);
+      }
+      CPPUNIT_ASSERT(not r->pop());
+      CPPUNIT_ASSERT(r->front(p));
+      CPPUNIT_ASSERT(check(p, 21));
+      CPPUNIT_ASSERT(r->pop());
+      stats = r->get_stats();
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(1), stats.torn);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(12), stats.dropped);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(7), stats.lag);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(13), writer->get_stats().consumer_drops);
+
+      // Another process reads the oldest records, then dies attached
+      const pid_t child = ::fork();
+      if (child == 0) {
+        int status = 1;
+        try {
+          pulse_ring_reader::sptr c = pulse_ring_reader::make(name, true);
+          pulse_framer::pulse_t q;
+          status = 0;
+          for (size_t n = 21; n < 21 + NUM_SLOTS; n++) {
+            if (not c->front(q) or not check(q, n) or not c->pop()) {
+              status = 2;
+            }
+          }
+          // Leaked, so its entry stays claimed as if the process crashed
+          new pulse_ring_reader::sptr(c);
+        }
+        catch (...) {}
+        ::_exit(status);
+      }
+      int status = -1;
+      CPPUNIT_ASSERT_EQUAL(child, ::waitpid(child, &status, 0));
+      CPPUNIT_ASSERT(WIFEXITED(status));
+      CPPUNIT_ASSERT_EQUAL(0, WEXITSTATUS(status));
+
+      CPPUNIT_ASSERT_EQUAL(size_t(1), writer->get_consumers().size());
+      const pulse_ring_writer::stats_t wstats = writer->get_stats();
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(1), wstats.reaped_consumers);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(1), wstats.consumers);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(1), wstats.lagging_consumers);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(7), wstats.max_lag);
+      CPPUNIT_ASSERT(not r->closed());
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
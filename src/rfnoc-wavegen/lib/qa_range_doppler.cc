@@ -0,0 +1,211 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include "qa_range_doppler.h"
+#include <wavegen/range_doppler.h>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+#include <cmath>
+#include <stdexcept>
+
+namespace gr {
+  namespace wavegen {
+
+    static const size_t NUM_BINS = 200;
+    static const size_t CPI_LEN = 16;
+    static const double PRF = 1000.0;
+
+    /* Pulse \p p of a target in range bin \p bin moving at \p doppler Hz */
+    static std::vector<gr_complex>
+    target_pulse(size_t p, size_t bin, double doppler)
+    {
+      std::vector<gr_complex> bins(NUM_BINS, gr_complex(0.0f));
+      const double phase = 2.0 * M_PI * doppler * double(p) / PRF;
+      bins[bin] = gr_complex(float(std::cos(phase)), float(std::sin(phase)));
+      bins[(bin + 37) % NUM_BINS] += gr_complex(0.01f * float(p % CPI_LEN), 0.0f);
+      return bins;
+    }
+
+    static size_t
+    peak(const float *data, size_t n)
+    {
+      return size_t(std::max_element(data, data + n) - data);
+    }
+
+    void
+    qa_range_doppler::t1()
+    {
+      // A target at range bin 50 and -250 Hz peaks in its own cell
+      range_doppler::config_t config;
+      config.num_bins = NUM_BINS;
+      config.cpi_len = CPI_LEN;
+      config.window = gr::fft::window::WIN_NONE;
+      config.prf = PRF;
+      config.num_workers = 1;
+      range_doppler::sptr rd = range_doppler::make(config);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0, rd->doppler_frequency(CPI_LEN / 2), 1e-9);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(-250.0, rd->doppler_frequency(4), 1e-9);
+
+      std::vector<gr_complex> cube;
+      for (size_t p = 0; p < CPI_LEN; p++) {
+        const std::vector<gr_complex> bins = target_pulse(p, 50, -250.0);
+        cube.insert(cube.end(), bins.begin(), bins.end());
+      }
+      std::vector<float> map(NUM_BINS * CPI_LEN);
+      rd->process(&cube[0], &map[0]);
+      CPPUNIT_ASSERT_EQUAL(size_t(50 * CPI_LEN + 4), peak(&map[0], map.size()));
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(double(CPI_LEN), map[50 * CPI_LEN + 4], 1e-3);
+      CPPUNIT_ASSERT(map[50 * CPI_LEN + 5] < 1e-3f);
+      // A ramp in bin 87 is mostly near zero Doppler
+      CPPUNIT_ASSERT_EQUAL(size_t(CPI_LEN / 2), peak(&map[87 * CPI_LEN], CPI_LEN));
+
+      // Power is magnitude squared; zero padding doubles the columns
+      config.output = range_doppler::OUTPUT_POWER;
+      config.doppler_size = 2 * CPI_LEN;
+      rd = range_doppler::make(config);
+      map.resize(NUM_BINS * 2 * CPI_LEN);
+      rd->process(&cube[0], &map[0]);
+      CPPUNIT_ASSERT_EQUAL(size_t(50 * 2 * CPI_LEN + 8), peak(&map[0], map.size()));
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(double(CPI_LEN * CPI_LEN), map[50 * 2 * CPI_LEN + 8], 1e-2);
+
+      // The taper lowers the sidelobes away from the target
+      config.output = range_doppler::OUTPUT_MAGNITUDE;
+      config.doppler_size = 0;
+      config.window = gr::fft::window::WIN_HAMMING;
+      config.cpi_len = CPI_LEN;
+      std::vector<float> tapered(NUM_BINS * CPI_LEN);
+      std::vector<gr_complex> off_cube;
+      for (size_t p = 0; p < CPI_LEN; p++) {
+        const std::vector<gr_complex> bins = target_pulse(p, 50, -220.0);
+        off_cube.insert(off_cube.end(), bins.begin(), bins.end());
+      }
+      range_doppler::make(config)->process(&off_cube[0], &tapered[0]);
+      config.window = gr::fft::window::WIN_NONE;
+      map.resize(NUM_BINS * CPI_LEN);
+      range_doppler::make(config)->process(&off_cube[0], &map[0]);
+      CPPUNIT_ASSERT(tapered[50 * CPI_LEN + 12] / tapered[50 * CPI_LEN + 4]
+                     < map[50 * CPI_LEN + 12] / map[50 * CPI_LEN + 4]);
+
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(1000.0, range_doppler::prf_from_count(200000, 200e6), 1e-9);
+      CPPUNIT_ASSERT_THROW(range_doppler::prf_from_count(0, 200e6), std::invalid_argument);
+      config.prf = 0.0;
+      CPPUNIT_ASSERT_THROW(range_doppler::make(config), std::invalid_argument);
+      config.prf = PRF;
+      config.doppler_size = CPI_LEN - 1;
+      CPPUNIT_ASSERT_THROW(range_doppler::make(config), std::invalid_argument);
+    }
+
+    static bool
+    dropped(size_t p)
+    {
+      return p % 11 == 3 or (p >= 48 and p < 64);
+    }
+
+    static void
+    feed(range_doppler::sptr rd, size_t num_pulses)
+    {
+      for (size_t p = 0; p < num_pulses; p++) {
+        if (dropped(p)) {
+          continue;
+        }
+        const std::vector<gr_complex> bins = target_pulse(p, p / CPI_LEN * 10, 125.0);
+        pulse_framer::pulse_t pulse;
+        pulse.index = p;
+        pulse.has_time = true;
+        pulse.time = uhd::time_spec_t(10.0 + double(p) / PRF);
+        pulse.nsamps = (p % 5 == 0) ? 100 : NUM_BINS;
+        pulse.samples = &bins[0];
+        rd->add(pulse);
+        if (p == 40) {
+          // Belongs to a CPI that has been handed on
+          pulse.index = 5;
+          rd->add(pulse);
+        }
+      }
+      rd->flush();
+    }
+
+    void
+    qa_range_doppler::t2()
+    {
+      // Pipeline maps match process() on the same pulses, missing ones zero
+      range_doppler::config_t config;
+      config.num_bins = NUM_BINS;
+      config.cpi_len = CPI_LEN;
+      config.prf = PRF;
+      config.num_workers = 3;
+      config.num_cpis = 2;
+      range_doppler::sptr rd = range_doppler::make(config);
+      const size_t num_pulses = 7 * CPI_LEN + 5;
+      boost::thread producer(boost::bind(&feed, rd, num_pulses));
+
+      const size_t expected_cpis[] = {0, 1, 2, 4, 5, 6, 7};
+      std::vector<float> expected(NUM_BINS * CPI_LEN);
+      for (size_t n = 0; n < sizeof(expected_cpis) / sizeof(expected_cpis[0]); n++) {
+        const size_t cpi = expected_cpis[n];
+        range_doppler::map_t map;
+        while (not rd->front(map)) {
+          boost::this_thread::yield();
+        }
+        CPPUNIT_ASSERT_EQUAL(boost::uint64_t(cpi), map.index);
+        CPPUNIT_ASSERT_EQUAL(boost::uint64_t(cpi * CPI_LEN), map.first_pulse);
+        CPPUNIT_ASSERT_EQUAL(NUM_BINS, map.num_bins);
+        CPPUNIT_ASSERT_EQUAL(CPI_LEN, map.doppler_size);
+        CPPUNIT_ASSERT(map.has_time);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(10.0 + double(cpi * CPI_LEN) / PRF, map.time.get_real_secs(), 1e-9);
+
+        std::vector<gr_complex> cube(CPI_LEN * NUM_BINS, gr_complex(0.0f));
+        size_t pulses = 0;
+        for (size_t i = 0; i < CPI_LEN; i++) {
+          const size_t p = cpi * CPI_LEN + i;
+          if (p >= num_pulses or dropped(p)) {
+            continue;
+          }
+          const std::vector<gr_complex> bins = target_pulse(p, cpi * 10, 125.0);
+          std::copy(bins.begin(), bins.begin() + ((p % 5 == 0) ? 100 : NUM_BINS),
+                    cube.begin() + i * NUM_BINS);
+          pulses++;
+        }
+        CPPUNIT_ASSERT_EQUAL(pulses, map.pulses);
+        rd->process(&cube[0], &expected[0]);
+        CPPUNIT_ASSERT(std::equal(expected.begin(), expected.end(), map.data));
+        CPPUNIT_ASSERT_EQUAL(size_t(cpi * 10 * CPI_LEN + 10), peak(map.data, NUM_BINS * CPI_LEN));
+        rd->pop();
+      }
+      producer.join();
+      CPPUNIT_ASSERT_EQUAL(size_t(0), rd->size());
+
+      const range_doppler::stats_t stats = rd->get_stats();
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(7), stats.cpis);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(1), stats.late_pulses);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(7 * CPI_LEN) - stats.pulses, stats.missing_pulses);
+
+      pulse_framer::pulse_t pulse;
+      pulse.nsamps = NUM_BINS + 1;
+      CPPUNIT_ASSERT_THROW(rd->add(pulse), std::invalid_argument);
+      CPPUNIT_ASSERT_THROW(rd->pop(), std::runtime_error);
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
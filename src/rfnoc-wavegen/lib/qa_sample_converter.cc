@@ -0,0 +1,157 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include "qa_sample_converter.h"
+#include <wavegen/sample_converter.h>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+#include <cmath>
+#include <stdexcept>
+#include <sched.h>
+
+namespace gr {
+  namespace wavegen {
+
+    /* Block b, sample k holds (b + k, -(b + k)) modulo the int16 range
+     * plus a DC offset of (100, -50) */
+    static std::complex<short>
+    test_sample(size_t b, size_t k)
+    {
+      const short v = short((b + k) % 1000);
+      return std::complex<short>(short(v + 100), short(-v - 50));
+    }
+
+    static size_t
+    test_nsamps(size_t b)
+    {
+      return 1 + (b * 37) % 500;
+    }
+
+    static void
+    produce(sample_converter::sptr converter, size_t num_blocks)
+    {
+      for (size_t b = 0; b < num_blocks; b++) {
+        std::complex<short> *in = converter->acquire();
+        const size_t n = test_nsamps(b);
+        for (size_t k = 0; k < n; k++) {
+          in[k] = test_sample(b, k);
+        }
+        converter->submit(n);
+      }
+    }
+
+    template <typename T> static bool
+    check_block(const sample_converter::block_t &block, size_t b, float scale, bool remove_dc)
+    {
+      const std::complex<T> *out = static_cast<const std::complex<T> *>(block.samples);
+      if (block.nsamps != test_nsamps(b)) {
+        return false;
+      }
+      double mean_i = 0.0, mean_q = 0.0;
+      if (remove_dc) {
+        for (size_t k = 0; k < block.nsamps; k++) {
+          mean_i += test_sample(b, k).real();
+          mean_q += test_sample(b, k).imag();
+        }
+        mean_i /= block.nsamps;
+        mean_q /= block.nsamps;
+      }
+      for (size_t k = 0; k < block.nsamps; k++) {
+        const std::complex<short> in = test_sample(b, k);
+        if (std::abs(double(out[k].real()) - (in.real() - mean_i) / scale) > 1e-5
+            or std::abs(double(out[k].imag()) - (in.imag() - mean_q) / scale) > 1e-5) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    template <typename T> static void
+    run(const sample_converter::config_t &config, size_t num_blocks)
+    {
+      sample_converter::sptr converter = sample_converter::make(config);
+      CPPUNIT_ASSERT_EQUAL(sizeof(std::complex<T>), converter->output_item_size());
+      boost::thread producer(boost::bind(&produce, converter, num_blocks));
+      for (size_t b = 0; b < num_blocks; b++) {
+        sample_converter::block_t block;
+        while (not converter->front(block)) {
+          boost::this_thread::yield();
+        }
+        CPPUNIT_ASSERT(check_block<T>(block, b, config.scale, config.remove_dc));
+        converter->pop();
+      }
+      producer.join();
+      CPPUNIT_ASSERT_EQUAL(size_t(0), converter->size());
+
+      sample_converter::block_t block;
+      CPPUNIT_ASSERT(not converter->front(block));
+      CPPUNIT_ASSERT_THROW(converter->pop(), std::runtime_error);
+      const sample_converter::stats_t stats = converter->get_stats();
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(num_blocks), stats.blocks);
+      CPPUNIT_ASSERT(stats.max_pending <= config.num_blocks);
+    }
+
+    void
+    qa_sample_converter::t1()
+    {
+      // fc32 across several workers, delivered in order
+      sample_converter::config_t config;
+      config.num_workers = 3;
+      config.num_blocks = 8;
+      config.block_samps = 500;
+      run<float>(config, 2000);
+    }
+
+    void
+    qa_sample_converter::t2()
+    {
+      // fc64 with DC removal and a custom scale; bad arguments
+      sample_converter::config_t config;
+      config.output = sample_converter::OUTPUT_FC64;
+      config.num_workers = 2;
+      config.num_blocks = 4;
+      config.block_samps = 500;
+      config.scale = 1000.0f;
+      config.remove_dc = true;
+      run<double>(config, 500);
+
+      sample_converter::sptr converter = sample_converter::make(config);
+      converter->acquire();
+      CPPUNIT_ASSERT_THROW(converter->submit(501), std::invalid_argument);
+      config.num_workers = 0;
+      CPPUNIT_ASSERT_THROW(sample_converter::make(config), std::invalid_argument);
+      config.num_workers = 1;
+      config.scale = 0.0f;
+      CPPUNIT_ASSERT_THROW(sample_converter::make(config), std::invalid_argument);
+
+      // A strict profile that cannot pin the workers fails make()
+      config.scale = 1.0f;
+      thread_profile::config_t thread_config;
+      thread_config.roles[thread_profile::ROLE_CONVERT].cpus.push_back(CPU_SETSIZE - 1);
+      thread_config.strict = true;
+      config.threads = thread_profile::make(thread_config);
+      CPPUNIT_ASSERT_THROW(sample_converter::make(config), std::runtime_error);
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
@@ -0,0 +1,147 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include "qa_sample_recorder.h"
+#include <wavegen/sample_recorder.h>
+#include <boost/filesystem.hpp>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace gr {
+  namespace wavegen {
+
+    static std::string
+    temp_path()
+    {
+      return (boost::filesystem::temp_directory_path()
+              / boost::filesystem::unique_path("qa_sample_recorder-%%%%-%%%%.dat")).string();
+    }
+
+    static std::vector<char>
+    read_file(const std::string &path)
+    {
+      std::ifstream in(path.c_str(), std::ios::binary);
+      return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    void
+    qa_sample_recorder::t1()
+    {
+      // Many writers, batched and direct writes, a short last buffer
+      const std::string path = temp_path();
+      sample_recorder::config_t config;
+      config.num_buffers = 8;
+      config.buffer_size = 4 * sample_recorder::ALIGNMENT;
+      config.num_writers = 3;
+      config.max_batch = 3;
+
+      std::vector<char> expected;
+      {
+        sample_recorder::sptr recorder = sample_recorder::make(path, config);
+        for (size_t n = 0; n < 200; n++) {
+          sample_recorder::buffer_t buffer;
+          CPPUNIT_ASSERT(recorder->acquire(buffer));
+          CPPUNIT_ASSERT_EQUAL(config.buffer_size, buffer.size);
+          CPPUNIT_ASSERT_EQUAL(size_t(0), size_t(buffer.data - (char *)0) % sample_recorder::ALIGNMENT);
+          const size_t nbytes = (n == 199) ? 1000 : buffer.size;
+          for (size_t i = 0; i < nbytes; i++) {
+            buffer.data[i] = char(n * 7 + i);
+          }
+          expected.insert(expected.end(), buffer.data, buffer.data + nbytes);
+          recorder->commit(buffer, nbytes);
+        }
+        recorder->close();
+
+        const sample_recorder::stats_t stats = recorder->get_stats();
+        CPPUNIT_ASSERT_EQUAL(boost::uint64_t(200), stats.buffers_written);
+        CPPUNIT_ASSERT_EQUAL(boost::uint64_t(expected.size()), stats.bytes_written);
+        CPPUNIT_ASSERT(stats.writes <= 200);
+        CPPUNIT_ASSERT(stats.max_queued <= config.num_buffers);
+        CPPUNIT_ASSERT_EQUAL(boost::uint64_t(0), stats.buffers_dropped);
+      }
+      CPPUNIT_ASSERT(read_file(path) == expected);
+      boost::filesystem::remove(path);
+    }
+
+    void
+    qa_sample_recorder::t2()
+    {
+      // Drop policy, buffer returns and bad arguments
+      const std::string path = temp_path();
+      sample_recorder::config_t config;
+      config.num_buffers = 2;
+      config.buffer_size = sample_recorder::ALIGNMENT;
+      config.policy = sample_recorder::POLICY_DROP;
+      sample_recorder::sptr recorder = sample_recorder::make(path, config);
+
+      sample_recorder::buffer_t a, b, c;
+      CPPUNIT_ASSERT(recorder->acquire(a));
+      CPPUNIT_ASSERT(recorder->acquire(b));
+      CPPUNIT_ASSERT(not recorder->acquire(c));
+      recorder->drop(4096);
+      recorder->commit(a, 0);
+      CPPUNIT_ASSERT(recorder->acquire(c));
+      CPPUNIT_ASSERT_THROW(recorder->commit(b, 4097), std::invalid_argument);
+      sample_recorder::buffer_t stray = { NULL, 0 };
+      CPPUNIT_ASSERT_THROW(recorder->commit(stray, 1), std::invalid_argument);
+      recorder->commit(b, 10);
+      recorder->commit(c, 0);
+      recorder->close();
+
+      const sample_recorder::stats_t stats = recorder->get_stats();
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(1), stats.buffers_dropped);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(4096), stats.bytes_dropped);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(10), stats.bytes_written);
+      CPPUNIT_ASSERT_EQUAL(size_t(10), read_file(path).size());
+      boost::filesystem::remove(path);
+
+      // With a shared pool, buffers another stage holds are not reused
+      buffer_pool::config_t pool_config;
+      pool_config.num_buffers = 2;
+      pool_config.buffer_size = 2 * buffer_pool::ALIGNMENT;
+      config.pool = buffer_pool::make(pool_config);
+      buffer_pool::handle_t other;
+      CPPUNIT_ASSERT(config.pool->try_acquire(other));
+      recorder = sample_recorder::make(path, config);
+      CPPUNIT_ASSERT(recorder->acquire(a));
+      CPPUNIT_ASSERT_EQUAL(pool_config.buffer_size, a.size);
+      CPPUNIT_ASSERT(a.data != other.data());
+      CPPUNIT_ASSERT(not recorder->acquire(b));
+      std::memset(a.data, 'x', 100);
+      recorder->commit(a, 100);
+      recorder->close();
+      CPPUNIT_ASSERT_EQUAL(size_t(1), config.pool->available());
+      CPPUNIT_ASSERT_EQUAL(size_t(100), read_file(path).size());
+      boost::filesystem::remove(path);
+      config.pool.reset();
+
+      config.buffer_size = 1000;
+      CPPUNIT_ASSERT_THROW(sample_recorder::make(path, config), std::invalid_argument);
+      config.buffer_size = sample_recorder::ALIGNMENT;
+      CPPUNIT_ASSERT_THROW(sample_recorder::make("/nonexistent/dir/file.dat", config), std::runtime_error);
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
@@ -0,0 +1,229 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include "qa_thread_profile.h"
+#include <wavegen/thread_profile.h>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/barrier.hpp>
+#include <boost/bind.hpp>
+#include <stdexcept>
+#include <vector>
+#include <sched.h>
+#include <pthread.h>
+
+namespace gr {
+  namespace wavegen {
+
+    typedef thread_profile::thread_stats_t thread_stats_t;
+
+    /* First core this process may run on */
+    static int
+    first_allowed_cpu()
+    {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      sched_getaffinity(0, sizeof(set), &set);
+      for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &set)) {
+          return cpu;
+        }
+      }
+      return 0;
+    }
+
+    static void
+    spin(thread_profile::sptr profile, thread_profile::role_t role, int *cpu)
+    {
+      thread_profile::scoped_role r(profile, role, "spin");
+      volatile double x = 0.0;
+      for (int i = 0; i < 2000000; i++) {
+        x += i;
+      }
+      *cpu = sched_getcpu();
+    }
+
+    static void
+    wait_at(thread_profile::sptr profile, boost::barrier *entered, boost::barrier *done)
+    {
+      thread_profile::scoped_role r(profile, thread_profile::ROLE_CONTROL, "waiter");
+      entered->wait();
+      done->wait();
+    }
+
+    static void
+    enter_strict(thread_profile::sptr profile, int *result)
+    {
+      try {
+        profile->enter(thread_profile::ROLE_RECEIVE, "strict");
+        int policy;
+        struct sched_param param;
+        pthread_getschedparam(pthread_self(), &policy, &param);
+        *result = (policy == SCHED_FIFO and param.sched_priority == 1) ? 1 : -1;
+        profile->leave();
+      }
+      catch (const std::runtime_error &) {
+        *result = 0;
+      }
+    }
+
+    void
+    qa_thread_profile::t1()
+    {
+      // Parsing, validation and an unpinned profile on this thread
+      std::vector<int> cpus = thread_profile::parse_cpus("4-6, 9");
+      CPPUNIT_ASSERT_EQUAL(size_t(4), cpus.size());
+      CPPUNIT_ASSERT_EQUAL(4, cpus[0]);
+      CPPUNIT_ASSERT_EQUAL(6, cpus[2]);
+      CPPUNIT_ASSERT_EQUAL(9, cpus[3]);
+      CPPUNIT_ASSERT(thread_profile::parse_cpus("").empty());
+      CPPUNIT_ASSERT_EQUAL(size_t(1), thread_profile::parse_cpus("2\n").size());
+      CPPUNIT_ASSERT_THROW(thread_profile::parse_cpus("3-1"), std::invalid_argument);
+      CPPUNIT_ASSERT_THROW(thread_profile::parse_cpus("a"), std::invalid_argument);
+      CPPUNIT_ASSERT(thread_profile::parse_policy("fifo") == thread_profile::POLICY_FIFO);
+      CPPUNIT_ASSERT(thread_profile::parse_policy("rr") == thread_profile::POLICY_RR);
+      CPPUNIT_ASSERT(thread_profile::parse_policy("other") == thread_profile::POLICY_OTHER);
+      CPPUNIT_ASSERT_THROW(thread_profile::parse_policy("idle"), std::invalid_argument);
+      CPPUNIT_ASSERT_EQUAL(std::string("receive"),
+                           std::string(thread_profile::role_name(thread_profile::ROLE_RECEIVE)));
+
+      thread_profile::config_t bad;
+      bad.roles[thread_profile::ROLE_WRITE].policy = thread_profile::POLICY_FIFO;
+      CPPUNIT_ASSERT_THROW(thread_profile::make(bad), std::invalid_argument);
+      bad.roles[thread_profile::ROLE_WRITE].priority = 100;
+      CPPUNIT_ASSERT_THROW(thread_profile::make(bad), std::invalid_argument);
+      bad.roles[thread_profile::ROLE_WRITE] = thread_profile::role_config_t();
+      bad.roles[thread_profile::ROLE_WRITE].priority = 5;
+      CPPUNIT_ASSERT_THROW(thread_profile::make(bad), std::invalid_argument);
+      bad.roles[thread_profile::ROLE_WRITE] = thread_profile::role_config_t();
+      bad.roles[thread_profile::ROLE_WRITE].cpus.push_back(-1);
+      CPPUNIT_ASSERT_THROW(thread_profile::make(bad), std::invalid_argument);
+
+      thread_profile::sptr profile = thread_profile::make(thread_profile::config_t());
+      std::vector<std::string> problems = profile->check();
+      CPPUNIT_ASSERT(not problems.empty());
+      CPPUNIT_ASSERT(problems[0].find("not pinned") != std::string::npos);
+
+      profile->enter(thread_profile::ROLE_CONTROL, "main");
+      volatile double x = 0.0;
+      for (int i = 0; i < 2000000; i++) {
+        x += i;
+      }
+      std::vector<thread_stats_t> stats = profile->get_thread_stats();
+      CPPUNIT_ASSERT_EQUAL(size_t(1), stats.size());
+      CPPUNIT_ASSERT(stats[0].applied);
+      CPPUNIT_ASSERT(stats[0].error.empty());
+      CPPUNIT_ASSERT(stats[0].running);
+      CPPUNIT_ASSERT_EQUAL(std::string("main"), stats[0].name);
+      CPPUNIT_ASSERT(stats[0].tid > 0);
+      CPPUNIT_ASSERT(stats[0].cpu_ns > 0);
+      CPPUNIT_ASSERT(stats[0].last_cpu >= 0);
+
+      // Entering again changes the role and restarts the counts
+      profile->enter(thread_profile::ROLE_RECEIVE, "main");
+      profile->leave();
+      stats = profile->get_thread_stats();
+      CPPUNIT_ASSERT_EQUAL(size_t(1), stats.size());
+      CPPUNIT_ASSERT(stats[0].role == thread_profile::ROLE_RECEIVE);
+      CPPUNIT_ASSERT(not stats[0].running);
+      CPPUNIT_ASSERT(stats[0].cpu_ns < 100000000);
+
+      // A null profile is a no-op
+      thread_profile::scoped_role none(thread_profile::sptr(), thread_profile::ROLE_WRITE, "none");
+    }
+
+    void
+    qa_thread_profile::t2()
+    {
+      // Pinned threads, tracking across threads and strict failures
+      const int cpu = first_allowed_cpu();
+      thread_profile::config_t config;
+      config.roles[thread_profile::ROLE_WRITE].cpus.push_back(cpu);
+      config.roles[thread_profile::ROLE_RECEIVE].cpus.push_back(cpu);
+      thread_profile::sptr profile = thread_profile::make(config);
+
+      std::vector<std::string> problems = profile->check();
+      bool shared = false;
+      for (size_t i = 0; i < problems.size(); i++) {
+        shared = shared or problems[i].find("shared with the write") != std::string::npos;
+      }
+      CPPUNIT_ASSERT(shared);
+
+      int ran_on[3] = { -1, -1, -1 };
+      boost::thread_group threads;
+      for (size_t i = 0; i < 3; i++) {
+        threads.create_thread(boost::bind(&spin, profile, thread_profile::ROLE_WRITE, &ran_on[i]));
+      }
+      threads.join_all();
+
+      boost::barrier entered(2), done(2);
+      boost::thread waiter(boost::bind(&wait_at, profile, &entered, &done));
+      entered.wait();
+      std::vector<thread_stats_t> stats = profile->get_thread_stats();
+      done.wait();
+      waiter.join();
+
+      CPPUNIT_ASSERT_EQUAL(size_t(4), stats.size());
+      for (size_t i = 0; i < 3; i++) {
+        CPPUNIT_ASSERT_EQUAL(cpu, ran_on[i]);
+        CPPUNIT_ASSERT(stats[i].role == thread_profile::ROLE_WRITE);
+        CPPUNIT_ASSERT(stats[i].applied);
+        CPPUNIT_ASSERT(not stats[i].running);
+        CPPUNIT_ASSERT(stats[i].cpu_ns > 0);
+        CPPUNIT_ASSERT_EQUAL(cpu, stats[i].last_cpu);
+      }
+      CPPUNIT_ASSERT(stats[0].tid != stats[1].tid and stats[1].tid != stats[2].tid);
+      CPPUNIT_ASSERT(stats[3].role == thread_profile::ROLE_CONTROL);
+      CPPUNIT_ASSERT(stats[3].running);
+      CPPUNIT_ASSERT(not profile->get_thread_stats()[3].running);
+
+      // SCHED_FIFO either applies or throws, depending on privileges
+      thread_profile::config_t rt;
+      rt.roles[thread_profile::ROLE_RECEIVE].policy = thread_profile::POLICY_FIFO;
+      rt.roles[thread_profile::ROLE_RECEIVE].priority = 1;
+      rt.strict = true;
+      thread_profile::sptr strict = thread_profile::make(rt);
+      int result = -1;
+      boost::thread(boost::bind(&enter_strict, strict, &result)).join();
+      CPPUNIT_ASSERT(result != -1);
+      stats = strict->get_thread_stats();
+      CPPUNIT_ASSERT_EQUAL(size_t(1), stats.size());
+      CPPUNIT_ASSERT_EQUAL(result == 1, stats[0].applied);
+
+      // validate() reports a strict failure to the caller; a worker's
+      // scoped_role only records it
+      thread_profile::config_t bad;
+      bad.roles[thread_profile::ROLE_WRITE].cpus.push_back(CPU_SETSIZE - 1);
+      thread_profile::make(bad)->validate(thread_profile::ROLE_WRITE);
+      bad.strict = true;
+      thread_profile::sptr bad_profile = thread_profile::make(bad);
+      CPPUNIT_ASSERT_THROW(bad_profile->validate(thread_profile::ROLE_WRITE), std::runtime_error);
+      bad_profile->validate(thread_profile::ROLE_CONTROL);
+      boost::thread(boost::bind(&spin, bad_profile, thread_profile::ROLE_WRITE, &ran_on[0])).join();
+      stats = bad_profile->get_thread_stats();
+      CPPUNIT_ASSERT_EQUAL(size_t(1), stats.size());
+      CPPUNIT_ASSERT(not stats[0].applied);
+      CPPUNIT_ASSERT(not stats[0].error.empty());
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
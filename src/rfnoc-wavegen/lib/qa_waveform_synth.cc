@@ -0,0 +1,183 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include "qa_waveform_synth.h"
+#include <wavegen/waveform_synth.h>
+#include <cmath>
+#include <stdexcept>
+
+namespace gr {
+  namespace wavegen {
+
+    static boost::int16_t word_i(boost::uint32_t w) { return boost::int16_t(w >> 16); }
+    static boost::int16_t word_q(boost::uint32_t w) { return boost::int16_t(w & 0xffff); }
+
+    void
+    qa_waveform_synth::t1()
+    {
+      // Chirp generator model
+      const int A = waveform_synth::DDS_AMPLITUDE;
+
+      // Quarter-cycle tone: exact table points
+      std::vector<boost::uint32_t> tone = waveform_synth::hw_chirp(5, 0, 0x40000000);
+      CPPUNIT_ASSERT_EQUAL(size_t(5), tone.size());
+      CPPUNIT_ASSERT_EQUAL(boost::int16_t(A), word_i(tone[0]));
+      CPPUNIT_ASSERT_EQUAL(boost::int16_t(0), word_q(tone[0]));
+      CPPUNIT_ASSERT_EQUAL(boost::int16_t(0), word_i(tone[1]));
+      CPPUNIT_ASSERT_EQUAL(boost::int16_t(A), word_q(tone[1]));
+      CPPUNIT_ASSERT_EQUAL(boost::int16_t(-A), word_i(tone[2]));
+      CPPUNIT_ASSERT_EQUAL(boost::int16_t(0), word_i(tone[3]));
+      CPPUNIT_ASSERT_EQUAL(boost::int16_t(-A), word_q(tone[3]));
+      CPPUNIT_ASSERT_EQUAL(tone[0], tone[4]);
+
+      // Frequency steps by tuning_coef each sample: with freq_offset 0
+      // and tuning_coef 2^30 the phase after n samples is n(n-1)/2
+      // quarter cycles
+      std::vector<boost::uint32_t> ramp = waveform_synth::hw_chirp(6, 0x40000000, 0);
+      const size_t quarters[] = {0, 0, 1, 3, 6, 10};
+      for (size_t n = 0; n < 6; n++) {
+        CPPUNIT_ASSERT_EQUAL(tone[quarters[n] % 4], ramp[n]);
+      }
+
+      // Same sweep as lfm() for the coefficients chirp_coefs() gives,
+      // to within the table's phase resolution. lfm() is fed the
+      // rounded coefficients: over 4096 samples the rounding alone
+      // moves the phase by more than the table does.
+      const size_t len = 4096;
+      const waveform_synth::chirp_coefs_t coefs = waveform_synth::chirp_coefs(len, 0.8, 0.05);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(len), coefs.len);
+      const double bw = coefs.tuning_coef / 4294967296.0 * len;
+      const double f0 = boost::int32_t(coefs.freq_offset) / 4294967296.0;
+      std::vector<boost::uint32_t> hw = waveform_synth::hw_chirp(coefs.len, coefs.tuning_coef, coefs.freq_offset);
+      std::vector<boost::uint32_t> sw = waveform_synth::pack_sc16(
+        waveform_synth::lfm(len, bw, f0 + bw / 2.0), float(A));
+      int max_err = 0;
+      for (size_t n = 0; n < len; n++) {
+        max_err = std::max(max_err, std::abs(word_i(hw[n]) - word_i(sw[n])));
+        max_err = std::max(max_err, std::abs(word_q(hw[n]) - word_q(sw[n])));
+      }
+      CPPUNIT_ASSERT(max_err <= 8);
+
+      // Negative start frequency wraps to two's complement
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(0xc0000000),
+                           waveform_synth::chirp_coefs(4, 0.5, 0.0).freq_offset);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(0x08000000),
+                           waveform_synth::chirp_coefs(4, 0.125, 0.0).tuning_coef);
+    }
+
+    void
+    qa_waveform_synth::t2()
+    {
+      // sc16 packing
+      std::vector<gr_complex> x;
+      x.push_back(gr_complex(1.0f, -1.0f));
+      x.push_back(gr_complex(0.5f, 0.25f));
+      x.push_back(gr_complex(2.0f, -2.0f));
+
+      std::vector<boost::uint32_t> w = waveform_synth::pack_sc16(x);
+      CPPUNIT_ASSERT_EQUAL(size_t(3), w.size());
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(0x7fff8001), w[0]);
+      CPPUNIT_ASSERT_EQUAL(boost::int16_t(16384), word_i(w[1]));
+      CPPUNIT_ASSERT_EQUAL(boost::int16_t(8192), word_q(w[1]));
+      // Saturated, not wrapped
+      CPPUNIT_ASSERT_EQUAL(boost::int16_t(32767), word_i(w[2]));
+      CPPUNIT_ASSERT_EQUAL(boost::int16_t(-32768), word_q(w[2]));
+
+      std::vector<gr_complex> y = waveform_synth::unpack_sc16(w);
+      CPPUNIT_ASSERT_EQUAL(size_t(3), y.size());
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(0.5, y[1].real(), 1e-4);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(0.25, y[1].imag(), 1e-4);
+
+      CPPUNIT_ASSERT(waveform_synth::pack_sc16(std::vector<gr_complex>()).empty());
+    }
+
+    void
+    qa_waveform_synth::t3()
+    {
+      // Phase codes
+      std::vector<float> b13 = waveform_synth::barker_code(13);
+      std::vector<gr_complex> p = waveform_synth::phase_coded(b13, 1);
+      CPPUNIT_ASSERT_EQUAL(size_t(13), p.size());
+      for (size_t lag = 0; lag < 13; lag++) {
+        gr_complex acc(0.0f, 0.0f);
+        for (size_t n = lag; n < 13; n++) {
+          acc += p[n] * std::conj(p[n - lag]);
+        }
+        if (lag == 0) {
+          CPPUNIT_ASSERT_DOUBLES_EQUAL(13.0, std::abs(acc), 1e-3);
+        } else {
+          CPPUNIT_ASSERT(std::abs(acc) <= 1.0 + 1e-3);
+        }
+      }
+      CPPUNIT_ASSERT_THROW(waveform_synth::barker_code(6), std::invalid_argument);
+
+      CPPUNIT_ASSERT_EQUAL(size_t(16), waveform_synth::frank_code(4).size());
+      std::vector<float> frank = waveform_synth::frank_code(4);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(M_PI / 2.0, frank[4 + 1], 1e-6);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(-M_PI / 2.0, frank[4 + 3], 1e-6);
+
+      std::vector<float> p4 = waveform_synth::p4_code(16);
+      CPPUNIT_ASSERT_EQUAL(size_t(16), p4.size());
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0, p4[0], 1e-6);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(M_PI / 16.0 - M_PI, p4[1], 1e-5);
+
+      // Each chip is held samps_per_chip samples
+      std::vector<gr_complex> held = waveform_synth::phase_coded(waveform_synth::barker_code(3), 4);
+      CPPUNIT_ASSERT_EQUAL(size_t(12), held.size());
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(1.0, held[7].real(), 1e-6);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(-1.0, held[8].real(), 1e-6);
+    }
+
+    void
+    qa_waveform_synth::t4()
+    {
+      // Stepped frequency, NLFM and windowing
+      std::vector<gr_complex> s = waveform_synth::stepped_frequency(3, 8, 0.0, 0.125);
+      CPPUNIT_ASSERT_EQUAL(size_t(24), s.size());
+      for (size_t n = 1; n < s.size(); n++) {
+        const double freq = std::arg(s[n] * std::conj(s[n - 1])) / (2.0 * M_PI);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(0.125 * ((n - 1) / 8), freq, 1e-5);
+      }
+
+      // Frequency runs from -B/2 to B/2 and changes fastest at the ends
+      const size_t len = 1000;
+      std::vector<gr_complex> nl = waveform_synth::nlfm(len, 0.4, 1.2);
+      CPPUNIT_ASSERT_EQUAL(len, nl.size());
+      const double f_start = std::arg(nl[1] * std::conj(nl[0])) / (2.0 * M_PI);
+      const double f_mid = std::arg(nl[len / 2 + 1] * std::conj(nl[len / 2])) / (2.0 * M_PI);
+      const double f_mid2 = std::arg(nl[len / 2 + 2] * std::conj(nl[len / 2 + 1])) / (2.0 * M_PI);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(-0.2, f_start, 1e-3);
+      CPPUNIT_ASSERT(std::abs(f_mid2 - f_mid) < 0.4 / len);
+      CPPUNIT_ASSERT_THROW(waveform_synth::nlfm(len, 0.4, 2.0), std::invalid_argument);
+
+      std::vector<gr_complex> w = waveform_synth::lfm(64, 0.25);
+      waveform_synth::apply_window(w, gr::fft::window::WIN_HANN);
+      CPPUNIT_ASSERT(std::abs(w[0]) < 1e-6);
+      CPPUNIT_ASSERT(std::abs(w[32]) > 0.99);
+      for (size_t n = 0; n < w.size(); n++) {
+        CPPUNIT_ASSERT(std::abs(w[n]) <= 1.0 + 1e-6);
+      }
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
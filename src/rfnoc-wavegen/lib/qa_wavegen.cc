@@ -36,5 +36,3 @@ namespace gr {
 
   } /* namespace wavegen */
 } /* namespace gr */
-
-  s->addTest(gr::wavegen::qa_wavegen::suite());
\ No newline at end of file
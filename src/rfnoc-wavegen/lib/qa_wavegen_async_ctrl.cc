@@ -0,0 +1,148 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include "qa_wavegen_async_ctrl.h"
+#include "wavegen_mock_reg_iface.h"
+#include <wavegen/wavegen_async_ctrl.hpp>
+#include <wavegen/thread_profile.h>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/bind.hpp>
+
+using uhd::rfnoc::wavegen_core;
+using uhd::rfnoc::wavegen_config;
+using uhd::rfnoc::wavegen_async_ctrl;
+using uhd::rfnoc::wavegen_mock_reg_iface;
+
+namespace gr {
+  namespace wavegen {
+
+    /* Mock whose settings bus stalls until the test opens the gate */
+    class gated_reg_iface : public wavegen_mock_reg_iface
+    {
+    public:
+      gated_reg_iface(void): _open(false) {}
+
+      void sr_write(const boost::uint32_t reg, const boost::uint32_t data)
+      {
+        {
+          boost::mutex::scoped_lock lock(_mutex);
+          while (not _open) {
+            _cond.wait(lock);
+          }
+        }
+        wavegen_mock_reg_iface::sr_write(reg, data);
+      }
+
+      void open(void)
+      {
+        boost::mutex::scoped_lock lock(_mutex);
+        _open = true;
+        _cond.notify_all();
+      }
+
+    private:
+      boost::mutex _mutex;
+      boost::condition_variable _cond;
+      bool _open;
+    };
+
+    static void
+    post_prf_counts(wavegen_async_ctrl::sptr async, boost::uint64_t base, size_t n)
+    {
+      for (size_t i = 0; i < n; i++) {
+        async->set_prf_count(base + i);
+      }
+    }
+
+    void
+    qa_wavegen_async_ctrl::t1()
+    {
+      // Posting never waits for the bus
+      boost::shared_ptr<gated_reg_iface> iface(new gated_reg_iface());
+      wavegen_core::sptr core = wavegen_core::make(iface);
+      wavegen_async_ctrl::sptr async = wavegen_async_ctrl::make(core);
+      iface->rb[wavegen_core::RB_AWG_STATE] = 0x42;
+
+      wavegen_async_ctrl::done_future_t prf = async->set_prf_count(0x100000002);
+      wavegen_async_ctrl::done_future_t cfg = async->commit(wavegen_config().set_num_adc_samples(400));
+      wavegen_async_ctrl::readback_future_t state = async->get_state();
+      boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+      CPPUNIT_ASSERT(not prf.is_ready());
+      CPPUNIT_ASSERT(not state.is_ready());
+
+      // Commands complete in posting order once the bus frees up
+      iface->open();
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(0x42), state.get());
+      CPPUNIT_ASSERT(prf.is_ready());
+      CPPUNIT_ASSERT(cfg.is_ready());
+      CPPUNIT_ASSERT_EQUAL(size_t(3), iface->writes.size());
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::SR_PRF_INT_ADDR, iface->writes[0].reg);
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::SR_ADC_SAMPLE_ADDR, iface->writes[2].reg);
+
+      wavegen_async_ctrl::latency_stats_t stats = async->get_latency_stats();
+      CPPUNIT_ASSERT_EQUAL(size_t(3), stats.num_commands);
+      CPPUNIT_ASSERT(stats.max_us >= 10000);
+      CPPUNIT_ASSERT(stats.mean_us <= stats.max_us);
+    }
+
+    void
+    qa_wavegen_async_ctrl::t2()
+    {
+      // Errors reach the caller; several producers share one queue
+      wavegen_mock_reg_iface::sptr iface(new wavegen_mock_reg_iface());
+      wavegen_core::sptr core = wavegen_core::make(iface);
+      wavegen_async_ctrl::sptr async = wavegen_async_ctrl::make(core, 8);
+
+      wavegen_async_ctrl::done_future_t bad = async->set_waveform(std::vector<boost::uint32_t>());
+      CPPUNIT_ASSERT_THROW(bad.get(), uhd::value_error);
+      CPPUNIT_ASSERT_EQUAL(size_t(1), async->get_latency_stats().num_errors);
+      async->reset_latency_stats();
+
+      boost::thread_group producers;
+      for (size_t i = 0; i < 4; i++) {
+        producers.create_thread(boost::bind(&post_prf_counts, async, boost::uint64_t(i) << 32, 100));
+      }
+      producers.join_all();
+      async->flush();
+      CPPUNIT_ASSERT_EQUAL(size_t(401), async->get_latency_stats().num_commands);
+      CPPUNIT_ASSERT_EQUAL(size_t(0), async->get_latency_stats().num_errors);
+
+      // The request pool is sized up front
+      CPPUNIT_ASSERT_THROW(wavegen_async_ctrl::make(core, 0), uhd::value_error);
+      CPPUNIT_ASSERT_THROW(wavegen_async_ctrl::make(core, 65535), uhd::value_error);
+
+      // The control thread runs in the profile's control role
+      gr::wavegen::thread_profile::sptr threads =
+        gr::wavegen::thread_profile::make(gr::wavegen::thread_profile::config_t());
+      wavegen_async_ctrl::make(core, 16, threads)->set_prf_count(5).wait();
+      const std::vector<gr::wavegen::thread_profile::thread_stats_t> thread_stats = threads->get_thread_stats();
+      CPPUNIT_ASSERT_EQUAL(size_t(1), thread_stats.size());
+      CPPUNIT_ASSERT(thread_stats[0].role == gr::wavegen::thread_profile::ROLE_CONTROL);
+      CPPUNIT_ASSERT_EQUAL(std::string("async control"), thread_stats[0].name);
+      CPPUNIT_ASSERT(not thread_stats[0].running);
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
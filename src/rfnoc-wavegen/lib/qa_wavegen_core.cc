@@ -0,0 +1,523 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include "qa_wavegen_core.h"
+#include "wavegen_mock_reg_iface.h"
+#include <wavegen/wavegen_core.hpp>
+#include <wavegen/wavegen_config.hpp>
+
+using uhd::rfnoc::wavegen_core;
+using uhd::rfnoc::wavegen_config;
+using uhd::rfnoc::wavegen_reg_iface;
+using uhd::rfnoc::wavegen_mock_reg_iface;
+
+namespace gr {
+  namespace wavegen {
+
+    static std::vector<boost::uint32_t>
+    ramp(size_t n)
+    {
+      std::vector<boost::uint32_t> samples(n);
+      for (size_t i = 0; i < n; i++) {
+        samples[i] = boost::uint32_t(0xFEED0000 + i);
+      }
+      return samples;
+    }
+
+    /* Flatten the recorded settings writes of an SR or burst upload */
+    static std::vector<boost::uint32_t>
+    written_words(wavegen_mock_reg_iface::sptr iface)
+    {
+      std::vector<boost::uint32_t> words;
+      for (size_t i = 0; i < iface->writes.size(); i++) {
+        words.push_back(iface->writes[i].data);
+      }
+      return words;
+    }
+
+    void
+    qa_wavegen_core::t1()
+    {
+      // Single packet upload over the settings bus
+      wavegen_mock_reg_iface::sptr iface(new wavegen_mock_reg_iface());
+      wavegen_core::sptr core = wavegen_core::make(iface);
+
+      core->set_waveform(ramp(4));
+      CPPUNIT_ASSERT_EQUAL(size_t(6), iface->writes.size());
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(0x57440000), iface->writes[0].data);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(0x00000004), iface->writes[1].data);
+      for (size_t i = 0; i < 5; i++) {
+        CPPUNIT_ASSERT_EQUAL(wavegen_core::SR_AWG_RELOAD, iface->writes[i].reg);
+      }
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::SR_AWG_RELOAD_LAST, iface->writes[5].reg);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(0xFEED0003), iface->writes[5].data);
+
+      // Every upload gets a new id
+      iface->reset_counters();
+      core->set_waveform(ramp(4));
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(0x57440001), iface->writes[0].data);
+    }
+
+    void
+    qa_wavegen_core::t2()
+    {
+      // Packetised upload: one header per packet, ind counts packets
+      wavegen_mock_reg_iface::sptr iface(new wavegen_mock_reg_iface());
+      wavegen_core::sptr core = wavegen_core::make(iface);
+
+      core->set_waveform(ramp(5), 2);
+      CPPUNIT_ASSERT_EQUAL(size_t(3 * 2 + 5), iface->writes.size());
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(0x00000005), iface->writes[1].data);
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::SR_AWG_RELOAD_LAST, iface->writes[3].reg);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(0x00010005), iface->writes[5].data);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(0x00020005), iface->writes[9].data);
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::SR_AWG_RELOAD_LAST, iface->writes[10].reg);
+    }
+
+    void
+    qa_wavegen_core::t3()
+    {
+      // All upload modes carry the same words, in fewer transactions
+      const std::vector<boost::uint32_t> samples = ramp(100);
+
+      wavegen_mock_reg_iface::sptr sr_iface(new wavegen_mock_reg_iface());
+      wavegen_core::make(sr_iface)->set_waveform(samples, 32);
+      const std::vector<boost::uint32_t> expected = written_words(sr_iface);
+      CPPUNIT_ASSERT_EQUAL(expected.size(), sr_iface->num_transactions);
+
+      wavegen_mock_reg_iface::sptr burst_iface(new wavegen_mock_reg_iface());
+      wavegen_core::sptr burst_core = wavegen_core::make(burst_iface);
+      burst_core->set_upload_mode(wavegen_core::UPLOAD_MODE_BURST);
+      burst_core->set_waveform(samples, 32);
+      CPPUNIT_ASSERT(expected == written_words(burst_iface));
+      CPPUNIT_ASSERT_EQUAL(size_t(4), burst_iface->num_transactions);
+
+      wavegen_mock_reg_iface::sptr stream_iface(new wavegen_mock_reg_iface(64));
+      wavegen_core::sptr stream_core = wavegen_core::make(stream_iface);
+      stream_core->set_upload_mode(wavegen_core::UPLOAD_MODE_STREAM);
+      stream_core->set_waveform(samples, 32);
+      CPPUNIT_ASSERT_EQUAL(size_t(4), stream_iface->packets.size());
+      std::vector<boost::uint32_t> streamed;
+      for (size_t i = 0; i < stream_iface->packets.size(); i++) {
+        streamed.insert(streamed.end(),
+            stream_iface->packets[i].begin(), stream_iface->packets[i].end());
+      }
+      CPPUNIT_ASSERT(expected == streamed);
+
+      // Without spp, stream mode splits at the backend packet size
+      stream_iface->reset_counters();
+      stream_core->set_waveform(samples);
+      CPPUNIT_ASSERT_EQUAL(size_t(2), stream_iface->packets.size());
+      CPPUNIT_ASSERT_EQUAL(size_t(64), stream_iface->packets[0].size());
+    }
+
+    void
+    qa_wavegen_core::t4()
+    {
+      wavegen_mock_reg_iface::sptr iface(new wavegen_mock_reg_iface());
+      wavegen_core::sptr core = wavegen_core::make(iface);
+
+      CPPUNIT_ASSERT_THROW(core->set_waveform(std::vector<boost::uint32_t>()), uhd::value_error);
+      CPPUNIT_ASSERT_THROW(core->set_waveform(ramp(4), 0), uhd::value_error);
+      CPPUNIT_ASSERT_THROW(core->set_upload_mode(wavegen_core::UPLOAD_MODE_STREAM), uhd::value_error);
+      CPPUNIT_ASSERT_EQUAL(size_t(0), iface->num_transactions);
+    }
+
+    void
+    qa_wavegen_core::t5()
+    {
+      // Waveforms past 16 bits use the wide header and are segmented
+      wavegen_mock_reg_iface::sptr iface(new wavegen_mock_reg_iface());
+      wavegen_core::sptr core = wavegen_core::make(iface);
+      core->set_upload_mode(wavegen_core::UPLOAD_MODE_BURST);
+
+      const size_t len = 70000;
+      core->set_waveform(ramp(len));
+      CPPUNIT_ASSERT_EQUAL(size_t(2), iface->num_transactions);
+      CPPUNIT_ASSERT_EQUAL(size_t(2 * 3 + len), iface->writes.size());
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(0x57450000), iface->writes[0].data);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(len), iface->writes[1].data);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(0), iface->writes[2].data);
+      const size_t second = 3 + wavegen_core::MAX_SEGMENT_SAMPS;
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(len), iface->writes[second + 1].data);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(1), iface->writes[second + 2].data);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(0xFEED0000 + len - 1), iface->writes.back().data);
+
+      // The narrow header throws instead of truncating the length
+      core->set_header_format(wavegen_core::HEADER_FORMAT_NARROW);
+      iface->reset_counters();
+      CPPUNIT_ASSERT_THROW(core->set_waveform(ramp(len)), uhd::value_error);
+      CPPUNIT_ASSERT_EQUAL(size_t(0), iface->num_transactions);
+
+      // Short waveforms keep the narrow header unless asked otherwise
+      core->set_header_format(wavegen_core::HEADER_FORMAT_AUTO);
+      core->set_waveform(ramp(16));
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(0x57440001), iface->writes[0].data);
+      iface->reset_counters();
+      core->set_header_format(wavegen_core::HEADER_FORMAT_WIDE);
+      core->set_waveform(ramp(16));
+      CPPUNIT_ASSERT_EQUAL(size_t(3 + 16), iface->writes.size());
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(0x57450002), iface->writes[0].data);
+    }
+
+    void
+    qa_wavegen_core::t6()
+    {
+      // Shadow register cache
+      wavegen_mock_reg_iface::sptr iface(new wavegen_mock_reg_iface());
+      wavegen_core::sptr core = wavegen_core::make(iface);
+      iface->rb[wavegen_core::RB_AWG_PRF] = 200000000;
+      iface->rb[wavegen_core::RB_ADC_LEN] = 400;
+      iface->rb[wavegen_core::RB_AWG_LEN] = 128;
+
+      // Unchanged writes are skipped, one PRF word at a time
+      core->set_prf_count(200000000);
+      core->set_prf_count(200000000);
+      core->set_prf_count(200000001);
+      CPPUNIT_ASSERT_EQUAL(size_t(3), iface->num_sr_writes);
+      CPPUNIT_ASSERT_EQUAL(size_t(3), core->get_cache_stats().writes_skipped);
+
+      // Readbacks are fetched once, then served from the cache
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(528), core->get_rx_len());
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(528), core->get_rx_len());
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(200000000), core->get_prf_count());
+      CPPUNIT_ASSERT_EQUAL(size_t(3), iface->num_reads);
+      CPPUNIT_ASSERT_EQUAL(size_t(2), core->get_cache_stats().reads_avoided);
+
+      // A write invalidates the matching readback; state is never cached
+      core->set_num_adc_samples(100);
+      core->get_rx_len();
+      core->get_state();
+      core->get_state();
+      CPPUNIT_ASSERT_EQUAL(size_t(6), iface->num_reads);
+
+      // Verify mode and refresh() go back to the hardware
+      core->set_readback_verify(true);
+      core->get_prf_count();
+      CPPUNIT_ASSERT_EQUAL(size_t(7), iface->num_reads);
+      core->set_readback_verify(false);
+      core->refresh();
+      core->set_prf_count(200000001);
+      core->get_prf_count();
+      CPPUNIT_ASSERT_EQUAL(size_t(8), iface->num_reads);
+      CPPUNIT_ASSERT_EQUAL(size_t(6), iface->num_sr_writes);
+
+      // Command strobes are never skipped
+      core->send_pulse(1000);
+      core->send_pulse(1000);
+      CPPUNIT_ASSERT_EQUAL(size_t(12), iface->num_sr_writes);
+
+      // and count as writes, so the stats match the bus
+      CPPUNIT_ASSERT_EQUAL(iface->num_sr_writes, core->get_cache_stats().sr_writes);
+      core->send_pulse();
+      core->clear_commands();
+      CPPUNIT_ASSERT_EQUAL(size_t(15), core->get_cache_stats().sr_writes);
+    }
+
+    void
+    qa_wavegen_core::t7()
+    {
+      // Staged config commit
+      wavegen_mock_reg_iface::sptr iface(new wavegen_mock_reg_iface());
+      wavegen_core::sptr core = wavegen_core::make(iface);
+
+      wavegen_config cfg;
+      CPPUNIT_ASSERT(cfg.empty());
+      cfg.set_policy(wavegen_core::RADAR_POLICY_AUTO)
+        .set_prf_count((boost::uint64_t(2) << 32) | 5)
+        .set_num_adc_samples(400)
+        .set_src_chirp()
+        .setup_chirp(256, 0x100, 0x20);
+      CPPUNIT_ASSERT(not cfg.empty());
+
+      // One transaction, settings in dependency order, policy last
+      core->commit(cfg);
+      CPPUNIT_ASSERT_EQUAL(size_t(1), iface->num_transactions);
+      CPPUNIT_ASSERT_EQUAL(size_t(8), iface->writes.size());
+      const boost::uint32_t order[] = {
+        wavegen_core::SR_CH_COUNTER_ADDR, wavegen_core::SR_CH_TUNING_COEF_ADDR,
+        wavegen_core::SR_CH_FREQ_OFFSET_ADDR, wavegen_core::SR_AWG_CTRL_WORD_ADDR,
+        wavegen_core::SR_ADC_SAMPLE_ADDR, wavegen_core::SR_PRF_INT_ADDR,
+        wavegen_core::SR_PRF_FRAC_ADDR, wavegen_core::SR_RADAR_CTRL_POLICY
+      };
+      for (size_t i = 0; i < 8; i++) {
+        CPPUNIT_ASSERT_EQUAL(order[i], iface->writes[i].reg);
+      }
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(255), iface->sr[wavegen_core::SR_CH_COUNTER_ADDR]);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(399), iface->sr[wavegen_core::SR_ADC_SAMPLE_ADDR]);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(2), iface->sr[wavegen_core::SR_PRF_INT_ADDR]);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(5), iface->sr[wavegen_core::SR_PRF_FRAC_ADDR]);
+      CPPUNIT_ASSERT_EQUAL(size_t(0), iface->num_timed_writes);
+
+      // The committed chirp is known without a readback
+      boost::uint32_t len = 0, tuning_coef = 0, freq_offset = 0;
+      CPPUNIT_ASSERT(core->get_chirp(len, tuning_coef, freq_offset));
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(256), len);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(0x100), tuning_coef);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(0x20), freq_offset);
+
+      // Only changed registers are sent, as timed commands
+      iface->reset_counters();
+      cfg.set_prf_count((boost::uint64_t(2) << 32) | 6);
+      cfg.set_command_time(uhd::time_spec_t(2.0));
+      core->commit(cfg);
+      CPPUNIT_ASSERT_EQUAL(size_t(1), iface->num_transactions);
+      CPPUNIT_ASSERT_EQUAL(size_t(1), iface->writes.size());
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::SR_PRF_FRAC_ADDR, iface->writes[0].reg);
+      CPPUNIT_ASSERT_EQUAL(size_t(1), iface->num_timed_writes);
+      CPPUNIT_ASSERT(not iface->timed);
+      CPPUNIT_ASSERT_EQUAL(size_t(7), core->get_cache_stats().writes_skipped);
+
+      // Nothing changed: no bus traffic at all
+      iface->reset_counters();
+      core->commit(cfg);
+      core->commit(wavegen_config());
+      CPPUNIT_ASSERT_EQUAL(size_t(0), iface->num_transactions);
+
+      CPPUNIT_ASSERT_THROW(wavegen_config().set_num_adc_samples(0), uhd::value_error);
+      CPPUNIT_ASSERT_THROW(wavegen_config().setup_chirp(0, 0, 0), uhd::value_error);
+      CPPUNIT_ASSERT_THROW(wavegen_config().get_command_time(), uhd::value_error);
+    }
+
+    void
+    qa_wavegen_core::t8()
+    {
+      // Packed timed command schedule
+      wavegen_mock_reg_iface::sptr iface(new wavegen_mock_reg_iface());
+      wavegen_core::sptr core = wavegen_core::make(iface);
+
+      std::vector<boost::uint64_t> ticks;
+      ticks.push_back(0xFFFFFFF0);
+      ticks.push_back(0xFFFFFFF8);
+      ticks.push_back(0x100000004);
+      ticks.push_back(0x100000008);
+      core->send_commands(0, ticks);
+
+      // COMMAND once, TIME_HI on change, TIME_LO per pulse
+      CPPUNIT_ASSERT_EQUAL(size_t(1), iface->num_transactions);
+      CPPUNIT_ASSERT_EQUAL(size_t(2 + 1 + 4), iface->writes.size());
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::SR_RADAR_CTRL_COMMAND, iface->writes[0].reg);
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::SR_RADAR_CTRL_TIME_HI, iface->writes[1].reg);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(0), iface->writes[1].data);
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::SR_RADAR_CTRL_TIME_LO, iface->writes[3].reg);
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::SR_RADAR_CTRL_TIME_HI, iface->writes[4].reg);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(1), iface->writes[4].data);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(8), iface->writes[6].data);
+
+      // Registers already holding the value are not rewritten
+      iface->reset_counters();
+      ticks.assign(1, 0x100000010);
+      core->send_commands(0, ticks);
+      CPPUNIT_ASSERT_EQUAL(size_t(1), iface->writes.size());
+
+      // An immediate pulse moves TIME_HI, so the next schedule sets it again
+      iface->reset_counters();
+      core->send_pulse();
+      core->send_commands(0, ticks);
+      CPPUNIT_ASSERT_EQUAL(size_t(2 + 2), iface->writes.size());
+    }
+
+    void
+    qa_wavegen_core::t9()
+    {
+      // Waveform bank registers
+      wavegen_mock_reg_iface::sptr iface(new wavegen_mock_reg_iface());
+      wavegen_core::sptr core = wavegen_core::make(iface);
+
+      core->set_load_bank(1);
+      core->set_load_bank(1);
+      CPPUNIT_ASSERT_EQUAL(size_t(1), iface->num_sr_writes);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(1), iface->sr[wavegen_core::SR_AWG_LOAD_BANK]);
+
+      // Bank selects are swap requests and always reach the bus
+      core->select_bank(1);
+      core->select_bank(1, uhd::time_spec_t(1.5));
+      CPPUNIT_ASSERT_EQUAL(size_t(3), iface->num_sr_writes);
+      CPPUNIT_ASSERT_EQUAL(iface->num_sr_writes, core->get_cache_stats().sr_writes);
+      CPPUNIT_ASSERT_EQUAL(size_t(1), iface->num_timed_writes);
+      CPPUNIT_ASSERT(not iface->timed);
+
+      // The live bank is read from the hardware every time
+      iface->rb[wavegen_core::RB_AWG_BANK] = wavegen_core::AWG_BANK_LOAD_MASK | 1;
+      CPPUNIT_ASSERT_EQUAL(size_t(1), core->get_live_bank());
+      iface->rb[wavegen_core::RB_AWG_BANK] = 0;
+      CPPUNIT_ASSERT_EQUAL(size_t(0), core->get_live_bank());
+      CPPUNIT_ASSERT_EQUAL(size_t(2), iface->num_reads);
+
+      CPPUNIT_ASSERT_THROW(core->set_load_bank(2), uhd::value_error);
+      CPPUNIT_ASSERT_THROW(core->select_bank(2), uhd::value_error);
+    }
+
+    void
+    qa_wavegen_core::t11()
+    {
+      // The waveform length follows the live bank
+      wavegen_mock_reg_iface::sptr iface(new wavegen_mock_reg_iface());
+      wavegen_core::sptr core = wavegen_core::make(iface);
+
+      iface->rb[wavegen_core::RB_AWG_LEN] = 100;
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(100), core->get_waveform_len());
+
+      // A bank select drops the cached length
+      iface->rb[wavegen_core::RB_AWG_LEN] = 300;
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(100), core->get_waveform_len());
+      core->select_bank(1);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(300), core->get_waveform_len());
+
+      // Load 300 samples into bank 1, swap at a time, read the length
+      core = wavegen_core::make(iface);
+      iface->rb[wavegen_core::RB_AWG_LEN] = 100;
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(100), core->get_waveform_len());
+      core->set_load_bank(1);
+      core->set_waveform(std::vector<boost::uint32_t>(300, 7));
+      core->select_bank(1, uhd::time_spec_t(2.0));
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(100), core->get_waveform_len());
+      // The swap lands at the next pulse boundary
+      iface->rb[wavegen_core::RB_AWG_LEN] = 300;
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(300), core->get_waveform_len());
+
+      // With banks in use every read goes to the hardware
+      iface->reset_counters();
+      core->get_waveform_len();
+      core->get_waveform_len();
+      CPPUNIT_ASSERT_EQUAL(size_t(2), iface->num_reads);
+    }
+
+    void
+    qa_wavegen_core::t10()
+    {
+      // Pulse integrator registers
+      wavegen_mock_reg_iface::sptr iface(new wavegen_mock_reg_iface());
+      wavegen_core::sptr core = wavegen_core::make(iface);
+
+      core->set_integration(16, 4, 1024);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(16), iface->sr[wavegen_core::SR_INTEG_NUM_PULSES]);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(4), iface->sr[wavegen_core::SR_INTEG_DECIM]);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(1024), iface->sr[wavegen_core::SR_INTEG_LEN]);
+      // The mean of 64 samples
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(6), iface->sr[wavegen_core::SR_INTEG_SHIFT]);
+      CPPUNIT_ASSERT_EQUAL(size_t(4), iface->num_sr_writes);
+
+      // Only changes reach the bus
+      core->set_integration(8, 4, 1024);
+      CPPUNIT_ASSERT_EQUAL(size_t(4 + 2), iface->num_sr_writes);
+      core->set_integration(8, 4, 1024, 0);
+      CPPUNIT_ASSERT_EQUAL(size_t(4 + 3), iface->num_sr_writes);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(0), iface->sr[wavegen_core::SR_INTEG_SHIFT]);
+
+      // Bypass needs no pulse length
+      core->set_integration(1, 1, 0);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(1), iface->sr[wavegen_core::SR_INTEG_NUM_PULSES]);
+
+      CPPUNIT_ASSERT_THROW(core->set_integration(0, 1, 1024), uhd::value_error);
+      CPPUNIT_ASSERT_THROW(core->set_integration(4, 3, 1024), uhd::value_error);
+      CPPUNIT_ASSERT_THROW(core->set_integration(4, 1, 2 * wavegen_core::INTEG_MAX_LEN), uhd::value_error);
+      CPPUNIT_ASSERT_THROW(core->set_integration(65535, 2, 1024), uhd::value_error);
+
+      // The state is read from the hardware every time
+      iface->rb[wavegen_core::RB_INTEG] = (boost::uint64_t(7) << wavegen_core::INTEG_RECORDS_SHIFT)
+                                          | wavegen_core::INTEG_ACTIVE;
+      CPPUNIT_ASSERT_EQUAL(iface->rb[wavegen_core::RB_INTEG], core->get_integration_state());
+      core->get_integration_state();
+      CPPUNIT_ASSERT_EQUAL(size_t(2), iface->num_reads);
+    }
+
+    void
+    qa_wavegen_core::t12()
+    {
+      // A running sequence bypasses the length readback cache
+      wavegen_mock_reg_iface::sptr iface(new wavegen_mock_reg_iface());
+      wavegen_core::sptr core = wavegen_core::make(iface);
+      iface->rb[wavegen_core::RB_AWG_LEN] = 100;
+      iface->rb[wavegen_core::RB_ADC_LEN] = 500;
+      core->get_waveform_len();
+      core->get_num_adc_samples();
+
+      // Loading a table drops the cached lengths
+      core->set_sequence(std::vector<wavegen_core::seq_entry_t>(2));
+      iface->rb[wavegen_core::RB_AWG_LEN] = 200;
+      iface->rb[wavegen_core::RB_ADC_LEN] = 600;
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(200), core->get_waveform_len());
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(600), core->get_num_adc_samples());
+
+      core->enable_sequence(true);
+      iface->reset_counters();
+      for (boost::uint32_t i = 0; i < 3; i++) {
+        iface->rb[wavegen_core::RB_AWG_LEN] = 100 * i;
+        iface->rb[wavegen_core::RB_ADC_LEN] = 10 * i;
+        CPPUNIT_ASSERT_EQUAL(100 * i, core->get_waveform_len());
+        CPPUNIT_ASSERT_EQUAL(10 * i, core->get_num_adc_samples());
+      }
+      CPPUNIT_ASSERT_EQUAL(size_t(6), iface->num_reads);
+
+      // Stopped, the lengths are cached again
+      core->enable_sequence(false);
+      iface->reset_counters();
+      core->get_waveform_len();
+      core->get_waveform_len();
+      core->get_num_adc_samples();
+      core->get_num_adc_samples();
+      CPPUNIT_ASSERT_EQUAL(size_t(2), iface->num_reads);
+    }
+
+    void
+    qa_wavegen_core::t13()
+    {
+      // Readbacks after a timed commit follow the hardware
+      wavegen_mock_reg_iface::sptr iface(new wavegen_mock_reg_iface());
+      wavegen_core::sptr core = wavegen_core::make(iface);
+      iface->rb[wavegen_core::RB_ADC_LEN] = 99;
+      iface->rb[wavegen_core::RB_AWG_POLICY] = wavegen_core::RADAR_POLICY_MANUAL;
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(99), core->get_num_adc_samples());
+
+      wavegen_config cfg;
+      cfg.set_num_adc_samples(500)
+        .set_policy(wavegen_core::RADAR_POLICY_AUTO)
+        .set_command_time(uhd::time_spec_t(2.0));
+      core->commit(cfg);
+
+      // Read before the command time, then again once it has landed
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(99), core->get_num_adc_samples());
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::RADAR_POLICY_MANUAL, core->get_policy_word());
+      iface->rb[wavegen_core::RB_ADC_LEN] = 499;
+      iface->rb[wavegen_core::RB_AWG_POLICY] = wavegen_core::RADAR_POLICY_AUTO;
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(499), core->get_num_adc_samples());
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::RADAR_POLICY_AUTO, core->get_policy_word());
+
+      // Registers the commit did not touch are still cached
+      iface->rb[wavegen_core::RB_AWG_CTRL] = 1;
+      core->get_ctrl_word();
+      iface->reset_counters();
+      core->get_ctrl_word();
+      CPPUNIT_ASSERT_EQUAL(size_t(0), iface->num_reads);
+
+      // refresh() caches them again
+      core->refresh();
+      core->get_num_adc_samples();
+      core->get_num_adc_samples();
+      CPPUNIT_ASSERT_EQUAL(size_t(1), iface->num_reads);
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
+
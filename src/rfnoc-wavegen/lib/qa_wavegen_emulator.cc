@@ -0,0 +1,307 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include "qa_wavegen_emulator.h"
+#include <wavegen/wavegen_emulator.hpp>
+#include <wavegen/wavegen_core.hpp>
+#include <wavegen/wavegen_waveform_library.hpp>
+#include <wavegen/wavegen_sequencer.hpp>
+#include <wavegen/waveform_synth.h>
+
+using uhd::rfnoc::wavegen_core;
+using uhd::rfnoc::wavegen_emulator;
+using uhd::rfnoc::wavegen_waveform_library;
+using uhd::rfnoc::wavegen_sequencer;
+
+namespace gr {
+  namespace wavegen {
+
+    static const double TICK_RATE = 1000.0;
+
+    static std::vector<boost::uint32_t>
+    ramp(size_t n, boost::uint32_t base = 0xFEED0000)
+    {
+      std::vector<boost::uint32_t> samples(n);
+      for (size_t i = 0; i < n; i++) {
+        samples[i] = boost::uint32_t(base + i);
+      }
+      return samples;
+    }
+
+    static std::vector<boost::uint64_t>
+    pulse_times(wavegen_emulator::sptr emu)
+    {
+      std::vector<boost::uint64_t> ticks;
+      wavegen_emulator::pulse_t pulse;
+      while (emu->recv_pulse(pulse)) {
+        ticks.push_back(pulse.ticks);
+      }
+      return ticks;
+    }
+
+    void
+    qa_wavegen_emulator::t1()
+    {
+      // Upload framing in every mode and header format
+      const wavegen_core::upload_mode_t modes[] = {
+        wavegen_core::UPLOAD_MODE_SR,
+        wavegen_core::UPLOAD_MODE_BURST,
+        wavegen_core::UPLOAD_MODE_STREAM
+      };
+      for (size_t m = 0; m < 3; m++) {
+        wavegen_emulator::sptr emu = wavegen_emulator::make(TICK_RATE, 1000);
+        wavegen_core::sptr core = wavegen_core::make(emu);
+        core->set_upload_mode(modes[m]);
+
+        core->set_waveform(ramp(4));
+        CPPUNIT_ASSERT(ramp(4) == emu->get_bank(0));
+        CPPUNIT_ASSERT_EQUAL(boost::uint32_t(4), core->get_waveform_len());
+
+        core->set_waveform(ramp(5000, 0x100), 700);
+        CPPUNIT_ASSERT(ramp(5000, 0x100) == emu->get_bank(0));
+
+        core->set_waveform(ramp(70000, 0x200), 990);
+        CPPUNIT_ASSERT(ramp(70000, 0x200) == emu->get_bank(0));
+        CPPUNIT_ASSERT_EQUAL(boost::uint32_t(70000), core->get_waveform_len());
+        CPPUNIT_ASSERT_EQUAL(size_t(3), emu->get_stats().uploads);
+        CPPUNIT_ASSERT_EQUAL(size_t(0), emu->get_stats().framing_errors);
+      }
+
+      // Stream words that skip the sc16 packing reach the block garbled
+      wavegen_emulator::sptr emu = wavegen_emulator::make(TICK_RATE);
+      const boost::uint32_t raw[] = { 0x57440000, 0x00000001, 0x1234 };
+      emu->stream_write(raw, 3);
+      CPPUNIT_ASSERT_EQUAL(size_t(1), emu->get_stats().framing_errors);
+      emu->reset();
+
+      // A segment without its first packet is dropped
+      emu->sr_write(wavegen_core::SR_AWG_RELOAD, 0x57440007);
+      emu->sr_write(wavegen_core::SR_AWG_RELOAD, 0x00010004);
+      emu->sr_write(wavegen_core::SR_AWG_RELOAD_LAST, 0x1234);
+      CPPUNIT_ASSERT_EQUAL(size_t(1), emu->get_stats().framing_errors);
+      CPPUNIT_ASSERT(emu->get_bank(0).empty());
+
+      // Uploads go to the load bank
+      wavegen_core::sptr core = wavegen_core::make(emu);
+      core->set_load_bank(1);
+      core->set_waveform(ramp(8));
+      CPPUNIT_ASSERT(emu->get_bank(0).empty());
+      CPPUNIT_ASSERT(ramp(8) == emu->get_bank(1));
+    }
+
+    void
+    qa_wavegen_emulator::t2()
+    {
+      // AUTO and MANUAL policies, PRF and command timing
+      wavegen_emulator::sptr emu = wavegen_emulator::make(TICK_RATE);
+      wavegen_core::sptr core = wavegen_core::make(emu);
+      core->setup_chirp(100, 0x10000, 0);
+      core->set_num_adc_samples(200);
+      core->set_prf_count(1000);
+      core->set_policy(wavegen_core::RADAR_POLICY_AUTO);
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::AWG_STATE_IDLE, core->get_state() & wavegen_core::AWG_STATE_MASK);
+
+      // One command starts a pulse train at the PRF
+      core->send_pulse(500);
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::AWG_STATE_WAIT, core->get_state() & wavegen_core::AWG_STATE_MASK);
+      emu->run_until(3550);
+      const boost::uint64_t state = core->get_state();
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::AWG_STATE_PULSE, state & wavegen_core::AWG_STATE_MASK);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(4), state >> wavegen_core::AWG_STATE_COUNT_SHIFT);
+      std::vector<boost::uint64_t> ticks = pulse_times(emu);
+      CPPUNIT_ASSERT_EQUAL(size_t(4), ticks.size());
+      for (size_t i = 0; i < ticks.size(); i++) {
+        CPPUNIT_ASSERT_EQUAL(boost::uint64_t(500 + 1000 * i), ticks[i]);
+      }
+
+      // Clearing the commands stops it
+      core->clear_commands();
+      emu->run_until(10000);
+      CPPUNIT_ASSERT(pulse_times(emu).empty());
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::AWG_STATE_IDLE, core->get_state() & wavegen_core::AWG_STATE_MASK);
+
+      // MANUAL: one pulse per command, never overlapping
+      core->set_policy(wavegen_core::RADAR_POLICY_MANUAL);
+      core->send_pulse(11000);
+      core->send_pulse(11100);
+      emu->run_until(20000);
+      ticks = pulse_times(emu);
+      CPPUNIT_ASSERT_EQUAL(size_t(2), ticks.size());
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(11000), ticks[0]);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(11200), ticks[1]);
+
+      // Late and immediate commands run at once
+      core->send_pulse(10);
+      CPPUNIT_ASSERT_EQUAL(size_t(1), emu->get_stats().late_commands);
+      core->send_pulse();
+      emu->run_until(21000);
+      ticks = pulse_times(emu);
+      CPPUNIT_ASSERT_EQUAL(size_t(2), ticks.size());
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(20000), ticks[0]);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(20200), ticks[1]);
+
+      // A scheduled burst is latched in one go and plays in order
+      std::vector<boost::uint64_t> sched;
+      for (size_t i = 0; i < 10; i++) {
+        sched.push_back(30000 + 500 * i);
+      }
+      core->send_commands(0, sched);
+      emu->run_until(40000);
+      CPPUNIT_ASSERT(sched == pulse_times(emu));
+    }
+
+    void
+    qa_wavegen_emulator::t3()
+    {
+      // Pulse output and readbacks
+      wavegen_emulator::sptr emu = wavegen_emulator::make(TICK_RATE);
+      wavegen_core::sptr core = wavegen_core::make(emu);
+      emu->set_keep_samples(true);
+      core->set_policy(wavegen_core::RADAR_POLICY_MANUAL);
+
+      core->setup_chirp(256, 0x00100000, 0xF0000000);
+      core->set_ctrl_word(wavegen_core::CTRL_WORD_SEL_CHIRP);
+      core->set_num_adc_samples(64);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(64), core->get_num_adc_samples());
+      core->send_pulse();
+
+      wavegen_emulator::pulse_t pulse;
+      CPPUNIT_ASSERT(emu->recv_pulse(pulse));
+      CPPUNIT_ASSERT(pulse.samples == waveform_synth::hw_chirp(256, 0x00100000, 0xF0000000));
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(64), pulse.rx_len);
+
+      core->set_waveform(ramp(300));
+      core->set_ctrl_word(wavegen_core::CTRL_WORD_SEL_AWG);
+      core->set_rx_len(1000);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(1000), core->get_rx_len());
+      core->set_prf_count(0x123456789ULL);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(0x123456789ULL), core->get_prf_count());
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::CTRL_WORD_SEL_AWG, core->get_ctrl_word());
+      CPPUNIT_ASSERT(core->get_state() & wavegen_core::AWG_STATE_LOADED);
+
+      emu->run_for(500);
+      core->send_pulse();
+      CPPUNIT_ASSERT(emu->recv_pulse(pulse));
+      CPPUNIT_ASSERT(pulse.samples == ramp(300));
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(1000), pulse.rx_len);
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::CTRL_WORD_SEL_AWG, pulse.ctrl_word);
+
+      // Records beyond the limit push out the oldest
+      emu->set_max_pulses(2);
+      for (size_t i = 0; i < 3; i++) {
+        emu->run_for(2000);
+        core->send_pulse();
+      }
+      CPPUNIT_ASSERT_EQUAL(size_t(2), emu->get_num_pulses_queued());
+      CPPUNIT_ASSERT_EQUAL(size_t(1), emu->get_stats().pulses_dropped);
+    }
+
+    void
+    qa_wavegen_emulator::t4()
+    {
+      // Bank swaps wait for the pulse boundary; timed writes wait for their time
+      wavegen_emulator::sptr emu = wavegen_emulator::make(TICK_RATE);
+      wavegen_core::sptr core = wavegen_core::make(emu);
+      core->set_policy(wavegen_core::RADAR_POLICY_MANUAL);
+      core->set_ctrl_word(wavegen_core::CTRL_WORD_SEL_AWG);
+      core->set_waveform(ramp(100));
+      core->set_num_adc_samples(400);
+
+      core->send_pulse();
+      emu->run_for(10);
+      core->select_bank(1);
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::AWG_BANK_SWAP_PENDING, core->get_bank_state());
+      emu->run_until(499);
+      CPPUNIT_ASSERT_EQUAL(size_t(0), core->get_live_bank());
+      emu->run_until(500);
+      CPPUNIT_ASSERT_EQUAL(size_t(1), core->get_live_bank());
+
+      // Idle: swaps at once
+      core->select_bank(0);
+      CPPUNIT_ASSERT_EQUAL(size_t(0), core->get_live_bank());
+
+      // Timed swap at 2 s
+      core->select_bank(1, uhd::time_spec_t(2.0));
+      CPPUNIT_ASSERT_EQUAL(size_t(1), emu->get_stats().timed_writes);
+      emu->run_until(1999);
+      CPPUNIT_ASSERT_EQUAL(size_t(0), core->get_live_bank());
+      emu->run_until(2000);
+      CPPUNIT_ASSERT_EQUAL(size_t(1), core->get_live_bank());
+    }
+
+    void
+    qa_wavegen_emulator::t5()
+    {
+      // Library and sequencer end to end
+      wavegen_emulator::sptr emu = wavegen_emulator::make(TICK_RATE);
+      wavegen_core::sptr core = wavegen_core::make(emu);
+      wavegen_waveform_library::sptr lib = wavegen_waveform_library::make(core);
+      wavegen_sequencer::sptr seq = wavegen_sequencer::make(core, lib);
+      lib->set_num_banks(2);
+
+      const wavegen_waveform_library::waveform_id_t a = lib->add(ramp(100, 0xA000));
+      const wavegen_waveform_library::waveform_id_t b = lib->add(ramp(200, 0xB000));
+      std::vector<wavegen_sequencer::entry_t> entries(3);
+      entries[0].waveform = a;
+      entries[0].ctrl_word = wavegen_core::CTRL_WORD_SEL_AWG;
+      entries[0].rx_len = 300;
+      entries[1].waveform = b;
+      entries[1].ctrl_word = wavegen_core::CTRL_WORD_SEL_AWG;
+      entries[1].rx_len = 300;
+      entries[2].rx_len = 150;
+      seq->set_sequence(entries);
+      seq->start();
+
+      core->setup_chirp(50, 0, 0x01000000);
+      core->set_prf_count(1000);
+      core->set_policy(wavegen_core::RADAR_POLICY_AUTO);
+      emu->set_keep_samples(true);
+      core->send_pulse(0);
+      emu->run_until(5500);
+
+      wavegen_emulator::pulse_t pulse;
+      for (size_t i = 0; i < 6; i++) {
+        CPPUNIT_ASSERT(emu->recv_pulse(pulse));
+        CPPUNIT_ASSERT_EQUAL(boost::uint64_t(1000 * i), pulse.ticks);
+        CPPUNIT_ASSERT_EQUAL(i % 3, pulse.seq_index);
+        switch (i % 3) {
+        case 0:
+          CPPUNIT_ASSERT(pulse.samples == ramp(100, 0xA000));
+          CPPUNIT_ASSERT_EQUAL(boost::uint32_t(300), pulse.rx_len);
+          break;
+        case 1:
+          CPPUNIT_ASSERT(pulse.samples == ramp(200, 0xB000));
+          CPPUNIT_ASSERT_EQUAL(boost::uint32_t(300), pulse.rx_len);
+          break;
+        case 2:
+          CPPUNIT_ASSERT_EQUAL(size_t(50), pulse.samples.size());
+          CPPUNIT_ASSERT_EQUAL(boost::uint32_t(150), pulse.rx_len);
+          break;
+        }
+      }
+      CPPUNIT_ASSERT(not emu->recv_pulse(pulse));
+      CPPUNIT_ASSERT_EQUAL(size_t(2), seq->get_index());
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
@@ -0,0 +1,121 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include "qa_wavegen_metrics.h"
+#include <wavegen/wavegen_metrics.hpp>
+#include <wavegen/wavegen_emulator.hpp>
+#include <wavegen/wavegen_core.hpp>
+#include <wavegen/wavegen_config.hpp>
+#include <boost/thread/thread.hpp>
+
+using uhd::rfnoc::wavegen_metrics;
+using uhd::rfnoc::wavegen_emulator;
+using uhd::rfnoc::wavegen_core;
+using uhd::rfnoc::wavegen_config;
+
+namespace gr {
+  namespace wavegen {
+
+    static wavegen_metrics::sptr
+    make_metrics()
+    {
+      std::vector<std::string> names;
+      names.push_back("send_pulse");
+      names.push_back("get_state");
+      return wavegen_metrics::make(names);
+    }
+
+    static void
+    time_calls(wavegen_metrics::sptr metrics, size_t n)
+    {
+      for (size_t i = 0; i < n; i++) {
+        wavegen_metrics::scoped_call call(*metrics, 0);
+      }
+    }
+
+    void
+    qa_wavegen_metrics::t1()
+    {
+      // Per-method slots, concurrent recording and reset
+      wavegen_metrics::sptr metrics = make_metrics();
+      {
+        wavegen_metrics::scoped_call call(*metrics, 1);
+        boost::this_thread::sleep(boost::posix_time::milliseconds(2));
+      }
+      boost::thread_group threads;
+      for (size_t i = 0; i < 4; i++) {
+        threads.create_thread(boost::bind(&time_calls, metrics, 10000));
+      }
+      threads.join_all();
+
+      wavegen_metrics::snapshot_t snap = metrics->snapshot();
+      CPPUNIT_ASSERT_EQUAL(size_t(2), snap.methods.size());
+      CPPUNIT_ASSERT_EQUAL(std::string("send_pulse"), snap.methods[0].name);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(40000), snap.methods[0].calls);
+      CPPUNIT_ASSERT_EQUAL(std::string("get_state"), snap.methods[1].name);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(1), snap.methods[1].calls);
+      CPPUNIT_ASSERT(snap.methods[1].total_ns >= 2000000);
+
+      CPPUNIT_ASSERT_THROW(metrics->record_call(2, 0), uhd::index_error);
+
+      metrics->reset();
+      snap = metrics->snapshot();
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(0), snap.methods[0].calls);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(0), snap.methods[1].total_ns);
+    }
+
+    void
+    qa_wavegen_metrics::t2()
+    {
+      // The wrapped backend counts what the core puts on the bus
+      wavegen_emulator::sptr emu = wavegen_emulator::make(1000.0, 100);
+      wavegen_metrics::sptr metrics = make_metrics();
+      wavegen_core::sptr core = wavegen_core::make(metrics->wrap(emu));
+      core->set_cache_enabled(false);
+      metrics->reset();
+
+      core->set_rx_len(100);
+      core->get_state();
+      core->get_state();
+      wavegen_metrics::snapshot_t snap = metrics->snapshot();
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(1), snap.sr_writes);
+      // set_rx_len() reads the waveform length first
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(3), snap.rb_reads);
+
+      wavegen_config config;
+      config.set_prf_count(1000);
+      config.set_num_adc_samples(64);
+      core->commit(config);
+      snap = metrics->snapshot();
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(1), snap.sr_bursts);
+      CPPUNIT_ASSERT(snap.sr_writes > 1);
+
+      core->set_upload_mode(wavegen_core::UPLOAD_MODE_STREAM);
+      core->set_waveform(std::vector<boost::uint32_t>(250, 0x7FFF0000));
+      snap = metrics->snapshot();
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(3), snap.stream_packets);
+      CPPUNIT_ASSERT(snap.stream_words > 250);
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
@@ -0,0 +1,206 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include "qa_wavegen_pulse_scheduler.h"
+#include "wavegen_mock_reg_iface.h"
+#include <wavegen/wavegen_pulse_scheduler.hpp>
+#include <wavegen/thread_profile.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+
+using uhd::rfnoc::wavegen_core;
+using uhd::rfnoc::wavegen_pulse_scheduler;
+using uhd::rfnoc::wavegen_mock_reg_iface;
+
+namespace gr {
+  namespace wavegen {
+
+    /* Device time under test control */
+    class fake_clock
+    {
+    public:
+      fake_clock(void): _ticks(0) {}
+
+      boost::uint64_t get_ticks(void)
+      {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _ticks;
+      }
+
+      void set_ticks(const boost::uint64_t ticks)
+      {
+        boost::mutex::scoped_lock lock(_mutex);
+        _ticks = ticks;
+      }
+
+    private:
+      boost::mutex _mutex;
+      boost::uint64_t _ticks;
+    };
+
+    /* Mock whose settings bursts fail while the test says so */
+    class failing_reg_iface : public wavegen_mock_reg_iface
+    {
+    public:
+      failing_reg_iface(void): fail(false) {}
+
+      void sr_write_burst(const sr_burst_t &ops)
+      {
+        if (fail) {
+          throw uhd::io_error("failing_reg_iface: bus timeout");
+        }
+        wavegen_mock_reg_iface::sr_write_burst(ops);
+      }
+
+      bool fail;
+    };
+
+    /* Wait up to a second for the refill thread to issue n pulses */
+    static bool
+    wait_issued(wavegen_pulse_scheduler::sptr sched, size_t n)
+    {
+      for (size_t i = 0; i < 1000; i++) {
+        if (sched->get_stats().pulses_issued >= n) {
+          return true;
+        }
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+      }
+      return false;
+    }
+
+    void
+    qa_wavegen_pulse_scheduler::t1()
+    {
+      // Schedule longer than the queue is fed as it drains
+      wavegen_mock_reg_iface::sptr iface(new wavegen_mock_reg_iface());
+      wavegen_core::sptr core = wavegen_core::make(iface);
+      fake_clock clock;
+      wavegen_pulse_scheduler::sptr sched = wavegen_pulse_scheduler::make(
+        core, boost::bind(&fake_clock::get_ticks, &clock), 1e6, 4);
+
+      sched->schedule_burst(1000, 100, 10);
+      CPPUNIT_ASSERT_EQUAL(size_t(4), sched->get_queue_depth());
+      CPPUNIT_ASSERT_EQUAL(size_t(6), sched->get_num_pending());
+      CPPUNIT_ASSERT_EQUAL(size_t(1), iface->num_transactions);
+
+      // Two pulses fire; the refill thread tops the queue back up
+      clock.set_ticks(1150);
+      CPPUNIT_ASSERT(wait_issued(sched, 6));
+      CPPUNIT_ASSERT_EQUAL(size_t(4), sched->get_queue_depth());
+      CPPUNIT_ASSERT_EQUAL(size_t(4), sched->get_num_pending());
+
+      clock.set_ticks(2000);
+      CPPUNIT_ASSERT(sched->wait_done(1.0));
+      CPPUNIT_ASSERT_EQUAL(size_t(0), sched->get_queue_depth());
+
+      // Every pulse went out exactly once, in order
+      wavegen_pulse_scheduler::stats_t stats = sched->get_stats();
+      CPPUNIT_ASSERT_EQUAL(size_t(10), stats.pulses_issued);
+      CPPUNIT_ASSERT_EQUAL(size_t(4), stats.max_queue_depth);
+      std::vector<boost::uint32_t> time_lo;
+      for (size_t i = 0; i < iface->writes.size(); i++) {
+        if (iface->writes[i].reg == wavegen_core::SR_RADAR_CTRL_TIME_LO) {
+          time_lo.push_back(iface->writes[i].data);
+        }
+      }
+      CPPUNIT_ASSERT_EQUAL(size_t(10), time_lo.size());
+      for (size_t i = 0; i < time_lo.size(); i++) {
+        CPPUNIT_ASSERT_EQUAL(boost::uint32_t(1000 + 100 * i), time_lo[i]);
+      }
+      CPPUNIT_ASSERT_EQUAL(size_t(stats.bursts), iface->num_transactions);
+    }
+
+    void
+    qa_wavegen_pulse_scheduler::t2()
+    {
+      // Validation, late pulses and cancel
+      wavegen_mock_reg_iface::sptr iface(new wavegen_mock_reg_iface());
+      wavegen_core::sptr core = wavegen_core::make(iface);
+      fake_clock clock;
+      clock.set_ticks(500);
+      wavegen_pulse_scheduler::sptr sched = wavegen_pulse_scheduler::make(
+        core, boost::bind(&fake_clock::get_ticks, &clock), 1e6, 4);
+
+      std::vector<boost::uint64_t> ticks;
+      ticks.push_back(400);
+      ticks.push_back(600);
+      sched->schedule_pulses(ticks);
+      CPPUNIT_ASSERT_EQUAL(size_t(1), sched->get_stats().late_pulses);
+
+      ticks.assign(1, 550);
+      CPPUNIT_ASSERT_THROW(sched->schedule_pulses(ticks), uhd::value_error);
+      CPPUNIT_ASSERT_THROW(sched->schedule_burst(700, 0, 2), uhd::value_error);
+
+      sched->schedule_burst(700, 100, 20);
+      iface->reset_counters();
+      sched->cancel();
+      CPPUNIT_ASSERT_EQUAL(size_t(0), sched->get_num_pending());
+      CPPUNIT_ASSERT_EQUAL(size_t(0), sched->get_queue_depth());
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::SR_RADAR_CTRL_CLEAR_CMDS, iface->writes.back().reg);
+
+      CPPUNIT_ASSERT_THROW(
+        wavegen_pulse_scheduler::make(core, boost::bind(&fake_clock::get_ticks, &clock), 1e6, 0),
+        uhd::value_error);
+
+      // The refill thread runs in the profile's control role
+      gr::wavegen::thread_profile::sptr threads =
+        gr::wavegen::thread_profile::make(gr::wavegen::thread_profile::config_t());
+      wavegen_pulse_scheduler::make(
+        core, boost::bind(&fake_clock::get_ticks, &clock), 1e6, 4, threads).reset();
+      const std::vector<gr::wavegen::thread_profile::thread_stats_t> thread_stats = threads->get_thread_stats();
+      CPPUNIT_ASSERT_EQUAL(size_t(1), thread_stats.size());
+      CPPUNIT_ASSERT(thread_stats[0].role == gr::wavegen::thread_profile::ROLE_CONTROL);
+      CPPUNIT_ASSERT_EQUAL(std::string("pulse scheduler"), thread_stats[0].name);
+      CPPUNIT_ASSERT(not thread_stats[0].running);
+    }
+
+    void
+    qa_wavegen_pulse_scheduler::t3()
+    {
+      // A refill that fails on the background thread reaches the caller
+      boost::shared_ptr<failing_reg_iface> iface(new failing_reg_iface());
+      wavegen_core::sptr core = wavegen_core::make(iface);
+      fake_clock clock;
+      wavegen_pulse_scheduler::sptr sched = wavegen_pulse_scheduler::make(
+        core, boost::bind(&fake_clock::get_ticks, &clock), 1e6, 4);
+
+      sched->schedule_burst(1000, 100, 10);
+      iface->fail = true;
+      clock.set_ticks(1150);
+      CPPUNIT_ASSERT_THROW(sched->wait_done(1.0), uhd::runtime_error);
+      CPPUNIT_ASSERT_THROW(sched->schedule_burst(5000, 100, 2), uhd::runtime_error);
+      CPPUNIT_ASSERT_EQUAL(size_t(4), sched->get_stats().pulses_issued);
+      CPPUNIT_ASSERT_EQUAL(size_t(6), sched->get_num_pending());
+
+      // cancel() clears the error and the scheduler works again
+      iface->fail = false;
+      sched->cancel();
+      sched->schedule_burst(5000, 100, 2);
+      clock.set_ticks(6000);
+      CPPUNIT_ASSERT(sched->wait_done(1.0));
+      CPPUNIT_ASSERT_EQUAL(size_t(6), sched->get_stats().pulses_issued);
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
@@ -0,0 +1,129 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include "qa_wavegen_sequencer.h"
+#include "wavegen_mock_reg_iface.h"
+#include <wavegen/wavegen_sequencer.hpp>
+
+using uhd::rfnoc::wavegen_core;
+using uhd::rfnoc::wavegen_waveform_library;
+using uhd::rfnoc::wavegen_sequencer;
+using uhd::rfnoc::wavegen_mock_reg_iface;
+
+namespace gr {
+  namespace wavegen {
+
+    static wavegen_sequencer::entry_t
+    awg_entry(wavegen_waveform_library::waveform_id_t id, boost::uint32_t rx_len)
+    {
+      wavegen_sequencer::entry_t e;
+      e.waveform = id;
+      e.ctrl_word = wavegen_core::CTRL_WORD_SEL_AWG;
+      e.rx_len = rx_len;
+      return e;
+    }
+
+    void
+    qa_wavegen_sequencer::t1()
+    {
+      // Table layout and waveform placement
+      wavegen_mock_reg_iface::sptr iface(new wavegen_mock_reg_iface());
+      wavegen_core::sptr core = wavegen_core::make(iface);
+      wavegen_waveform_library::sptr lib = wavegen_waveform_library::make(core);
+      wavegen_sequencer::sptr seq = wavegen_sequencer::make(core, lib);
+      lib->set_num_banks(2);
+
+      const wavegen_waveform_library::waveform_id_t a = lib->add(std::vector<boost::uint32_t>(100, 1));
+      const wavegen_waveform_library::waveform_id_t b = lib->add(std::vector<boost::uint32_t>(200, 2));
+      lib->set_waveform(std::vector<boost::uint32_t>(200, 2));
+      CPPUNIT_ASSERT_EQUAL(size_t(1), lib->get_bank(b));
+
+      std::vector<wavegen_sequencer::entry_t> entries;
+      entries.push_back(awg_entry(a, 528));
+      entries.push_back(awg_entry(b, 528));
+      wavegen_sequencer::entry_t chirp;
+      chirp.tuning_coef = 0x1234;
+      chirp.freq_offset = 0x56;
+      chirp.rx_len = 400;
+      entries.push_back(chirp);
+
+      // b stays where it is, a goes to the free bank
+      iface->reset_counters();
+      seq->set_sequence(entries);
+      CPPUNIT_ASSERT_EQUAL(size_t(0), lib->get_bank(a));
+      CPPUNIT_ASSERT_EQUAL(size_t(1), lib->get_bank(b));
+
+      // The table is the last burst: stop, address, 3 x 5 words
+      const size_t t = iface->writes.size() - 3 * wavegen_core::SEQ_WORDS_PER_ENTRY;
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::SR_SEQ_CTRL, iface->writes[t - 2].reg);
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::SR_SEQ_ADDR, iface->writes[t - 1].reg);
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::SR_SEQ_DATA, iface->writes[t].reg);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(0), iface->writes[t + 0].data);
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::CTRL_WORD_SEL_AWG, iface->writes[t + 1].data);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(527 - 100), iface->writes[t + 4].data);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(1), iface->writes[t + 5].data);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(527 - 200), iface->writes[t + 9].data);
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::CTRL_WORD_SEL_CHIRP, iface->writes[t + 11].data);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(0x1234), iface->writes[t + 12].data);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(399), iface->writes[t + 14].data);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(2), iface->sr[wavegen_core::SR_SEQ_CTRL]);
+
+      // Constant host traffic once running
+      seq->start();
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::SEQ_CTRL_ENABLE | 2, iface->sr[wavegen_core::SR_SEQ_CTRL]);
+      iface->rb[wavegen_core::RB_SEQ_INDEX] = 2;
+      CPPUNIT_ASSERT_EQUAL(size_t(2), seq->get_index());
+      seq->stop();
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(2), iface->sr[wavegen_core::SR_SEQ_CTRL]);
+    }
+
+    void
+    qa_wavegen_sequencer::t2()
+    {
+      // Limits
+      wavegen_mock_reg_iface::sptr iface(new wavegen_mock_reg_iface());
+      wavegen_core::sptr core = wavegen_core::make(iface);
+      wavegen_waveform_library::sptr lib = wavegen_waveform_library::make(core);
+      wavegen_sequencer::sptr seq = wavegen_sequencer::make(core, lib);
+
+      CPPUNIT_ASSERT_THROW(seq->start(), uhd::runtime_error);
+      CPPUNIT_ASSERT_THROW(seq->set_sequence(std::vector<wavegen_sequencer::entry_t>()), uhd::value_error);
+
+      // One bank: only one AWG waveform per sequence
+      const wavegen_waveform_library::waveform_id_t a = lib->add(std::vector<boost::uint32_t>(100, 1));
+      const wavegen_waveform_library::waveform_id_t b = lib->add(std::vector<boost::uint32_t>(100, 2));
+      std::vector<wavegen_sequencer::entry_t> entries;
+      entries.push_back(awg_entry(a, 200));
+      entries.push_back(awg_entry(b, 200));
+      CPPUNIT_ASSERT_THROW(seq->set_sequence(entries), uhd::value_error);
+
+      entries.pop_back();
+      entries.push_back(awg_entry(a, 50));
+      CPPUNIT_ASSERT_THROW(seq->set_sequence(entries), uhd::value_error);
+      entries.back().rx_len = 200;
+      seq->set_sequence(entries);
+      CPPUNIT_ASSERT(lib->is_live(a));
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
@@ -0,0 +1,231 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include "qa_wavegen_status_monitor.h"
+#include "wavegen_mock_reg_iface.h"
+#include <wavegen/wavegen_status_monitor.hpp>
+#include <wavegen/wavegen_emulator.hpp>
+#include <wavegen/wavegen_core.hpp>
+#include <wavegen/wavegen_waveform_library.hpp>
+#include <wavegen/thread_profile.h>
+#include <boost/thread/thread.hpp>
+#include <boost/atomic.hpp>
+
+using uhd::rfnoc::wavegen_status;
+using uhd::rfnoc::wavegen_status_monitor;
+using uhd::rfnoc::wavegen_emulator;
+using uhd::rfnoc::wavegen_core;
+using uhd::rfnoc::wavegen_waveform_library;
+using uhd::rfnoc::wavegen_mock_reg_iface;
+
+namespace gr {
+  namespace wavegen {
+
+    /* Every register of the n-th batched readback reads n */
+    class counting_backend : public uhd::rfnoc::wavegen_reg_iface
+    {
+    public:
+      typedef boost::shared_ptr<counting_backend> sptr;
+
+      counting_backend(void): _bursts(0) {}
+
+      void sr_write(const boost::uint32_t, const boost::uint32_t) {}
+
+      boost::uint64_t user_reg_read64(const boost::uint32_t)
+      {
+        return _bursts;
+      }
+
+      void user_reg_read64_burst(const std::vector<boost::uint32_t> &addrs, std::vector<boost::uint64_t> &values)
+      {
+        values.assign(addrs.size(), ++_bursts);
+      }
+
+    private:
+      boost::uint64_t _bursts;
+    };
+
+    static void
+    read_until_stopped(wavegen_status_monitor::sptr monitor,
+                       boost::atomic<bool> *done,
+                       boost::atomic<bool> *ordered)
+    {
+      boost::uint64_t last = 0;
+      while (not done->load()) {
+        const wavegen_status status = monitor->get_status();
+        /* A torn copy would mix the fields of two polls */
+        if (status.sequence < last or status.raw_state != status.sequence
+            or status.prf_count != status.sequence
+            or status.waveform_len != boost::uint32_t(status.sequence)) {
+          ordered->store(false);
+        }
+        last = status.sequence;
+      }
+    }
+
+    void
+    qa_wavegen_status_monitor::t1()
+    {
+      // Every field decoded from one batched readback
+      wavegen_mock_reg_iface::sptr regs(new wavegen_mock_reg_iface());
+      regs->rb[wavegen_core::RB_AWG_LEN] = 4;
+      regs->rb[wavegen_core::RB_ADC_LEN] = 100;
+      regs->rb[wavegen_core::RB_AWG_CTRL] = wavegen_core::CTRL_WORD_SEL_AWG;
+      regs->rb[wavegen_core::RB_AWG_PRF] = 5000;
+      regs->rb[wavegen_core::RB_AWG_POLICY] = wavegen_core::RADAR_POLICY_AUTO;
+      regs->rb[wavegen_core::RB_AWG_STATE] = (boost::uint64_t(77) << wavegen_core::AWG_STATE_COUNT_SHIFT)
+        | (boost::uint64_t(3) << wavegen_core::AWG_STATE_QUEUE_SHIFT)
+        | wavegen_core::AWG_STATE_LATE | wavegen_core::AWG_STATE_LOADED
+        | wavegen_core::AWG_STATE_PULSE;
+      regs->rb[wavegen_core::RB_AWG_BANK] = wavegen_core::AWG_BANK_LOAD_MASK
+        | wavegen_core::AWG_BANK_SWAP_PENDING | 1;
+      regs->rb[wavegen_core::RB_SEQ_INDEX] = 9;
+      wavegen_core::sptr core = wavegen_core::make(regs);
+      regs->reset_counters();
+
+      const wavegen_status status = core->get_status();
+      CPPUNIT_ASSERT_EQUAL(size_t(1), regs->num_transactions);
+      CPPUNIT_ASSERT_EQUAL(size_t(8), regs->num_reads);
+      CPPUNIT_ASSERT_EQUAL(boost::uint8_t(wavegen_core::AWG_STATE_PULSE), status.state);
+      CPPUNIT_ASSERT(status.busy);
+      CPPUNIT_ASSERT(status.loaded);
+      CPPUNIT_ASSERT(status.late);
+      CPPUNIT_ASSERT(not status.underrun);
+      CPPUNIT_ASSERT(not status.seq_enabled);
+      CPPUNIT_ASSERT_EQUAL(boost::uint16_t(3), status.queue_depth);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(77), status.pulse_count);
+      CPPUNIT_ASSERT_EQUAL(size_t(1), status.live_bank);
+      CPPUNIT_ASSERT_EQUAL(size_t(1), status.load_bank);
+      CPPUNIT_ASSERT(status.swap_pending);
+      CPPUNIT_ASSERT_EQUAL(size_t(9), status.seq_index);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(4), status.waveform_len);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(100), status.num_adc_samples);
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::CTRL_WORD_SEL_AWG, status.ctrl_word);
+      CPPUNIT_ASSERT_EQUAL(wavegen_core::RADAR_POLICY_AUTO, status.policy);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(5000), status.prf_count);
+      CPPUNIT_ASSERT(not status.waveform_known);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(0), status.sequence);
+      CPPUNIT_ASSERT(not status.chirp_known);
+
+      // The chirp settings come from the shadow registers, not the bus
+      core->setup_chirp(256, 1000, 20);
+      regs->reset_counters();
+      const wavegen_status chirped = core->get_status();
+      CPPUNIT_ASSERT_EQUAL(size_t(8), regs->num_reads);
+      CPPUNIT_ASSERT(chirped.chirp_known);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(256), chirped.chirp_len);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(1000), chirped.chirp_tuning_coef);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(20), chirped.chirp_freq_offset);
+
+      // Also with the cache off, until the core is told to forget
+      core->set_cache_enabled(false);
+      core->set_chirp_counter(127);
+      core->set_chirp_tuning_coef(5);
+      core->set_chirp_freq_offset(6);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(128), core->get_status().chirp_len);
+      core->refresh();
+      CPPUNIT_ASSERT(not core->get_status().chirp_known);
+    }
+
+    void
+    qa_wavegen_status_monitor::t2()
+    {
+      // Sticky flags from the emulator and the live waveform id
+      wavegen_emulator::sptr emu = wavegen_emulator::make(1000.0, 0);
+      wavegen_core::sptr core = wavegen_core::make(emu);
+      wavegen_waveform_library::sptr library = wavegen_waveform_library::make(core);
+      wavegen_status_monitor::sptr monitor = wavegen_status_monitor::make(core, library);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(0), monitor->get_status().sequence);
+
+      core->set_policy(wavegen_core::RADAR_POLICY_MANUAL);
+      core->set_ctrl_word(wavegen_core::CTRL_WORD_SEL_AWG);
+      core->send_pulse();
+      emu->run_until(1000);
+      wavegen_status status = monitor->poll();
+      CPPUNIT_ASSERT(status.underrun);
+      CPPUNIT_ASSERT(not status.late);
+      CPPUNIT_ASSERT(not status.waveform_known);
+
+      core->send_pulse(10);
+      status = monitor->poll();
+      CPPUNIT_ASSERT(status.late);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(2), monitor->get_status().sequence);
+
+      core->clear_commands();
+      const wavegen_waveform_library::waveform_id_t id =
+        library->set_waveform(std::vector<boost::uint32_t>(16, 0x40000000));
+      status = monitor->poll();
+      CPPUNIT_ASSERT(not status.late);
+      CPPUNIT_ASSERT(not status.underrun);
+      CPPUNIT_ASSERT(status.loaded);
+      CPPUNIT_ASSERT_EQUAL(boost::uint16_t(0), status.queue_depth);
+      CPPUNIT_ASSERT(status.waveform_known);
+      CPPUNIT_ASSERT_EQUAL(id, status.waveform_id);
+
+      CPPUNIT_ASSERT_THROW(monitor->start(0), uhd::value_error);
+    }
+
+    void
+    qa_wavegen_status_monitor::t3()
+    {
+      // Background polling with concurrent readers never sees a torn snapshot
+      wavegen_status_monitor::sptr monitor =
+        wavegen_status_monitor::make(wavegen_core::make(counting_backend::sptr(new counting_backend())));
+      CPPUNIT_ASSERT(not monitor->is_running());
+      monitor->start(2000.0);
+      CPPUNIT_ASSERT(monitor->is_running());
+
+      boost::atomic<bool> done(false);
+      boost::atomic<bool> ordered(true);
+      boost::thread_group readers;
+      for (size_t i = 0; i < 3; i++) {
+        readers.create_thread(boost::bind(&read_until_stopped, monitor, &done, &ordered));
+      }
+      boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+      done.store(true);
+      readers.join_all();
+      monitor->stop();
+      CPPUNIT_ASSERT(not monitor->is_running());
+
+      CPPUNIT_ASSERT(ordered.load());
+      const wavegen_status_monitor::stats_t stats = monitor->get_stats();
+      CPPUNIT_ASSERT(stats.polls > 10);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(0), stats.errors);
+      CPPUNIT_ASSERT_EQUAL(stats.polls, monitor->get_status().sequence);
+
+      // The poll thread runs in the profile's control role
+      gr::wavegen::thread_profile::sptr threads =
+        gr::wavegen::thread_profile::make(gr::wavegen::thread_profile::config_t());
+      monitor = wavegen_status_monitor::make(
+        wavegen_core::make(counting_backend::sptr(new counting_backend())), wavegen_waveform_library::sptr(), threads);
+      monitor->start(2000.0);
+      monitor->stop();
+      const std::vector<gr::wavegen::thread_profile::thread_stats_t> thread_stats = threads->get_thread_stats();
+      CPPUNIT_ASSERT_EQUAL(size_t(1), thread_stats.size());
+      CPPUNIT_ASSERT(thread_stats[0].role == gr::wavegen::thread_profile::ROLE_CONTROL);
+      CPPUNIT_ASSERT_EQUAL(std::string("status monitor"), thread_stats[0].name);
+      CPPUNIT_ASSERT(not thread_stats[0].running);
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
@@ -0,0 +1,203 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include "qa_wavegen_waveform_library.h"
+#include "wavegen_mock_reg_iface.h"
+#include <wavegen/wavegen_waveform_library.hpp>
+
+using uhd::rfnoc::wavegen_core;
+using uhd::rfnoc::wavegen_waveform_library;
+using uhd::rfnoc::wavegen_mock_reg_iface;
+
+namespace gr {
+  namespace wavegen {
+
+    static std::vector<boost::uint32_t>
+    tone(size_t n, boost::uint32_t step)
+    {
+      std::vector<boost::uint32_t> samples(n);
+      for (size_t i = 0; i < n; i++) {
+        samples[i] = boost::uint32_t(i * step);
+      }
+      return samples;
+    }
+
+    void
+    qa_wavegen_waveform_library::t1()
+    {
+      // Resident waveforms are not uploaded again
+      wavegen_mock_reg_iface::sptr iface(new wavegen_mock_reg_iface());
+      wavegen_core::sptr core = wavegen_core::make(iface);
+      wavegen_waveform_library::sptr lib = wavegen_waveform_library::make(core);
+
+      const wavegen_waveform_library::waveform_id_t a = lib->set_waveform(tone(256, 1));
+      const size_t upload_writes = iface->num_sr_writes;
+      CPPUNIT_ASSERT(lib->is_resident(a));
+      CPPUNIT_ASSERT_EQUAL(a, lib->set_waveform(tone(256, 1)));
+      CPPUNIT_ASSERT_EQUAL(upload_writes, iface->num_sr_writes);
+
+      // Same content, same id, one copy
+      CPPUNIT_ASSERT_EQUAL(a, lib->add(tone(256, 1)));
+      const wavegen_waveform_library::waveform_id_t b = lib->add(tone(256, 2));
+      CPPUNIT_ASSERT(a != b);
+      CPPUNIT_ASSERT_EQUAL(size_t(2), lib->size());
+      CPPUNIT_ASSERT(a != wavegen_waveform_library::hash(tone(255, 1)));
+      CPPUNIT_ASSERT(lib->get_samples(b) == tone(256, 2));
+
+      // Switching uploads once per change
+      lib->select(b);
+      lib->select(b);
+      lib->select(a, 64);
+      CPPUNIT_ASSERT(lib->is_resident(a));
+      CPPUNIT_ASSERT(not lib->is_resident(b));
+
+      wavegen_waveform_library::stats_t stats = lib->get_stats();
+      CPPUNIT_ASSERT_EQUAL(size_t(3), stats.misses);
+      CPPUNIT_ASSERT_EQUAL(size_t(2), stats.hits);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(2 * 256 * 4), stats.bytes_avoided);
+      CPPUNIT_ASSERT_EQUAL(boost::uint64_t(3 * 256 * 4), stats.bytes_uploaded);
+    }
+
+    void
+    qa_wavegen_waveform_library::t2()
+    {
+      // Residency is dropped by foreign uploads and invalidate()
+      wavegen_mock_reg_iface::sptr iface(new wavegen_mock_reg_iface());
+      wavegen_core::sptr core = wavegen_core::make(iface);
+      wavegen_waveform_library::sptr lib = wavegen_waveform_library::make(core);
+
+      const wavegen_waveform_library::waveform_id_t a = lib->set_waveform(tone(64, 3));
+      core->set_waveform(tone(64, 5));
+      CPPUNIT_ASSERT(not lib->is_resident(a));
+      lib->select(a);
+      CPPUNIT_ASSERT(lib->is_resident(a));
+      lib->invalidate();
+      CPPUNIT_ASSERT(not lib->is_resident(a));
+      CPPUNIT_ASSERT_EQUAL(size_t(2), lib->get_stats().misses);
+
+      lib->remove(a);
+      CPPUNIT_ASSERT(not lib->contains(a));
+      CPPUNIT_ASSERT_THROW(lib->select(a), uhd::key_error);
+      CPPUNIT_ASSERT_THROW(lib->add(std::vector<boost::uint32_t>()), uhd::value_error);
+    }
+
+    /* Bank the AWG was last told to play */
+    static boost::uint32_t
+    selected_bank(wavegen_mock_reg_iface::sptr iface)
+    {
+      return iface->sr[wavegen_core::SR_AWG_BANK_SEL];
+    }
+
+    void
+    qa_wavegen_waveform_library::t3()
+    {
+      // Ping-pong banks
+      wavegen_mock_reg_iface::sptr iface(new wavegen_mock_reg_iface());
+      wavegen_core::sptr core = wavegen_core::make(iface);
+      wavegen_waveform_library::sptr lib = wavegen_waveform_library::make(core);
+      CPPUNIT_ASSERT_THROW(lib->swap(), uhd::runtime_error);
+      lib->set_num_banks(2);
+      CPPUNIT_ASSERT_EQUAL(size_t(0), lib->get_live_bank());
+
+      // A new waveform goes to the idle bank, then the banks swap
+      const wavegen_waveform_library::waveform_id_t a = lib->set_waveform(tone(128, 1));
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(1), iface->sr[wavegen_core::SR_AWG_LOAD_BANK]);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(1), selected_bank(iface));
+      CPPUNIT_ASSERT(lib->is_live(a));
+
+      // Prefetch loads the idle bank without touching playback
+      const wavegen_waveform_library::waveform_id_t b = lib->add(tone(128, 2));
+      iface->reset_counters();
+      lib->prefetch(b);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(0), iface->sr[wavegen_core::SR_AWG_LOAD_BANK]);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(1), selected_bank(iface));
+      CPPUNIT_ASSERT(lib->is_live(a));
+      CPPUNIT_ASSERT(lib->is_resident(b));
+
+      // Switching between resident waveforms is one write each
+      iface->reset_counters();
+      lib->select(b);
+      lib->select(a);
+      lib->select(a);
+      CPPUNIT_ASSERT_EQUAL(size_t(2), iface->num_sr_writes);
+      CPPUNIT_ASSERT_EQUAL(boost::uint32_t(1), selected_bank(iface));
+
+      // Timed swap
+      iface->reset_counters();
+      lib->select_at(b, uhd::time_spec_t(3.0));
+      CPPUNIT_ASSERT_EQUAL(size_t(1), iface->num_timed_writes);
+      CPPUNIT_ASSERT_EQUAL(size_t(0), lib->get_live_bank());
+
+      wavegen_waveform_library::stats_t stats = lib->get_stats();
+      CPPUNIT_ASSERT_EQUAL(size_t(2), stats.misses);
+      CPPUNIT_ASSERT_EQUAL(size_t(4), stats.bank_swaps);
+      CPPUNIT_ASSERT_EQUAL(size_t(4), stats.hits);
+    }
+
+    void
+    qa_wavegen_waveform_library::t4()
+    {
+      // Capacity, least recently used waveforms go first
+      wavegen_mock_reg_iface::sptr iface(new wavegen_mock_reg_iface());
+      wavegen_core::sptr core = wavegen_core::make(iface);
+      wavegen_waveform_library::sptr lib = wavegen_waveform_library::make(core);
+      CPPUNIT_ASSERT_EQUAL(wavegen_waveform_library::DEFAULT_CAPACITY, lib->get_capacity());
+      CPPUNIT_ASSERT_THROW(lib->set_capacity(0), uhd::value_error);
+      lib->set_num_banks(2);
+      lib->set_capacity(3);
+
+      const wavegen_waveform_library::waveform_id_t a = lib->set_waveform(tone(32, 1));
+      const wavegen_waveform_library::waveform_id_t b = lib->add(tone(32, 2));
+      const wavegen_waveform_library::waveform_id_t c = lib->add(tone(32, 3));
+      const wavegen_waveform_library::waveform_id_t d = lib->add(tone(32, 4));
+
+      // a is oldest but live, so b goes
+      CPPUNIT_ASSERT_EQUAL(size_t(3), lib->size());
+      CPPUNIT_ASSERT(lib->contains(a));
+      CPPUNIT_ASSERT(not lib->contains(b));
+      CPPUNIT_ASSERT_EQUAL(size_t(1), lib->get_stats().evictions);
+
+      // Use refreshes the order
+      lib->get_samples(c);
+      lib->set_waveform(tone(32, 5));
+      CPPUNIT_ASSERT(not lib->contains(d));
+      CPPUNIT_ASSERT(lib->contains(c));
+
+      // Shrinking keeps only what is in the banks
+      lib->set_capacity(1);
+      CPPUNIT_ASSERT_EQUAL(size_t(2), lib->size());
+      CPPUNIT_ASSERT(lib->contains(a));
+      CPPUNIT_ASSERT(not lib->contains(c));
+
+      // A stream of new waveforms stays bounded
+      lib->set_num_banks(1);
+      lib->set_capacity(4);
+      for (size_t i = 0; i < 20; i++) {
+        lib->set_waveform(tone(16, boost::uint32_t(10 + i)));
+      }
+      CPPUNIT_ASSERT_EQUAL(size_t(4), lib->size());
+      CPPUNIT_ASSERT_EQUAL(size_t(3 + 18), lib->get_stats().evictions);
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
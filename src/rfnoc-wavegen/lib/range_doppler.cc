@@ -0,0 +1,359 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <wavegen/range_doppler.h>
+#include "fft_plan_cache.h"
+#include "worker_ring.h"
+#include <volk/volk.h>
+#include <boost/chrono.hpp>
+#include <boost/format.hpp>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace gr {
+  namespace wavegen {
+
+    /* Range bins per work item; a CPI is split into this many pieces
+     * for the workers */
+    static const size_t CHUNK_BINS = 64;
+
+    /* Range bins per corner turn tile. Each pulse contributes
+     * TILE_BINS consecutive bins (two cache lines) per tile. */
+    static const size_t TILE_BINS = 16;
+
+    class range_doppler_impl : public range_doppler
+    {
+    public:
+      range_doppler_impl(const config_t &config):
+        _config(config),
+        _doppler_size(config.doppler_size ? config.doppler_size : config.cpi_len),
+        _num_chunks((config.num_bins + CHUNK_BINS - 1) / CHUNK_BINS),
+        _maps(config.num_cpis),
+        _ring(config.num_cpis, _num_chunks),
+        _open(false),
+        _cur_cpi(0),
+        _next_cpi(0)
+      {
+        if (config.num_bins == 0 or config.cpi_len == 0
+            or config.num_workers == 0 or config.num_cpis == 0) {
+          throw std::invalid_argument(
+            "range_doppler: num_bins, cpi_len, workers and CPI slots must be non-zero");
+        }
+        if (_doppler_size < config.cpi_len) {
+          throw std::invalid_argument(str(
+            boost::format("range_doppler: Doppler FFT size %d is below cpi_len %d")
+            % _doppler_size % config.cpi_len));
+        }
+        if (not (config.prf > 0.0)) {
+          throw std::invalid_argument("range_doppler: PRF must be positive");
+        }
+
+        if (config.window == gr::fft::window::WIN_NONE
+            or config.window == gr::fft::window::WIN_RECTANGULAR) {
+          _window.assign(config.cpi_len, 1.0f);
+        } else {
+          _window = gr::fft::window::build(config.window, config.cpi_len, 6.76);
+        }
+
+        _cube.resize(config.num_cpis * config.cpi_len * config.num_bins);
+        _received.resize(config.num_cpis * config.cpi_len);
+        _output.resize(config.num_cpis * config.num_bins * _doppler_size);
+        counter_t *counters[] = {
+          &_num_cpis, &_num_pulses, &_missing_pulses, &_late_pulses, &_process_ns
+        };
+        for (size_t i = 0; i < sizeof(counters) / sizeof(counters[0]); i++) {
+          counters[i]->store(0, boost::memory_order_relaxed);
+        }
+        /* Tiles are allocated here so a worker never allocates */
+        _tiles.resize(config.num_workers);
+        for (size_t i = 0; i < config.num_workers; i++) {
+          _tiles[i].resize(TILE_BINS * config.cpi_len);
+        }
+        if (config.threads) {
+          config.threads->validate(thread_profile::ROLE_PROCESS);
+        }
+        _ring.start(config.num_workers, boost::bind(&range_doppler_impl::worker_loop, this, _1));
+      }
+
+      ~range_doppler_impl()
+      {
+        _ring.stop();
+      }
+
+      void
+      process(const gr_complex *cube, float *out)
+      {
+        fft_plan_cache::plan fft(int(_doppler_size), true);
+        std::vector<gr_complex> tile(TILE_BINS * _config.cpi_len);
+        doppler_bins(cube, NULL, 0, _config.num_bins, out, fft, &tile[0]);
+      }
+
+      double
+      doppler_frequency(size_t k) const
+      {
+        return (double(k) - double(_doppler_size / 2)) * _config.prf / double(_doppler_size);
+      }
+
+      void
+      add(const pulse_framer::pulse_t &pulse)
+      {
+        if (pulse.nsamps > _config.num_bins) {
+          throw std::invalid_argument(str(
+            boost::format("range_doppler: pulse of %d bins is longer than num_bins %d")
+            % pulse.nsamps % _config.num_bins));
+        }
+        const boost::uint64_t cpi = pulse.index / _config.cpi_len;
+        if (_open and cpi > _cur_cpi) {
+          hand_on();
+        }
+        if (cpi < (_open ? _cur_cpi : _next_cpi)) {
+          count(_late_pulses);
+          return;
+        }
+        if (not _open) {
+          open(cpi);
+        }
+
+        const size_t slot = _ring.head_slot();
+        const size_t pos = size_t(pulse.index % _config.cpi_len);
+        char &received = _received[slot * _config.cpi_len + pos];
+        if (received) {
+          count(_late_pulses);
+          return;
+        }
+        gr_complex *row = &_cube[(slot * _config.cpi_len + pos) * _config.num_bins];
+        const gr_complex *bins = static_cast<const gr_complex *>(pulse.samples);
+        std::copy(bins, bins + pulse.nsamps, row);
+        std::fill(row + pulse.nsamps, row + _config.num_bins, gr_complex(0.0f));
+        received = 1;
+
+        map_t &map = _maps[slot];
+        map.pulses++;
+        if (pulse.has_time and not map.has_time) {
+          map.has_time = true;
+          map.time = pulse.time - uhd::time_spec_t(double(pos) / _config.prf);
+        }
+        count(_num_pulses);
+      }
+
+      void
+      flush()
+      {
+        if (_open) {
+          hand_on();
+        }
+      }
+
+      bool
+      front(map_t &map)
+      {
+        size_t slot;
+        if (not _ring.front(slot)) {
+          return false;
+        }
+        map = _maps[slot];
+        map.num_bins = _config.num_bins;
+        map.doppler_size = _doppler_size;
+        map.output = _config.output;
+        map.data = &_output[slot * _config.num_bins * _doppler_size];
+        return true;
+      }
+
+      void
+      pop()
+      {
+        if (not _ring.pop()) {
+          throw std::runtime_error("range_doppler: pop() without a finished map");
+        }
+      }
+
+      size_t
+      size()
+      {
+        return _ring.size();
+      }
+
+      stats_t
+      get_stats()
+      {
+        stats_t stats;
+        stats.cpis = _num_cpis.load(boost::memory_order_relaxed);
+        stats.pulses = _num_pulses.load(boost::memory_order_relaxed);
+        stats.missing_pulses = _missing_pulses.load(boost::memory_order_relaxed);
+        stats.late_pulses = _late_pulses.load(boost::memory_order_relaxed);
+        stats.process_ns = _process_ns.load(boost::memory_order_relaxed);
+        stats.backpressure_waits = _ring.backpressure_waits();
+        stats.max_pending = _ring.max_pending();
+        return stats;
+      }
+
+      config_t
+      get_config()
+      {
+        return _config;
+      }
+
+    private:
+      //! Start filling CPI \p cpi in the slot at the ring's head
+      void
+      open(boost::uint64_t cpi)
+      {
+        const size_t slot = _ring.acquire();
+        std::fill(_received.begin() + slot * _config.cpi_len,
+                  _received.begin() + (slot + 1) * _config.cpi_len, 0);
+        map_t &map = _maps[slot];
+        map = map_t();
+        map.index = cpi;
+        map.first_pulse = cpi * _config.cpi_len;
+        _cur_cpi = cpi;
+        _open = true;
+      }
+
+      //! Queue the open CPI's range bins for the workers
+      void
+      hand_on()
+      {
+        count(_missing_pulses, _config.cpi_len - _maps[_ring.head_slot()].pulses);
+        _ring.commit();
+        _open = false;
+        _next_cpi = _cur_cpi + 1;
+      }
+
+      /*!
+       * Map range bins [first, first + count) of \p cube. Missing
+       * pulses (received[p] == 0, if given) are taken as zeros.
+       */
+      void
+      doppler_bins(const gr_complex *cube, const char *received, size_t first, size_t count,
+                   float *out, fft_plan_cache::plan &fft, gr_complex *tile)
+      {
+        const size_t n = _config.cpi_len;
+        const size_t half = _doppler_size / 2;
+        gr_complex *in = fft.in();
+        std::fill(in + n, in + _doppler_size, gr_complex(0.0f));
+        for (size_t b0 = first; b0 < first + count; b0 += TILE_BINS) {
+          const size_t nb = std::min(TILE_BINS, first + count - b0);
+          /* Corner turn: read each pulse's bins in order, write one tile row per bin */
+          for (size_t p = 0; p < n; p++) {
+            if (received and not received[p]) {
+              for (size_t j = 0; j < nb; j++) {
+                tile[j * n + p] = gr_complex(0.0f);
+              }
+              continue;
+            }
+            const gr_complex *row = cube + p * _config.num_bins + b0;
+            for (size_t j = 0; j < nb; j++) {
+              tile[j * n + p] = row[j];
+            }
+          }
+          for (size_t j = 0; j < nb; j++) {
+            volk_32fc_32f_multiply_32fc(in, tile + j * n, &_window[0], n);
+            fft.execute();
+            /* Negative Doppler first, so zero Doppler lands at half */
+            float *row_out = out + (b0 + j) * _doppler_size;
+            detect(row_out, fft.out() + (_doppler_size - half), half);
+            detect(row_out + half, fft.out(), _doppler_size - half);
+          }
+        }
+      }
+
+      void
+      detect(float *out, const gr_complex *in, size_t n)
+      {
+        if (_config.output == OUTPUT_POWER) {
+          volk_32fc_magnitude_squared_32f(out, in, n);
+        } else {
+          volk_32fc_magnitude_32f(out, in, n);
+        }
+      }
+
+      void
+      worker_loop(size_t worker)
+      {
+        thread_profile::scoped_role role(_config.threads, thread_profile::ROLE_PROCESS, "range-Doppler worker");
+        fft_plan_cache::plan fft(int(_doppler_size), true);
+        gr_complex *tile = &_tiles[worker][0];
+        const size_t cube_size = _config.cpi_len * _config.num_bins;
+        const size_t map_size = _config.num_bins * _doppler_size;
+        size_t item;
+        while (_ring.next(item)) {
+          const size_t slot = _ring.slot_of(item);
+          const size_t first = _ring.part_of(item) * CHUNK_BINS;
+          const boost::chrono::steady_clock::time_point start = boost::chrono::steady_clock::now();
+          doppler_bins(&_cube[slot * cube_size], &_received[slot * _config.cpi_len],
+                       first, std::min(CHUNK_BINS, _config.num_bins - first),
+                       &_output[slot * map_size], fft, tile);
+          count(_process_ns, boost::chrono::duration_cast<boost::chrono::nanoseconds>(
+                  boost::chrono::steady_clock::now() - start).count());
+          _ring.finish(item, &_num_cpis);
+        }
+      }
+
+      const config_t _config;
+      const size_t _doppler_size;
+      const size_t _num_chunks;
+      std::vector<float> _window;
+
+      /* Per slot: pulse-major cube, which pulses arrived, map metadata
+       * and output. add() and flush() fill the ring's head, one work
+       * item per chunk of range bins; pop() releases its tail. */
+      std::vector<gr_complex> _cube;
+      std::vector<char> _received;
+      std::vector<map_t> _maps;
+      std::vector<float> _output;
+      std::vector<std::vector<gr_complex> > _tiles;
+      worker_ring _ring;
+
+      /* The CPI being filled, owned by the adding thread */
+      bool _open;
+      boost::uint64_t _cur_cpi;
+      boost::uint64_t _next_cpi;
+
+      counter_t _num_cpis;
+      counter_t _num_pulses;
+      counter_t _missing_pulses;
+      counter_t _late_pulses;
+      counter_t _process_ns;
+    };
+
+    range_doppler::sptr
+    range_doppler::make(const config_t &config)
+    {
+      return sptr(new range_doppler_impl(config));
+    }
+
+    double
+    range_doppler::prf_from_count(boost::uint64_t prf_count, double tick_rate)
+    {
+      if (prf_count == 0 or not (tick_rate > 0.0)) {
+        throw std::invalid_argument("range_doppler: PRF count and tick rate must be positive");
+      }
+      return tick_rate / double(prf_count);
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
@@ -0,0 +1,243 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <wavegen/sample_converter.h>
+#include "worker_ring.h"
+#include <volk/volk.h>
+#include <boost/chrono.hpp>
+#include <boost/bind.hpp>
+#include <stdexcept>
+#include <vector>
+
+namespace gr {
+  namespace wavegen {
+
+    /* Subtract the block mean from the converted samples. The sums run
+     * on the sc16 input, in integers, so they are exact. */
+    static void
+    remove_mean(const std::complex<short> *in, float *out, size_t nsamps, float scale)
+    {
+      if (nsamps == 0) {
+        return;
+      }
+      const boost::int16_t *iq = reinterpret_cast<const boost::int16_t *>(in);
+      boost::int64_t sum_i = 0, sum_q = 0;
+      for (size_t k = 0; k < nsamps; k++) {
+        sum_i += iq[2 * k];
+        sum_q += iq[2 * k + 1];
+      }
+      const float dc_i = float(double(sum_i) / double(nsamps) / scale);
+      const float dc_q = float(double(sum_q) / double(nsamps) / scale);
+      for (size_t k = 0; k < nsamps; k++) {
+        out[2 * k] -= dc_i;
+        out[2 * k + 1] -= dc_q;
+      }
+    }
+
+    class sample_converter_impl : public sample_converter
+    {
+    public:
+      sample_converter_impl(const config_t &config):
+        _config(config),
+        _item_size(config.output == OUTPUT_FC64 ? sizeof(std::complex<double>)
+                                                : sizeof(std::complex<float>)),
+        _input(NULL),
+        _output(NULL),
+        _scratch(NULL),
+        _nsamps(config.num_blocks, 0),
+        _ring(config.num_blocks)
+      {
+        if (config.num_workers == 0 or config.num_blocks == 0 or config.block_samps == 0) {
+          throw std::invalid_argument("sample_converter: workers, blocks and block size must be non-zero");
+        }
+        if (not (config.scale > 0.0f)) {
+          throw std::invalid_argument("sample_converter: scale must be positive");
+        }
+        if (config.threads) {
+          config.threads->validate(thread_profile::ROLE_CONVERT);
+        }
+
+        const size_t alignment = volk_get_alignment();
+        _input = static_cast<std::complex<short> *>(volk_malloc(
+          config.num_blocks * config.block_samps * sizeof(std::complex<short>), alignment));
+        _output = static_cast<char *>(volk_malloc(
+          config.num_blocks * config.block_samps * _item_size, alignment));
+        /* fc64 goes through fc32; VOLK has no direct 16i to 64f kernel */
+        if (config.output == OUTPUT_FC64) {
+          _scratch = static_cast<float *>(volk_malloc(
+            config.num_workers * config.block_samps * sizeof(std::complex<float>), alignment));
+        }
+        if (_input == NULL or _output == NULL
+            or (config.output == OUTPUT_FC64 and _scratch == NULL)) {
+          volk_free(_input);
+          volk_free(_output);
+          volk_free(_scratch);
+          throw std::runtime_error("sample_converter: cannot allocate the blocks");
+        }
+
+        counter_t *counters[] = { &_blocks, &_samples, &_convert_ns };
+        for (size_t i = 0; i < sizeof(counters) / sizeof(counters[0]); i++) {
+          counters[i]->store(0, boost::memory_order_relaxed);
+        }
+        _ring.start(config.num_workers, boost::bind(&sample_converter_impl::worker_loop, this, _1));
+      }
+
+      ~sample_converter_impl()
+      {
+        _ring.stop();
+        volk_free(_input);
+        volk_free(_output);
+        volk_free(_scratch);
+      }
+
+      std::complex<short> *
+      acquire(void)
+      {
+        return _input + _ring.acquire() * _config.block_samps;
+      }
+
+      void
+      submit(size_t nsamps)
+      {
+        if (nsamps > _config.block_samps) {
+          throw std::invalid_argument("sample_converter: submit() of more samples than a block holds");
+        }
+        _nsamps[_ring.head_slot()] = nsamps;
+        _ring.commit();
+      }
+
+      bool
+      front(block_t &block)
+      {
+        size_t slot;
+        if (not _ring.front(slot)) {
+          return false;
+        }
+        block.samples = _output + slot * _config.block_samps * _item_size;
+        block.nsamps = _nsamps[slot];
+        return true;
+      }
+
+      void
+      pop(void)
+      {
+        if (not _ring.pop()) {
+          throw std::runtime_error("sample_converter: pop() without a converted block");
+        }
+      }
+
+      size_t
+      size(void)
+      {
+        return _ring.size();
+      }
+
+      size_t
+      output_item_size(void) const
+      {
+        return _item_size;
+      }
+
+      stats_t
+      get_stats(void)
+      {
+        stats_t stats;
+        stats.blocks = _blocks.load(boost::memory_order_relaxed);
+        stats.samples = _samples.load(boost::memory_order_relaxed);
+        stats.convert_ns = _convert_ns.load(boost::memory_order_relaxed);
+        stats.backpressure_waits = _ring.backpressure_waits();
+        stats.max_pending = _ring.max_pending();
+        return stats;
+      }
+
+      config_t
+      get_config(void)
+      {
+        return _config;
+      }
+
+    private:
+      void
+      convert(size_t slot, float *scratch)
+      {
+        const size_t nsamps = _nsamps[slot];
+        const std::complex<short> *in = _input + slot * _config.block_samps;
+        void *out = _output + slot * _config.block_samps * _item_size;
+        if (nsamps == 0) {
+          return;
+        }
+        float *f = (_config.output == OUTPUT_FC32) ? static_cast<float *>(out) : scratch;
+        volk_16i_s32f_convert_32f(f, reinterpret_cast<const boost::int16_t *>(in),
+                                  _config.scale, 2 * nsamps);
+        if (_config.remove_dc) {
+          remove_mean(in, f, nsamps, _config.scale);
+        }
+        if (_config.output == OUTPUT_FC64) {
+          volk_32f_convert_64f(static_cast<double *>(out), f, 2 * nsamps);
+        }
+      }
+
+      void
+      worker_loop(size_t worker)
+      {
+        thread_profile::scoped_role role(_config.threads, thread_profile::ROLE_CONVERT, "converter worker");
+        float *scratch = _scratch ? _scratch + 2 * worker * _config.block_samps : NULL;
+        size_t slot;
+        while (_ring.next(slot)) {
+          const boost::chrono::steady_clock::time_point start = boost::chrono::steady_clock::now();
+          convert(slot, scratch);
+          count(_convert_ns, boost::chrono::duration_cast<boost::chrono::nanoseconds>(
+                  boost::chrono::steady_clock::now() - start).count());
+          count(_blocks);
+          count(_samples, _nsamps[slot]);
+          _ring.finish(slot);
+        }
+      }
+
+      const config_t _config;
+      const size_t _item_size;
+      std::complex<short> *_input;
+      char *_output;
+      //! fc32 staging for fc64 output, one block per worker
+      float *_scratch;
+
+      /* Samples in each block; the receive side fills blocks at the
+       * ring's head, the consumer takes them from its tail */
+      std::vector<size_t> _nsamps;
+      worker_ring _ring;
+
+      counter_t _blocks;
+      counter_t _samples;
+      counter_t _convert_ns;
+    };
+
+    sample_converter::sptr
+    sample_converter::make(const config_t &config)
+    {
+      return sptr(new sample_converter_impl(config));
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
@@ -0,0 +1,399 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <wavegen/sample_recorder.h>
+#include "worker_ring.h"
+#include <boost/lockfree/queue.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/bind.hpp>
+#include <boost/format.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+namespace gr {
+  namespace wavegen {
+
+    const size_t sample_recorder::ALIGNMENT;
+
+    /* WAKE_INTERVAL, for the spin-then-sleep arithmetic */
+    static const double WAKE_SECONDS = 1e-3;
+
+    /* With a pool, its buffers are the recorder's */
+    static sample_recorder::config_t
+    pool_config(const sample_recorder::config_t &config)
+    {
+      sample_recorder::config_t c = config;
+      if (c.pool) {
+        c.num_buffers = c.pool->get_num_buffers();
+        c.buffer_size = c.pool->get_buffer_size();
+      }
+      return c;
+    }
+
+    class sample_recorder_impl : public sample_recorder
+    {
+    public:
+      sample_recorder_impl(const std::string &path, const config_t &config_in):
+        _config(pool_config(config_in)),
+        _pool(_config.pool),
+        _fd(-1),
+        _direct_fd(-1),
+        _held(_config.num_buffers),
+        _filled(_config.num_buffers),
+        _next_offset(0),
+        _queued(0),
+        _error(0),
+        _closing(false),
+        _closed(false)
+      {
+        const config_t &config = _config;
+        if (config.num_buffers == 0 or config.num_writers == 0 or config.max_batch == 0) {
+          throw std::invalid_argument("sample_recorder: buffers, writers and batch size must be non-zero");
+        }
+        if (config.buffer_size == 0 or config.buffer_size % ALIGNMENT) {
+          throw std::invalid_argument(str(
+            boost::format("sample_recorder: buffer size %d is not a multiple of %d")
+            % config.buffer_size % ALIGNMENT));
+        }
+        if (config.max_batch > size_t(IOV_MAX)) {
+          throw std::invalid_argument("sample_recorder: batch size exceeds IOV_MAX");
+        }
+        if (config.threads) {
+          config.threads->validate(thread_profile::ROLE_WRITE);
+        }
+
+        if (not _pool) {
+          buffer_pool::config_t pool_config;
+          pool_config.num_buffers = config.num_buffers;
+          pool_config.buffer_size = config.buffer_size;
+          _pool = buffer_pool::make(pool_config);
+        }
+
+        _fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (_fd < 0) {
+          const int err = errno;
+          throw std::runtime_error(str(
+            boost::format("sample_recorder: cannot open %s: %s") % path % std::strerror(err)));
+        }
+#ifdef O_DIRECT
+        /* Not every file system takes O_DIRECT; fall back to buffered */
+        if (config.direct_io) {
+          _direct_fd = ::open(path.c_str(), O_WRONLY | O_DIRECT);
+        }
+#endif
+
+        reset_counters();
+        for (size_t i = 0; i < config.num_writers; i++) {
+          _writers.create_thread(boost::bind(&sample_recorder_impl::writer_loop, this));
+        }
+      }
+
+      ~sample_recorder_impl()
+      {
+        try {
+          close();
+        }
+        catch (const std::exception &) {
+          /* Reported by an explicit close() */
+        }
+      }
+
+      bool
+      acquire(buffer_t &buffer)
+      {
+        check_error();
+        buffer_pool::handle_t handle;
+        if (not _pool->try_acquire(handle)) {
+          if (_config.policy == POLICY_DROP) {
+            count(_buffers_dropped);
+            return false;
+          }
+          count(_backpressure_waits);
+          while (not _pool->acquire(handle, WAKE_SECONDS)) {
+            check_error();
+          }
+        }
+        buffer.data = handle.data();
+        buffer.size = handle.size();
+        _held[handle.index()] = handle;
+        return true;
+      }
+
+      void
+      commit(const buffer_t &buffer, size_t nbytes)
+      {
+        size_t index = 0;
+        try {
+          index = _pool->index_of(buffer.data);
+        }
+        catch (const std::invalid_argument &) {
+          index = _config.num_buffers;
+        }
+        if (index >= _config.num_buffers or not _held[index].valid()
+            or buffer.data != _held[index].data() or nbytes > _config.buffer_size) {
+          throw std::invalid_argument("sample_recorder: commit() of a buffer not from acquire()");
+        }
+        if (nbytes == 0) {
+          release(index);
+          return;
+        }
+        job_t job;
+        job.index = index;
+        job.nbytes = nbytes;
+        job.offset = _next_offset;
+        _next_offset += nbytes;
+        raise_max(_max_queued, _queued.fetch_add(1, boost::memory_order_relaxed) + 1);
+        _filled.bounded_push(job);
+        _work_cond.notify_one();
+      }
+
+      void
+      drop(size_t nbytes)
+      {
+        count(_bytes_dropped, nbytes);
+      }
+
+      void
+      close()
+      {
+        boost::mutex::scoped_lock lock(_close_mutex);
+        if (_closed) {
+          return;
+        }
+        _closing.store(true);
+        _work_cond.notify_all();
+        _writers.join_all();
+        if (_direct_fd >= 0) {
+          ::close(_direct_fd);
+        }
+        ::close(_fd);
+        _closed = true;
+        check_error();
+      }
+
+      stats_t
+      get_stats()
+      {
+        stats_t stats;
+        stats.buffers_written = _buffers_written.load(boost::memory_order_relaxed);
+        stats.bytes_written = _bytes_written.load(boost::memory_order_relaxed);
+        stats.writes = _writes.load(boost::memory_order_relaxed);
+        stats.buffers_dropped = _buffers_dropped.load(boost::memory_order_relaxed);
+        stats.bytes_dropped = _bytes_dropped.load(boost::memory_order_relaxed);
+        stats.backpressure_waits = _backpressure_waits.load(boost::memory_order_relaxed);
+        stats.max_queued = _max_queued.load(boost::memory_order_relaxed);
+        stats.max_write_us = _max_write_us.load(boost::memory_order_relaxed);
+        stats.direct_io = _direct_fd >= 0;
+        return stats;
+      }
+
+    private:
+      struct job_t {
+        size_t index;
+        size_t nbytes;
+        boost::uint64_t offset;
+      };
+
+      static bool
+      by_offset(const job_t &a, const job_t &b)
+      {
+        return a.offset < b.offset;
+      }
+
+      void
+      reset_counters()
+      {
+        counter_t *counters[] = {
+          &_buffers_written, &_bytes_written, &_writes, &_buffers_dropped,
+          &_bytes_dropped, &_backpressure_waits, &_max_queued, &_max_write_us
+        };
+        for (size_t i = 0; i < sizeof(counters) / sizeof(counters[0]); i++) {
+          counters[i]->store(0, boost::memory_order_relaxed);
+        }
+      }
+
+      void
+      check_error()
+      {
+        const int err = _error.load();
+        if (err) {
+          throw std::runtime_error(str(
+            boost::format("sample_recorder: write failed: %s") % std::strerror(err)));
+        }
+      }
+
+      void
+      release(size_t index)
+      {
+        _held[index].reset();
+      }
+
+      bool
+      aligned(const job_t &job) const
+      {
+        return (job.nbytes % ALIGNMENT) == 0 and (job.offset % ALIGNMENT) == 0;
+      }
+
+      void
+      writer_loop()
+      {
+        thread_profile::scoped_role role(_config.threads, thread_profile::ROLE_WRITE, "recorder writer");
+        std::vector<job_t> batch;
+        batch.reserve(_config.max_batch);
+        std::vector<struct iovec> iov(_config.max_batch);
+        for (;;) {
+          batch.clear();
+          job_t job;
+          while (batch.size() < _config.max_batch and _filled.pop(job)) {
+            batch.push_back(job);
+          }
+          if (batch.empty()) {
+            if (_closing.load()) {
+              return;
+            }
+            boost::mutex::scoped_lock lock(_work_mutex);
+            _work_cond.timed_wait(lock, WAKE_INTERVAL);
+            continue;
+          }
+
+          /* Write runs of adjacent buffers that take the same path */
+          std::sort(batch.begin(), batch.end(), &sample_recorder_impl::by_offset);
+          size_t first = 0;
+          while (first < batch.size()) {
+            const bool direct = _direct_fd >= 0 and aligned(batch[first]);
+            size_t last = first + 1;
+            while (last < batch.size()
+                   and batch[last].offset == batch[last - 1].offset + batch[last - 1].nbytes
+                   and (_direct_fd >= 0 and aligned(batch[last])) == direct) {
+              last++;
+            }
+            write_run(&batch[first], last - first, direct, &iov[0]);
+            first = last;
+          }
+
+          for (size_t i = 0; i < batch.size(); i++) {
+            _queued.fetch_sub(1, boost::memory_order_relaxed);
+            release(batch[i].index);
+          }
+        }
+      }
+
+      void
+      write_run(const job_t *jobs, size_t njobs, bool direct, struct iovec *iov)
+      {
+        if (_error.load()) {
+          return;
+        }
+        size_t total = 0;
+        for (size_t i = 0; i < njobs; i++) {
+          iov[i].iov_base = _pool->data(jobs[i].index);
+          iov[i].iov_len = jobs[i].nbytes;
+          total += jobs[i].nbytes;
+        }
+
+        const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+        const int fd = direct ? _direct_fd : _fd;
+        const ssize_t ret = pwritev(fd, iov, int(njobs), off_t(jobs[0].offset));
+        count(_writes);
+        if (ret < 0) {
+          _error.store(errno);
+          return;
+        }
+        /* Finish a short write through the buffered descriptor, which
+         * takes any length and offset */
+        size_t done = size_t(ret);
+        while (done < total) {
+          size_t skip = done;
+          size_t i = 0;
+          while (skip >= iov[i].iov_len) {
+            skip -= iov[i].iov_len;
+            i++;
+          }
+          const ssize_t n = pwrite(_fd, static_cast<char *>(iov[i].iov_base) + skip,
+                                   iov[i].iov_len - skip, off_t(jobs[0].offset + done));
+          count(_writes);
+          if (n <= 0) {
+            _error.store(n < 0 ? errno : EIO);
+            return;
+          }
+          done += size_t(n);
+        }
+        const boost::posix_time::time_duration elapsed =
+          boost::posix_time::microsec_clock::universal_time() - start;
+
+        raise_max(_max_write_us, boost::uint64_t(elapsed.total_microseconds()));
+        count(_buffers_written, njobs);
+        count(_bytes_written, total);
+      }
+
+      const config_t _config;
+      buffer_pool::sptr _pool;
+      int _fd;
+      int _direct_fd;
+
+      /* Buffers from acquire() until written, by pool index, and
+       * filled buffers for the writers */
+      std::vector<buffer_pool::handle_t> _held;
+      boost::lockfree::queue<job_t> _filled;
+      boost::uint64_t _next_offset;
+      boost::atomic<size_t> _queued;
+      boost::atomic<int> _error;
+
+      boost::mutex _work_mutex;
+      boost::condition_variable _work_cond;
+      boost::thread_group _writers;
+      boost::atomic<bool> _closing;
+      boost::mutex _close_mutex;
+      bool _closed;
+
+      counter_t _buffers_written;
+      counter_t _bytes_written;
+      counter_t _writes;
+      counter_t _buffers_dropped;
+      counter_t _bytes_dropped;
+      counter_t _backpressure_waits;
+      counter_t _max_queued;
+      counter_t _max_write_us;
+    };
+
+    sample_recorder::sptr
+    sample_recorder::make(const std::string &path, const config_t &config)
+    {
+      return sptr(new sample_recorder_impl(path, config));
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
@@ -29,6 +29,26 @@
 
 #include <gnuradio/unittests.h>
 #include "qa_wavegen.h"
+#include "qa_wavegen_core.h"
+#include "qa_wavegen_pulse_scheduler.h"
+#include "qa_wavegen_async_ctrl.h"
+#include "qa_wavegen_waveform_library.h"
+#include "qa_wavegen_sequencer.h"
+#include "qa_waveform_synth.h"
+#include "qa_wavegen_emulator.h"
+#include "qa_wavegen_metrics.h"
+#include "qa_wavegen_status_monitor.h"
+#include "qa_sample_recorder.h"
+#include "qa_pulse_framer.h"
+#include "qa_pulse_file.h"
+#include "qa_sample_converter.h"
+#include "qa_matched_filter.h"
+#include "qa_range_doppler.h"
+#include "qa_cfar_detector.h"
+#include "qa_pulse_integrator.h"
+#include "qa_pulse_ring.h"
+#include "qa_buffer_pool.h"
+#include "qa_thread_profile.h"
 #include <iostream>
 #include <fstream>
 
@@ -39,7 +59,27 @@ main (int argc, char **argv)
   std::ofstream xmlfile(get_unittest_path("wavegen.xml").c_str());
   CppUnit::XmlOutputter *xmlout = new CppUnit::XmlOutputter(&runner.result(), xmlfile);
 
-  runner.addTest(qa_wavegen::suite());
+  runner.addTest(gr::wavegen::qa_wavegen::suite());
+  runner.addTest(gr::wavegen::qa_wavegen_core::suite());
+  runner.addTest(gr::wavegen::qa_wavegen_pulse_scheduler::suite());
+  runner.addTest(gr::wavegen::qa_wavegen_async_ctrl::suite());
+  runner.addTest(gr::wavegen::qa_wavegen_waveform_library::suite());
+  runner.addTest(gr::wavegen::qa_wavegen_sequencer::suite());
+  runner.addTest(gr::wavegen::qa_waveform_synth::suite());
+  runner.addTest(gr::wavegen::qa_wavegen_emulator::suite());
+  runner.addTest(gr::wavegen::qa_wavegen_metrics::suite());
+  runner.addTest(gr::wavegen::qa_wavegen_status_monitor::suite());
+  runner.addTest(gr::wavegen::qa_sample_recorder::suite());
+  runner.addTest(gr::wavegen::qa_pulse_framer::suite());
+  runner.addTest(gr::wavegen::qa_pulse_file::suite());
+  runner.addTest(gr::wavegen::qa_sample_converter::suite());
+  runner.addTest(gr::wavegen::qa_matched_filter::suite());
+  runner.addTest(gr::wavegen::qa_range_doppler::suite());
+  runner.addTest(gr::wavegen::qa_cfar_detector::suite());
+  runner.addTest(gr::wavegen::qa_pulse_integrator::suite());
+  runner.addTest(gr::wavegen::qa_pulse_ring::suite());
+  runner.addTest(gr::wavegen::qa_buffer_pool::suite());
+  runner.addTest(gr::wavegen::qa_thread_profile::suite());
   runner.setOutputter(xmlout);
 
   bool was_successful = runner.run("", false);
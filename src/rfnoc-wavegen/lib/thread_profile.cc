@@ -0,0 +1,490 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <wavegen/thread_profile.h>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/bind.hpp>
+#include <boost/format.hpp>
+#include <boost/lexical_cast.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <list>
+#include <sstream>
+#include <stdexcept>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+namespace gr {
+  namespace wavegen {
+
+    /* Counts of one thread at one moment */
+    struct usage_t {
+      usage_t(void): cpu_ns(0), voluntary(0), involuntary(0), cpu(-1) {}
+      boost::uint64_t cpu_ns;
+      boost::uint64_t voluntary;
+      boost::uint64_t involuntary;
+      int cpu;
+    };
+
+    static int
+    gettid()
+    {
+      return int(::syscall(SYS_gettid));
+    }
+
+    /* The calling thread's counts, from the kernel directly */
+    static usage_t
+    self_usage()
+    {
+      usage_t u;
+      struct rusage ru;
+      if (::getrusage(RUSAGE_THREAD, &ru) == 0) {
+        u.cpu_ns = (boost::uint64_t(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000
+                    + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000;
+        u.voluntary = ru.ru_nvcsw;
+        u.involuntary = ru.ru_nivcsw;
+      }
+      u.cpu = ::sched_getcpu();
+      return u;
+    }
+
+    /* Any thread's counts from /proc; false once it has exited */
+    static bool
+    proc_usage(int tid, usage_t &u)
+    {
+      const std::string dir = str(boost::format("/proc/self/task/%d/") % tid);
+      std::ifstream status((dir + "status").c_str());
+      if (not status) {
+        return false;
+      }
+      std::string line;
+      while (std::getline(status, line)) {
+        std::istringstream fields(line);
+        std::string key;
+        fields >> key;
+        if (key == "voluntary_ctxt_switches:") {
+          fields >> u.voluntary;
+        } else if (key == "nonvoluntary_ctxt_switches:") {
+          fields >> u.involuntary;
+        }
+      }
+
+      /* Fields after the command name, which may hold spaces: utime
+       * and stime are the 12th and 13th, the last core the 37th */
+      std::ifstream stat((dir + "stat").c_str());
+      std::string text((std::istreambuf_iterator<char>(stat)), std::istreambuf_iterator<char>());
+      const size_t paren = text.rfind(')');
+      if (paren != std::string::npos) {
+        std::istringstream fields(text.substr(paren + 1));
+        std::vector<std::string> f;
+        std::string field;
+        while (fields >> field) {
+          f.push_back(field);
+        }
+        if (f.size() > 36) {
+          const double tick_ns = 1e9 / double(::sysconf(_SC_CLK_TCK));
+          u.cpu_ns = boost::uint64_t((boost::lexical_cast<double>(f[11])
+                                      + boost::lexical_cast<double>(f[12])) * tick_ns);
+          u.cpu = boost::lexical_cast<int>(f[36]);
+        }
+      }
+      /* Nanoseconds on the CPU, where the kernel keeps schedstats */
+      std::ifstream schedstat((dir + "schedstat").c_str());
+      boost::uint64_t run_ns;
+      if (schedstat >> run_ns) {
+        u.cpu_ns = run_ns;
+      }
+      return true;
+    }
+
+    static std::string
+    format_cpus(const std::vector<int> &cpus)
+    {
+      std::string s;
+      for (size_t i = 0; i < cpus.size(); i++) {
+        s += (i ? "," : "") + boost::lexical_cast<std::string>(cpus[i]);
+      }
+      return s;
+    }
+
+    static std::vector<int>
+    read_cpus(const char *path)
+    {
+      std::ifstream in(path);
+      std::string list;
+      std::getline(in, list);
+      try {
+        return thread_profile::parse_cpus(list);
+      }
+      catch (const std::invalid_argument &) {
+        return std::vector<int>();
+      }
+    }
+
+    static bool
+    contains(const std::vector<int> &cpus, int cpu)
+    {
+      return std::find(cpus.begin(), cpus.end(), cpu) != cpus.end();
+    }
+
+    class thread_profile_impl : public thread_profile
+    {
+    public:
+      thread_profile_impl(const config_t &config):
+        _config(config)
+      {
+        CPU_ZERO(&_allowed);
+        if (::sched_getaffinity(0, sizeof(_allowed), &_allowed) != 0) {
+          for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET(cpu, &_allowed);
+          }
+        }
+        for (size_t r = 0; r < NUM_ROLES; r++) {
+          const role_config_t &rc = config.roles[r];
+          for (size_t i = 0; i < rc.cpus.size(); i++) {
+            if (rc.cpus[i] < 0 or rc.cpus[i] >= CPU_SETSIZE) {
+              throw std::invalid_argument(str(
+                boost::format("thread_profile: %s core %d out of range")
+                % role_name(role_t(r)) % rc.cpus[i]));
+            }
+          }
+          const bool rt = rc.policy != POLICY_OTHER;
+          if (rt ? (rc.priority < 1 or rc.priority > 99) : rc.priority != 0) {
+            throw std::invalid_argument(str(
+              boost::format("thread_profile: %s priority %d is not valid for its policy")
+              % role_name(role_t(r)) % rc.priority));
+          }
+        }
+      }
+
+      void
+      enter(role_t role, const std::string &name)
+      {
+        const std::string error = apply(role);
+
+        const int tid = gettid();
+        const usage_t base = self_usage();
+        {
+          boost::mutex::scoped_lock lock(_mutex);
+          entry_t *e = find(tid);
+          if (e == NULL) {
+            _threads.push_back(entry_t());
+            e = &_threads.back();
+          }
+          e->stats = thread_stats_t();
+          e->stats.role = role;
+          e->stats.name = name;
+          e->stats.tid = tid;
+          e->stats.applied = error.empty();
+          e->stats.error = error;
+          e->stats.running = true;
+          e->stats.last_cpu = base.cpu;
+          e->base = base;
+        }
+        if (not error.empty() and _config.strict) {
+          throw std::runtime_error(str(
+            boost::format("thread_profile: %s thread %s: %s") % role_name(role) % name % error));
+        }
+      }
+
+      void
+      validate(role_t role)
+      {
+        if (not _config.strict) {
+          return;
+        }
+        /* Try it on a throwaway thread so the caller keeps its own */
+        std::string error;
+        boost::thread probe(boost::bind(&thread_profile_impl::probe, this, role, &error));
+        probe.join();
+        if (not error.empty()) {
+          throw std::runtime_error(str(
+            boost::format("thread_profile: %s threads: %s") % role_name(role) % error));
+        }
+      }
+
+      void
+      leave()
+      {
+        const usage_t u = self_usage();
+        boost::mutex::scoped_lock lock(_mutex);
+        entry_t *e = find(gettid());
+        if (e != NULL and e->stats.running) {
+          update(*e, u);
+          e->stats.running = false;
+        }
+      }
+
+      std::vector<std::string>
+      check()
+      {
+        std::vector<std::string> problems;
+        const role_config_t &rx = _config.roles[ROLE_RECEIVE];
+        if (rx.cpus.empty()) {
+          problems.push_back("the receive thread is not pinned to a core");
+        }
+
+        const std::vector<int> isolated = read_cpus("/sys/devices/system/cpu/isolated");
+        bool rt = false;
+        for (size_t r = 0; r < NUM_ROLES; r++) {
+          const role_config_t &rc = _config.roles[r];
+          rt = rt or rc.policy != POLICY_OTHER;
+          for (size_t i = 0; i < rc.cpus.size(); i++) {
+            const int cpu = rc.cpus[i];
+            if (not CPU_ISSET(cpu, &_allowed)) {
+              problems.push_back(str(boost::format("%s core %d is not available to this process")
+                                     % role_name(role_t(r)) % cpu));
+            }
+            if (r != ROLE_RECEIVE and contains(rx.cpus, cpu)) {
+              problems.push_back(str(boost::format("receive core %d is shared with the %s threads")
+                                     % cpu % role_name(role_t(r))));
+            }
+          }
+          if (rc.priority > 0 and ::geteuid() != 0) {
+            struct rlimit limit;
+            if (::getrlimit(RLIMIT_RTPRIO, &limit) == 0 and limit.rlim_cur != RLIM_INFINITY
+                and limit.rlim_cur < rlim_t(rc.priority)) {
+              problems.push_back(str(boost::format(
+                "%s priority %d exceeds the real-time priority limit %d (ulimit -r)")
+                % role_name(role_t(r)) % rc.priority % limit.rlim_cur));
+            }
+          }
+        }
+        for (size_t i = 0; i < rx.cpus.size(); i++) {
+          if (not contains(isolated, rx.cpus[i])) {
+            problems.push_back(str(boost::format(
+              "receive core %d is not isolated (isolcpus), so other tasks may run on it")
+              % rx.cpus[i]));
+          }
+        }
+        if (rt) {
+          std::ifstream in("/proc/sys/kernel/sched_rt_runtime_us");
+          long runtime = -1;
+          if (in >> runtime and runtime >= 0) {
+            problems.push_back(str(boost::format(
+              "real-time throttling is on (sched_rt_runtime_us %d), so real-time threads "
+              "are stopped for part of every period") % runtime));
+          }
+        }
+        return problems;
+      }
+
+      std::vector<thread_stats_t>
+      get_thread_stats()
+      {
+        boost::mutex::scoped_lock lock(_mutex);
+        std::vector<thread_stats_t> stats;
+        for (std::list<entry_t>::iterator it = _threads.begin(); it != _threads.end(); ++it) {
+          if (it->stats.running) {
+            usage_t u;
+            if (proc_usage(it->stats.tid, u)) {
+              update(*it, u);
+            } else {
+              /* Exited without leave(); keep the last counts */
+              it->stats.running = false;
+            }
+          }
+          stats.push_back(it->stats);
+        }
+        return stats;
+      }
+
+      config_t
+      get_config()
+      {
+        return _config;
+      }
+
+    private:
+      struct entry_t {
+        thread_stats_t stats;
+        //! Counts when the thread entered its role
+        usage_t base;
+      };
+
+      /* Pin and schedule the calling thread; the error, or empty */
+      std::string
+      apply(role_t role)
+      {
+        const role_config_t &rc = _config.roles[role];
+        std::string error;
+
+        /* Unpinned roles undo pinning inherited from the creator */
+        cpu_set_t set = _allowed;
+        if (not rc.cpus.empty()) {
+          CPU_ZERO(&set);
+          for (size_t i = 0; i < rc.cpus.size(); i++) {
+            CPU_SET(rc.cpus[i], &set);
+          }
+        }
+        const int aff_err = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+        if (aff_err) {
+          error = rc.cpus.empty() ?
+            str(boost::format("cannot unpin: %s") % std::strerror(aff_err)) :
+            str(boost::format("cannot pin to cores %s: %s")
+                % format_cpus(rc.cpus) % std::strerror(aff_err));
+        }
+
+        struct sched_param param;
+        std::memset(&param, 0, sizeof(param));
+        param.sched_priority = rc.priority;
+        const int policy = (rc.policy == POLICY_FIFO) ? SCHED_FIFO :
+                           (rc.policy == POLICY_RR) ? SCHED_RR : SCHED_OTHER;
+        const int err = ::pthread_setschedparam(::pthread_self(), policy, &param);
+        if (err) {
+          error += str(boost::format("%scannot set %s priority %d: %s")
+                       % (error.empty() ? "" : "; ")
+                       % (rc.policy == POLICY_FIFO ? "SCHED_FIFO" : rc.policy == POLICY_RR ? "SCHED_RR" : "SCHED_OTHER")
+                       % rc.priority % std::strerror(err));
+        }
+        return error;
+      }
+
+      void
+      probe(role_t role, std::string *error)
+      {
+        *error = apply(role);
+      }
+
+      /* Tids are reused, so only a running entry is the caller's */
+      entry_t *
+      find(int tid)
+      {
+        for (std::list<entry_t>::iterator it = _threads.begin(); it != _threads.end(); ++it) {
+          if (it->stats.tid == tid and it->stats.running) {
+            return &*it;
+          }
+        }
+        return NULL;
+      }
+
+      static void
+      update(entry_t &e, const usage_t &u)
+      {
+        e.stats.cpu_ns = (u.cpu_ns > e.base.cpu_ns) ? u.cpu_ns - e.base.cpu_ns : 0;
+        e.stats.voluntary_switches =
+          (u.voluntary > e.base.voluntary) ? u.voluntary - e.base.voluntary : 0;
+        e.stats.involuntary_switches =
+          (u.involuntary > e.base.involuntary) ? u.involuntary - e.base.involuntary : 0;
+        if (u.cpu >= 0) {
+          e.stats.last_cpu = u.cpu;
+        }
+      }
+
+      const config_t _config;
+      //! The process's cores when the profile was made
+      cpu_set_t _allowed;
+      boost::mutex _mutex;
+      std::list<entry_t> _threads;
+    };
+
+    thread_profile::scoped_role::scoped_role(sptr profile, role_t role, const std::string &name):
+      _profile(profile)
+    {
+      if (_profile) {
+        try {
+          _profile->enter(role, name);
+        }
+        catch (const std::runtime_error &) {
+          /* Already in the thread's stats; see validate() */
+        }
+      }
+    }
+
+    thread_profile::scoped_role::~scoped_role()
+    {
+      if (_profile) {
+        _profile->leave();
+      }
+    }
+
+    thread_profile::sptr
+    thread_profile::make(const config_t &config)
+    {
+      return sptr(new thread_profile_impl(config));
+    }
+
+    std::vector<int>
+    thread_profile::parse_cpus(const std::string &list)
+    {
+      std::vector<int> cpus;
+      std::istringstream in(list);
+      std::string range;
+      while (std::getline(in, range, ',')) {
+        range.erase(std::remove_if(range.begin(), range.end(), ::isspace), range.end());
+        if (range.empty()) {
+          continue;
+        }
+        try {
+          const size_t dash = range.find('-');
+          const int first = boost::lexical_cast<int>(range.substr(0, dash));
+          const int last = (dash == std::string::npos) ? first :
+            boost::lexical_cast<int>(range.substr(dash + 1));
+          if (first < 0 or last < first) {
+            throw std::invalid_argument(range);
+          }
+          for (int cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+          }
+        }
+        catch (const std::exception &) {
+          throw std::invalid_argument("thread_profile: bad core list " + list);
+        }
+      }
+      return cpus;
+    }
+
+    thread_profile::policy_t
+    thread_profile::parse_policy(const std::string &policy)
+    {
+      if (policy == "other") return POLICY_OTHER;
+      if (policy == "fifo") return POLICY_FIFO;
+      if (policy == "rr") return POLICY_RR;
+      throw std::invalid_argument("thread_profile: unknown scheduling policy " + policy);
+    }
+
+    const char *
+    thread_profile::role_name(role_t role)
+    {
+      switch (role) {
+      case ROLE_RECEIVE: return "receive";
+      case ROLE_CONVERT: return "convert";
+      case ROLE_WRITE: return "write";
+      case ROLE_PROCESS: return "process";
+      case ROLE_CONTROL: return "control";
+      default: return "unknown";
+      }
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
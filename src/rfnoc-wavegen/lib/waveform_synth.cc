@@ -0,0 +1,347 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <wavegen/waveform_synth.h>
+#include <volk/volk.h>
+#include <boost/format.hpp>
+#include <cmath>
+#include <stdexcept>
+
+namespace gr {
+  namespace wavegen {
+
+    const int waveform_synth::DDS_ACCUM_BITS;
+    const int waveform_synth::DDS_LUT_BITS;
+    const int waveform_synth::DDS_AMPLITUDE;
+
+    static const double TWO_PI = 2.0 * M_PI;
+    static const double ACCUM_SCALE = 4294967296.0; /* 2^DDS_ACCUM_BITS */
+
+    /* Cycles to radians in [-pi, pi) */
+    static inline float
+    wrap_phase(double cycles)
+    {
+      double frac = cycles - std::floor(cycles);
+      if (frac >= 0.5) {
+        frac -= 1.0;
+      }
+      return float(TWO_PI * frac);
+    }
+
+    /* Same, for an accumulator already kept in [0, 1) */
+    static inline float
+    accum_phase(double cycles)
+    {
+      return float(TWO_PI * ((cycles >= 0.5) ? cycles - 1.0 : cycles));
+    }
+
+    static inline boost::int16_t
+    round_sample(double x)
+    {
+      return boost::int16_t(std::floor(x + 0.5));
+    }
+
+    static inline boost::uint32_t
+    pack_word(boost::int16_t i, boost::int16_t q)
+    {
+      return (boost::uint32_t(boost::uint16_t(i)) << 16) | boost::uint16_t(q);
+    }
+
+    /* exp(j*phase) for a whole buffer through the VOLK trig kernels */
+    static void
+    phase_to_samples(const std::vector<float> &phase, std::vector<gr_complex> &out)
+    {
+      const unsigned int n = phase.size();
+      std::vector<float> re(n), im(n);
+      out.resize(n);
+      if (n == 0) {
+        return;
+      }
+      volk_32f_cos_32f(&re[0], &phase[0], n);
+      volk_32f_sin_32f(&im[0], &phase[0], n);
+      volk_32f_x2_interleave_32fc(&out[0], &re[0], &im[0], n);
+    }
+
+    /*
+     * The chirp generator's sin/cos table, packed as AWG words so a
+     * lookup is the output sample. Built on first use.
+     */
+    class dds_table
+    {
+    public:
+      dds_table(void) : _words(size_t(1) << waveform_synth::DDS_LUT_BITS)
+      {
+        const double step = TWO_PI / _words.size();
+        for (size_t a = 0; a < _words.size(); a++) {
+          _words[a] = pack_word(
+            round_sample(waveform_synth::DDS_AMPLITUDE * std::cos(step * a)),
+            round_sample(waveform_synth::DDS_AMPLITUDE * std::sin(step * a)));
+        }
+      }
+
+      boost::uint32_t lookup(boost::uint32_t phase) const
+      {
+        return _words[phase >> (waveform_synth::DDS_ACCUM_BITS - waveform_synth::DDS_LUT_BITS)];
+      }
+
+    private:
+      std::vector<boost::uint32_t> _words;
+    };
+
+    static const dds_table &
+    get_dds_table(void)
+    {
+      static const dds_table table;
+      return table;
+    }
+
+    std::vector<gr_complex>
+    waveform_synth::lfm(size_t num_samps, double bandwidth, double center_freq)
+    {
+      if (num_samps == 0) {
+        throw std::invalid_argument("waveform_synth::lfm: num_samps must be > 0");
+      }
+      const double k = bandwidth / num_samps;
+      double freq = center_freq - bandwidth / 2.0;
+      double cycles = 0.0;
+
+      /*
+       * Accumulate like the hardware does and keep the accumulator
+       * wrapped to one cycle: no n^2 term to lose precision in.
+       */
+      std::vector<float> phase(num_samps);
+      for (size_t n = 0; n < num_samps; n++) {
+        phase[n] = accum_phase(cycles);
+        cycles += freq;
+        cycles -= std::floor(cycles);
+        freq += k;
+      }
+
+      std::vector<gr_complex> out;
+      phase_to_samples(phase, out);
+      return out;
+    }
+
+    std::vector<gr_complex>
+    waveform_synth::nlfm(size_t num_samps, double bandwidth, double beta, double center_freq)
+    {
+      if (num_samps == 0) {
+        throw std::invalid_argument("waveform_synth::nlfm: num_samps must be > 0");
+      }
+      if (not (beta > 0.0 and beta < M_PI / 2.0)) {
+        throw std::invalid_argument(str(
+          boost::format("waveform_synth::nlfm: beta %f outside (0, pi/2)") % beta));
+      }
+      const double scale = bandwidth / 2.0 / std::tan(beta);
+      double cycles = 0.0;
+
+      std::vector<float> phase(num_samps);
+      for (size_t n = 0; n < num_samps; n++) {
+        const double u = double(n) / num_samps - 0.5;
+        phase[n] = accum_phase(cycles);
+        cycles += center_freq + scale * std::tan(2.0 * beta * u);
+        cycles -= std::floor(cycles);
+      }
+
+      std::vector<gr_complex> out;
+      phase_to_samples(phase, out);
+      return out;
+    }
+
+    std::vector<float>
+    waveform_synth::barker_code(size_t len)
+    {
+      const char *code;
+      switch (len) {
+      case 2:  code = "+-"; break;
+      case 3:  code = "++-"; break;
+      case 4:  code = "++-+"; break;
+      case 5:  code = "+++-+"; break;
+      case 7:  code = "+++--+-"; break;
+      case 11: code = "+++---+--+-"; break;
+      case 13: code = "+++++--++-+-+"; break;
+      default:
+        throw std::invalid_argument(str(
+          boost::format("waveform_synth::barker_code: no Barker code of length %d") % len));
+      }
+
+      std::vector<float> phases(len);
+      for (size_t i = 0; i < len; i++) {
+        phases[i] = (code[i] == '+') ? 0.0f : float(M_PI);
+      }
+      return phases;
+    }
+
+    std::vector<float>
+    waveform_synth::frank_code(size_t m)
+    {
+      if (m == 0) {
+        throw std::invalid_argument("waveform_synth::frank_code: m must be > 0");
+      }
+      std::vector<float> phases(m * m);
+      for (size_t i = 0; i < m; i++) {
+        for (size_t j = 0; j < m; j++) {
+          phases[i * m + j] = wrap_phase(double((i * j) % m) / m);
+        }
+      }
+      return phases;
+    }
+
+    std::vector<float>
+    waveform_synth::p4_code(size_t len)
+    {
+      if (len == 0) {
+        throw std::invalid_argument("waveform_synth::p4_code: len must be > 0");
+      }
+      /* phi_k = pi*k^2/N - pi*k, in cycles k^2/(2N) - k/2 */
+      std::vector<float> phases(len);
+      for (size_t k = 0; k < len; k++) {
+        const double sq = double((k * k) % (2 * len));
+        phases[k] = wrap_phase(sq / (2.0 * len) - 0.5 * (k % 2));
+      }
+      return phases;
+    }
+
+    std::vector<gr_complex>
+    waveform_synth::phase_coded(const std::vector<float> &phases, size_t samps_per_chip)
+    {
+      if (phases.empty() or samps_per_chip == 0) {
+        throw std::invalid_argument("waveform_synth::phase_coded: empty code or zero samps_per_chip");
+      }
+      std::vector<gr_complex> chips;
+      phase_to_samples(phases, chips);
+
+      std::vector<gr_complex> out(phases.size() * samps_per_chip);
+      for (size_t i = 0; i < chips.size(); i++) {
+        std::fill(out.begin() + i * samps_per_chip,
+                  out.begin() + (i + 1) * samps_per_chip, chips[i]);
+      }
+      return out;
+    }
+
+    std::vector<gr_complex>
+    waveform_synth::stepped_frequency(size_t num_steps, size_t samps_per_step,
+                                      double start_freq, double freq_step)
+    {
+      if (num_steps == 0 or samps_per_step == 0) {
+        throw std::invalid_argument("waveform_synth::stepped_frequency: empty waveform");
+      }
+      double cycles = 0.0;
+
+      std::vector<float> phase(num_steps * samps_per_step);
+      for (size_t i = 0; i < num_steps; i++) {
+        const double freq = start_freq + i * freq_step;
+        for (size_t n = 0; n < samps_per_step; n++) {
+          phase[i * samps_per_step + n] = accum_phase(cycles);
+          cycles += freq;
+          cycles -= std::floor(cycles);
+        }
+      }
+
+      std::vector<gr_complex> out;
+      phase_to_samples(phase, out);
+      return out;
+    }
+
+    void
+    waveform_synth::apply_window(std::vector<gr_complex> &samples,
+                                 gr::fft::window::win_type type,
+                                 double beta)
+    {
+      if (samples.empty() or type == gr::fft::window::WIN_NONE
+          or type == gr::fft::window::WIN_RECTANGULAR) {
+        return;
+      }
+      const std::vector<float> win = gr::fft::window::build(type, samples.size(), beta);
+      volk_32fc_32f_multiply_32fc(&samples[0], &samples[0], &win[0], samples.size());
+    }
+
+    std::vector<boost::uint32_t>
+    waveform_synth::pack_sc16(const std::vector<gr_complex> &samples, float scale)
+    {
+      const size_t n = samples.size();
+      std::vector<boost::uint32_t> words(n);
+      if (n == 0) {
+        return words;
+      }
+      std::vector<boost::int16_t> iq(2 * n);
+      volk_32f_s32f_convert_16i(&iq[0], reinterpret_cast<const float *>(&samples[0]), scale, 2 * n);
+      for (size_t i = 0; i < n; i++) {
+        words[i] = pack_word(iq[2 * i], iq[2 * i + 1]);
+      }
+      return words;
+    }
+
+    std::vector<gr_complex>
+    waveform_synth::unpack_sc16(const std::vector<boost::uint32_t> &words, float scale)
+    {
+      const size_t n = words.size();
+      std::vector<gr_complex> samples(n);
+      if (n == 0) {
+        return samples;
+      }
+      std::vector<boost::int16_t> iq(2 * n);
+      for (size_t i = 0; i < n; i++) {
+        iq[2 * i] = boost::int16_t(words[i] >> 16);
+        iq[2 * i + 1] = boost::int16_t(words[i] & 0xffff);
+      }
+      volk_16i_s32f_convert_32f(reinterpret_cast<float *>(&samples[0]), &iq[0], scale, 2 * n);
+      return samples;
+    }
+
+    waveform_synth::chirp_coefs_t
+    waveform_synth::chirp_coefs(size_t len, double bandwidth, double center_freq)
+    {
+      if (len == 0 or len > 0xffffffffULL) {
+        throw std::invalid_argument(str(
+          boost::format("waveform_synth::chirp_coefs: invalid length %d") % len));
+      }
+      /* Two's complement wrap gives negative frequencies */
+      chirp_coefs_t coefs;
+      coefs.len = boost::uint32_t(len);
+      coefs.tuning_coef = boost::uint32_t(boost::int64_t(
+        std::floor(bandwidth / len * ACCUM_SCALE + 0.5)));
+      coefs.freq_offset = boost::uint32_t(boost::int64_t(
+        std::floor((center_freq - bandwidth / 2.0) * ACCUM_SCALE + 0.5)));
+      return coefs;
+    }
+
+    std::vector<boost::uint32_t>
+    waveform_synth::hw_chirp(boost::uint32_t len, boost::uint32_t tuning_coef,
+                             boost::uint32_t freq_offset)
+    {
+      const dds_table &table = get_dds_table();
+      std::vector<boost::uint32_t> words(len);
+      boost::uint32_t phase = 0;
+      boost::uint32_t freq = freq_offset;
+      for (boost::uint32_t n = 0; n < len; n++) {
+        words[n] = table.lookup(phase);
+        phase += freq;
+        freq += tuning_coef;
+      }
+      return words;
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
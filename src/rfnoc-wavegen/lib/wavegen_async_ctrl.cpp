@@ -0,0 +1,312 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <wavegen/wavegen_async_ctrl.hpp>
+#include <uhd/exception.hpp>
+#include <boost/lockfree/queue.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/format.hpp>
+#include <algorithm>
+#include <vector>
+
+using namespace uhd;
+using namespace uhd::rfnoc;
+
+
+const size_t wavegen_async_ctrl::DEFAULT_QUEUE_DEPTH;
+
+class wavegen_async_ctrl_impl : public wavegen_async_ctrl
+{
+public:
+    wavegen_async_ctrl_impl(
+        wavegen_core::sptr core,
+        const size_t queue_depth,
+        gr::wavegen::thread_profile::sptr threads
+    ):
+        _core(core),
+        _threads(threads),
+        _requests(_check_depth(queue_depth)),
+        _free(queue_depth),
+        _queue(queue_depth),
+        _waiting(false),
+        _stop(false),
+        _total_us(0)
+    {
+        for (size_t i = 0; i < queue_depth; i++) {
+            _free.push(&_requests[i]);
+        }
+        if (_threads) {
+            _threads->validate(gr::wavegen::thread_profile::ROLE_CONTROL);
+        }
+        _thread = boost::thread(boost::bind(&wavegen_async_ctrl_impl::_control_loop, this));
+    }
+
+    ~wavegen_async_ctrl_impl(void)
+    {
+        {
+            boost::mutex::scoped_lock lock(_wake_mutex);
+            _stop = true;
+        }
+        _wake_cond.notify_one();
+        _thread.join();
+    }
+
+    done_future_t post(const command_t &command)
+    {
+        boost::shared_ptr<boost::promise<void> > promise = boost::make_shared<boost::promise<void> >();
+        done_future_t future(promise->get_future());
+        _push(boost::bind(&wavegen_async_ctrl_impl::_run_command, this, command, promise, _1));
+        return future;
+    }
+
+    readback_future_t read(const readback_t &readback)
+    {
+        boost::shared_ptr<boost::promise<boost::uint64_t> > promise =
+            boost::make_shared<boost::promise<boost::uint64_t> >();
+        readback_future_t future(promise->get_future());
+        _push(boost::bind(&wavegen_async_ctrl_impl::_run_readback, this, readback, promise, _1));
+        return future;
+    }
+
+    done_future_t set_waveform(const std::vector<boost::uint32_t> &samples)
+    {
+        /* The bound copy keeps the samples alive until the upload runs */
+        return post(boost::bind(&wavegen_async_ctrl_impl::_set_waveform, _1, samples));
+    }
+
+    done_future_t set_prf_count(const boost::uint64_t prf_count)
+    {
+        return post(boost::bind(&wavegen_core::set_prf_count, _1, prf_count));
+    }
+
+    done_future_t commit(const wavegen_config &config)
+    {
+        return post(boost::bind(&wavegen_core::commit, _1, config));
+    }
+
+    readback_future_t get_state(void)
+    {
+        return read(boost::bind(&wavegen_core::get_state, _1));
+    }
+
+    void flush(void)
+    {
+        post(command_t(&wavegen_async_ctrl_impl::_nop)).wait();
+    }
+
+    latency_stats_t get_latency_stats(void)
+    {
+        boost::mutex::scoped_lock lock(_stats_mutex);
+        latency_stats_t stats = _stats;
+        stats.mean_us = stats.num_commands ? _total_us / stats.num_commands : 0.0;
+        return stats;
+    }
+
+    void reset_latency_stats(void)
+    {
+        boost::mutex::scoped_lock lock(_stats_mutex);
+        _stats = latency_stats_t();
+        _total_us = 0;
+    }
+
+private:
+    /* Runs a command; given the time it was posted */
+    typedef boost::function<void(const boost::posix_time::ptime &)> task_t;
+
+    struct request_t {
+        task_t task;
+        boost::posix_time::ptime posted;
+    };
+
+    static size_t _check_depth(const size_t queue_depth)
+    {
+        if (queue_depth == 0 or queue_depth > MAX_QUEUE_DEPTH) {
+            throw uhd::value_error(str(
+                boost::format("wavegen_async_ctrl: queue depth must be 1 to %d") % MAX_QUEUE_DEPTH
+            ));
+        }
+        return queue_depth;
+    }
+
+    static void _nop(wavegen_core &)
+    {
+    }
+
+    static void _set_waveform(wavegen_core &core, const std::vector<boost::uint32_t> &samples)
+    {
+        core.set_waveform(samples);
+    }
+
+    /* boost::current_exception() slices uhd exceptions down to
+     * std::runtime_error; keep the type callers are likely to catch */
+    static boost::exception_ptr _capture_exception(void)
+    {
+        try {
+            throw;
+        }
+        catch (const uhd::value_error &e)           { return boost::copy_exception(e); }
+        catch (const uhd::index_error &e)           { return boost::copy_exception(e); }
+        catch (const uhd::key_error &e)             { return boost::copy_exception(e); }
+        catch (const uhd::assertion_error &e)       { return boost::copy_exception(e); }
+        catch (const uhd::not_implemented_error &e) { return boost::copy_exception(e); }
+        catch (const uhd::runtime_error &e)         { return boost::copy_exception(e); }
+        catch (const uhd::io_error &e)              { return boost::copy_exception(e); }
+        catch (const uhd::os_error &e)              { return boost::copy_exception(e); }
+        catch (...) {
+            return boost::current_exception();
+        }
+    }
+
+    void _run_command(
+        const command_t &command,
+        boost::shared_ptr<boost::promise<void> > promise,
+        const boost::posix_time::ptime &posted
+    ) {
+        try {
+            command(*_core);
+        } catch (...) {
+            boost::exception_ptr error = _capture_exception();
+            _record(posted, false);
+            promise->set_exception(error);
+            return;
+        }
+        _record(posted, true);
+        promise->set_value();
+    }
+
+    void _run_readback(
+        const readback_t &readback,
+        boost::shared_ptr<boost::promise<boost::uint64_t> > promise,
+        const boost::posix_time::ptime &posted
+    ) {
+        boost::uint64_t value;
+        try {
+            value = readback(*_core);
+        } catch (...) {
+            boost::exception_ptr error = _capture_exception();
+            _record(posted, false);
+            promise->set_exception(error);
+            return;
+        }
+        _record(posted, true);
+        promise->set_value(value);
+    }
+
+    /* Counted before the future is made ready, so a caller that has
+     * seen its result also sees it in the stats */
+    void _record(const boost::posix_time::ptime &posted, const bool ok)
+    {
+        const double latency_us = double((
+            boost::posix_time::microsec_clock::universal_time() - posted
+        ).total_microseconds());
+        boost::mutex::scoped_lock lock(_stats_mutex);
+        _stats.num_commands++;
+        _stats.num_errors += ok ? 0 : 1;
+        _stats.last_us = latency_us;
+        _stats.max_us = std::max(_stats.max_us, latency_us);
+        _total_us += latency_us;
+    }
+
+    /* Never takes a lock unless the control thread is asleep. Requests
+     * come from the pool, so a full queue shows up as an empty pool. */
+    void _push(const task_t &task)
+    {
+        request_t *req;
+        while (not _free.pop(req)) {
+            boost::this_thread::yield();
+        }
+        req->task = task;
+        req->posted = boost::posix_time::microsec_clock::universal_time();
+        /* Holds every request, so this cannot fail */
+        _queue.bounded_push(req);
+        if (_waiting.load()) {
+            boost::mutex::scoped_lock lock(_wake_mutex);
+            _wake_cond.notify_one();
+        }
+    }
+
+    void _control_loop(void)
+    {
+        gr::wavegen::thread_profile::scoped_role role(
+            _threads, gr::wavegen::thread_profile::ROLE_CONTROL, "async control");
+        while (true) {
+            request_t *req;
+            if (not _queue.pop(req)) {
+                boost::mutex::scoped_lock lock(_wake_mutex);
+                _waiting.store(true);
+                while (_queue.empty() and not _stop) {
+                    _wake_cond.wait(lock);
+                }
+                _waiting.store(false);
+                if (_stop and _queue.empty()) {
+                    return;
+                }
+                continue;
+            }
+
+            req->task(req->posted);
+            /* Drop the bound arguments before the request is reused */
+            req->task.clear();
+            _free.push(req);
+        }
+    }
+
+    /* Fixed-size lock-free queues index their nodes with 16 bits */
+    static const size_t MAX_QUEUE_DEPTH = 65534;
+
+    typedef boost::lockfree::queue<request_t *, boost::lockfree::fixed_sized<true> > request_queue_t;
+
+    wavegen_core::sptr _core;
+    gr::wavegen::thread_profile::sptr _threads;
+    /* Request pool, the free ones and the posted ones */
+    std::vector<request_t> _requests;
+    request_queue_t _free;
+    request_queue_t _queue;
+
+    /* Only used to park the control thread while the queue is empty */
+    boost::atomic<bool> _waiting;
+    boost::mutex _wake_mutex;
+    boost::condition_variable _wake_cond;
+    bool _stop;
+    boost::thread _thread;
+
+    boost::mutex _stats_mutex;
+    latency_stats_t _stats;
+    double _total_us;
+};
+
+
+const size_t wavegen_async_ctrl_impl::MAX_QUEUE_DEPTH;
+
+
+wavegen_async_ctrl::sptr wavegen_async_ctrl::make(
+    wavegen_core::sptr core,
+    const size_t queue_depth,
+    gr::wavegen::thread_profile::sptr threads
+) {
+    return sptr(new wavegen_async_ctrl_impl(core, queue_depth, threads));
+}
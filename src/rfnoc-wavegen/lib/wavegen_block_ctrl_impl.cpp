@@ -20,6 +20,15 @@
 
 
 #include <uhd/rfnoc/wavegen_block_ctrl.hpp>
+#include <wavegen/wavegen_core.hpp>
+#include <wavegen/wavegen_config.hpp>
+#include <wavegen/wavegen_pulse_scheduler.hpp>
+#include <wavegen/wavegen_async_ctrl.hpp>
+#include <wavegen/wavegen_waveform_library.hpp>
+#include <wavegen/wavegen_sequencer.hpp>
+#include <wavegen/wavegen_metrics.hpp>
+#include <wavegen/wavegen_status_monitor.hpp>
+#include <wavegen/waveform_synth.h>
 #include <uhd/convert.hpp>
 #include <uhd/utils/msg.hpp>
 #include <uhd/types/ranges.hpp>
@@ -27,114 +36,246 @@
 #include <uhd/types/stream_cmd.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
 #include "time_core_3000.hpp"
 #include <math.h>
 
 using namespace uhd;
 using namespace uhd::rfnoc;
 
+/* Instrumented methods; overloads share a slot */
+#define WAVEGEN_BLOCK_METHODS(X) \
+    X(set_backend) \
+    X(set_waveform) \
+    X(set_upload_mode) \
+    X(set_upload_streamer) \
+    X(set_waveform_header_format) \
+    X(issue_stream_cmd) \
+    X(send_pulse) \
+    X(set_ctrl_word) \
+    X(set_src_awg) \
+    X(set_src_chirp) \
+    X(set_policy) \
+    X(set_policy_manual) \
+    X(set_policy_auto) \
+    X(set_num_adc_samples) \
+    X(set_rx_len) \
+    X(set_prf_count) \
+    X(set_chirp_counter) \
+    X(set_chirp_tuning_coef) \
+    X(set_chirp_freq_offset) \
+    X(setup_chirp) \
+    X(clear_commands) \
+    X(set_pulse_time_source) \
+    X(set_thread_profile) \
+    X(schedule_pulses) \
+    X(schedule_burst) \
+    X(commit) \
+    X(set_cache_enabled) \
+    X(set_readback_verify) \
+    X(refresh) \
+    X(set_waveform_banks_enabled) \
+    X(load_next_waveform) \
+    X(swap_waveform_bank) \
+    X(set_sequence) \
+    X(start_sequence) \
+    X(stop_sequence) \
+    X(set_integration) \
+    X(get_integration_state) \
+    X(get_live_bank) \
+    X(get_ctrl_word) \
+    X(get_src) \
+    X(get_policy_word) \
+    X(get_policy) \
+    X(get_num_adc_samples) \
+    X(get_rx_len) \
+    X(get_waveform_len) \
+    X(get_prf_count) \
+    X(get_state) \
+    X(get_status) \
+    X(get_reference_waveform)
+
+#define WAVEGEN_METHOD_ENUM(name) METHOD_##name,
+#define WAVEGEN_METHOD_NAME(name) #name,
+enum block_method_t { WAVEGEN_BLOCK_METHODS(WAVEGEN_METHOD_ENUM) NUM_BLOCK_METHODS };
+static const char *block_method_names[] = { WAVEGEN_BLOCK_METHODS(WAVEGEN_METHOD_NAME) };
+
+/* The block trace builds its message on every call, so keep it out of
+ * release builds; call counts and timing are always kept in _metrics. */
+#ifdef NDEBUG
+#define WAVEGEN_BLOCK_TRACE(msg)
+#else
+#define WAVEGEN_BLOCK_TRACE(msg) UHD_RFNOC_BLOCK_TRACE() << msg << std::endl
+#endif
+#define WAVEGEN_BLOCK_SCOPE(name) \
+    wavegen_metrics::scoped_call _call_scope(*_metrics, METHOD_##name)
+#define WAVEGEN_BLOCK_CALL(name) \
+    WAVEGEN_BLOCK_TRACE("wavegen_block::" #name "()"); \
+    WAVEGEN_BLOCK_SCOPE(name)
+
+
+/*! Register backend that drives this block's settings bus, readback
+ * registers and (optionally) a TX streamer into its sink port.
+ */
+class wavegen_block_reg_iface : public wavegen_reg_iface
+{
+public:
+    typedef boost::shared_ptr<wavegen_block_reg_iface> sptr;
+
+    wavegen_block_reg_iface(block_ctrl_base *block):
+        _block(block)
+    {
+    }
+
+    void sr_write(const boost::uint32_t reg, const boost::uint32_t data)
+    {
+        _block->sr_write(reg, data);
+    }
+
+    /* A control packet carries a single register write, so a burst
+     * still costs one bus transaction per op. */
+    void sr_write_burst(const sr_burst_t &ops)
+    {
+        for (sr_burst_t::const_iterator it = ops.begin(); it != ops.end(); ++it) {
+            _block->sr_write(it->reg, it->data);
+        }
+    }
+
+    void set_command_time(const uhd::time_spec_t &time)
+    {
+        _block->set_command_time(time, 0);
+    }
+
+    void clear_command_time(void)
+    {
+        _block->clear_command_time(0);
+    }
+
+    boost::uint64_t user_reg_read64(const boost::uint32_t addr)
+    {
+        return _block->user_reg_read64(addr);
+    }
+
+    void set_tx_stream(uhd::tx_streamer::sptr tx_stream)
+    {
+        _tx_stream = tx_stream;
+    }
+
+    bool has_stream(void)
+    {
+        return bool(_tx_stream);
+    }
+
+    size_t get_max_stream_words(void)
+    {
+        return _tx_stream ? _tx_stream->get_max_num_samps() : 0;
+    }
+
+    void stream_write(const boost::uint32_t *data, const size_t nwords)
+    {
+        if (not _tx_stream) {
+            throw uhd::runtime_error("wavegen_block: no upload streamer set");
+        }
+        /* The items come from pack_sc16(), so the sc16 converter turns
+         * them back into the words the block parses. One burst per
+         * packet so the sink sees tlast after the last word. */
+        uhd::tx_metadata_t md;
+        md.start_of_burst = true;
+        md.end_of_burst = true;
+        const size_t num_sent = _tx_stream->send(data, nwords, md, 1.0);
+        if (num_sent != nwords) {
+            throw uhd::io_error(str(
+                boost::format("wavegen_block: upload packet sent %d of %d words")
+                % num_sent % nwords
+            ));
+        }
+    }
+
+private:
+    block_ctrl_base *_block;
+    uhd::tx_streamer::sptr _tx_stream;
+};
+
 
 class wavegen_block_ctrl_impl : public wavegen_block_ctrl
 {
 public:
-    static const boost::uint32_t SR_CH_COUNTER_ADDR = 200;
-    static const boost::uint32_t SR_CH_TUNING_COEF_ADDR = 201;
-    static const boost::uint32_t SR_CH_FREQ_OFFSET_ADDR = 202;
-    static const boost::uint32_t SR_AWG_CTRL_WORD_ADDR = 203;
-
-    static const boost::uint32_t SR_PRF_INT_ADDR = 204;
-    static const boost::uint32_t SR_PRF_FRAC_ADDR = 205;
-    static const boost::uint32_t SR_ADC_SAMPLE_ADDR = 206;
-
-    static const boost::uint32_t SR_RADAR_CTRL_POLICY = 207;
-    static const boost::uint32_t SR_RADAR_CTRL_COMMAND = 208;
-    static const boost::uint32_t SR_RADAR_CTRL_TIME_HI = 209;
-    static const boost::uint32_t SR_RADAR_CTRL_TIME_LO = 210;
-    static const boost::uint32_t SR_RADAR_CTRL_CLEAR_CMDS = 211;
-    static const boost::uint32_t SR_AWG_RELOAD = 212;
-    static const boost::uint32_t SR_AWG_RELOAD_LAST = 213;
-
-    /* Control readback registers */
-
-    static const boost::uint32_t RB_AWG_LEN              = 5;
-    static const boost::uint32_t RB_ADC_LEN              = 6;
-    static const boost::uint32_t RB_AWG_CTRL             = 7;
-    static const boost::uint32_t RB_AWG_PRF              = 8;
-    static const boost::uint32_t RB_AWG_POLICY           = 9;
-    static const boost::uint32_t RB_AWG_STATE            = 10;
-
-     /* Constant settings values */
-    static const boost::uint32_t CTRL_WORD_SEL_CHIRP = 0x00000010;
-    static const boost::uint32_t CTRL_WORD_SEL_AWG = 0x00000310;
-
-    static const boost::uint32_t RADAR_POLICY_AUTO = 0;
-    static const boost::uint32_t RADAR_POLICY_MANUAL = 1;
-
-    /*Waveform Data Upload Header Command Identifier */
-    static const boost::uint16_t WAVEFORM_WRITE_CMD = 0x5744;
-
     UHD_RFNOC_BLOCK_CONSTRUCTOR(wavegen_block_ctrl),
-        _item_type("sc16") // We only support sc16 in this block
+        _item_type("sc16"), // We only support sc16 in this block
+        _tick_rate(0.0)
     {
-        wfrm_header.cmd = WAVEFORM_WRITE_CMD;
-        wfrm_header.id = 0;
-        wfrm_header.ind = 0;
-        wfrm_header.len = 0;
+        _metrics = wavegen_metrics::make(std::vector<std::string>(
+            block_method_names, block_method_names + NUM_BLOCK_METHODS
+        ));
+        _regs = wavegen_block_reg_iface::sptr(new wavegen_block_reg_iface(this));
+        _attach(_regs);
     }
 
-    void set_waveform(const std::vector<boost::uint32_t> &samples)
+    void set_backend(wavegen_reg_iface::sptr backend)
     {
-        UHD_RFNOC_BLOCK_TRACE() << "wavegen_block::set_waveform()" << std::endl;
-        wfrm_header.cmd = WAVEFORM_WRITE_CMD;
-        wfrm_header.ind = 0;
-        wfrm_header.len = boost::uint16_t(samples.size());
-
-        sr_write(SR_AWG_RELOAD, *((boost::uint32_t *)&wfrm_header+1));
-        sr_write(SR_AWG_RELOAD, *((boost::uint32_t *)&wfrm_header));
+        WAVEGEN_BLOCK_CALL(set_backend);
+        _attach(backend ? backend : wavegen_reg_iface::sptr(_regs));
+    }
 
-        for (size_t i = 0; i < samples.size() - 1; i++) {
-            sr_write(SR_AWG_RELOAD, samples[i]);
+    void set_thread_profile(gr::wavegen::thread_profile::sptr threads)
+    {
+        WAVEGEN_BLOCK_CALL(set_thread_profile);
+        if (_status_monitor->is_running()) {
+            throw uhd::runtime_error("wavegen_block: stop the status monitor before changing the thread profile");
         }
-        sr_write(SR_AWG_RELOAD_LAST, boost::uint32_t(samples.back()));
+        /* A strict profile that cannot place the monitor leaves both unchanged */
+        _status_monitor = wavegen_status_monitor::make(_core, _library, threads);
+        _threads = threads;
+        boost::mutex::scoped_lock lock(_async_mutex);
+        _async.reset();
+    }
 
-        /* Each waveform upload must have unique ID */
-        wfrm_header.id ++;
+    void set_waveform(const std::vector<boost::uint32_t> &samples)
+    {
+        WAVEGEN_BLOCK_CALL(set_waveform);
+        _library->set_waveform(samples);
     }
 
 
     void set_waveform(const std::vector<boost::uint32_t> &samples, int spp)
     {
-        UHD_RFNOC_BLOCK_TRACE() << "wavegen_block::set_waveform()" << std::endl;
-        wfrm_header.cmd = WAVEFORM_WRITE_CMD;
-        wfrm_header.ind = 0;
-        wfrm_header.len = boost::uint16_t(samples.size());
+        WAVEGEN_BLOCK_CALL(set_waveform);
+        if (spp <= 0) {
+            throw uhd::value_error("wavegen_block: samples per packet must be positive");
+        }
+        _library->set_waveform(samples, size_t(spp));
+    }
 
-        int round_pkts = (int)floor((double)samples.size() / spp);
-        int partial_spp = (int)samples.size() % spp;
+    void set_upload_mode(wavegen_core::upload_mode_t mode)
+    {
+        WAVEGEN_BLOCK_CALL(set_upload_mode);
+        _core->set_upload_mode(mode);
+    }
 
-        for(int j=0; j<round_pkts;j++){
-            sr_write(SR_AWG_RELOAD, *((boost::uint32_t *)&wfrm_header+1));
-            sr_write(SR_AWG_RELOAD, *((boost::uint32_t *)&wfrm_header));
-            for (int i = 0; i < spp - 1; i++) {
-                sr_write(SR_AWG_RELOAD, samples[j*spp+i]);
-            }
-            sr_write(SR_AWG_RELOAD_LAST, samples[j*spp+spp-1]);
-            wfrm_header.ind ++;
-        }
-        if(partial_spp > 0){
-            sr_write(SR_AWG_RELOAD, *((boost::uint32_t *)&wfrm_header+1));
-            sr_write(SR_AWG_RELOAD, *((boost::uint32_t *)&wfrm_header));
-            for (int i = 0; i < partial_spp - 1; i++) {
-                sr_write(SR_AWG_RELOAD, samples[round_pkts*spp+i]);
-            }
-            sr_write(SR_AWG_RELOAD_LAST, samples.back());
+    wavegen_core::upload_mode_t get_upload_mode()
+    {
+        return _core->get_upload_mode();
+    }
+
+    void set_upload_streamer(uhd::tx_streamer::sptr tx_stream)
+    {
+        WAVEGEN_BLOCK_CALL(set_upload_streamer);
+        _regs->set_tx_stream(tx_stream);
+        if (not tx_stream and _core->get_upload_mode() == wavegen_core::UPLOAD_MODE_STREAM) {
+            _core->set_upload_mode(wavegen_core::UPLOAD_MODE_SR);
         }
-        /* Each waveform upload must have unique ID */
-        wfrm_header.id ++;
     }
+
+    void set_waveform_header_format(wavegen_core::header_format_t format)
+    {
+        WAVEGEN_BLOCK_CALL(set_waveform_header_format);
+        _core->set_header_format(format);
+    }
+
     void issue_stream_cmd(const uhd::stream_cmd_t &stream_cmd, const size_t)
     {
-        UHD_RFNOC_BLOCK_TRACE() << "wavegen_block_ctrl::issue_stream_cmd() " << char(stream_cmd.stream_mode) << std::endl;
+        WAVEGEN_BLOCK_TRACE("wavegen_block::issue_stream_cmd() " << char(stream_cmd.stream_mode));
+        WAVEGEN_BLOCK_SCOPE(issue_stream_cmd);
 
         //setup the mode to instruction flags
         typedef boost::tuple<bool, bool, bool, bool> inst_t;
@@ -159,10 +300,8 @@ public:
         cmd_word |= (inst_samps)? stream_cmd.num_samps : ((inst_stop)? 0 : 1);
 
         //issue the stream command
-        const boost::uint64_t ticks = (stream_cmd.stream_now)? 0 : stream_cmd.time_spec.to_ticks(get_rate());
-        sr_write(SR_RADAR_CTRL_COMMAND, cmd_word);
-        sr_write(SR_RADAR_CTRL_TIME_HI, boost::uint32_t(ticks >> 32));
-        sr_write(SR_RADAR_CTRL_TIME_LO, boost::uint32_t(ticks >> 0)); //latches the command
+        const boost::uint64_t ticks = (stream_cmd.stream_now)? 0 : stream_cmd.time_spec.to_ticks(_require_rate());
+        _core->send_command(cmd_word, ticks);
 
         send_pulse();
     }
@@ -172,141 +311,253 @@ public:
     }
 
     void send_pulse(){
-        UHD_RFNOC_BLOCK_TRACE() << "wavegen_block::send_pulse()" << std::endl;
-        boost::uint32_t pulse_cmd_imm = 0x80000000;
-        /* Start immediately */
-        sr_write(SR_RADAR_CTRL_TIME_HI, pulse_cmd_imm);
-        /* Write TIME_LO register to initiate */
-        sr_write(SR_RADAR_CTRL_TIME_LO, 0);
+        WAVEGEN_BLOCK_CALL(send_pulse);
+        _core->send_pulse();
     }
     void send_pulse(const boost::uint64_t ticks){
-        UHD_RFNOC_BLOCK_TRACE() << "wavegen_block::send_pulse(ticks)" << std::endl;
-
-        // //setup the instruction flag values
-        // bool inst_reload, inst_chain, inst_samps, inst_stop;
-        // boost::tie(inst_reload, inst_chain, inst_samps, inst_stop) = mode_to_inst[stream_cmd.stream_mode];
-        //
-        // //calculate the word from flags and length
-        // boost::uint32_t cmd_word = 0;
-        // cmd_word |= boost::uint32_t((stream_cmd.stream_now)? 1 : 0) << 31;
-        // cmd_word |= boost::uint32_t((inst_chain)?            1 : 0) << 30;
-        // cmd_word |= boost::uint32_t((inst_reload)?           1 : 0) << 29;
-        // cmd_word |= boost::uint32_t((inst_stop)?             1 : 0) << 28;
-        // cmd_word |= (inst_samps)? stream_cmd.num_samps : ((inst_stop)? 0 : 1);
-        //issue the stream command
-        // const boost::uint64_t ticks = (stream_cmd.stream_now)? 0 : stream_cmd.time_spec.to_ticks(get_rate());
-
-        // Send timed command - Let Radar Pulse Controller handle the details
-        boost::uint32_t cmd_word = 0;
-        //issue the stream command
-        sr_write(SR_RADAR_CTRL_COMMAND, cmd_word);
-        sr_write(SR_RADAR_CTRL_TIME_HI, boost::uint32_t(ticks >> 32));
-        sr_write(SR_RADAR_CTRL_TIME_LO, boost::uint32_t(ticks >> 0)); //latches the command
+        WAVEGEN_BLOCK_CALL(send_pulse);
+        _core->send_pulse(ticks);
     }
 
     void set_ctrl_word(boost::uint32_t ctrl_word)
     {
-        UHD_RFNOC_BLOCK_TRACE() << "wavegen_block::set_ctrl_word()" << std::endl;
-        sr_write(SR_AWG_CTRL_WORD_ADDR, ctrl_word);
+        WAVEGEN_BLOCK_CALL(set_ctrl_word);
+        _core->set_ctrl_word(ctrl_word);
     }
 
     void set_src_awg()
     {
-        UHD_RFNOC_BLOCK_TRACE() << "wavegen_block::set_ctrl_word()" << std::endl;
-        sr_write(SR_AWG_CTRL_WORD_ADDR, CTRL_WORD_SEL_AWG);
+        WAVEGEN_BLOCK_CALL(set_src_awg);
+        _core->set_ctrl_word(wavegen_core::CTRL_WORD_SEL_AWG);
     }
     void set_src_chirp()
     {
-        UHD_RFNOC_BLOCK_TRACE() << "wavegen_block::set_ctrl_word()" << std::endl;
-        sr_write(SR_AWG_CTRL_WORD_ADDR, CTRL_WORD_SEL_CHIRP);
+        WAVEGEN_BLOCK_CALL(set_src_chirp);
+        _core->set_ctrl_word(wavegen_core::CTRL_WORD_SEL_CHIRP);
     }
 
     void set_policy(boost::uint32_t policy)
     {
-        UHD_RFNOC_BLOCK_TRACE() << "wavegen_block::set_policy()" << std::endl;
-        sr_write(SR_RADAR_CTRL_POLICY, policy);
+        WAVEGEN_BLOCK_CALL(set_policy);
+        _core->set_policy(policy);
     }
 
     void set_policy_manual()
     {
-        UHD_RFNOC_BLOCK_TRACE() << "wavegen_block::set_policy_manual()" << std::endl;
-        sr_write(SR_RADAR_CTRL_POLICY, RADAR_POLICY_MANUAL);
+        WAVEGEN_BLOCK_CALL(set_policy_manual);
+        _core->set_policy(wavegen_core::RADAR_POLICY_MANUAL);
     }
     void set_policy_auto()
     {
-        UHD_RFNOC_BLOCK_TRACE() << "wavegen_block::set_policy_auto()" << std::endl;
-        sr_write(SR_RADAR_CTRL_POLICY, RADAR_POLICY_AUTO);
+        WAVEGEN_BLOCK_CALL(set_policy_auto);
+        _core->set_policy(wavegen_core::RADAR_POLICY_AUTO);
     }
     void set_num_adc_samples(boost::uint32_t n)
     {
-        boost::uint32_t sample_count = n-1;
-        UHD_RFNOC_BLOCK_TRACE() << "wavegen_block::set_num_adc_samples()" << std::endl;
-        sr_write(SR_ADC_SAMPLE_ADDR, sample_count);
+        WAVEGEN_BLOCK_CALL(set_num_adc_samples);
+        _core->set_num_adc_samples(n);
     }
 
     void set_rx_len(boost::uint32_t rx_len)
     {
-        boost::uint32_t wfrm_len = get_waveform_len();
-        if (rx_len < wfrm_len) {
-            throw uhd::value_error(str(
-                boost::format("wavegen_block: Requested rx length %d is less than waveform length %d.\n")
-                % rx_len % wfrm_len
-            ));
-        }
-        boost::uint32_t sample_count = rx_len-wfrm_len;
-        if (sample_count>0) sample_count -= 1;
-        UHD_RFNOC_BLOCK_TRACE() << "wavegen_block::set_rx_len()" << std::endl;
-        sr_write(SR_ADC_SAMPLE_ADDR, sample_count);
+        WAVEGEN_BLOCK_CALL(set_rx_len);
+        _core->set_rx_len(rx_len);
     }
 
     void set_prf_count(boost::uint64_t prf_count)
     {
-        boost::uint32_t prf_count_int = boost::uint32_t(prf_count>>32);
-        boost::uint32_t prf_count_frac = boost::uint32_t(prf_count);
-        UHD_RFNOC_BLOCK_TRACE() << "wavegen_block::set_prf_count()" << std::endl;
-        sr_write(SR_PRF_INT_ADDR, prf_count_int);
-        sr_write(SR_PRF_FRAC_ADDR, prf_count_frac);
+        WAVEGEN_BLOCK_CALL(set_prf_count);
+        _core->set_prf_count(prf_count);
     }
     void set_chirp_counter(boost::uint32_t chirp_count)
     {
-        UHD_RFNOC_BLOCK_TRACE() << "wavegen_block::set_chirp_counter()" << std::endl;
-        sr_write(SR_CH_COUNTER_ADDR, chirp_count);
+        WAVEGEN_BLOCK_CALL(set_chirp_counter);
+        _core->set_chirp_counter(chirp_count);
     }
     void set_chirp_tuning_coef(boost::uint32_t tuning_coef)
     {
-        UHD_RFNOC_BLOCK_TRACE() << "wavegen_block::set_chirp_tuning_coef()" << std::endl;
-        sr_write(SR_CH_TUNING_COEF_ADDR, tuning_coef);
+        WAVEGEN_BLOCK_CALL(set_chirp_tuning_coef);
+        _core->set_chirp_tuning_coef(tuning_coef);
     }
     void set_chirp_freq_offset(boost::uint32_t freq_offset)
     {
-        UHD_RFNOC_BLOCK_TRACE() << "wavegen_block::set_chirp_freq_offset()" << std::endl;
-        sr_write(SR_CH_FREQ_OFFSET_ADDR, freq_offset);
+        WAVEGEN_BLOCK_CALL(set_chirp_freq_offset);
+        _core->set_chirp_freq_offset(freq_offset);
     }
     void setup_chirp(boost::uint32_t len, boost::uint32_t tuning_coef, boost::uint32_t freq_offset){
-        set_chirp_counter(len-1);
-        set_chirp_tuning_coef(tuning_coef);
-        set_chirp_freq_offset(freq_offset);
+        WAVEGEN_BLOCK_CALL(setup_chirp);
+        _core->setup_chirp(len, tuning_coef, freq_offset);
     }
 
     void clear_commands()
     {
-        UHD_RFNOC_BLOCK_TRACE() << "wavegen_block::clear_commands()" << std::endl;
-        sr_write(SR_RADAR_CTRL_CLEAR_CMDS, 1);
+        WAVEGEN_BLOCK_CALL(clear_commands);
+        if (_scheduler) {
+            _scheduler->cancel();
+        } else {
+            _core->clear_commands();
+        }
+    }
+
+    void set_pulse_time_source(wavegen_pulse_scheduler::tick_source_t tick_source, size_t queue_depth)
+    {
+        WAVEGEN_BLOCK_CALL(set_pulse_time_source);
+        _scheduler.reset();
+        _scheduler = wavegen_pulse_scheduler::make(_core, tick_source, _require_rate(), queue_depth, _threads);
+    }
+
+    void schedule_pulses(const std::vector<boost::uint64_t> &ticks)
+    {
+        WAVEGEN_BLOCK_CALL(schedule_pulses);
+        get_pulse_scheduler()->schedule_pulses(ticks);
+    }
+
+    void schedule_burst(boost::uint64_t start, boost::uint64_t interval, size_t count)
+    {
+        WAVEGEN_BLOCK_CALL(schedule_burst);
+        get_pulse_scheduler()->schedule_burst(start, interval, count);
+    }
+
+    wavegen_pulse_scheduler::sptr get_pulse_scheduler()
+    {
+        if (not _scheduler) {
+            throw uhd::runtime_error("wavegen_block: no pulse time source set");
+        }
+        return _scheduler;
+    }
+
+    wavegen_async_ctrl::sptr get_async_ctrl()
+    {
+        boost::mutex::scoped_lock lock(_async_mutex);
+        if (not _async) {
+            _async = wavegen_async_ctrl::make(_core, wavegen_async_ctrl::DEFAULT_QUEUE_DEPTH, _threads);
+        }
+        return _async;
+    }
+
+    void commit(const wavegen_config &config)
+    {
+        WAVEGEN_BLOCK_CALL(commit);
+        _core->commit(config);
+    }
+
+    void set_cache_enabled(bool enable)
+    {
+        WAVEGEN_BLOCK_CALL(set_cache_enabled);
+        _core->set_cache_enabled(enable);
+    }
+
+    void set_readback_verify(bool verify)
+    {
+        WAVEGEN_BLOCK_CALL(set_readback_verify);
+        _core->set_readback_verify(verify);
+    }
+
+    void refresh()
+    {
+        WAVEGEN_BLOCK_CALL(refresh);
+        _core->refresh();
+        _library->invalidate();
+    }
+
+    wavegen_waveform_library::sptr get_waveform_library()
+    {
+        return _library;
+    }
+
+    void set_waveform_banks_enabled(bool enable)
+    {
+        WAVEGEN_BLOCK_CALL(set_waveform_banks_enabled);
+        _library->set_num_banks(enable ? wavegen_core::NUM_AWG_BANKS : 1);
+    }
+
+    void load_next_waveform(const std::vector<boost::uint32_t> &samples)
+    {
+        WAVEGEN_BLOCK_CALL(load_next_waveform);
+        _library->prefetch(_library->add(samples));
+    }
+
+    void swap_waveform_bank()
+    {
+        WAVEGEN_BLOCK_CALL(swap_waveform_bank);
+        _library->swap();
+    }
+
+    void swap_waveform_bank(const uhd::time_spec_t &time)
+    {
+        WAVEGEN_BLOCK_CALL(swap_waveform_bank);
+        _library->swap(time);
+    }
+
+    void set_sequence(const std::vector<wavegen_sequencer::entry_t> &entries)
+    {
+        WAVEGEN_BLOCK_CALL(set_sequence);
+        _sequencer->set_sequence(entries);
+    }
+
+    void start_sequence()
+    {
+        WAVEGEN_BLOCK_CALL(start_sequence);
+        _sequencer->start();
+    }
+
+    void stop_sequence()
+    {
+        WAVEGEN_BLOCK_CALL(stop_sequence);
+        _sequencer->stop();
+    }
+
+    size_t get_sequence_index()
+    {
+        return _sequencer->get_index();
+    }
+
+    void set_integration(size_t num_pulses, size_t decimation)
+    {
+        WAVEGEN_BLOCK_CALL(set_integration);
+        const bool bypass = (num_pulses == 1 and decimation == 1);
+        _core->set_integration(num_pulses, decimation, bypass ? 0 : get_rx_len());
+    }
+
+    boost::uint64_t get_integration_state()
+    {
+        WAVEGEN_BLOCK_CALL(get_integration_state);
+        return _core->get_integration_state();
+    }
+
+    size_t get_live_bank()
+    {
+        WAVEGEN_BLOCK_CALL(get_live_bank);
+        boost::uint32_t bank_state = _core->get_bank_state();
+        return size_t(bank_state & wavegen_core::AWG_BANK_LIVE_MASK);
+    }
+
+    wavegen_core::cache_stats_t get_cache_stats()
+    {
+        return _core->get_cache_stats();
+    }
+
+    wavegen_metrics::snapshot_t get_metrics()
+    {
+        return _metrics->snapshot();
+    }
+
+    void reset_metrics()
+    {
+        _metrics->reset();
     }
 
     boost::uint32_t get_ctrl_word()
     {
-        UHD_RFNOC_BLOCK_TRACE() << "wavegen_block::get_ctrl_word()" << std::endl;
-        boost::uint32_t ctrl_word = boost::uint32_t(user_reg_read64(RB_AWG_CTRL));
-        UHD_MSG(status) << "wavegen_block::get_ctrl_word() ctrl_word ==" << ctrl_word << std::endl;
+        WAVEGEN_BLOCK_CALL(get_ctrl_word);
+        boost::uint32_t ctrl_word = _core->get_ctrl_word();
         UHD_ASSERT_THROW(ctrl_word);
         return ctrl_word;
     }
     std::string get_src()
     {
-        UHD_RFNOC_BLOCK_TRACE() << "wavegen_block::get_src()" << std::endl;
-        boost::uint32_t ctrl_word = boost::uint32_t(user_reg_read64(RB_AWG_CTRL));
-        UHD_MSG(status) << "wavegen_block::get_ctrl_word() ctrl_word ==" << ctrl_word << std::endl;
+        WAVEGEN_BLOCK_CALL(get_src);
+        boost::uint32_t ctrl_word = _core->get_ctrl_word();
         UHD_ASSERT_THROW(ctrl_word);
         std::string src_str;
         boost::uint32_t mask = 0x00000003;
@@ -324,25 +575,23 @@ public:
     }
     boost::uint32_t get_policy_word()
     {
-        UHD_RFNOC_BLOCK_TRACE() << "wavegen_block::get_policy_word()" << std::endl;
-        boost::uint32_t policy = boost::uint32_t(user_reg_read64(RB_AWG_POLICY));
-        UHD_MSG(status) << "wavegen_block::get_policy_word() policy ==" << policy << std::endl;
+        WAVEGEN_BLOCK_CALL(get_policy_word);
+        boost::uint32_t policy = _core->get_policy_word();
         //UHD_ASSERT_THROW(policy);
         UHD_ASSERT_THROW(1);
         return policy;
     }
     std::string get_policy()
     {
-        UHD_RFNOC_BLOCK_TRACE() << "wavegen_block::get_policy()" << std::endl;
-        boost::uint32_t policy = boost::uint32_t(user_reg_read64(RB_AWG_POLICY));
-        UHD_MSG(status) << "wavegen_block::get_policy() policy ==" << policy << std::endl;
+        WAVEGEN_BLOCK_CALL(get_policy);
+        boost::uint32_t policy = _core->get_policy_word();
         //UHD_ASSERT_THROW(policy);
         std::string policy_str;
-        if (policy == RADAR_POLICY_AUTO) {
+        if (policy == wavegen_core::RADAR_POLICY_AUTO) {
             policy_str = "AUTO";
             UHD_ASSERT_THROW(1);
         }
-        else if (policy == RADAR_POLICY_MANUAL) {
+        else if (policy == wavegen_core::RADAR_POLICY_MANUAL) {
             policy_str = "MANUAL";
             UHD_ASSERT_THROW(1);
         }
@@ -354,62 +603,117 @@ public:
 
     boost::uint32_t get_num_adc_samples()
     {
-        UHD_RFNOC_BLOCK_TRACE() << "wavegen_block::get_num_adc_samples()" << std::endl;
-        boost::uint32_t samples = boost::uint32_t(user_reg_read64(RB_ADC_LEN));
-        UHD_MSG(status) << "wavegen_block::get_num_adc_samples() samples ==" << samples << std::endl;
+        WAVEGEN_BLOCK_CALL(get_num_adc_samples);
+        boost::uint32_t samples = _core->get_num_adc_samples();
         UHD_ASSERT_THROW(samples);
         return samples;
     }
     boost::uint32_t get_rx_len()
     {
-        UHD_RFNOC_BLOCK_TRACE() << "wavegen_block::get_rx_len()" << std::endl;
+        WAVEGEN_BLOCK_CALL(get_rx_len);
         boost::uint32_t adc_samples = get_num_adc_samples();
         boost::uint32_t wfrm_len = get_waveform_len();
         boost::uint32_t rx_len = adc_samples+wfrm_len;
-        UHD_MSG(status) << "wavegen_block::get_rx_len() rx_len ==" << rx_len << std::endl;
         UHD_ASSERT_THROW(rx_len);
         return rx_len;
     }
 
     boost::uint32_t get_waveform_len()
     {
-        UHD_RFNOC_BLOCK_TRACE() << "wavegen_block::get_waveform_len()" << std::endl;
-        boost::uint32_t len = boost::uint32_t(user_reg_read64(RB_AWG_LEN));
-        UHD_MSG(status) << "wavegen_block::get_waveform_len() len ==" << len << std::endl;
+        WAVEGEN_BLOCK_CALL(get_waveform_len);
+        boost::uint32_t len = _core->get_waveform_len();
         UHD_ASSERT_THROW(len);
         return len;
     }
 
     boost::uint64_t get_prf_count()
     {
-        UHD_RFNOC_BLOCK_TRACE() << "wavegen_block::get_prf_count()" << std::endl;
-        boost::uint64_t prf_count = boost::uint64_t(user_reg_read64(RB_AWG_PRF));
-        UHD_MSG(status) << "wavegen_block::get_prf_count() prf_count ==" << prf_count << std::endl;
+        WAVEGEN_BLOCK_CALL(get_prf_count);
+        boost::uint64_t prf_count = _core->get_prf_count();
         UHD_ASSERT_THROW(prf_count);
         return prf_count;
     }
     boost::uint64_t get_state()
     {
-        UHD_RFNOC_BLOCK_TRACE() << "wavegen_block::get_state()" << std::endl;
-        boost::uint64_t awg_state = boost::uint64_t(user_reg_read64(RB_AWG_STATE));
-        UHD_MSG(status) << "wavegen_block::get_state() awg_state ==" << awg_state << std::endl;
+        WAVEGEN_BLOCK_CALL(get_state);
+        boost::uint64_t awg_state = _core->get_state();
         UHD_ASSERT_THROW(awg_state);
         return awg_state;
     }
 
+    wavegen_status get_status()
+    {
+        WAVEGEN_BLOCK_CALL(get_status);
+        return _status_monitor->poll();
+    }
+
+    wavegen_status_monitor::sptr get_status_monitor()
+    {
+        return _status_monitor;
+    }
+
+    std::vector<boost::uint32_t> get_reference_waveform()
+    {
+        WAVEGEN_BLOCK_CALL(get_reference_waveform);
+        const boost::uint32_t sel = _core->get_ctrl_word() & wavegen_core::CTRL_WORD_SEL_AWG;
+        if (sel != wavegen_core::CTRL_WORD_SEL_AWG) {
+            gr::wavegen::waveform_synth::chirp_coefs_t chirp;
+            if (not _core->get_chirp(chirp.len, chirp.tuning_coef, chirp.freq_offset)) {
+                throw uhd::runtime_error("wavegen_block: the chirp source has not been set up");
+            }
+            return gr::wavegen::waveform_synth::hw_chirp(
+                chirp.len, chirp.tuning_coef, chirp.freq_offset);
+        }
+        wavegen_waveform_library::waveform_id_t id;
+        if (not _library->get_bank_id(_library->get_live_bank(), id)) {
+            throw uhd::runtime_error("wavegen_block: the AWG waveform was not loaded through set_waveform() or the library");
+        }
+        return _library->get_samples(id);
+    }
+
     double get_rate(){
       return _tick_rate;
     }
 
 private:
+    /* Tick rate for converting times, which set_rate() must have given */
+    double _require_rate(void)
+    {
+        if (not (_tick_rate > 0)) {
+            throw uhd::runtime_error("wavegen_block: no tick rate, call set_rate() first");
+        }
+        return _tick_rate;
+    }
+
+    /* Build the controller stack on a register backend */
+    void _attach(wavegen_reg_iface::sptr backend)
+    {
+        /* Stop the threads that use the old core before dropping it */
+        _scheduler.reset();
+        _status_monitor.reset();
+        {
+            boost::mutex::scoped_lock lock(_async_mutex);
+            _async.reset();
+        }
+        _core = wavegen_core::make(_metrics->wrap(backend));
+        _library = wavegen_waveform_library::make(_core);
+        _sequencer = wavegen_sequencer::make(_core, _library);
+        _status_monitor = wavegen_status_monitor::make(_core, _library, _threads);
+    }
+
     const std::string _item_type;
     double _tick_rate;
-    struct waveform_header {
-        boost::uint16_t len;
-        boost::uint16_t ind;
-        boost::uint16_t id;
-        boost::uint16_t cmd;
-    }wfrm_header;
+    wavegen_metrics::sptr _metrics;
+    wavegen_block_reg_iface::sptr _regs;
+    wavegen_core::sptr _core;
+    wavegen_waveform_library::sptr _library;
+    wavegen_sequencer::sptr _sequencer;
+    wavegen_pulse_scheduler::sptr _scheduler;
+    wavegen_status_monitor::sptr _status_monitor;
+    /* Profile for the control threads above, may be empty */
+    gr::wavegen::thread_profile::sptr _threads;
+    boost::mutex _async_mutex;
+    wavegen_async_ctrl::sptr _async;
 };
 
 UHD_RFNOC_BLOCK_REGISTER(wavegen_block_ctrl,"wavegen");
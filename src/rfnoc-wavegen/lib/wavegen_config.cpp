@@ -0,0 +1,141 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <wavegen/wavegen_config.hpp>
+#include <wavegen/wavegen_core.hpp>
+#include <uhd/exception.hpp>
+
+using namespace uhd;
+using namespace uhd::rfnoc;
+
+
+wavegen_config &wavegen_config::set_chirp_counter(const boost::uint32_t chirp_counter)
+{
+    _chirp_counter = chirp_counter;
+    return *this;
+}
+
+wavegen_config &wavegen_config::set_chirp_tuning_coef(const boost::uint32_t tuning_coef)
+{
+    _tuning_coef = tuning_coef;
+    return *this;
+}
+
+wavegen_config &wavegen_config::set_chirp_freq_offset(const boost::uint32_t freq_offset)
+{
+    _freq_offset = freq_offset;
+    return *this;
+}
+
+wavegen_config &wavegen_config::setup_chirp(const boost::uint32_t len, const boost::uint32_t tuning_coef, const boost::uint32_t freq_offset)
+{
+    if (len == 0) {
+        throw uhd::value_error("wavegen_config: chirp length must be non-zero");
+    }
+    set_chirp_counter(len-1);
+    set_chirp_tuning_coef(tuning_coef);
+    return set_chirp_freq_offset(freq_offset);
+}
+
+wavegen_config &wavegen_config::set_ctrl_word(const boost::uint32_t ctrl_word)
+{
+    _ctrl_word = ctrl_word;
+    return *this;
+}
+
+wavegen_config &wavegen_config::set_src_awg(void)
+{
+    return set_ctrl_word(wavegen_core::CTRL_WORD_SEL_AWG);
+}
+
+wavegen_config &wavegen_config::set_src_chirp(void)
+{
+    return set_ctrl_word(wavegen_core::CTRL_WORD_SEL_CHIRP);
+}
+
+wavegen_config &wavegen_config::set_prf_count(const boost::uint64_t prf_count)
+{
+    _prf_count = prf_count;
+    return *this;
+}
+
+wavegen_config &wavegen_config::set_num_adc_samples(const boost::uint32_t n)
+{
+    if (n == 0) {
+        throw uhd::value_error("wavegen_config: number of ADC samples must be non-zero");
+    }
+    _adc_samples = n-1;
+    return *this;
+}
+
+wavegen_config &wavegen_config::set_policy(const boost::uint32_t policy)
+{
+    _policy = policy;
+    return *this;
+}
+
+wavegen_config &wavegen_config::set_command_time(const uhd::time_spec_t &time)
+{
+    _command_time = time;
+    return *this;
+}
+
+wavegen_config &wavegen_config::clear_command_time(void)
+{
+    _command_time = boost::none;
+    return *this;
+}
+
+bool wavegen_config::has_command_time(void) const
+{
+    return bool(_command_time);
+}
+
+uhd::time_spec_t wavegen_config::get_command_time(void) const
+{
+    if (not _command_time) {
+        throw uhd::value_error("wavegen_config: no command time set");
+    }
+    return *_command_time;
+}
+
+bool wavegen_config::empty(void) const
+{
+    return not (_chirp_counter or _tuning_coef or _freq_offset or _ctrl_word
+        or _adc_samples or _prf_count or _policy);
+}
+
+wavegen_reg_iface::sr_burst_t wavegen_config::get_writes(void) const
+{
+    typedef wavegen_reg_iface::sr_op_t sr_op_t;
+    wavegen_reg_iface::sr_burst_t ops;
+    if (_chirp_counter) ops.push_back(sr_op_t(wavegen_core::SR_CH_COUNTER_ADDR, *_chirp_counter));
+    if (_tuning_coef)   ops.push_back(sr_op_t(wavegen_core::SR_CH_TUNING_COEF_ADDR, *_tuning_coef));
+    if (_freq_offset)   ops.push_back(sr_op_t(wavegen_core::SR_CH_FREQ_OFFSET_ADDR, *_freq_offset));
+    if (_ctrl_word)     ops.push_back(sr_op_t(wavegen_core::SR_AWG_CTRL_WORD_ADDR, *_ctrl_word));
+    if (_adc_samples)   ops.push_back(sr_op_t(wavegen_core::SR_ADC_SAMPLE_ADDR, *_adc_samples));
+    if (_prf_count) {
+        ops.push_back(sr_op_t(wavegen_core::SR_PRF_INT_ADDR, boost::uint32_t(*_prf_count >> 32)));
+        ops.push_back(sr_op_t(wavegen_core::SR_PRF_FRAC_ADDR, boost::uint32_t(*_prf_count)));
+    }
+    if (_policy)        ops.push_back(sr_op_t(wavegen_core::SR_RADAR_CTRL_POLICY, *_policy));
+    return ops;
+}
@@ -0,0 +1,917 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <wavegen/wavegen_core.hpp>
+#include <wavegen/wavegen_config.hpp>
+#include <uhd/exception.hpp>
+#include <boost/format.hpp>
+#include <boost/thread/recursive_mutex.hpp>
+#include <algorithm>
+#include <map>
+#include <set>
+
+using namespace uhd;
+using namespace uhd::rfnoc;
+
+
+/* Out-of-class definitions so the register map can be bound to references */
+const boost::uint32_t wavegen_core::SR_CH_COUNTER_ADDR;
+const boost::uint32_t wavegen_core::SR_CH_TUNING_COEF_ADDR;
+const boost::uint32_t wavegen_core::SR_CH_FREQ_OFFSET_ADDR;
+const boost::uint32_t wavegen_core::SR_AWG_CTRL_WORD_ADDR;
+const boost::uint32_t wavegen_core::SR_PRF_INT_ADDR;
+const boost::uint32_t wavegen_core::SR_PRF_FRAC_ADDR;
+const boost::uint32_t wavegen_core::SR_ADC_SAMPLE_ADDR;
+const boost::uint32_t wavegen_core::SR_RADAR_CTRL_POLICY;
+const boost::uint32_t wavegen_core::SR_RADAR_CTRL_COMMAND;
+const boost::uint32_t wavegen_core::SR_RADAR_CTRL_TIME_HI;
+const boost::uint32_t wavegen_core::SR_RADAR_CTRL_TIME_LO;
+const boost::uint32_t wavegen_core::SR_RADAR_CTRL_CLEAR_CMDS;
+const boost::uint32_t wavegen_core::SR_AWG_RELOAD;
+const boost::uint32_t wavegen_core::SR_AWG_RELOAD_LAST;
+const boost::uint32_t wavegen_core::SR_AWG_LOAD_BANK;
+const boost::uint32_t wavegen_core::SR_AWG_BANK_SEL;
+const boost::uint32_t wavegen_core::SR_SEQ_ADDR;
+const boost::uint32_t wavegen_core::SR_SEQ_DATA;
+const boost::uint32_t wavegen_core::SR_SEQ_CTRL;
+const boost::uint32_t wavegen_core::SR_INTEG_NUM_PULSES;
+const boost::uint32_t wavegen_core::SR_INTEG_DECIM;
+const boost::uint32_t wavegen_core::SR_INTEG_LEN;
+const boost::uint32_t wavegen_core::SR_INTEG_SHIFT;
+const boost::uint32_t wavegen_core::RB_AWG_LEN;
+const boost::uint32_t wavegen_core::RB_ADC_LEN;
+const boost::uint32_t wavegen_core::RB_AWG_CTRL;
+const boost::uint32_t wavegen_core::RB_AWG_PRF;
+const boost::uint32_t wavegen_core::RB_AWG_POLICY;
+const boost::uint32_t wavegen_core::RB_AWG_STATE;
+const boost::uint32_t wavegen_core::RB_AWG_BANK;
+const boost::uint32_t wavegen_core::RB_SEQ_INDEX;
+const boost::uint32_t wavegen_core::RB_INTEG;
+const boost::uint32_t wavegen_core::CTRL_WORD_SEL_CHIRP;
+const boost::uint32_t wavegen_core::CTRL_WORD_SEL_AWG;
+const boost::uint32_t wavegen_core::RADAR_POLICY_AUTO;
+const boost::uint32_t wavegen_core::RADAR_POLICY_MANUAL;
+const size_t wavegen_core::NUM_AWG_BANKS;
+const boost::uint32_t wavegen_core::AWG_BANK_LIVE_MASK;
+const boost::uint32_t wavegen_core::AWG_BANK_SWAP_PENDING;
+const boost::uint32_t wavegen_core::AWG_BANK_LOAD_MASK;
+const boost::uint64_t wavegen_core::AWG_STATE_MASK;
+const boost::uint64_t wavegen_core::AWG_STATE_IDLE;
+const boost::uint64_t wavegen_core::AWG_STATE_WAIT;
+const boost::uint64_t wavegen_core::AWG_STATE_PULSE;
+const boost::uint64_t wavegen_core::AWG_STATE_LOADED;
+const boost::uint64_t wavegen_core::AWG_STATE_SEQ_ENABLED;
+const boost::uint64_t wavegen_core::AWG_STATE_LATE;
+const boost::uint64_t wavegen_core::AWG_STATE_UNDERRUN;
+const boost::uint64_t wavegen_core::AWG_STATE_STICKY_MASK;
+const int wavegen_core::AWG_STATE_QUEUE_SHIFT;
+const int wavegen_core::AWG_STATE_COUNT_SHIFT;
+const boost::uint32_t wavegen_core::CMD_STOP;
+const boost::uint32_t wavegen_core::CMD_TIME_NOW;
+const size_t wavegen_core::SEQ_MAX_ENTRIES;
+const size_t wavegen_core::SEQ_WORDS_PER_ENTRY;
+const boost::uint32_t wavegen_core::SEQ_CTRL_ENABLE;
+const size_t wavegen_core::INTEG_MAX_PULSES;
+const size_t wavegen_core::INTEG_MAX_DECIM;
+const size_t wavegen_core::INTEG_MAX_LEN;
+const boost::uint64_t wavegen_core::INTEG_ACTIVE;
+const int wavegen_core::INTEG_PULSE_SHIFT;
+const int wavegen_core::INTEG_RECORDS_SHIFT;
+const boost::uint16_t wavegen_core::WAVEFORM_WRITE_CMD;
+const boost::uint16_t wavegen_core::WAVEFORM_WRITE_WIDE_CMD;
+const size_t wavegen_core::MAX_SEGMENT_SAMPS;
+
+class wavegen_core_impl : public wavegen_core
+{
+public:
+    /* Header words at the start of every upload packet */
+    static const size_t NARROW_HEADER_WORDS = 2;
+    static const size_t WIDE_HEADER_WORDS = 3;
+
+    wavegen_core_impl(wavegen_reg_iface::sptr iface):
+        _iface(iface),
+        _upload_mode(UPLOAD_MODE_SR),
+        _header_format(HEADER_FORMAT_AUTO),
+        _header_words(NARROW_HEADER_WORDS),
+        _cache_enabled(true),
+        _verify(false),
+        _num_uploads(0),
+        _seq_len(0),
+        _seq_enabled(false),
+        _banks_used(false)
+    {
+        _wfrm_header.cmd = WAVEFORM_WRITE_CMD;
+        _wfrm_header.id = 0;
+        _wfrm_header.ind = 0;
+        _wfrm_header.len = 0;
+    }
+
+    void set_upload_mode(const upload_mode_t mode)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        if (mode == UPLOAD_MODE_STREAM and not _iface->has_stream()) {
+            throw uhd::value_error("wavegen_core: stream upload requested but backend has no stream path");
+        }
+        _upload_mode = mode;
+    }
+
+    upload_mode_t get_upload_mode(void)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        return _upload_mode;
+    }
+
+    void set_header_format(const header_format_t format)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        _header_format = format;
+    }
+
+    header_format_t get_header_format(void)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        return _header_format;
+    }
+
+    void set_waveform(const std::vector<boost::uint32_t> &samples)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        _check_waveform(samples);
+        _begin_upload(samples.size());
+
+        size_t spp = std::min(samples.size(), size_t(MAX_SEGMENT_SAMPS));
+        if (_upload_mode == UPLOAD_MODE_STREAM) {
+            spp = std::min(spp, _max_stream_spp());
+        }
+        _upload(samples, spp);
+    }
+
+    void set_waveform(const std::vector<boost::uint32_t> &samples, const size_t spp)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        _check_waveform(samples);
+        if (spp == 0) {
+            throw uhd::value_error("wavegen_core: samples per packet must be non-zero");
+        }
+        _begin_upload(samples.size());
+        if (_upload_mode == UPLOAD_MODE_STREAM and spp > _max_stream_spp()) {
+            throw uhd::value_error(str(
+                boost::format("wavegen_core: %d samples per packet exceeds stream packet limit of %d")
+                % spp % _max_stream_spp()
+            ));
+        }
+        _upload(samples, spp);
+    }
+
+    void send_pulse(void)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        boost::uint32_t pulse_cmd_imm = CMD_TIME_NOW;
+        /* Start immediately */
+        _strobe(SR_RADAR_CTRL_TIME_HI, pulse_cmd_imm);
+        _note_write(SR_RADAR_CTRL_TIME_HI, pulse_cmd_imm);
+        /* Write TIME_LO register to initiate */
+        _strobe(SR_RADAR_CTRL_TIME_LO, 0);
+    }
+
+    void send_pulse(const boost::uint64_t ticks)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        // Send timed command - Let Radar Pulse Controller handle the details
+        send_command(0, ticks);
+    }
+
+    void send_command(const boost::uint32_t cmd_word, const boost::uint64_t ticks)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        _strobe(SR_RADAR_CTRL_COMMAND, cmd_word);
+        _strobe(SR_RADAR_CTRL_TIME_HI, boost::uint32_t(ticks >> 32));
+        _strobe(SR_RADAR_CTRL_TIME_LO, boost::uint32_t(ticks >> 0)); //latches the command
+        _note_write(SR_RADAR_CTRL_COMMAND, cmd_word);
+        _note_write(SR_RADAR_CTRL_TIME_HI, boost::uint32_t(ticks >> 32));
+    }
+
+    void send_commands(const boost::uint32_t cmd_word, const std::vector<boost::uint64_t> &ticks)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        if (ticks.empty()) {
+            return;
+        }
+        /* COMMAND and TIME_HI hold their value, so only the TIME_LO strobe
+         * has to be repeated for every pulse */
+        _burst.clear();
+        _queue_if_changed(SR_RADAR_CTRL_COMMAND, cmd_word);
+        for (size_t i = 0; i < ticks.size(); i++) {
+            _queue_if_changed(SR_RADAR_CTRL_TIME_HI, boost::uint32_t(ticks[i] >> 32));
+            _burst.push_back(wavegen_reg_iface::sr_op_t(SR_RADAR_CTRL_TIME_LO, boost::uint32_t(ticks[i])));
+        }
+        try {
+            _iface->sr_write_burst(_burst);
+        } catch (...) {
+            refresh();
+            throw;
+        }
+        _cache_stats.sr_writes += _burst.size();
+    }
+
+    void set_ctrl_word(const boost::uint32_t ctrl_word)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        _poke(SR_AWG_CTRL_WORD_ADDR, ctrl_word);
+    }
+
+    void set_policy(const boost::uint32_t policy)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        _poke(SR_RADAR_CTRL_POLICY, policy);
+    }
+
+    void set_num_adc_samples(const boost::uint32_t n)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        boost::uint32_t sample_count = n-1;
+        _poke(SR_ADC_SAMPLE_ADDR, sample_count);
+    }
+
+    void set_rx_len(const boost::uint32_t rx_len)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        boost::uint32_t wfrm_len = get_waveform_len();
+        if (rx_len < wfrm_len) {
+            throw uhd::value_error(str(
+                boost::format("wavegen_block: Requested rx length %d is less than waveform length %d.\n")
+                % rx_len % wfrm_len
+            ));
+        }
+        boost::uint32_t sample_count = rx_len-wfrm_len;
+        if (sample_count>0) sample_count -= 1;
+        _poke(SR_ADC_SAMPLE_ADDR, sample_count);
+    }
+
+    void set_prf_count(const boost::uint64_t prf_count)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        boost::uint32_t prf_count_int = boost::uint32_t(prf_count>>32);
+        boost::uint32_t prf_count_frac = boost::uint32_t(prf_count);
+        _poke(SR_PRF_INT_ADDR, prf_count_int);
+        _poke(SR_PRF_FRAC_ADDR, prf_count_frac);
+    }
+
+    void set_chirp_counter(const boost::uint32_t chirp_count)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        _poke(SR_CH_COUNTER_ADDR, chirp_count);
+    }
+
+    void set_chirp_tuning_coef(const boost::uint32_t tuning_coef)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        _poke(SR_CH_TUNING_COEF_ADDR, tuning_coef);
+    }
+
+    void set_chirp_freq_offset(const boost::uint32_t freq_offset)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        _poke(SR_CH_FREQ_OFFSET_ADDR, freq_offset);
+    }
+
+    void setup_chirp(const boost::uint32_t len, const boost::uint32_t tuning_coef, const boost::uint32_t freq_offset)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        set_chirp_counter(len-1);
+        set_chirp_tuning_coef(tuning_coef);
+        set_chirp_freq_offset(freq_offset);
+    }
+
+    bool get_chirp(boost::uint32_t &len, boost::uint32_t &tuning_coef, boost::uint32_t &freq_offset)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        boost::uint32_t chirp_count;
+        if (not _written(SR_CH_COUNTER_ADDR, chirp_count)
+            or not _written(SR_CH_TUNING_COEF_ADDR, tuning_coef)
+            or not _written(SR_CH_FREQ_OFFSET_ADDR, freq_offset)) {
+            return false;
+        }
+        len = chirp_count + 1;
+        return true;
+    }
+
+    void commit(const wavegen_config &config)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        const wavegen_reg_iface::sr_burst_t staged = config.get_writes();
+        _commit_ops.clear();
+        for (size_t i = 0; i < staged.size(); i++) {
+            const shadow_reg_t &shadow = _sr_shadow[staged[i].reg];
+            if (_cache_enabled and shadow.valid and shadow.value == staged[i].data) {
+                _cache_stats.writes_skipped++;
+                continue;
+            }
+            _commit_ops.push_back(staged[i]);
+        }
+        if (_commit_ops.empty()) {
+            return;
+        }
+
+        if (config.has_command_time()) {
+            _iface->set_command_time(config.get_command_time());
+        }
+        try {
+            _iface->sr_write_burst(_commit_ops);
+        } catch (...) {
+            // State of the registers is unknown now
+            refresh();
+            if (config.has_command_time()) {
+                _iface->clear_command_time();
+            }
+            throw;
+        }
+        if (config.has_command_time()) {
+            _iface->clear_command_time();
+        }
+
+        for (size_t i = 0; i < _commit_ops.size(); i++) {
+            shadow_reg_t &shadow = _sr_shadow[_commit_ops[i].reg];
+            shadow.value = _commit_ops[i].data;
+            shadow.valid = _cache_enabled;
+            shadow.written = true;
+            _invalidate_readback(_commit_ops[i].reg, config.has_command_time());
+        }
+        _cache_stats.sr_writes += _commit_ops.size();
+    }
+
+    void clear_commands(void)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        _strobe(SR_RADAR_CTRL_CLEAR_CMDS, 1);
+    }
+
+    boost::uint32_t get_ctrl_word(void)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        return boost::uint32_t(_peek(RB_AWG_CTRL));
+    }
+
+    boost::uint32_t get_policy_word(void)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        return boost::uint32_t(_peek(RB_AWG_POLICY));
+    }
+
+    boost::uint32_t get_num_adc_samples(void)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        return boost::uint32_t(_peek(RB_ADC_LEN));
+    }
+
+    boost::uint32_t get_rx_len(void)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        return get_num_adc_samples() + get_waveform_len();
+    }
+
+    boost::uint32_t get_waveform_len(void)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        return boost::uint32_t(_peek(RB_AWG_LEN));
+    }
+
+    boost::uint64_t get_prf_count(void)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        return boost::uint64_t(_peek(RB_AWG_PRF));
+    }
+
+    boost::uint64_t get_state(void)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        return boost::uint64_t(_peek(RB_AWG_STATE));
+    }
+
+    wavegen_status get_status(void)
+    {
+        std::vector<boost::uint32_t> addrs;
+        for (boost::uint32_t addr = RB_AWG_LEN; addr <= RB_SEQ_INDEX; addr++) {
+            addrs.push_back(addr);
+        }
+        std::vector<boost::uint64_t> values;
+        wavegen_status status;
+        {
+            boost::recursive_mutex::scoped_lock lock(_mutex);
+            _iface->user_reg_read64_burst(addrs, values);
+            _cache_stats.rb_reads += addrs.size();
+            status.chirp_known = get_chirp(status.chirp_len, status.chirp_tuning_coef, status.chirp_freq_offset);
+        }
+        if (values.size() != addrs.size()) {
+            throw uhd::runtime_error("wavegen_core: short status readback");
+        }
+        const boost::uint64_t *rb = &values[0] - RB_AWG_LEN;
+
+        status.raw_state = rb[RB_AWG_STATE];
+        status.state = boost::uint8_t(status.raw_state & AWG_STATE_MASK);
+        status.busy = (status.state == AWG_STATE_PULSE);
+        status.loaded = (status.raw_state & AWG_STATE_LOADED) != 0;
+        status.seq_enabled = (status.raw_state & AWG_STATE_SEQ_ENABLED) != 0;
+        status.late = (status.raw_state & AWG_STATE_LATE) != 0;
+        status.underrun = (status.raw_state & AWG_STATE_UNDERRUN) != 0;
+        status.queue_depth = boost::uint16_t(status.raw_state >> AWG_STATE_QUEUE_SHIFT);
+        status.pulse_count = boost::uint32_t(status.raw_state >> AWG_STATE_COUNT_SHIFT);
+
+        const boost::uint64_t bank = rb[RB_AWG_BANK];
+        status.live_bank = size_t(bank & AWG_BANK_LIVE_MASK);
+        status.load_bank = (bank & AWG_BANK_LOAD_MASK) ? 1 : 0;
+        status.swap_pending = (bank & AWG_BANK_SWAP_PENDING) != 0;
+        status.seq_index = size_t(rb[RB_SEQ_INDEX]);
+
+        status.waveform_len = boost::uint32_t(rb[RB_AWG_LEN]);
+        status.num_adc_samples = boost::uint32_t(rb[RB_ADC_LEN]);
+        status.ctrl_word = boost::uint32_t(rb[RB_AWG_CTRL]);
+        status.policy = boost::uint32_t(rb[RB_AWG_POLICY]);
+        status.prf_count = rb[RB_AWG_PRF];
+        return status;
+    }
+
+    void set_load_bank(const size_t bank)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        _check_bank(bank);
+        _banks_used = true;
+        _poke(SR_AWG_LOAD_BANK, boost::uint32_t(bank));
+    }
+
+    void select_bank(const size_t bank)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        _check_bank(bank);
+        _banks_used = true;
+        /* Every write is a swap request, so never skip it */
+        _strobe(SR_AWG_BANK_SEL, boost::uint32_t(bank));
+        _note_write(SR_AWG_BANK_SEL, boost::uint32_t(bank));
+        _invalidate_readback(SR_AWG_BANK_SEL);
+    }
+
+    void select_bank(const size_t bank, const uhd::time_spec_t &time)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        _check_bank(bank);
+        _banks_used = true;
+        _iface->set_command_time(time);
+        try {
+            _strobe(SR_AWG_BANK_SEL, boost::uint32_t(bank));
+        } catch (...) {
+            _iface->clear_command_time();
+            throw;
+        }
+        _iface->clear_command_time();
+        _note_write(SR_AWG_BANK_SEL, boost::uint32_t(bank));
+        _invalidate_readback(SR_AWG_BANK_SEL);
+    }
+
+    void set_sequence(const std::vector<seq_entry_t> &entries)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        if (entries.empty() or entries.size() > SEQ_MAX_ENTRIES) {
+            throw uhd::value_error(str(
+                boost::format("wavegen_core: sequence must have 1 to %d entries, got %d")
+                % SEQ_MAX_ENTRIES % entries.size()
+            ));
+        }
+        for (size_t i = 0; i < entries.size(); i++) {
+            _check_bank(entries[i].bank);
+        }
+
+        /* Stop the sequencer before its table changes under it */
+        _burst.clear();
+        _burst.push_back(wavegen_reg_iface::sr_op_t(SR_SEQ_CTRL, boost::uint32_t(entries.size() - 1)));
+        _burst.push_back(wavegen_reg_iface::sr_op_t(SR_SEQ_ADDR, 0));
+        for (size_t i = 0; i < entries.size(); i++) {
+            const seq_entry_t &e = entries[i];
+            _burst.push_back(wavegen_reg_iface::sr_op_t(SR_SEQ_DATA, e.bank));
+            _burst.push_back(wavegen_reg_iface::sr_op_t(SR_SEQ_DATA, e.ctrl_word));
+            _burst.push_back(wavegen_reg_iface::sr_op_t(SR_SEQ_DATA, e.tuning_coef));
+            _burst.push_back(wavegen_reg_iface::sr_op_t(SR_SEQ_DATA, e.freq_offset));
+            _burst.push_back(wavegen_reg_iface::sr_op_t(SR_SEQ_DATA, e.adc_samples));
+        }
+        try {
+            _iface->sr_write_burst(_burst);
+        } catch (...) {
+            refresh();
+            throw;
+        }
+        _note_write(SR_SEQ_CTRL, boost::uint32_t(entries.size() - 1));
+        _invalidate_readback(SR_SEQ_DATA);
+        _seq_len = entries.size();
+        _seq_enabled = false;
+        _cache_stats.sr_writes += _burst.size();
+    }
+
+    void enable_sequence(const bool enable)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        if (enable and _seq_len == 0) {
+            throw uhd::runtime_error("wavegen_core: no sequence loaded");
+        }
+        const boost::uint32_t len_word = (_seq_len > 0) ? boost::uint32_t(_seq_len - 1) : 0;
+        _poke(SR_SEQ_CTRL, len_word | (enable ? SEQ_CTRL_ENABLE : 0));
+        _seq_enabled = enable;
+    }
+
+    size_t get_sequence_index(void)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        return size_t(_peek(RB_SEQ_INDEX));
+    }
+
+    void set_integration(const size_t num_pulses, const size_t decimation,
+                         const boost::uint32_t pulse_len, const int shift)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        if (num_pulses == 0 or num_pulses > INTEG_MAX_PULSES
+            or decimation == 0 or decimation > INTEG_MAX_DECIM) {
+            throw uhd::value_error(str(
+                boost::format("wavegen_core: integration of %d pulses, decimation %d out of range")
+                % num_pulses % decimation
+            ));
+        }
+        const bool bypass = (num_pulses == 1 and decimation == 1);
+        if (not bypass and (pulse_len == 0 or pulse_len % decimation
+                            or pulse_len / decimation > INTEG_MAX_LEN)) {
+            throw uhd::value_error(str(
+                boost::format("wavegen_core: cannot integrate pulses of %d samples, decimation %d, record RAM %d")
+                % pulse_len % decimation % INTEG_MAX_LEN
+            ));
+        }
+        /* 16-bit samples summed into the 32-bit accumulators */
+        const size_t gain = num_pulses * decimation;
+        if (gain > (1 << 16)) {
+            throw uhd::value_error("wavegen_core: integration would overflow the accumulators");
+        }
+        int bits = 0;
+        while ((size_t(1) << bits) < gain) {
+            bits++;
+        }
+        if (shift > 31) {
+            throw uhd::value_error("wavegen_core: integration shift above 31");
+        }
+        _poke(SR_INTEG_LEN, pulse_len);
+        _poke(SR_INTEG_DECIM, boost::uint32_t(decimation));
+        _poke(SR_INTEG_SHIFT, boost::uint32_t(shift < 0 ? bits : shift));
+        _poke(SR_INTEG_NUM_PULSES, boost::uint32_t(num_pulses));
+    }
+
+    boost::uint64_t get_integration_state(void)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        return _peek(RB_INTEG);
+    }
+
+    size_t get_live_bank(void)
+    {
+        return size_t(get_bank_state() & AWG_BANK_LIVE_MASK);
+    }
+
+    boost::uint32_t get_bank_state(void)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        return boost::uint32_t(_peek(RB_AWG_BANK));
+    }
+
+    void set_cache_enabled(const bool enable)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        _cache_enabled = enable;
+        if (not enable) {
+            refresh();
+        }
+    }
+
+    void set_readback_verify(const bool verify)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        _verify = verify;
+    }
+
+    void refresh(void)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        _sr_shadow.clear();
+        _rb_cache.clear();
+        _timed_rb.clear();
+    }
+
+    size_t get_num_uploads(void)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        return _num_uploads;
+    }
+
+    cache_stats_t get_cache_stats(void)
+    {
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        return _cache_stats;
+    }
+
+private:
+    struct shadow_reg_t {
+        shadow_reg_t(void): value(0), valid(false), written(false) {}
+        boost::uint64_t value;
+        /* The cache may skip writes of this value */
+        bool valid;
+        /* Set since the last refresh(), whether or not the cache is on */
+        bool written;
+    };
+
+    /* Settings write through the shadow cache */
+    void _poke(const boost::uint32_t reg, const boost::uint32_t data)
+    {
+        shadow_reg_t &shadow = _sr_shadow[reg];
+        if (_cache_enabled and shadow.valid and shadow.value == data) {
+            _cache_stats.writes_skipped++;
+            return;
+        }
+        _iface->sr_write(reg, data);
+        _cache_stats.sr_writes++;
+        shadow.value = data;
+        shadow.valid = _cache_enabled;
+        shadow.written = true;
+        _invalidate_readback(reg);
+    }
+
+    /* Settings write that always reaches the bus, e.g. a command strobe */
+    void _strobe(const boost::uint32_t reg, const boost::uint32_t data)
+    {
+        _iface->sr_write(reg, data);
+        _cache_stats.sr_writes++;
+    }
+
+    /* Record a value written around the cache */
+    void _note_write(const boost::uint32_t reg, const boost::uint32_t data)
+    {
+        shadow_reg_t &shadow = _sr_shadow[reg];
+        shadow.value = data;
+        shadow.valid = _cache_enabled;
+        shadow.written = true;
+    }
+
+    /* Last value written to a settings register with no readback */
+    bool _written(const boost::uint32_t reg, boost::uint32_t &data)
+    {
+        std::map<boost::uint32_t, shadow_reg_t>::const_iterator it = _sr_shadow.find(reg);
+        if (it == _sr_shadow.end() or not it->second.written) {
+            return false;
+        }
+        data = boost::uint32_t(it->second.value);
+        return true;
+    }
+
+    /* Append a write to _burst unless the register already holds the value */
+    void _queue_if_changed(const boost::uint32_t reg, const boost::uint32_t data)
+    {
+        const shadow_reg_t &shadow = _sr_shadow[reg];
+        if (_cache_enabled and shadow.valid and shadow.value == data) {
+            _cache_stats.writes_skipped++;
+            return;
+        }
+        _burst.push_back(wavegen_reg_iface::sr_op_t(reg, data));
+        _note_write(reg, data);
+    }
+
+    /* Readback through the cache; the status readbacks are never cached */
+    boost::uint64_t _peek(const boost::uint32_t addr)
+    {
+        shadow_reg_t &cached = _rb_cache[addr];
+        if (_cache_enabled and not _verify and cached.valid) {
+            _cache_stats.reads_avoided++;
+            return cached.value;
+        }
+        cached.value = _iface->user_reg_read64(addr);
+        cached.valid = _cache_enabled and _cacheable(addr);
+        _cache_stats.rb_reads++;
+        return cached.value;
+    }
+
+    /* Readbacks that can change without a settings write from us */
+    bool _cacheable(const boost::uint32_t addr)
+    {
+        if (_timed_rb.count(addr)) {
+            return false;
+        }
+        switch (addr) {
+        case RB_AWG_STATE:
+        case RB_AWG_BANK:
+        case RB_SEQ_INDEX:
+        case RB_INTEG:      return false;
+        /* Follows the live bank, and a timed swap lands whenever it lands */
+        case RB_AWG_LEN:    return not _banks_used and not _seq_enabled;
+        /* The sequencer rewrites it every entry */
+        case RB_ADC_LEN:    return not _seq_enabled;
+        default:            return true;
+        }
+    }
+
+    /* Drop the readback that reflects a settings register. A timed
+     * write lands later, so its readback stays uncached until refresh(). */
+    void _invalidate_readback(const boost::uint32_t reg, const bool timed = false)
+    {
+        switch (reg) {
+        case SR_AWG_CTRL_WORD_ADDR: _drop_readback(RB_AWG_CTRL, timed); break;
+        case SR_ADC_SAMPLE_ADDR:    _drop_readback(RB_ADC_LEN, timed); break;
+        case SR_PRF_INT_ADDR:
+        case SR_PRF_FRAC_ADDR:      _drop_readback(RB_AWG_PRF, timed); break;
+        case SR_RADAR_CTRL_POLICY:  _drop_readback(RB_AWG_POLICY, timed); break;
+        case SR_AWG_RELOAD_LAST:
+        case SR_AWG_BANK_SEL:       _drop_readback(RB_AWG_LEN, timed); break;
+        case SR_SEQ_CTRL:
+        case SR_SEQ_DATA:
+            _drop_readback(RB_AWG_LEN, timed);
+            _drop_readback(RB_ADC_LEN, timed);
+            break;
+        default: break;
+        }
+    }
+
+    void _drop_readback(const boost::uint32_t addr, const bool timed)
+    {
+        _rb_cache[addr].valid = false;
+        if (timed) {
+            _timed_rb.insert(addr);
+        }
+    }
+
+    void _check_bank(const size_t bank)
+    {
+        if (bank >= NUM_AWG_BANKS) {
+            throw uhd::value_error(str(
+                boost::format("wavegen_core: bank %d out of range, there are %d banks")
+                % bank % NUM_AWG_BANKS
+            ));
+        }
+    }
+
+    void _check_waveform(const std::vector<boost::uint32_t> &samples)
+    {
+        if (samples.empty()) {
+            throw uhd::value_error("wavegen_core: cannot upload an empty waveform");
+        }
+    }
+
+    size_t _max_stream_spp(void)
+    {
+        const size_t max_words = _iface->get_max_stream_words();
+        if (max_words <= _header_words) {
+            throw uhd::value_error("wavegen_core: stream path cannot carry an upload packet");
+        }
+        return max_words - _header_words;
+    }
+
+    /* Pick the header layout for this upload; throws rather than
+     * letting the length wrap in a 16 or 32-bit field. */
+    void _begin_upload(const size_t num_samps)
+    {
+        const bool fits_narrow = (num_samps <= 0xFFFF);
+        const bool fits_wide = (boost::uint64_t(num_samps) <= 0xFFFFFFFF);
+        if (not fits_wide) {
+            throw uhd::value_error(str(
+                boost::format("wavegen_core: waveform of %d samples exceeds the 32-bit upload length")
+                % num_samps
+            ));
+        }
+        if (_header_format == HEADER_FORMAT_NARROW and not fits_narrow) {
+            throw uhd::value_error(str(
+                boost::format("wavegen_core: waveform of %d samples needs the wide upload header")
+                % num_samps
+            ));
+        }
+        const bool wide = (_header_format == HEADER_FORMAT_WIDE) or not fits_narrow;
+
+        _wfrm_header.cmd = wide ? WAVEFORM_WRITE_WIDE_CMD : WAVEFORM_WRITE_CMD;
+        _wfrm_header.ind = 0;
+        _wfrm_header.len = boost::uint32_t(num_samps);
+        _header_words = wide ? WIDE_HEADER_WORDS : NARROW_HEADER_WORDS;
+    }
+
+    /* Send the waveform as segments of spp samples. The segment index
+     * never exceeds the length, so it cannot overflow its field. */
+    void _upload(const std::vector<boost::uint32_t> &samples, const size_t spp)
+    {
+        /* Counted up front: a failed upload still overwrites the AWG */
+        _num_uploads++;
+        for (size_t offset = 0; offset < samples.size(); offset += spp) {
+            _send_packet(&samples[offset], std::min(spp, samples.size() - offset));
+            _wfrm_header.ind ++;
+        }
+
+        /* Each waveform upload must have unique ID (wraps at 16 bits) */
+        _wfrm_header.id ++;
+        _invalidate_readback(SR_AWG_RELOAD_LAST);
+    }
+
+    /* Header word order matches the hardware:
+     *   narrow: {cmd, id} {ind, len}
+     *   wide:   {cmd, id} {len} {ind}
+     */
+    boost::uint32_t _header_word(const size_t i) const
+    {
+        if (i == 0) {
+            return (boost::uint32_t(_wfrm_header.cmd) << 16) | _wfrm_header.id;
+        }
+        if (_header_words == NARROW_HEADER_WORDS) {
+            return (_wfrm_header.ind << 16) | (_wfrm_header.len & 0xFFFF);
+        }
+        return (i == 1) ? _wfrm_header.len : _wfrm_header.ind;
+    }
+
+    void _send_packet(const boost::uint32_t *samps, const size_t nsamps)
+    {
+        const size_t nwords = _header_words + nsamps;
+        switch (_upload_mode) {
+        case UPLOAD_MODE_SR:
+            for (size_t i = 0; i < _header_words; i++) {
+                _iface->sr_write(SR_AWG_RELOAD, _header_word(i));
+            }
+            for (size_t i = 0; i < nsamps - 1; i++) {
+                _iface->sr_write(SR_AWG_RELOAD, samps[i]);
+            }
+            _iface->sr_write(SR_AWG_RELOAD_LAST, samps[nsamps - 1]);
+            break;
+
+        case UPLOAD_MODE_BURST:
+            _burst.resize(nwords);
+            for (size_t i = 0; i < _header_words; i++) {
+                _burst[i] = wavegen_reg_iface::sr_op_t(SR_AWG_RELOAD, _header_word(i));
+            }
+            for (size_t i = 0; i < nsamps; i++) {
+                _burst[_header_words + i] = wavegen_reg_iface::sr_op_t(SR_AWG_RELOAD, samps[i]);
+            }
+            _burst.back().reg = SR_AWG_RELOAD_LAST;
+            _iface->sr_write_burst(_burst);
+            break;
+
+        case UPLOAD_MODE_STREAM:
+            /* The streamer converts sc16, so hand it items, not words */
+            _packet.resize(nwords);
+            for (size_t i = 0; i < _header_words; i++) {
+                _packet[i] = wavegen_reg_iface::pack_sc16(_header_word(i));
+            }
+            for (size_t i = 0; i < nsamps; i++) {
+                _packet[_header_words + i] = wavegen_reg_iface::pack_sc16(samps[i]);
+            }
+            _iface->stream_write(&_packet.front(), nwords);
+            break;
+        }
+    }
+
+    wavegen_reg_iface::sptr _iface;
+    /* Serialises bus access between the caller and the pulse scheduler */
+    boost::recursive_mutex _mutex;
+    upload_mode_t _upload_mode;
+    header_format_t _header_format;
+    size_t _header_words;
+
+    /* Shadow copies of the settings and readback registers */
+    bool _cache_enabled;
+    bool _verify;
+    std::map<boost::uint32_t, shadow_reg_t> _sr_shadow;
+    std::map<boost::uint32_t, shadow_reg_t> _rb_cache;
+    /* Readbacks a timed commit may still change */
+    std::set<boost::uint32_t> _timed_rb;
+    cache_stats_t _cache_stats;
+    /* Reused between packets so large uploads do not reallocate */
+    wavegen_reg_iface::sr_burst_t _burst;
+    std::vector<boost::uint32_t> _packet;
+    wavegen_reg_iface::sr_burst_t _commit_ops;
+    size_t _num_uploads;
+    size_t _seq_len;
+    bool _seq_enabled;
+    bool _banks_used;
+
+    struct waveform_header {
+        boost::uint32_t len;
+        boost::uint32_t ind;
+        boost::uint16_t id;
+        boost::uint16_t cmd;
+    } _wfrm_header;
+};
+
+wavegen_core::sptr wavegen_core::make(wavegen_reg_iface::sptr iface)
+{
+    return sptr(new wavegen_core_impl(iface));
+}
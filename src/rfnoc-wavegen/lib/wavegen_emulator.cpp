@@ -0,0 +1,671 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include <wavegen/wavegen_emulator.hpp>
+#include <wavegen/waveform_synth.h>
+#include <uhd/exception.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/format.hpp>
+#include <deque>
+#include <map>
+
+using namespace uhd;
+using namespace uhd::rfnoc;
+
+const size_t wavegen_emulator::CMD_FIFO_DEPTH;
+const size_t wavegen_emulator::DEFAULT_MAX_STREAM_WORDS;
+const size_t wavegen_emulator::DEFAULT_MAX_PULSES;
+
+class wavegen_emulator_impl : public wavegen_emulator
+{
+public:
+    wavegen_emulator_impl(const double tick_rate, const size_t max_stream_words):
+        _tick_rate(tick_rate),
+        _max_stream_words(max_stream_words),
+        _keep_samples(false),
+        _max_pulses(DEFAULT_MAX_PULSES)
+    {
+        if (not (tick_rate > 0.0)) {
+            throw uhd::value_error("wavegen_emulator: tick rate must be positive");
+        }
+        _reset();
+    }
+
+    /***********************************************************************
+     * Register backend
+     **********************************************************************/
+    void sr_write(const boost::uint32_t reg, const boost::uint32_t data)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _write(reg, data);
+    }
+
+    void sr_write_burst(const sr_burst_t &ops)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        for (size_t i = 0; i < ops.size(); i++) {
+            _write(ops[i].reg, ops[i].data);
+        }
+    }
+
+    void set_command_time(const uhd::time_spec_t &time)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        const long long ticks = time.to_ticks(_tick_rate);
+        _cmd_time_ticks = (ticks > 0) ? boost::uint64_t(ticks) : 0;
+        _timed = true;
+    }
+
+    void clear_command_time(void)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _timed = false;
+    }
+
+    boost::uint64_t user_reg_read64(const boost::uint32_t addr)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _read(addr);
+    }
+
+    /* All registers are sampled at the same instant */
+    void user_reg_read64_burst(const std::vector<boost::uint32_t> &addrs, std::vector<boost::uint64_t> &values)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        values.resize(addrs.size());
+        for (size_t i = 0; i < addrs.size(); i++) {
+            values[i] = _read(addrs[i]);
+        }
+    }
+
+    bool has_stream(void)
+    {
+        return _max_stream_words > 0;
+    }
+
+    size_t get_max_stream_words(void)
+    {
+        return _max_stream_words;
+    }
+
+    void stream_write(const boost::uint32_t *data, const size_t nwords)
+    {
+        if (not has_stream()) {
+            wavegen_reg_iface::stream_write(data, nwords);
+        }
+        if (nwords > _max_stream_words) {
+            throw uhd::value_error(str(
+                boost::format("wavegen_emulator: stream packet of %d words exceeds %d")
+                % nwords % _max_stream_words
+            ));
+        }
+        boost::mutex::scoped_lock lock(_mutex);
+        _stats.stream_packets++;
+        /* Undo the host's sc16 conversion, as the sink port sees it */
+        _packet.resize(nwords);
+        for (size_t i = 0; i < nwords; i++) {
+            _packet[i] = unpack_sc16(data[i]);
+        }
+        _handle_packet();
+        _run(_now);
+    }
+
+    /***********************************************************************
+     * Emulator control
+     **********************************************************************/
+    void reset(void)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _reset();
+    }
+
+    boost::uint64_t get_time_ticks(void)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _now;
+    }
+
+    void run_until(const boost::uint64_t ticks)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _run(ticks);
+    }
+
+    void run_for(const boost::uint64_t ticks)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _run(_now + ticks);
+    }
+
+    void set_keep_samples(const bool keep)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _keep_samples = keep;
+    }
+
+    void set_max_pulses(const size_t max_pulses)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _max_pulses = max_pulses;
+        while (_pulses.size() > _max_pulses) {
+            _pulses.pop_front();
+            _stats.pulses_dropped++;
+        }
+    }
+
+    bool recv_pulse(pulse_t &pulse)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        if (_pulses.empty()) {
+            return false;
+        }
+        pulse.ticks = _pulses.front().ticks;
+        pulse.cmd_word = _pulses.front().cmd_word;
+        pulse.ctrl_word = _pulses.front().ctrl_word;
+        pulse.bank = _pulses.front().bank;
+        pulse.seq_index = _pulses.front().seq_index;
+        pulse.rx_len = _pulses.front().rx_len;
+        pulse.samples.swap(_pulses.front().samples);
+        _pulses.pop_front();
+        return true;
+    }
+
+    size_t get_num_pulses_queued(void)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _pulses.size();
+    }
+
+    std::vector<boost::uint32_t> get_bank(const size_t bank)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        if (bank >= wavegen_core::NUM_AWG_BANKS) {
+            throw uhd::value_error(str(
+                boost::format("wavegen_emulator: bank %d out of range") % bank
+            ));
+        }
+        return _banks[bank];
+    }
+
+    boost::uint32_t get_sr(const boost::uint32_t reg)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _sr[reg & 0xFF];
+    }
+
+    stats_t get_stats(void)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _stats;
+    }
+
+private:
+    static const boost::uint64_t NEVER = ~boost::uint64_t(0);
+    static const size_t NUM_SR = 256;
+
+    struct command_t {
+        command_t(boost::uint32_t cmd_word_, boost::uint64_t ticks_):
+            cmd_word(cmd_word_), ticks(ticks_) {}
+        boost::uint32_t cmd_word;
+        boost::uint64_t ticks;
+    };
+
+    /* Waveform being reassembled from upload packets */
+    struct upload_t {
+        bool active;
+        boost::uint16_t id;
+        boost::uint32_t len;
+        boost::uint32_t next_ind;
+        size_t bank;
+        std::vector<boost::uint32_t> data;
+    };
+
+    void _reset(void)
+    {
+        _sr.assign(NUM_SR, 0);
+        _now = 0;
+        _timed = false;
+        _cmd_time_ticks = 0;
+        _timed_writes.clear();
+        _cmds.clear();
+        _auto_armed = false;
+        _auto_next = 0;
+        _auto_cmd = 0;
+        _busy_until = 0;
+        _pulse_count = 0;
+        _late = false;
+        _underrun = false;
+        for (size_t i = 0; i < wavegen_core::NUM_AWG_BANKS; i++) {
+            _banks[i].clear();
+        }
+        _live = 0;
+        _swap_pending = false;
+        _swap_to = 0;
+        _packet.clear();
+        _upload.active = false;
+        _upload.data.clear();
+        _seq_table.assign(wavegen_core::SEQ_MAX_ENTRIES * wavegen_core::SEQ_WORDS_PER_ENTRY, 0);
+        _seq_addr = 0;
+        _seq_cur = 0;
+        _seq_next = 0;
+        _chirp_key.clear();
+        _chirp.clear();
+        _pulses.clear();
+        _stats = stats_t();
+    }
+
+    /* A settings write as it arrives on the bus */
+    void _write(const boost::uint32_t reg, const boost::uint32_t data)
+    {
+        _stats.sr_writes++;
+        if (_timed and _cmd_time_ticks > _now) {
+            _stats.timed_writes++;
+            _timed_writes.insert(std::make_pair(_cmd_time_ticks, sr_op_t(reg, data)));
+            return;
+        }
+        _apply(reg, data);
+        /* A command may be due now, e.g. a pulse with CMD_TIME_NOW */
+        _run(_now);
+    }
+
+    void _apply(const boost::uint32_t reg, const boost::uint32_t data)
+    {
+        const bool seq_was_enabled = _seq_enabled();
+        _sr[reg & 0xFF] = data;
+
+        switch (reg) {
+        case wavegen_core::SR_AWG_RELOAD:
+            _packet.push_back(data);
+            break;
+
+        case wavegen_core::SR_AWG_RELOAD_LAST:
+            _packet.push_back(data);
+            _handle_packet();
+            _packet.clear();
+            break;
+
+        case wavegen_core::SR_RADAR_CTRL_TIME_LO:
+            _latch_command(data);
+            break;
+
+        case wavegen_core::SR_RADAR_CTRL_CLEAR_CMDS:
+            _cmds.clear();
+            _auto_armed = false;
+            _late = false;
+            _underrun = false;
+            break;
+
+        case wavegen_core::SR_AWG_BANK_SEL:
+            _swap_to = data & wavegen_core::AWG_BANK_LIVE_MASK;
+            _swap_pending = true;
+            break;
+
+        case wavegen_core::SR_SEQ_ADDR:
+            _seq_addr = data;
+            break;
+
+        case wavegen_core::SR_SEQ_DATA:
+            if (_seq_addr < _seq_table.size()) {
+                _seq_table[_seq_addr] = data;
+            }
+            _seq_addr++;
+            break;
+
+        case wavegen_core::SR_SEQ_CTRL:
+            if (_seq_enabled() and not seq_was_enabled) {
+                _seq_cur = 0;
+                _seq_next = 0;
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    void _latch_command(const boost::uint32_t time_lo)
+    {
+        _stats.commands++;
+        const boost::uint32_t time_hi = _sr[wavegen_core::SR_RADAR_CTRL_TIME_HI];
+        boost::uint64_t ticks = (time_hi & wavegen_core::CMD_TIME_NOW) ? _now
+            : ((boost::uint64_t(time_hi) << 32) | time_lo);
+        if (ticks < _now) {
+            _stats.late_commands++;
+            _late = true;
+            ticks = _now;
+        }
+        if (_cmds.size() >= CMD_FIFO_DEPTH) {
+            _stats.commands_dropped++;
+            return;
+        }
+        _cmds.push_back(command_t(_sr[wavegen_core::SR_RADAR_CTRL_COMMAND], ticks));
+    }
+
+    /*
+     * Upload packet, header first:
+     *   narrow: {cmd, id} {ind, len}
+     *   wide:   {cmd, id} {len} {ind}
+     * Segments of one upload share the id and arrive in index order.
+     */
+    void _handle_packet(void)
+    {
+        if (_packet.size() < 2) {
+            _framing_error();
+            return;
+        }
+        const boost::uint16_t cmd = boost::uint16_t(_packet[0] >> 16);
+        const boost::uint16_t id = boost::uint16_t(_packet[0] & 0xFFFF);
+        size_t header_words;
+        boost::uint32_t len, ind;
+        if (cmd == wavegen_core::WAVEFORM_WRITE_CMD) {
+            header_words = 2;
+            ind = _packet[1] >> 16;
+            len = _packet[1] & 0xFFFF;
+        } else if (cmd == wavegen_core::WAVEFORM_WRITE_WIDE_CMD and _packet.size() >= 3) {
+            header_words = 3;
+            len = _packet[1];
+            ind = _packet[2];
+        } else {
+            _framing_error();
+            return;
+        }
+
+        if (ind == 0) {
+            _upload.active = true;
+            _upload.id = id;
+            _upload.len = len;
+            _upload.next_ind = 0;
+            _upload.bank = _sr[wavegen_core::SR_AWG_LOAD_BANK] & wavegen_core::AWG_BANK_LIVE_MASK;
+            _upload.data.clear();
+            _upload.data.reserve(len);
+        }
+        const size_t nsamps = _packet.size() - header_words;
+        if (not _upload.active or id != _upload.id or ind != _upload.next_ind
+            or len != _upload.len or _upload.data.size() + nsamps > len) {
+            _framing_error();
+            return;
+        }
+        _upload.data.insert(_upload.data.end(), _packet.begin() + header_words, _packet.end());
+        _upload.next_ind++;
+
+        if (_upload.data.size() == len) {
+            _banks[_upload.bank].swap(_upload.data);
+            _upload.data.clear();
+            _upload.active = false;
+            _stats.uploads++;
+        }
+    }
+
+    void _framing_error(void)
+    {
+        _stats.framing_errors++;
+        _upload.active = false;
+    }
+
+    /* Play everything due up to ticks, in time order */
+    void _run(const boost::uint64_t ticks)
+    {
+        for (;;) {
+            boost::uint64_t next = NEVER;
+            if (not _timed_writes.empty()) {
+                next = _timed_writes.begin()->first;
+            }
+            if (_swap_pending) {
+                next = std::min(next, std::max(_busy_until, _now));
+            }
+            next = std::min(next, _next_pulse_time());
+            if (next == NEVER or next > ticks) {
+                break;
+            }
+            _now = std::max(_now, next);
+
+            /* At one instant: timed writes, then a swap, then a pulse */
+            if (not _timed_writes.empty() and _timed_writes.begin()->first <= _now) {
+                const sr_op_t op = _timed_writes.begin()->second;
+                _timed_writes.erase(_timed_writes.begin());
+                _apply(op.reg, op.data);
+                continue;
+            }
+            if (_swap_pending and _now >= _busy_until) {
+                _live = _swap_to;
+                _swap_pending = false;
+                continue;
+            }
+            _fire_pulse();
+        }
+        _now = std::max(_now, ticks);
+    }
+
+    boost::uint64_t _next_pulse_time(void) const
+    {
+        boost::uint64_t t = NEVER;
+        if (not _cmds.empty()) {
+            t = _cmds.front().ticks;
+        }
+        if (_auto_armed and _sr[wavegen_core::SR_RADAR_CTRL_POLICY] == wavegen_core::RADAR_POLICY_AUTO) {
+            t = std::min(t, _auto_next);
+        }
+        /* A pulse never starts before the previous one is done */
+        return (t == NEVER) ? NEVER : std::max(t, _busy_until);
+    }
+
+    void _fire_pulse(void)
+    {
+        boost::uint32_t cmd_word = _auto_cmd;
+        if (not _cmds.empty() and _cmds.front().ticks <= _now) {
+            cmd_word = _cmds.front().cmd_word;
+            _cmds.pop_front();
+            if (cmd_word & wavegen_core::CMD_STOP) {
+                _auto_armed = false;
+                return;
+            }
+        }
+
+        boost::uint32_t ctrl_word = _sr[wavegen_core::SR_AWG_CTRL_WORD_ADDR];
+        boost::uint32_t tuning_coef = _sr[wavegen_core::SR_CH_TUNING_COEF_ADDR];
+        boost::uint32_t freq_offset = _sr[wavegen_core::SR_CH_FREQ_OFFSET_ADDR];
+        boost::uint32_t adc_samples = _sr[wavegen_core::SR_ADC_SAMPLE_ADDR];
+        size_t bank = _live;
+        size_t seq_index = 0;
+        if (_seq_enabled()) {
+            const size_t num_entries = std::min<size_t>(
+                (_sr[wavegen_core::SR_SEQ_CTRL] & ~wavegen_core::SEQ_CTRL_ENABLE) + 1,
+                wavegen_core::SEQ_MAX_ENTRIES);
+            seq_index = _seq_next % num_entries;
+            const boost::uint32_t *entry = &_seq_table[seq_index * wavegen_core::SEQ_WORDS_PER_ENTRY];
+            bank = entry[0] & wavegen_core::AWG_BANK_LIVE_MASK;
+            ctrl_word = entry[1];
+            tuning_coef = entry[2];
+            freq_offset = entry[3];
+            adc_samples = entry[4];
+            _seq_cur = seq_index;
+            _seq_next = (seq_index + 1) % num_entries;
+        }
+
+        /* Source select is ctrl_word[9:8], 3 for the AWG */
+        const bool awg = ((ctrl_word >> 8) & 0x3) == 0x3;
+        if (awg and _banks[bank].empty()) {
+            _underrun = true;
+        }
+        const boost::uint64_t tx_len = awg ? _banks[bank].size()
+            : boost::uint64_t(_sr[wavegen_core::SR_CH_COUNTER_ADDR]) + 1;
+        const boost::uint64_t rx_len = boost::uint64_t(adc_samples) + 1 + (awg ? tx_len : 0);
+
+        pulse_t pulse;
+        pulse.ticks = _now;
+        pulse.cmd_word = cmd_word;
+        pulse.ctrl_word = ctrl_word;
+        pulse.bank = bank;
+        pulse.seq_index = seq_index;
+        pulse.rx_len = boost::uint32_t(rx_len);
+        if (_keep_samples) {
+            pulse.samples = awg ? _banks[bank]
+                : _chirp_samples(boost::uint32_t(tx_len), tuning_coef, freq_offset);
+        }
+
+        _busy_until = _now + std::max(tx_len, rx_len);
+        _pulse_count++;
+        _stats.pulses++;
+
+        const boost::uint64_t prf = _prf_count();
+        _auto_armed = (_sr[wavegen_core::SR_RADAR_CTRL_POLICY] == wavegen_core::RADAR_POLICY_AUTO)
+            and (prf > 0);
+        _auto_next = _now + prf;
+        _auto_cmd = cmd_word;
+
+        if (_pulses.size() >= _max_pulses) {
+            _stats.pulses_dropped++;
+            if (_pulses.empty()) {
+                return;
+            }
+            _pulses.pop_front();
+        }
+        _pulses.push_back(pulse);
+    }
+
+    /* Chirp output, cached since consecutive pulses usually repeat it */
+    const std::vector<boost::uint32_t> &_chirp_samples(
+        const boost::uint32_t len,
+        const boost::uint32_t tuning_coef,
+        const boost::uint32_t freq_offset
+    ) {
+        std::vector<boost::uint32_t> key(3);
+        key[0] = len;
+        key[1] = tuning_coef;
+        key[2] = freq_offset;
+        if (key != _chirp_key) {
+            _chirp = gr::wavegen::waveform_synth::hw_chirp(len, tuning_coef, freq_offset);
+            _chirp_key = key;
+        }
+        return _chirp;
+    }
+
+    bool _seq_enabled(void) const
+    {
+        return (_sr[wavegen_core::SR_SEQ_CTRL] & wavegen_core::SEQ_CTRL_ENABLE) != 0;
+    }
+
+    boost::uint64_t _prf_count(void) const
+    {
+        return (boost::uint64_t(_sr[wavegen_core::SR_PRF_INT_ADDR]) << 32)
+            | _sr[wavegen_core::SR_PRF_FRAC_ADDR];
+    }
+
+    boost::uint64_t _read(const boost::uint32_t addr)
+    {
+        _stats.readbacks++;
+        switch (addr) {
+        case wavegen_core::RB_AWG_LEN:    return _banks[_live].size();
+        case wavegen_core::RB_ADC_LEN:    return boost::uint64_t(_sr[wavegen_core::SR_ADC_SAMPLE_ADDR]) + 1;
+        case wavegen_core::RB_AWG_CTRL:   return _sr[wavegen_core::SR_AWG_CTRL_WORD_ADDR];
+        case wavegen_core::RB_AWG_PRF:    return _prf_count();
+        case wavegen_core::RB_AWG_POLICY: return _sr[wavegen_core::SR_RADAR_CTRL_POLICY];
+        case wavegen_core::RB_AWG_STATE:  return _state_word();
+        case wavegen_core::RB_AWG_BANK:
+            return ((_sr[wavegen_core::SR_AWG_LOAD_BANK] & 1) ? wavegen_core::AWG_BANK_LOAD_MASK : 0)
+                | (_swap_pending ? wavegen_core::AWG_BANK_SWAP_PENDING : 0)
+                | _live;
+        case wavegen_core::RB_SEQ_INDEX:  return _seq_cur;
+        default:                          return 0;
+        }
+    }
+
+    boost::uint64_t _state_word(void) const
+    {
+        boost::uint64_t state = wavegen_core::AWG_STATE_IDLE;
+        if (_now < _busy_until) {
+            state = wavegen_core::AWG_STATE_PULSE;
+        } else if (_next_pulse_time() != NEVER) {
+            state = wavegen_core::AWG_STATE_WAIT;
+        }
+        if (not _banks[_live].empty()) {
+            state |= wavegen_core::AWG_STATE_LOADED;
+        }
+        if (_seq_enabled()) {
+            state |= wavegen_core::AWG_STATE_SEQ_ENABLED;
+        }
+        if (_late) {
+            state |= wavegen_core::AWG_STATE_LATE;
+        }
+        if (_underrun) {
+            state |= wavegen_core::AWG_STATE_UNDERRUN;
+        }
+        state |= boost::uint64_t(std::min<size_t>(_cmds.size(), 0xFFFF)) << wavegen_core::AWG_STATE_QUEUE_SHIFT;
+        state |= boost::uint64_t(boost::uint32_t(_pulse_count)) << wavegen_core::AWG_STATE_COUNT_SHIFT;
+        return state;
+    }
+
+    const double _tick_rate;
+    const size_t _max_stream_words;
+    boost::mutex _mutex;
+
+    std::vector<boost::uint32_t> _sr;
+    boost::uint64_t _now;
+
+    /* Timed settings writes, applied in order at their tick */
+    bool _timed;
+    boost::uint64_t _cmd_time_ticks;
+    std::multimap<boost::uint64_t, sr_op_t> _timed_writes;
+
+    /* Radar controller */
+    std::deque<command_t> _cmds;
+    bool _auto_armed;
+    boost::uint64_t _auto_next;
+    boost::uint32_t _auto_cmd;
+    boost::uint64_t _busy_until;
+    boost::uint64_t _pulse_count;
+    /* Sticky status flags, cleared with the command queue */
+    bool _late;
+    bool _underrun;
+
+    /* AWG */
+    std::vector<boost::uint32_t> _banks[wavegen_core::NUM_AWG_BANKS];
+    size_t _live;
+    bool _swap_pending;
+    size_t _swap_to;
+    std::vector<boost::uint32_t> _packet;
+    upload_t _upload;
+
+    /* Sequencer */
+    std::vector<boost::uint32_t> _seq_table;
+    boost::uint32_t _seq_addr;
+    size_t _seq_cur;
+    size_t _seq_next;
+
+    std::vector<boost::uint32_t> _chirp_key;
+    std::vector<boost::uint32_t> _chirp;
+
+    bool _keep_samples;
+    size_t _max_pulses;
+    std::deque<pulse_t> _pulses;
+    stats_t _stats;
+};
+
+const boost::uint64_t wavegen_emulator_impl::NEVER;
+const size_t wavegen_emulator_impl::NUM_SR;
+
+wavegen_emulator::sptr wavegen_emulator::make(
+    const double tick_rate,
+    const size_t max_stream_words
+) {
+    return sptr(new wavegen_emulator_impl(tick_rate, max_stream_words));
+}
@@ -0,0 +1,203 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include <wavegen/wavegen_metrics.hpp>
+#include <uhd/exception.hpp>
+#include <boost/atomic.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/format.hpp>
+
+using namespace uhd;
+using namespace uhd::rfnoc;
+
+typedef boost::atomic<boost::uint64_t> counter_t;
+
+static void count(counter_t &c, const boost::uint64_t n = 1)
+{
+    c.fetch_add(n, boost::memory_order_relaxed);
+}
+
+static boost::uint64_t read(const counter_t &c)
+{
+    return c.load(boost::memory_order_relaxed);
+}
+
+class wavegen_metrics_impl;
+
+/* Counts the traffic of the backend it wraps */
+class wavegen_counting_reg_iface : public wavegen_reg_iface
+{
+public:
+    wavegen_counting_reg_iface(
+        wavegen_reg_iface::sptr backend,
+        boost::shared_ptr<wavegen_metrics_impl> metrics
+    ):
+        _backend(backend),
+        _metrics(metrics)
+    {
+    }
+
+    void sr_write(const boost::uint32_t reg, const boost::uint32_t data);
+    void sr_write_burst(const sr_burst_t &ops);
+    boost::uint64_t user_reg_read64(const boost::uint32_t addr);
+    void user_reg_read64_burst(const std::vector<boost::uint32_t> &addrs, std::vector<boost::uint64_t> &values);
+    void stream_write(const boost::uint32_t *data, const size_t nwords);
+
+    void set_command_time(const uhd::time_spec_t &time)
+    {
+        _backend->set_command_time(time);
+    }
+
+    void clear_command_time(void)
+    {
+        _backend->clear_command_time();
+    }
+
+    bool has_stream(void)
+    {
+        return _backend->has_stream();
+    }
+
+    size_t get_max_stream_words(void)
+    {
+        return _backend->get_max_stream_words();
+    }
+
+private:
+    wavegen_reg_iface::sptr _backend;
+    boost::shared_ptr<wavegen_metrics_impl> _metrics;
+};
+
+class wavegen_metrics_impl : public wavegen_metrics,
+    public boost::enable_shared_from_this<wavegen_metrics_impl>
+{
+public:
+    wavegen_metrics_impl(const std::vector<std::string> &method_names):
+        _names(method_names),
+        _calls(new counter_t[method_names.size()]),
+        _total_ns(new counter_t[method_names.size()])
+    {
+        reset();
+    }
+
+    void record_call(const size_t method, const boost::uint64_t ns)
+    {
+        if (method >= _names.size()) {
+            throw uhd::index_error(str(
+                boost::format("wavegen_metrics: no method slot %d") % method
+            ));
+        }
+        count(_calls[method]);
+        count(_total_ns[method], ns);
+    }
+
+    wavegen_reg_iface::sptr wrap(wavegen_reg_iface::sptr backend)
+    {
+        return wavegen_reg_iface::sptr(new wavegen_counting_reg_iface(backend, shared_from_this()));
+    }
+
+    snapshot_t snapshot(void)
+    {
+        snapshot_t snap;
+        snap.methods.resize(_names.size());
+        for (size_t i = 0; i < _names.size(); i++) {
+            snap.methods[i].name = _names[i];
+            snap.methods[i].calls = read(_calls[i]);
+            snap.methods[i].total_ns = read(_total_ns[i]);
+        }
+        snap.sr_writes = read(sr_writes);
+        snap.sr_bursts = read(sr_bursts);
+        snap.rb_reads = read(rb_reads);
+        snap.rb_bursts = read(rb_bursts);
+        snap.stream_packets = read(stream_packets);
+        snap.stream_words = read(stream_words);
+        return snap;
+    }
+
+    void reset(void)
+    {
+        for (size_t i = 0; i < _names.size(); i++) {
+            _calls[i].store(0, boost::memory_order_relaxed);
+            _total_ns[i].store(0, boost::memory_order_relaxed);
+        }
+        sr_writes.store(0, boost::memory_order_relaxed);
+        sr_bursts.store(0, boost::memory_order_relaxed);
+        rb_reads.store(0, boost::memory_order_relaxed);
+        rb_bursts.store(0, boost::memory_order_relaxed);
+        stream_packets.store(0, boost::memory_order_relaxed);
+        stream_words.store(0, boost::memory_order_relaxed);
+    }
+
+    /* Bus counters, bumped by wavegen_counting_reg_iface */
+    counter_t sr_writes;
+    counter_t sr_bursts;
+    counter_t rb_reads;
+    counter_t rb_bursts;
+    counter_t stream_packets;
+    counter_t stream_words;
+
+private:
+    const std::vector<std::string> _names;
+    boost::scoped_array<counter_t> _calls;
+    boost::scoped_array<counter_t> _total_ns;
+};
+
+void wavegen_counting_reg_iface::sr_write(const boost::uint32_t reg, const boost::uint32_t data)
+{
+    count(_metrics->sr_writes);
+    _backend->sr_write(reg, data);
+}
+
+void wavegen_counting_reg_iface::sr_write_burst(const sr_burst_t &ops)
+{
+    count(_metrics->sr_bursts);
+    count(_metrics->sr_writes, ops.size());
+    _backend->sr_write_burst(ops);
+}
+
+boost::uint64_t wavegen_counting_reg_iface::user_reg_read64(const boost::uint32_t addr)
+{
+    count(_metrics->rb_reads);
+    return _backend->user_reg_read64(addr);
+}
+
+void wavegen_counting_reg_iface::user_reg_read64_burst(
+    const std::vector<boost::uint32_t> &addrs,
+    std::vector<boost::uint64_t> &values
+) {
+    count(_metrics->rb_bursts);
+    count(_metrics->rb_reads, addrs.size());
+    _backend->user_reg_read64_burst(addrs, values);
+}
+
+void wavegen_counting_reg_iface::stream_write(const boost::uint32_t *data, const size_t nwords)
+{
+    count(_metrics->stream_packets);
+    count(_metrics->stream_words, nwords);
+    _backend->stream_write(data, nwords);
+}
+
+wavegen_metrics::sptr wavegen_metrics::make(const std::vector<std::string> &method_names)
+{
+    return sptr(new wavegen_metrics_impl(method_names));
+}
@@ -0,0 +1,162 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_WAVEGEN_WAVEGEN_MOCK_REG_IFACE_H
+#define INCLUDED_WAVEGEN_WAVEGEN_MOCK_REG_IFACE_H
+
+#include <wavegen/wavegen_reg_iface.hpp>
+#include <map>
+
+namespace uhd {
+  namespace rfnoc {
+
+    /*!
+     * Register backend for tests and benchmarks. Records every write,
+     * serves readbacks from a table and counts bus transactions (one
+     * per sr_write, sr_write_burst, readback or stream packet). With
+     * burst_per_op set, a burst costs one transaction per op instead,
+     * as it does on the block's settings bus.
+     */
+    class wavegen_mock_reg_iface : public wavegen_reg_iface
+    {
+    public:
+      typedef boost::shared_ptr<wavegen_mock_reg_iface> sptr;
+
+      wavegen_mock_reg_iface(size_t max_stream_words = 0):
+        record(true),
+        burst_per_op(false),
+        num_transactions(0),
+        num_sr_writes(0),
+        num_reads(0),
+        num_timed_writes(0),
+        timed(false),
+        _max_stream_words(max_stream_words)
+      {
+      }
+
+      void sr_write(const boost::uint32_t reg, const boost::uint32_t data)
+      {
+        num_transactions++;
+        _write(reg, data);
+      }
+
+      void sr_write_burst(const sr_burst_t &ops)
+      {
+        num_transactions += burst_per_op ? ops.size() : 1;
+        for (size_t i = 0; i < ops.size(); i++) {
+          _write(ops[i].reg, ops[i].data);
+        }
+      }
+
+      void set_command_time(const uhd::time_spec_t &time)
+      {
+        timed = true;
+        command_time = time;
+      }
+
+      void clear_command_time(void)
+      {
+        timed = false;
+      }
+
+      boost::uint64_t user_reg_read64(const boost::uint32_t addr)
+      {
+        num_transactions++;
+        num_reads++;
+        return rb[addr];
+      }
+
+      void user_reg_read64_burst(const std::vector<boost::uint32_t> &addrs, std::vector<boost::uint64_t> &values)
+      {
+        num_transactions++;
+        num_reads += addrs.size();
+        values.resize(addrs.size());
+        for (size_t i = 0; i < addrs.size(); i++) {
+          values[i] = rb[addrs[i]];
+        }
+      }
+
+      bool has_stream(void)
+      {
+        return _max_stream_words > 0;
+      }
+
+      size_t get_max_stream_words(void)
+      {
+        return _max_stream_words;
+      }
+
+      void stream_write(const boost::uint32_t *data, const size_t nwords)
+      {
+        num_transactions++;
+        if (record) {
+          packets.push_back(std::vector<boost::uint32_t>(nwords));
+          for (size_t i = 0; i < nwords; i++) {
+            packets.back()[i] = unpack_sc16(data[i]);
+          }
+        }
+      }
+
+      void reset_counters(void)
+      {
+        num_transactions = num_sr_writes = num_reads = num_timed_writes = 0;
+        writes.clear();
+        packets.clear();
+      }
+
+      //! Keep a copy of every write and stream packet
+      bool record;
+      //! Charge each op of a burst as its own transaction
+      bool burst_per_op;
+      size_t num_transactions;
+      size_t num_sr_writes;
+      size_t num_reads;
+      //! Writes issued while a command time was set
+      size_t num_timed_writes;
+      bool timed;
+      uhd::time_spec_t command_time;
+      //! Last value written to each settings register
+      std::map<boost::uint32_t, boost::uint32_t> sr;
+      //! Values returned by user_reg_read64()
+      std::map<boost::uint32_t, boost::uint64_t> rb;
+      sr_burst_t writes;
+      //! Stream packets as the block's sink port receives them
+      std::vector<std::vector<boost::uint32_t> > packets;
+
+    private:
+      void _write(const boost::uint32_t reg, const boost::uint32_t data)
+      {
+        num_sr_writes++;
+        if (timed) {
+          num_timed_writes++;
+        }
+        sr[reg] = data;
+        if (record) {
+          writes.push_back(sr_op_t(reg, data));
+        }
+      }
+
+      size_t _max_stream_words;
+    };
+
+  } /* namespace rfnoc */
+} /* namespace uhd */
+
+#endif /* INCLUDED_WAVEGEN_WAVEGEN_MOCK_REG_IFACE_H */
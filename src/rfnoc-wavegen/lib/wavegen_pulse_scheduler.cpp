@@ -0,0 +1,290 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <wavegen/wavegen_pulse_scheduler.hpp>
+#include <uhd/exception.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/bind.hpp>
+#include <boost/format.hpp>
+#include <algorithm>
+#include <deque>
+#include <string>
+
+using namespace uhd;
+using namespace uhd::rfnoc;
+
+
+const size_t wavegen_pulse_scheduler::DEFAULT_QUEUE_DEPTH;
+
+class wavegen_pulse_scheduler_impl : public wavegen_pulse_scheduler
+{
+public:
+    /* Bounds on how long the refill thread sleeps between checks */
+    static const long MIN_SLEEP_US = 50;
+    static const long MAX_SLEEP_US = 100000;
+
+    wavegen_pulse_scheduler_impl(
+        wavegen_core::sptr core,
+        tick_source_t tick_source,
+        const double tick_rate,
+        const size_t queue_depth,
+        gr::wavegen::thread_profile::sptr threads
+    ):
+        _core(core),
+        _tick_source(tick_source),
+        _tick_rate(tick_rate),
+        _queue_depth(queue_depth),
+        _low_water(queue_depth / 2),
+        _threads(threads),
+        _stop(false)
+    {
+        if (not _tick_source) {
+            throw uhd::value_error("wavegen_pulse_scheduler: no tick source");
+        }
+        if (tick_rate <= 0) {
+            throw uhd::value_error("wavegen_pulse_scheduler: tick rate must be positive");
+        }
+        if (queue_depth == 0) {
+            throw uhd::value_error("wavegen_pulse_scheduler: queue depth must be non-zero");
+        }
+        if (_threads) {
+            _threads->validate(gr::wavegen::thread_profile::ROLE_CONTROL);
+        }
+        _thread = boost::thread(boost::bind(&wavegen_pulse_scheduler_impl::_refill_loop, this));
+    }
+
+    ~wavegen_pulse_scheduler_impl(void)
+    {
+        {
+            boost::mutex::scoped_lock lock(_mutex);
+            _stop = true;
+        }
+        _cond.notify_all();
+        _thread.join();
+    }
+
+    void schedule_pulses(const std::vector<boost::uint64_t> &ticks)
+    {
+        if (ticks.empty()) {
+            return;
+        }
+        boost::mutex::scoped_lock lock(_mutex);
+        _check_error();
+        boost::uint64_t last = _last_tick();
+        const bool have_last = not (_pending.empty() and _in_flight.empty());
+        for (size_t i = 0; i < ticks.size(); i++) {
+            if ((i > 0 or have_last) and ticks[i] <= last) {
+                throw uhd::value_error("wavegen_pulse_scheduler: pulse times must be increasing");
+            }
+            last = ticks[i];
+        }
+        _pending.insert(_pending.end(), ticks.begin(), ticks.end());
+        _stats.pulses_scheduled += ticks.size();
+
+        /* Fill the queue from the caller so short schedules go out at once */
+        _refill(_tick_source());
+        _cond.notify_all();
+    }
+
+    void schedule_burst(const boost::uint64_t start, const boost::uint64_t interval, const size_t count)
+    {
+        if (count > 1 and interval == 0) {
+            throw uhd::value_error("wavegen_pulse_scheduler: burst interval must be non-zero");
+        }
+        std::vector<boost::uint64_t> ticks(count);
+        for (size_t i = 0; i < count; i++) {
+            ticks[i] = start + i * interval;
+        }
+        schedule_pulses(ticks);
+    }
+
+    size_t get_queue_depth(void)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _retire(_tick_source());
+        return _in_flight.size();
+    }
+
+    size_t get_num_pending(void)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _pending.size();
+    }
+
+    bool wait_done(const double timeout)
+    {
+        const boost::posix_time::ptime deadline =
+            boost::posix_time::microsec_clock::universal_time()
+            + boost::posix_time::microseconds(long(timeout * 1e6));
+        boost::mutex::scoped_lock lock(_mutex);
+        while (true) {
+            _check_error();
+            const boost::uint64_t now = _tick_source();
+            _retire(now);
+            if (_pending.empty() and _in_flight.empty()) {
+                return true;
+            }
+            if (boost::posix_time::microsec_clock::universal_time() >= deadline) {
+                return false;
+            }
+            _cond.timed_wait(lock, _sleep_until(_last_tick(), now));
+        }
+    }
+
+    void cancel(void)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _pending.clear();
+        _in_flight.clear();
+        _error.clear();
+        _core->clear_commands();
+        _cond.notify_all();
+    }
+
+    stats_t get_stats(void)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _stats;
+    }
+
+private:
+    /* Report a refill that failed on the background thread */
+    void _check_error(void)
+    {
+        if (not _error.empty()) {
+            throw uhd::runtime_error(str(
+                boost::format("wavegen_pulse_scheduler: refill failed: %s") % _error
+            ));
+        }
+    }
+
+    /* Latest time in the schedule; only valid if anything is queued */
+    boost::uint64_t _last_tick(void)
+    {
+        if (not _pending.empty()) {
+            return _pending.back();
+        }
+        return _in_flight.empty() ? 0 : _in_flight.back();
+    }
+
+    /* Drop the commands that have fired from the queue estimate */
+    void _retire(const boost::uint64_t now)
+    {
+        while (not _in_flight.empty() and _in_flight.front() <= now) {
+            _in_flight.pop_front();
+        }
+    }
+
+    /* Top up the controller queue from the pending schedule */
+    void _refill(const boost::uint64_t now)
+    {
+        _retire(now);
+        const size_t n = std::min(_queue_depth - _in_flight.size(), _pending.size());
+        if (n == 0) {
+            return;
+        }
+        _batch.assign(_pending.begin(), _pending.begin() + n);
+        _core->send_commands(0, _batch);
+
+        _pending.erase(_pending.begin(), _pending.begin() + n);
+        _in_flight.insert(_in_flight.end(), _batch.begin(), _batch.end());
+        for (size_t i = 0; i < n and _batch[i] <= now; i++) {
+            _stats.late_pulses++;
+        }
+        _stats.pulses_issued += n;
+        _stats.bursts++;
+        _stats.max_queue_depth = std::max(_stats.max_queue_depth, _in_flight.size());
+    }
+
+    /* Sleep until device time reaches \p target, within the bounds above */
+    boost::posix_time::time_duration _sleep_until(const boost::uint64_t target, const boost::uint64_t now)
+    {
+        const double secs = (target > now) ? double(target - now) / _tick_rate : 0.0;
+        const long us = std::min(std::max(long(secs * 1e6), MIN_SLEEP_US), MAX_SLEEP_US);
+        return boost::posix_time::microseconds(us);
+    }
+
+    void _refill_loop(void)
+    {
+        gr::wavegen::thread_profile::scoped_role role(
+            _threads, gr::wavegen::thread_profile::ROLE_CONTROL, "pulse scheduler");
+        boost::mutex::scoped_lock lock(_mutex);
+        while (not _stop) {
+            if (_pending.empty() or not _error.empty()) {
+                _cond.wait(lock);
+                continue;
+            }
+            const boost::uint64_t now = _tick_source();
+            try {
+                _refill(now);
+            } catch (const std::exception &e) {
+                /* Stop refilling; the caller sees it on the next call */
+                _error = e.what();
+                _cond.notify_all();
+                continue;
+            }
+            if (_pending.empty()) {
+                continue;
+            }
+            /* The queue is full now; wake once it has drained to the low
+             * water mark so the next refill is a large burst */
+            const size_t drain = _in_flight.size() - std::min(_low_water, _in_flight.size() - 1);
+            _cond.timed_wait(lock, _sleep_until(_in_flight[drain - 1], now));
+        }
+    }
+
+    wavegen_core::sptr _core;
+    tick_source_t _tick_source;
+    const double _tick_rate;
+    const size_t _queue_depth;
+    const size_t _low_water;
+    gr::wavegen::thread_profile::sptr _threads;
+
+    boost::mutex _mutex;
+    boost::condition_variable _cond;
+    boost::thread _thread;
+    bool _stop;
+
+    /* Pulses not yet handed to the controller, and those in its queue */
+    std::deque<boost::uint64_t> _pending;
+    std::deque<boost::uint64_t> _in_flight;
+    std::vector<boost::uint64_t> _batch;
+    stats_t _stats;
+    /* Set when the refill thread could not queue commands */
+    std::string _error;
+};
+
+const long wavegen_pulse_scheduler_impl::MIN_SLEEP_US;
+const long wavegen_pulse_scheduler_impl::MAX_SLEEP_US;
+
+
+wavegen_pulse_scheduler::sptr wavegen_pulse_scheduler::make(
+    wavegen_core::sptr core,
+    tick_source_t tick_source,
+    const double tick_rate,
+    const size_t queue_depth,
+    gr::wavegen::thread_profile::sptr threads
+) {
+    return sptr(new wavegen_pulse_scheduler_impl(core, tick_source, tick_rate, queue_depth, threads));
+}
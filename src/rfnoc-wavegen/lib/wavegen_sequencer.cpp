@@ -0,0 +1,135 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <wavegen/wavegen_sequencer.hpp>
+#include <uhd/exception.hpp>
+#include <boost/format.hpp>
+#include <algorithm>
+
+using namespace uhd;
+using namespace uhd::rfnoc;
+
+
+class wavegen_sequencer_impl : public wavegen_sequencer
+{
+public:
+    typedef wavegen_waveform_library::waveform_id_t waveform_id_t;
+
+    wavegen_sequencer_impl(wavegen_core::sptr core, wavegen_waveform_library::sptr library):
+        _core(core),
+        _library(library)
+    {
+    }
+
+    void set_sequence(const std::vector<entry_t> &entries)
+    {
+        /* Distinct AWG waveforms, in order of first use */
+        std::vector<waveform_id_t> waveforms;
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (_uses_awg(entries[i])
+                and std::find(waveforms.begin(), waveforms.end(), entries[i].waveform) == waveforms.end()) {
+                waveforms.push_back(entries[i].waveform);
+            }
+        }
+        const size_t num_banks = _library->get_num_banks();
+        if (waveforms.size() > num_banks) {
+            throw uhd::value_error(str(
+                boost::format("wavegen_sequencer: sequence uses %d AWG waveforms but only %d banks are available")
+                % waveforms.size() % num_banks
+            ));
+        }
+
+        /* Uploads below may overwrite a bank the old sequence plays */
+        _core->enable_sequence(false);
+        _place(waveforms, num_banks);
+
+        std::vector<wavegen_core::seq_entry_t> table(entries.size());
+        for (size_t i = 0; i < entries.size(); i++) {
+            const entry_t &e = entries[i];
+            wavegen_core::seq_entry_t &t = table[i];
+            const boost::uint32_t wfrm_len = _uses_awg(e) ? boost::uint32_t(_library->get_length(e.waveform)) : 0;
+            if (e.rx_len < wfrm_len) {
+                throw uhd::value_error(str(
+                    boost::format("wavegen_sequencer: entry %d rx length %d is less than waveform length %d")
+                    % i % e.rx_len % wfrm_len
+                ));
+            }
+            t.bank = _uses_awg(e) ? boost::uint32_t(_library->get_bank(e.waveform)) : 0;
+            t.ctrl_word = e.ctrl_word;
+            t.tuning_coef = e.tuning_coef;
+            t.freq_offset = e.freq_offset;
+            /* Same ADC count as set_rx_len() */
+            t.adc_samples = e.rx_len - wfrm_len;
+            if (t.adc_samples > 0) t.adc_samples -= 1;
+        }
+        _core->set_sequence(table);
+    }
+
+    void start(void)
+    {
+        _core->enable_sequence(true);
+    }
+
+    void stop(void)
+    {
+        _core->enable_sequence(false);
+    }
+
+    size_t get_index(void)
+    {
+        return _core->get_sequence_index();
+    }
+
+private:
+    static bool _uses_awg(const entry_t &e)
+    {
+        return e.ctrl_word == wavegen_core::CTRL_WORD_SEL_AWG;
+    }
+
+    /* Get every waveform into a bank, keeping the ones already there */
+    void _place(const std::vector<waveform_id_t> &waveforms, const size_t num_banks)
+    {
+        std::vector<bool> taken(num_banks, false);
+        std::vector<waveform_id_t> missing;
+        for (size_t i = 0; i < waveforms.size(); i++) {
+            if (_library->is_resident(waveforms[i]) and not taken[_library->get_bank(waveforms[i])]) {
+                taken[_library->get_bank(waveforms[i])] = true;
+            } else {
+                missing.push_back(waveforms[i]);
+            }
+        }
+        size_t bank = 0;
+        for (size_t i = 0; i < missing.size(); i++) {
+            while (taken[bank]) bank++;
+            _library->load(missing[i], bank);
+            taken[bank] = true;
+        }
+    }
+
+    wavegen_core::sptr _core;
+    wavegen_waveform_library::sptr _library;
+};
+
+
+wavegen_sequencer::sptr wavegen_sequencer::make(wavegen_core::sptr core, wavegen_waveform_library::sptr library)
+{
+    return sptr(new wavegen_sequencer_impl(core, library));
+}
@@ -0,0 +1,231 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include <wavegen/wavegen_status_monitor.hpp>
+#include <uhd/exception.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/bind.hpp>
+#include <boost/format.hpp>
+#include <exception>
+
+using namespace uhd;
+using namespace uhd::rfnoc;
+
+
+class wavegen_status_monitor_impl : public wavegen_status_monitor
+{
+public:
+    wavegen_status_monitor_impl(
+        wavegen_core::sptr core,
+        wavegen_waveform_library::sptr library,
+        gr::wavegen::thread_profile::sptr threads
+    ):
+        _core(core),
+        _library(library),
+        _threads(threads),
+        _latest(0),
+        _sequence(0),
+        _polls(0),
+        _errors(0),
+        _read_retries(0),
+        _running(false),
+        _stop(false)
+    {
+        for (size_t i = 0; i < NUM_SLOTS; i++) {
+            _slots[i].seq.store(0, boost::memory_order_relaxed);
+        }
+        if (_threads) {
+            _threads->validate(gr::wavegen::thread_profile::ROLE_CONTROL);
+        }
+    }
+
+    ~wavegen_status_monitor_impl(void)
+    {
+        stop();
+    }
+
+    wavegen_status poll(void)
+    {
+        wavegen_status status = _core->get_status();
+        if (_library) {
+            status.waveform_known = _library->get_bank_id(status.live_bank, status.waveform_id);
+        }
+        _polls.fetch_add(1, boost::memory_order_relaxed);
+        _publish(status);
+        return status;
+    }
+
+    void start(const double rate)
+    {
+        if (not (rate > 0)) {
+            throw uhd::value_error(str(
+                boost::format("wavegen_status_monitor: poll rate %f must be positive") % rate
+            ));
+        }
+        boost::mutex::scoped_lock control_lock(_control_mutex);
+        _stop_thread();
+        boost::mutex::scoped_lock lock(_wake_mutex);
+        _period = boost::posix_time::microseconds(static_cast<long>(1e6 / rate));
+        _stop = false;
+        _running = true;
+        _thread = boost::thread(boost::bind(&wavegen_status_monitor_impl::_poll_loop, this));
+    }
+
+    void stop(void)
+    {
+        boost::mutex::scoped_lock control_lock(_control_mutex);
+        _stop_thread();
+    }
+
+    bool is_running(void)
+    {
+        boost::mutex::scoped_lock lock(_wake_mutex);
+        return _running;
+    }
+
+    /* Seqlock read: retry if the slot was rewritten while copying */
+    wavegen_status get_status(void)
+    {
+        for (;;) {
+            const slot_t &slot = _slots[_latest.load(boost::memory_order_acquire)];
+            const boost::uint64_t before = slot.seq.load(boost::memory_order_acquire);
+            if ((before & 1) == 0) {
+                const wavegen_status status = slot.status;
+                boost::atomic_thread_fence(boost::memory_order_acquire);
+                if (slot.seq.load(boost::memory_order_relaxed) == before) {
+                    return status;
+                }
+            }
+            _read_retries.fetch_add(1, boost::memory_order_relaxed);
+        }
+    }
+
+    stats_t get_stats(void)
+    {
+        stats_t stats;
+        stats.polls = _polls.load(boost::memory_order_relaxed);
+        stats.errors = _errors.load(boost::memory_order_relaxed);
+        stats.read_retries = _read_retries.load(boost::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    /* Snapshots rotate through the slots, so a reader is only disturbed
+     * if it is still copying when the writer comes round again */
+    static const size_t NUM_SLOTS = 4;
+
+    struct slot_t {
+        //! Odd while the slot is being written
+        boost::atomic<boost::uint64_t> seq;
+        wavegen_status status;
+    };
+
+    void _publish(wavegen_status &status)
+    {
+        boost::mutex::scoped_lock lock(_publish_mutex);
+        status.sequence = ++_sequence;
+        const size_t index = (_latest.load(boost::memory_order_relaxed) + 1) % NUM_SLOTS;
+        slot_t &slot = _slots[index];
+        const boost::uint64_t seq = slot.seq.load(boost::memory_order_relaxed);
+        slot.seq.store(seq + 1, boost::memory_order_relaxed);
+        boost::atomic_thread_fence(boost::memory_order_release);
+        slot.status = status;
+        slot.seq.store(seq + 2, boost::memory_order_release);
+        _latest.store(index, boost::memory_order_release);
+    }
+
+    void _stop_thread(void)
+    {
+        {
+            boost::mutex::scoped_lock lock(_wake_mutex);
+            if (not _running) {
+                return;
+            }
+            _stop = true;
+        }
+        _wake_cond.notify_one();
+        _thread.join();
+        boost::mutex::scoped_lock lock(_wake_mutex);
+        _running = false;
+    }
+
+    void _poll_loop(void)
+    {
+        gr::wavegen::thread_profile::scoped_role role(
+            _threads, gr::wavegen::thread_profile::ROLE_CONTROL, "status monitor");
+        boost::mutex::scoped_lock lock(_wake_mutex);
+        boost::system_time next = boost::get_system_time();
+        while (not _stop) {
+            lock.unlock();
+            try {
+                poll();
+            } catch (const std::exception &) {
+                /* Keep the last good snapshot and try again next period */
+                _errors.fetch_add(1, boost::memory_order_relaxed);
+            }
+            lock.lock();
+            next += _period;
+            const boost::system_time now = boost::get_system_time();
+            if (next < now) {
+                next = now;
+            }
+            while (not _stop and _wake_cond.timed_wait(lock, next)) {}
+        }
+    }
+
+    wavegen_core::sptr _core;
+    wavegen_waveform_library::sptr _library;
+    gr::wavegen::thread_profile::sptr _threads;
+
+    /* Published snapshots; written under _publish_mutex, read lock-free */
+    slot_t _slots[NUM_SLOTS];
+    boost::atomic<size_t> _latest;
+    boost::mutex _publish_mutex;
+    boost::uint64_t _sequence;
+
+    boost::atomic<boost::uint64_t> _polls;
+    boost::atomic<boost::uint64_t> _errors;
+    boost::atomic<boost::uint64_t> _read_retries;
+
+    /* Poll thread; start() and stop() hold _control_mutex */
+    boost::mutex _control_mutex;
+    boost::thread _thread;
+    boost::mutex _wake_mutex;
+    boost::condition_variable _wake_cond;
+    boost::posix_time::time_duration _period;
+    bool _running;
+    bool _stop;
+};
+
+const size_t wavegen_status_monitor_impl::NUM_SLOTS;
+
+wavegen_status_monitor::sptr wavegen_status_monitor::make(
+    wavegen_core::sptr core,
+    wavegen_waveform_library::sptr library,
+    gr::wavegen::thread_profile::sptr threads
+) {
+    return sptr(new wavegen_status_monitor_impl(core, library, threads));
+}
@@ -0,0 +1,427 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <wavegen/wavegen_waveform_library.hpp>
+#include <uhd/exception.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/format.hpp>
+#include <list>
+#include <map>
+
+using namespace uhd;
+using namespace uhd::rfnoc;
+
+
+const size_t wavegen_waveform_library::DEFAULT_CAPACITY;
+
+wavegen_waveform_library::waveform_id_t wavegen_waveform_library::hash(
+    const std::vector<boost::uint32_t> &samples
+) {
+    static const boost::uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+    static const boost::uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+    /* One multiply per sample word rather than per byte */
+    boost::uint64_t h = FNV_OFFSET ^ samples.size();
+    for (size_t i = 0; i < samples.size(); i++) {
+        h = (h ^ samples[i]) * FNV_PRIME;
+    }
+    return h;
+}
+
+class wavegen_waveform_library_impl : public wavegen_waveform_library
+{
+public:
+    wavegen_waveform_library_impl(wavegen_core::sptr core):
+        _core(core),
+        _capacity(DEFAULT_CAPACITY),
+        _num_banks(1),
+        _live(0),
+        _uploads_seen(0)
+    {
+        _forget();
+    }
+
+    void set_num_banks(const size_t num_banks)
+    {
+        if (num_banks != 1 and num_banks != wavegen_core::NUM_AWG_BANKS) {
+            throw uhd::value_error(str(
+                boost::format("wavegen_waveform_library: %d banks not supported") % num_banks
+            ));
+        }
+        boost::mutex::scoped_lock lock(_mutex);
+        _num_banks = num_banks;
+        _live = (num_banks > 1) ? _core->get_live_bank() : 0;
+        _forget();
+    }
+
+    size_t get_num_banks(void)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _num_banks;
+    }
+
+    void set_capacity(const size_t capacity)
+    {
+        if (capacity == 0) {
+            throw uhd::value_error("wavegen_waveform_library: capacity must be at least 1");
+        }
+        boost::mutex::scoped_lock lock(_mutex);
+        _capacity = capacity;
+        _evict(0, false);
+    }
+
+    size_t get_capacity(void)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _capacity;
+    }
+
+    waveform_id_t add(const std::vector<boost::uint32_t> &samples)
+    {
+        if (samples.empty()) {
+            throw uhd::value_error("wavegen_waveform_library: cannot add an empty waveform");
+        }
+        const waveform_id_t id = hash(samples);
+        boost::mutex::scoped_lock lock(_mutex);
+        waveform_map_t::iterator it = _waveforms.find(id);
+        if (it == _waveforms.end()) {
+            entry_t &entry = _waveforms[id];
+            entry.samples = samples;
+            entry.lru = _lru.insert(_lru.begin(), id);
+            _evict(id, true);
+        } else if (it->second.samples != samples) {
+            throw uhd::runtime_error(str(
+                boost::format("wavegen_waveform_library: hash collision on id 0x%016x") % id
+            ));
+        } else {
+            _touch(it->second);
+        }
+        return id;
+    }
+
+    void remove(const waveform_id_t id)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        waveform_map_t::iterator it = _waveforms.find(id);
+        if (it != _waveforms.end()) {
+            _lru.erase(it->second.lru);
+            _waveforms.erase(it);
+        }
+    }
+
+    bool contains(const waveform_id_t id)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _waveforms.count(id) > 0;
+    }
+
+    size_t size(void)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _waveforms.size();
+    }
+
+    size_t get_length(const waveform_id_t id)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _lookup(id).size();
+    }
+
+    std::vector<boost::uint32_t> get_samples(const waveform_id_t id)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _lookup(id);
+    }
+
+    void select(const waveform_id_t id, const size_t spp)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        const std::vector<boost::uint32_t> &samples = _lookup(id);
+        if (_bank_of(id) == int(_live)) {
+            _count_hit(samples);
+            return;
+        }
+        if (_num_banks == 1) {
+            _load(0, id, samples, spp);
+            return;
+        }
+        const size_t idle = _idle_bank();
+        if (_bank_of(id) == int(idle)) {
+            _count_hit(samples);
+        } else {
+            _load(idle, id, samples, spp);
+        }
+        _core->select_bank(idle);
+        _live = idle;
+        _stats.bank_swaps++;
+    }
+
+    void select_at(const waveform_id_t id, const uhd::time_spec_t &time, const size_t spp)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _check_banked("select_at");
+        const std::vector<boost::uint32_t> &samples = _lookup(id);
+        const size_t idle = _idle_bank();
+        if (_bank_of(id) == int(idle)) {
+            _count_hit(samples);
+        } else {
+            /* Even if it is live: the timed swap always targets the
+             * idle bank, so the live one must not change before then */
+            _load(idle, id, samples, spp);
+        }
+        _core->select_bank(idle, time);
+        _live = idle;
+        _stats.bank_swaps++;
+    }
+
+    void prefetch(const waveform_id_t id, const size_t spp)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _check_banked("prefetch");
+        const std::vector<boost::uint32_t> &samples = _lookup(id);
+        if (_bank_of(id) >= 0) {
+            return;
+        }
+        _load(_idle_bank(), id, samples, spp);
+    }
+
+    void swap(void)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _check_banked("swap");
+        _live = _idle_bank();
+        _core->select_bank(_live);
+        _stats.bank_swaps++;
+    }
+
+    void swap(const uhd::time_spec_t &time)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _check_banked("swap");
+        _live = _idle_bank();
+        _core->select_bank(_live, time);
+        _stats.bank_swaps++;
+    }
+
+    void load(const waveform_id_t id, const size_t bank, const size_t spp)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        if (bank >= _num_banks) {
+            throw uhd::value_error(str(
+                boost::format("wavegen_waveform_library: bank %d out of range") % bank
+            ));
+        }
+        const std::vector<boost::uint32_t> &samples = _lookup(id);
+        if (_bank_of(id) == int(bank)) {
+            _count_hit(samples);
+            return;
+        }
+        _load(bank, id, samples, spp);
+    }
+
+    size_t get_bank(const waveform_id_t id)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        const int bank = _bank_of(id);
+        if (bank < 0) {
+            throw uhd::key_error(str(
+                boost::format("wavegen_waveform_library: waveform 0x%016x is not resident") % id
+            ));
+        }
+        return size_t(bank);
+    }
+
+    bool get_bank_id(const size_t bank, waveform_id_t &id)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        if (_core->get_num_uploads() != _uploads_seen) {
+            _forget();
+        }
+        if (bank >= _num_banks or not _banks[bank].valid) {
+            return false;
+        }
+        id = _banks[bank].id;
+        return true;
+    }
+
+    size_t get_live_bank(void)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _live;
+    }
+
+    waveform_id_t set_waveform(const std::vector<boost::uint32_t> &samples, const size_t spp)
+    {
+        const waveform_id_t id = add(samples);
+        select(id, spp);
+        return id;
+    }
+
+    bool is_resident(const waveform_id_t id)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _bank_of(id) >= 0;
+    }
+
+    bool is_live(const waveform_id_t id)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _bank_of(id) == int(_live);
+    }
+
+    void invalidate(void)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _forget();
+    }
+
+    stats_t get_stats(void)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _stats;
+    }
+
+private:
+    /* Most recently used id at the front of _lru */
+    struct entry_t {
+        std::vector<boost::uint32_t> samples;
+        std::list<waveform_id_t>::iterator lru;
+    };
+    typedef std::map<waveform_id_t, entry_t> waveform_map_t;
+
+    struct bank_t {
+        bool valid;
+        waveform_id_t id;
+    };
+
+    void _forget(void)
+    {
+        for (size_t i = 0; i < wavegen_core::NUM_AWG_BANKS; i++) {
+            _banks[i].valid = false;
+        }
+        _uploads_seen = _core->get_num_uploads();
+    }
+
+    const std::vector<boost::uint32_t> &_lookup(const waveform_id_t id)
+    {
+        waveform_map_t::iterator it = _waveforms.find(id);
+        if (it == _waveforms.end()) {
+            throw uhd::key_error(str(
+                boost::format("wavegen_waveform_library: no waveform with id 0x%016x") % id
+            ));
+        }
+        _touch(it->second);
+        return it->second.samples;
+    }
+
+    void _touch(entry_t &entry)
+    {
+        _lru.splice(_lru.begin(), _lru, entry.lru);
+    }
+
+    /* Drop least recently used waveforms until within capacity,
+     * skipping resident ones and \p keep (the one just added) */
+    void _evict(const waveform_id_t keep, const bool has_keep)
+    {
+        std::list<waveform_id_t>::iterator it = _lru.end();
+        while (_waveforms.size() > _capacity and it != _lru.begin()) {
+            --it;
+            if ((has_keep and *it == keep) or _bank_of(*it) >= 0) {
+                continue;
+            }
+            _waveforms.erase(*it);
+            it = _lru.erase(it);
+            _stats.evictions++;
+        }
+    }
+
+    void _check_banked(const char *what)
+    {
+        if (_num_banks < 2) {
+            throw uhd::runtime_error(str(
+                boost::format("wavegen_waveform_library: %s needs waveform banks enabled") % what
+            ));
+        }
+    }
+
+    size_t _idle_bank(void)
+    {
+        return (_live + 1) % _num_banks;
+    }
+
+    /* Bank holding \p id, or -1. An upload we did not make may have
+     * landed in either bank, so it clears the whole record. */
+    int _bank_of(const waveform_id_t id)
+    {
+        if (_core->get_num_uploads() != _uploads_seen) {
+            _forget();
+        }
+        for (size_t i = 0; i < _num_banks; i++) {
+            if (_banks[i].valid and _banks[i].id == id) {
+                return int(i);
+            }
+        }
+        return -1;
+    }
+
+    void _load(const size_t bank, const waveform_id_t id, const std::vector<boost::uint32_t> &samples, const size_t spp)
+    {
+        _banks[bank].valid = false;
+        if (_num_banks > 1) {
+            _core->set_load_bank(bank);
+        }
+        if (spp == 0) {
+            _core->set_waveform(samples);
+        } else {
+            _core->set_waveform(samples, spp);
+        }
+        _uploads_seen = _core->get_num_uploads();
+        _banks[bank].valid = true;
+        _banks[bank].id = id;
+        _stats.misses++;
+        _stats.bytes_uploaded += samples.size() * sizeof(boost::uint32_t);
+    }
+
+    void _count_hit(const std::vector<boost::uint32_t> &samples)
+    {
+        _stats.hits++;
+        _stats.bytes_avoided += samples.size() * sizeof(boost::uint32_t);
+    }
+
+    wavegen_core::sptr _core;
+    boost::mutex _mutex;
+    waveform_map_t _waveforms;
+    std::list<waveform_id_t> _lru;
+    size_t _capacity;
+
+    /* What each bank holds, valid while no other upload has happened */
+    size_t _num_banks;
+    size_t _live;
+    bank_t _banks[wavegen_core::NUM_AWG_BANKS];
+    size_t _uploads_seen;
+    stats_t _stats;
+};
+
+
+wavegen_waveform_library::sptr wavegen_waveform_library::make(wavegen_core::sptr core)
+{
+    return sptr(new wavegen_waveform_library_impl(core));
+}
@@ -0,0 +1,178 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "worker_ring.h"
+#include <boost/bind.hpp>
+
+namespace gr {
+  namespace wavegen {
+
+    worker_ring::worker_ring(size_t num_slots, size_t items_per_slot):
+      _num_slots(num_slots),
+      _items_per_slot(items_per_slot),
+      _done(new boost::atomic<bool>[num_slots]),
+      _remaining(new boost::atomic<size_t>[num_slots]),
+      _work(num_slots * items_per_slot),
+      _head(0),
+      _tail(0),
+      _pending(0),
+      _stopping(false),
+      _backpressure_waits(0),
+      _max_pending(0)
+    {
+      for (size_t i = 0; i < num_slots; i++) {
+        _done[i].store(false, boost::memory_order_relaxed);
+        _remaining[i].store(0, boost::memory_order_relaxed);
+      }
+    }
+
+    worker_ring::~worker_ring()
+    {
+      stop();
+    }
+
+    void
+    worker_ring::start(size_t num_workers, const boost::function<void (size_t)> &worker)
+    {
+      for (size_t i = 0; i < num_workers; i++) {
+        _workers.create_thread(boost::bind(worker, i));
+      }
+    }
+
+    void
+    worker_ring::stop(void)
+    {
+      _stopping.store(true);
+      _work_cond.notify_all();
+      _workers.join_all();
+    }
+
+    size_t
+    worker_ring::acquire(void)
+    {
+      const size_t head = _head.load(boost::memory_order_relaxed);
+      if (head - _tail.load(boost::memory_order_acquire) == _num_slots) {
+        count(_backpressure_waits);
+        boost::mutex::scoped_lock lock(_free_mutex);
+        while (head - _tail.load(boost::memory_order_acquire) == _num_slots) {
+          _free_cond.timed_wait(lock, WAKE_INTERVAL);
+        }
+      }
+      return head % _num_slots;
+    }
+
+    size_t
+    worker_ring::head_slot(void) const
+    {
+      return _head.load(boost::memory_order_relaxed) % _num_slots;
+    }
+
+    void
+    worker_ring::commit(void)
+    {
+      const size_t head = _head.load(boost::memory_order_relaxed);
+      const size_t slot = head % _num_slots;
+      _remaining[slot].store(_items_per_slot, boost::memory_order_relaxed);
+      _head.store(head + 1, boost::memory_order_release);
+      raise_max(_max_pending, _pending.fetch_add(1, boost::memory_order_relaxed) + 1);
+      for (size_t i = 0; i < _items_per_slot; i++) {
+        _work.bounded_push(slot * _items_per_slot + i);
+      }
+      if (_items_per_slot == 1) {
+        _work_cond.notify_one();
+      } else {
+        _work_cond.notify_all();
+      }
+    }
+
+    bool
+    worker_ring::next(size_t &item)
+    {
+      while (not _work.pop(item)) {
+        if (_stopping.load()) {
+          return false;
+        }
+        boost::mutex::scoped_lock lock(_work_mutex);
+        _work_cond.timed_wait(lock, WAKE_INTERVAL);
+      }
+      return true;
+    }
+
+    bool
+    worker_ring::finish(size_t item, counter_t *finished)
+    {
+      const size_t slot = slot_of(item);
+      /* The worker finishing the last item publishes the slot */
+      if (_remaining[slot].fetch_sub(1, boost::memory_order_acq_rel) != 1) {
+        return false;
+      }
+      if (finished) {
+        count(*finished);
+      }
+      _pending.fetch_sub(1, boost::memory_order_relaxed);
+      _done[slot].store(true, boost::memory_order_release);
+      return true;
+    }
+
+    bool
+    worker_ring::front(size_t &slot)
+    {
+      slot = _tail.load(boost::memory_order_relaxed) % _num_slots;
+      return _done[slot].load(boost::memory_order_acquire);
+    }
+
+    bool
+    worker_ring::pop(void)
+    {
+      const size_t tail = _tail.load(boost::memory_order_relaxed);
+      const size_t slot = tail % _num_slots;
+      if (not _done[slot].load(boost::memory_order_acquire)) {
+        return false;
+      }
+      _done[slot].store(false, boost::memory_order_relaxed);
+      _tail.store(tail + 1, boost::memory_order_release);
+      _free_cond.notify_one();
+      return true;
+    }
+
+    size_t
+    worker_ring::size(void) const
+    {
+      return _head.load(boost::memory_order_acquire) - _tail.load(boost::memory_order_acquire);
+    }
+
+    boost::uint64_t
+    worker_ring::backpressure_waits(void) const
+    {
+      return _backpressure_waits.load(boost::memory_order_relaxed);
+    }
+
+    boost::uint64_t
+    worker_ring::max_pending(void) const
+    {
+      return _max_pending.load(boost::memory_order_relaxed);
+    }
+
+  } /* namespace wavegen */
+} /* namespace gr */
@@ -0,0 +1,148 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2016 <+YOU OR YOUR COMPANY+>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_WAVEGEN_WORKER_RING_H
+#define INCLUDED_WAVEGEN_WORKER_RING_H
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+#include <boost/lockfree/queue.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace gr {
+  namespace wavegen {
+
+    /* Sleeping threads recheck their condition this often, so a notify
+     * that races the wait costs at most this long */
+    static const boost::posix_time::milliseconds WAKE_INTERVAL(1);
+
+    //! Statistics counter; updates are relaxed, readers see a recent value
+    typedef boost::atomic<boost::uint64_t> counter_t;
+
+    inline void
+    count(counter_t &c, boost::uint64_t n = 1)
+    {
+      c.fetch_add(n, boost::memory_order_relaxed);
+    }
+
+    inline void
+    raise_max(counter_t &c, boost::uint64_t value)
+    {
+      boost::uint64_t cur = c.load(boost::memory_order_relaxed);
+      while (value > cur and not c.compare_exchange_weak(cur, value, boost::memory_order_relaxed)) {}
+    }
+
+    /*!
+     * Ring of slots worked on by a pool of threads and handed back in
+     * order. One thread fills the slot at the head and commits it,
+     * which queues the slot's work items; workers take items in any
+     * order; one thread reads finished slots from the tail. A slot may
+     * be split into several items, and is finished when the last of
+     * them is. The ring holds the bookkeeping only; the stage owns the
+     * slot buffers and indexes them by slot number.
+     */
+    class worker_ring : boost::noncopyable
+    {
+    public:
+      worker_ring(size_t num_slots, size_t items_per_slot = 1);
+      ~worker_ring();
+
+      //! Run \p worker(i) on \p num_workers threads, i counting from 0
+      void start(size_t num_workers, const boost::function<void (size_t)> &worker);
+
+      //! Stop and join the workers once the queued items are done
+      void stop(void);
+
+      size_t num_slots(void) const { return _num_slots; }
+
+      /* Producer side, one thread */
+
+      //! The slot at the head, after waiting for it to be popped
+      size_t acquire(void);
+
+      //! The slot at the head, without waiting
+      size_t head_slot(void) const;
+
+      //! Queue the head slot's items and move on to the next slot
+      void commit(void);
+
+      /* Workers */
+
+      //! Next work item; false once stopped and nothing is left
+      bool next(size_t &item);
+
+      size_t slot_of(size_t item) const { return item / _items_per_slot; }
+      size_t part_of(size_t item) const { return item % _items_per_slot; }
+
+      /*!
+       * Mark \p item done. True if that finished its slot; \p finished,
+       * if given, is counted before the slot becomes visible.
+       */
+      bool finish(size_t item, counter_t *finished = NULL);
+
+      /* Consumer side, one thread */
+
+      //! The slot at the tail, if it is finished
+      bool front(size_t &slot);
+
+      //! Release the tail slot; false if it is not finished
+      bool pop(void);
+
+      //! Slots committed and not yet popped
+      size_t size(void) const;
+
+      boost::uint64_t backpressure_waits(void) const;
+      boost::uint64_t max_pending(void) const;
+
+    private:
+      const size_t _num_slots;
+      const size_t _items_per_slot;
+
+      /* Slot i is finished and waiting for pop(); items left in slot i */
+      boost::scoped_array<boost::atomic<bool> > _done;
+      boost::scoped_array<boost::atomic<size_t> > _remaining;
+      /* slot * _items_per_slot + part */
+      boost::lockfree::queue<size_t> _work;
+      /* Only the producer writes _head, only the consumer _tail */
+      boost::atomic<size_t> _head;
+      boost::atomic<size_t> _tail;
+      boost::atomic<size_t> _pending;
+
+      boost::mutex _free_mutex;
+      boost::condition_variable _free_cond;
+      boost::mutex _work_mutex;
+      boost::condition_variable _work_cond;
+      boost::thread_group _workers;
+      boost::atomic<bool> _stopping;
+
+      counter_t _backpressure_waits;
+      counter_t _max_pending;
+    };
+
+  } /* namespace wavegen */
+} /* namespace gr */
+
+#endif /* INCLUDED_WAVEGEN_WORKER_RING_H */
@@ -163,20 +163,132 @@ module noc_block_wavegen #(
     .clk(ce_clk), .rst(ce_rst),
     .strobe(set_stb), .addr(set_addr), .in(set_data), .out(test_reg_1), .changed());
 
+  // Waveform banks
+  //
+  // - The AWG memory is split into two banks. load_bank (set by
+  //   SR_AWG_LOAD_BANK) is the bank address bit for uploads, live_bank
+  //   the one for playback.
+  // - Any write to SR_AWG_BANK_SEL requests a swap to the written bank.
+  //   The swap is held pending and applied at the next pulse boundary
+  //   (end of an output packet, or at once while no pulse is playing),
+  //   so a pulse never mixes samples from both banks.
+  // - A timed SR_AWG_BANK_SEL write swaps at a given time.
+  //
+  localparam [7:0] SR_AWG_LOAD_BANK = 8'd214;
+  localparam [7:0] SR_AWG_BANK_SEL  = 8'd215;
+  localparam [7:0] RB_AWG_BANK      = 8'd11;
+
+  wire load_bank;
+  setting_reg #(
+    .my_addr(SR_AWG_LOAD_BANK), .awidth(8), .width(1))
+  sr_awg_load_bank (
+    .clk(ce_clk), .rst(ce_rst),
+    .strobe(set_stb), .addr(set_addr), .in(set_data), .out(load_bank), .changed());
+
+  wire bank_sel, bank_sel_stb;
+  setting_reg #(
+    .my_addr(SR_AWG_BANK_SEL), .awidth(8), .width(1))
+  sr_awg_bank_sel (
+    .clk(ce_clk), .rst(ce_rst),
+    .strobe(set_stb), .addr(set_addr), .in(set_data), .out(bank_sel), .changed(bank_sel_stb));
+
+  reg live_bank, swap_pending, in_pulse;
+  wire pulse_end   = s_axis_data_tvalid & s_axis_data_tready & s_axis_data_tlast;
+  wire pulse_start = s_axis_data_tvalid & s_axis_data_tready & ~in_pulse;
+  wire boundary    = pulse_end | (~in_pulse & ~pulse_start);
+
+  always @(posedge ce_clk) begin
+    if (ce_rst) begin
+      live_bank    <= 1'b0;
+      swap_pending <= 1'b0;
+      in_pulse     <= 1'b0;
+    end else begin
+      if (pulse_end)
+        in_pulse <= 1'b0;
+      else if (pulse_start)
+        in_pulse <= 1'b1;
+
+      if (bank_sel_stb)
+        swap_pending <= 1'b1;
+      else if (swap_pending & boundary) begin
+        live_bank    <= bank_sel;
+        swap_pending <= 1'b0;
+      end
+    end
+  end
+
+  // Pulse integrator
+  //
+  // - Output records pass through wavegen_pulse_integrator, which sums
+  //   SR_INTEG_DECIM adjacent samples and SR_INTEG_NUM_PULSES pulses of
+  //   SR_INTEG_LEN samples each into one record, shifted right by
+  //   SR_INTEG_SHIFT. Cuts the output rate by num_pulses * decim.
+  // - Both counts at 0 or 1 (the reset state) bypass it.
+  // - A write to any of these registers restarts the pulse grouping.
+  //
+  localparam [7:0] SR_INTEG_NUM_PULSES = 8'd219;
+  localparam [7:0] SR_INTEG_DECIM      = 8'd220;
+  localparam [7:0] SR_INTEG_LEN        = 8'd221;
+  localparam [7:0] SR_INTEG_SHIFT      = 8'd222;
+  localparam [7:0] RB_INTEG            = 8'd13;
+
+  wire [15:0] integ_num_pulses;
+  wire integ_num_pulses_stb;
+  setting_reg #(
+    .my_addr(SR_INTEG_NUM_PULSES), .awidth(8), .width(16))
+  sr_integ_num_pulses (
+    .clk(ce_clk), .rst(ce_rst),
+    .strobe(set_stb), .addr(set_addr), .in(set_data), .out(integ_num_pulses), .changed(integ_num_pulses_stb));
+
+  wire [7:0] integ_decim;
+  wire integ_decim_stb;
+  setting_reg #(
+    .my_addr(SR_INTEG_DECIM), .awidth(8), .width(8))
+  sr_integ_decim (
+    .clk(ce_clk), .rst(ce_rst),
+    .strobe(set_stb), .addr(set_addr), .in(set_data), .out(integ_decim), .changed(integ_decim_stb));
+
+  wire [31:0] integ_len;
+  wire integ_len_stb;
+  setting_reg #(
+    .my_addr(SR_INTEG_LEN), .awidth(8), .width(32))
+  sr_integ_len (
+    .clk(ce_clk), .rst(ce_rst),
+    .strobe(set_stb), .addr(set_addr), .in(set_data), .out(integ_len), .changed(integ_len_stb));
+
+  wire [4:0] integ_shift;
+  wire integ_shift_stb;
+  setting_reg #(
+    .my_addr(SR_INTEG_SHIFT), .awidth(8), .width(5))
+  sr_integ_shift (
+    .clk(ce_clk), .rst(ce_rst),
+    .strobe(set_stb), .addr(set_addr), .in(set_data), .out(integ_shift), .changed(integ_shift_stb));
+
+  wire integ_clear = integ_num_pulses_stb | integ_decim_stb | integ_len_stb | integ_shift_stb;
+  wire [31:0] integ_records;
+  wire [15:0] integ_pulse_cnt;
+  wire integ_bypass;
+
   // Readback registers
   // rb_stb set to 1'b1 on NoC Shell
   always @(posedge ce_clk) begin
     case(rb_addr)
       8'd0 : rb_data <= {32'd0, test_reg_0};
       8'd1 : rb_data <= {32'd0, test_reg_1};
+      RB_AWG_BANK : rb_data <= {61'd0, load_bank, swap_pending, live_bank};
+      RB_INTEG    : rb_data <= {integ_records, integ_pulse_cnt, 15'd0, ~integ_bypass};
       default : rb_data <= 64'h0BADC0DE0BADC0DE;
     endcase
   end
 
-  /* Simple Loopback */
-  assign m_axis_data_tready = s_axis_data_tready;
-  assign s_axis_data_tvalid = m_axis_data_tvalid;
-  assign s_axis_data_tlast  = m_axis_data_tlast;
-  assign s_axis_data_tdata  = m_axis_data_tdata;
+  /* Simple Loopback, through the pulse integrator */
+  wavegen_pulse_integrator #(
+    .MAX_LEN_LOG2(12))
+  pulse_integrator (
+    .clk(ce_clk), .reset(ce_rst), .clear(integ_clear),
+    .num_pulses(integ_num_pulses), .decim(integ_decim), .pulse_len(integ_len), .shift(integ_shift),
+    .i_tdata(m_axis_data_tdata), .i_tlast(m_axis_data_tlast), .i_tvalid(m_axis_data_tvalid), .i_tready(m_axis_data_tready),
+    .o_tdata(s_axis_data_tdata), .o_tlast(s_axis_data_tlast), .o_tvalid(s_axis_data_tvalid), .o_tready(s_axis_data_tready),
+    .records(integ_records), .pulse_cnt(integ_pulse_cnt), .bypass(integ_bypass));
 
 endmodule
@@ -0,0 +1,127 @@
+//
+// Copyright 2016 Ettus Research
+//
+// Coherent pulse integrator and range decimator for sc16 records.
+//
+// - Every decim adjacent samples of a pulse are summed into one.
+// - The decimated pulses of num_pulses consecutive pulses are summed
+//   sample by sample into one output record, held in an accumulator
+//   RAM of 2^MAX_LEN_LOG2 entries.
+// - The sums are shifted right by shift and saturated to sc16, so a
+//   shift of log2(num_pulses * decim) gives the mean.
+// - pulse_len is the input pulse length in samples; decim must divide
+//   it and pulse_len / decim must fit the RAM. The record's last sample
+//   carries tlast.
+// - With num_pulses and decim both 0 or 1 the stream passes through
+//   unchanged, packet boundaries included.
+// - clear restarts the grouping; pulse 0 after it starts a record.
+//
+module wavegen_pulse_integrator #(
+  parameter MAX_LEN_LOG2 = 12,
+  parameter ACC_WIDTH    = 32)
+(
+  input clk, input reset, input clear,
+  input [15:0] num_pulses, input [7:0] decim, input [31:0] pulse_len, input [4:0] shift,
+  input  [31:0] i_tdata, input  i_tlast, input  i_tvalid, output i_tready,
+  output [31:0] o_tdata, output o_tlast, output o_tvalid, input  o_tready,
+  output reg [31:0] records, output reg [15:0] pulse_cnt, output bypass
+);
+
+  assign bypass = (num_pulses <= 16'd1) & (decim <= 8'd1);
+
+  wire [15:0] last_pulse_cnt = (num_pulses == 16'd0) ? 16'd0 : num_pulses - 16'd1;
+  wire [7:0]  last_dec_cnt   = (decim == 8'd0) ? 8'd0 : decim - 8'd1;
+
+  reg [7:0]              dec_cnt;
+  reg [31:0]             samp_cnt;
+  reg [MAX_LEN_LOG2-1:0] out_idx;
+  reg signed [ACC_WIDTH-1:0] dsum_i, dsum_q;
+
+  wire signed [ACC_WIDTH-1:0] x_i = {{(ACC_WIDTH-16){i_tdata[31]}}, i_tdata[31:16]};
+  wire signed [ACC_WIDTH-1:0] x_q = {{(ACC_WIDTH-16){i_tdata[15]}}, i_tdata[15:0]};
+
+  wire first_pulse = (pulse_cnt == 16'd0);
+  wire last_pulse  = (pulse_cnt == last_pulse_cnt);
+  wire pulse_end   = (samp_cnt == pulse_len - 32'd1);
+  wire dec_end     = (dec_cnt == last_dec_cnt) | pulse_end;
+
+  // Decimated sample, complete when dec_end
+  wire signed [ACC_WIDTH-1:0] cur_i = ((dec_cnt == 8'd0) ? {ACC_WIDTH{1'b0}} : dsum_i) + x_i;
+  wire signed [ACC_WIDTH-1:0] cur_q = ((dec_cnt == 8'd0) ? {ACC_WIDTH{1'b0}} : dsum_q) + x_q;
+
+  // Accumulator RAM, read one sample ahead so the sum for out_idx is
+  // ready when its decimated sample is
+  reg [2*ACC_WIDTH-1:0] acc_mem [0:(1<<MAX_LEN_LOG2)-1];
+  reg [2*ACC_WIDTH-1:0] acc_rd;
+
+  wire signed [ACC_WIDTH-1:0] acc_i = acc_rd[2*ACC_WIDTH-1:ACC_WIDTH];
+  wire signed [ACC_WIDTH-1:0] acc_q = acc_rd[ACC_WIDTH-1:0];
+  wire signed [ACC_WIDTH-1:0] sum_i = (first_pulse ? {ACC_WIDTH{1'b0}} : acc_i) + cur_i;
+  wire signed [ACC_WIDTH-1:0] sum_q = (first_pulse ? {ACC_WIDTH{1'b0}} : acc_q) + cur_q;
+
+  wire emit  = dec_end & last_pulse;
+  wire take  = i_tvalid & i_tready & ~bypass;
+  wire store = take & dec_end & ~last_pulse;
+
+  wire [MAX_LEN_LOG2-1:0] next_idx = pulse_end ? {MAX_LEN_LOG2{1'b0}} : out_idx + 1'b1;
+  wire [MAX_LEN_LOG2-1:0] rd_addr  = (take & dec_end) ? next_idx : out_idx;
+
+  always @(posedge clk) begin
+    if (store)
+      acc_mem[out_idx] <= {sum_i, sum_q};
+    // A one-sample record reads back what it just wrote
+    if (store & (rd_addr == out_idx))
+      acc_rd <= {sum_i, sum_q};
+    else
+      acc_rd <= acc_mem[rd_addr];
+  end
+
+  always @(posedge clk) begin
+    if (reset | clear) begin
+      dec_cnt   <= 8'd0;
+      samp_cnt  <= 32'd0;
+      out_idx   <= {MAX_LEN_LOG2{1'b0}};
+      pulse_cnt <= 16'd0;
+      dsum_i    <= {ACC_WIDTH{1'b0}};
+      dsum_q    <= {ACC_WIDTH{1'b0}};
+      if (reset)
+        records <= 32'd0;
+    end else if (take) begin
+      dsum_i  <= cur_i;
+      dsum_q  <= cur_q;
+      dec_cnt <= dec_end ? 8'd0 : dec_cnt + 8'd1;
+      if (dec_end)
+        out_idx <= next_idx;
+      if (pulse_end) begin
+        samp_cnt  <= 32'd0;
+        pulse_cnt <= last_pulse ? 16'd0 : pulse_cnt + 16'd1;
+        if (last_pulse)
+          records <= records + 32'd1;
+      end else begin
+        samp_cnt <= samp_cnt + 32'd1;
+      end
+    end
+  end
+
+  function [15:0] sat16;
+    input signed [ACC_WIDTH-1:0] v;
+    begin
+      if (v > 32767)
+        sat16 = 16'h7FFF;
+      else if (v < -32768)
+        sat16 = 16'h8000;
+      else
+        sat16 = v[15:0];
+    end
+  endfunction
+
+  wire signed [ACC_WIDTH-1:0] out_i = sum_i >>> shift;
+  wire signed [ACC_WIDTH-1:0] out_q = sum_q >>> shift;
+
+  // Only the record's samples go out; the rest is taken without waiting
+  assign o_tdata  = bypass ? i_tdata  : {sat16(out_i), sat16(out_q)};
+  assign o_tlast  = bypass ? i_tlast  : pulse_end;
+  assign o_tvalid = bypass ? i_tvalid : i_tvalid & emit;
+  assign i_tready = bypass ? o_tready : (~emit | o_tready);
+
+endmodule
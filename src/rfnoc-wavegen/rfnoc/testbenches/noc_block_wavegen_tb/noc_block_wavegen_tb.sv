@@ -1,6 +1,6 @@
 `timescale 1ns/1ps
 `define NS_PER_TICK 1
-`define NUM_TEST_CASES 5
+`define NUM_TEST_CASES 7
 
 `include "sim_exec_report.vh"
 `include "sim_clks_rsts.vh"
@@ -94,6 +94,68 @@ module noc_block_wavegen_tb();
       end
     join
     `TEST_CASE_DONE(1);
+
+    /********************************************************
+    ** Test 6 -- Waveform bank select
+    ********************************************************/
+    // With no pulse playing the swap applies at once
+    `TEST_CASE_START("Waveform bank select");
+    tb_streamer.read_user_reg(sid_noc_block_wavegen, noc_block_wavegen.RB_AWG_BANK, readback);
+    `ASSERT_ERROR(readback[2:0] == 3'b000, "Banks not reset to 0");
+    tb_streamer.write_user_reg(sid_noc_block_wavegen, noc_block_wavegen.SR_AWG_LOAD_BANK, 1);
+    tb_streamer.write_user_reg(sid_noc_block_wavegen, noc_block_wavegen.SR_AWG_BANK_SEL, 1);
+    tb_streamer.read_user_reg(sid_noc_block_wavegen, noc_block_wavegen.RB_AWG_BANK, readback);
+    $sformat(s, "Incorrect bank readback! Expected: 5, Actual %0d", readback[2:0]);
+    `ASSERT_ERROR(readback[2:0] == 3'b101, s);
+    tb_streamer.write_user_reg(sid_noc_block_wavegen, noc_block_wavegen.SR_AWG_BANK_SEL, 0);
+    tb_streamer.read_user_reg(sid_noc_block_wavegen, noc_block_wavegen.RB_AWG_BANK, readback);
+    `ASSERT_ERROR(readback[1:0] == 2'b00, "Bank did not swap back to 0");
+    `TEST_CASE_DONE(1);
+
+    /********************************************************
+    ** Test 7 -- Pulse integrator
+    ********************************************************/
+    // Two pulses of SPP samples, decimated by 2 and summed, come back
+    // as one record of SPP/2 samples. A shift of 2 takes the mean.
+    `TEST_CASE_START("Pulse integrator");
+    tb_streamer.write_user_reg(sid_noc_block_wavegen, noc_block_wavegen.SR_INTEG_LEN, SPP);
+    tb_streamer.write_user_reg(sid_noc_block_wavegen, noc_block_wavegen.SR_INTEG_DECIM, 2);
+    tb_streamer.write_user_reg(sid_noc_block_wavegen, noc_block_wavegen.SR_INTEG_SHIFT, 2);
+    tb_streamer.write_user_reg(sid_noc_block_wavegen, noc_block_wavegen.SR_INTEG_NUM_PULSES, 2);
+    fork
+      begin
+        for (int p = 0; p < 2; p++) begin
+          cvita_payload_t send_payload;
+          // Sample n of pulse p is I = 8n + 4p, Q = n
+          for (int i = 0; i < SPP/2; i++) begin
+            send_payload.push_back({16'(16*i + 4*p), 16'(2*i), 16'(16*i + 8 + 4*p), 16'(2*i + 1)});
+          end
+          tb_streamer.send(send_payload);
+        end
+      end
+      begin
+        cvita_payload_t recv_payload;
+        cvita_metadata_t md;
+        logic [63:0] expected_value;
+        tb_streamer.recv(recv_payload,md);
+        $sformat(s, "Incorrect record length! Expected: %0d, Received: %0d", SPP/4, recv_payload.size());
+        `ASSERT_ERROR(recv_payload.size() == SPP/4, s);
+        // Output sample j is I = 16j + 6, Q = 2j
+        for (int i = 0; i < SPP/4; i++) begin
+          expected_value = {16'(32*i + 6), 16'(4*i), 16'(32*i + 22), 16'(4*i + 2)};
+          $sformat(s, "Incorrect value received! Expected: %0d, Received: %0d", expected_value, recv_payload[i]);
+          `ASSERT_ERROR(recv_payload[i] == expected_value, s);
+        end
+      end
+    join
+    tb_streamer.read_user_reg(sid_noc_block_wavegen, noc_block_wavegen.RB_INTEG, readback);
+    `ASSERT_ERROR(readback[0] == 1'b1, "Integrator bypassed");
+    `ASSERT_ERROR(readback[63:32] == 1, "Integrator did not count one record");
+    tb_streamer.write_user_reg(sid_noc_block_wavegen, noc_block_wavegen.SR_INTEG_NUM_PULSES, 1);
+    tb_streamer.write_user_reg(sid_noc_block_wavegen, noc_block_wavegen.SR_INTEG_DECIM, 1);
+    tb_streamer.read_user_reg(sid_noc_block_wavegen, noc_block_wavegen.RB_INTEG, readback);
+    `ASSERT_ERROR(readback[0] == 1'b0, "Integrator not bypassed");
+    `TEST_CASE_DONE(1);
     `TEST_BENCH_DONE;
 
   end